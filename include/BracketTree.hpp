@@ -0,0 +1,113 @@
+#pragma once
+#include "Completion.hpp"
+#include "Grammar.hpp"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// The brackets of a document, one treap node per line in line order. Each
+// line keeps the (){}[] in its code runs, lexed with the document's grammar
+// from the state the previous line ended in, and every subtree keeps the
+// running depth of its brackets (net, lowest prefix, highest suffix). Finding
+// a partner or the enclosing scope is a descent that skips whole subtrees
+// that cannot contain it, so no query or edit walks the file from the top.
+// #if/#ifdef/#ifndef and #endif pair up the same way on a depth of their own,
+// in grammars that have directives.
+//
+// Folding lives here too, since it needs the same per-line nodes: a folded
+// line hides the lines after it, and subtrees count their visible lines so
+// rows and visible indices convert with one descent.
+class BracketTree {
+public:
+    struct Pos {
+        int row = -1;
+        int col = -1;
+        bool valid() const { return row >= 0; }
+    };
+
+private:
+    struct Bracket {
+        uint32_t col;
+        char ch;                        // '<' and '>' stand for #if and #endif
+    };
+    // Depth change over a run of lines with opener +1, closer -1
+    struct Depth {
+        int sum = 0, minPrefix = 0, maxSuffix = 0;
+    };
+    struct Node {
+        int left = -1, right = -1;
+        uint32_t priority = 0;
+        int size = 1;
+        Depth depth[2];                 // subtree: brackets, then directives
+        Depth line[2];                  // this line alone
+        uint8_t startState = 0, endState = 0;
+        bool stale = true;
+        bool hidden = false;
+        int foldSpan = 0;               // lines hidden after this one, when folded
+        int visible = 1;                // subtree lines not hidden
+        int folds = 0;                  // subtree lines folded
+        std::vector<Bracket> brackets;
+    };
+    std::vector<Node> nodes;
+    std::vector<int> freeNodes;
+    int root = -1;
+    uint32_t seed = 0x9e3779b9u;
+    const Grammar* grammar = nullptr;   // null: plain text, every bracket counts
+    std::vector<Token> tokens;
+
+    static Depth append(const Depth& a, const Depth& b);
+    int newNode();
+    uint32_t random();
+    void pull(int n);
+    void split(int t, int k, int& a, int& b);
+    int merge(int a, int b);
+    int at(int index) const;
+    void lex(Node& node, const std::string& line, uint8_t state);
+    uint8_t relex(int t, int index, const std::string& line, uint8_t state);
+    int build(int lo, int hi, const std::vector<std::string>& lines, uint8_t& state, int& height);
+    void release(int t);
+    void setFoldSpan(int t, int index, int span);
+    // Hides rows [lo, hi), or shows them apart from what folds inside still hide.
+    void setHidden(int t, int offset, int lo, int hi, bool hide, int& hideUntil);
+    void collectFolds(int t, int offset, int lo, int hi, std::vector<int>& out) const;
+
+    // First line >= from where the depth, starting at `need`, reaches zero;
+    // `need` is left at what remained entering that line.
+    int findForward(int t, int offset, int from, int channel, int& need) const;
+    // Last line <= from where the depth, counted backwards, reaches zero.
+    int findBackward(int t, int offset, int from, int channel, int& need) const;
+    Pos scanForward(int row, size_t first, int channel, int& need) const;
+    Pos scanBackward(int row, size_t end, int channel, int& need) const;
+
+public:
+    // Lexes with `g` from now on; a change relexes the whole document on
+    // the next sync and opens its folds.
+    void setGrammar(const Grammar* g);
+    // Replays line edits; the lines of `lines` are the buffer after them.
+    // A fold whose first line an edit touches is opened first.
+    void sync(const std::vector<std::string>& lines, const std::vector<LineEdit>& edits);
+    // The partner of the bracket at (row, col), if there is one there.
+    Pos match(int row, int col) const;
+    // The innermost opener still open at (row, col).
+    Pos enclosing(int row, int col) const;
+    // False inside a string, char literal or comment.
+    bool inCode(const std::string& line, int row, int col) const;
+    int lineCount() const { return root < 0 ? 0 : nodes[root].size; }
+
+    // How many lines after `row` folding it would hide: up to the line that
+    // closes the brace or #if it leaves open, else its indented block.
+    int foldable(int row, const std::vector<std::string>& lines) const;
+    void fold(int row, int span);
+    void unfold(int row);
+    void unfoldAll();
+    bool folded(int row) const;
+    bool hidden(int row) const;
+    // Opens the folds that hide `row`.
+    void reveal(int row);
+    int visibleCount() const { return root < 0 ? 0 : nodes[root].visible; }
+    // Visible lines before `row`, which is its visible index when shown.
+    int toVisible(int row) const;
+    // The row shown at a visible index, clamped to the visible lines.
+    int toRow(int visible) const;
+    size_t memoryBytes() const;
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+// Caches Quick Run binaries under data/cache. The base key hashes the build
+// command, the compiler's --version and the source; the manifest stored with
+// a binary lists every header the compiler read (from -MD) with its hash, and
+// the binary is reused only while all of them still match. Hashing runs on a
+// worker thread and the result comes back as the command to run.
+class BuildCache {
+public:
+    enum Status { NONE, CHECKING, HIT, MISS, UNCACHED };
+
+    struct Plan {
+        std::string command;            // what the Run task should execute
+        std::string key;                // empty when the build is not cached
+        std::string output;             // the -o file of the build
+        bool hit = false;
+    };
+
+private:
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> jobs;
+    bool stopping = false;
+
+    std::atomic<int> state{NONE};
+    bool planReady = false;
+    Plan plan;
+
+    // Worker thread only
+    std::unordered_map<std::string, std::string> compilerVersions;
+
+    void post(std::function<void()> job);
+    void workerLoop();
+    Plan makePlan(const std::string& buildTemplate, const std::string& file);
+    void store(const Plan& plan);
+    const std::string& compilerVersion(const std::string& compiler);
+
+public:
+    BuildCache();
+    ~BuildCache();
+
+    // Starts working out how to run `file` with the cFlags template.
+    void check(const std::string& buildTemplate, const std::string& file);
+    // UI thread: true once the plan from check() is ready.
+    bool takePlan(Plan& out);
+    // After the Run task ends: records the new binary if a miss built one.
+    void finished(const Plan& plan);
+    Status status() const { return (Status)state.load(); }
+};
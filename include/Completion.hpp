@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+class Grammar;
+
+// A line-level change to a document: `removed` lines starting at `row` were
+// replaced by `added` lines. removed < 0 means the whole buffer changed.
+struct LineEdit {
+    int row;
+    int removed;
+    int added;
+};
+
+// The identifiers of one document, per line, plus how often each occurs.
+// Kept in step with the buffer by replaying its edit log, so a keystroke
+// rescans one line instead of the file.
+struct DocWords {
+    std::vector<std::vector<uint32_t>> lines;
+    std::vector<uint8_t> stale;         // lines added by edits, not scanned yet
+    std::unordered_map<uint32_t, uint32_t> counts;
+
+    size_t memoryBytes() const;
+};
+
+// Identifier completion. Every identifier seen in any document is interned
+// once and kept in a table sorted by text, so a prefix is a binary search
+// followed by a short walk; candidates are ranked by how often they occur
+// in the current document, then in the others, with the keywords and types
+// of the document's language offered too. Each id counts its uses
+// across all documents, and words nothing uses any more (half-typed ones,
+// mostly) are reclaimed when the table is next compacted.
+class CompletionIndex {
+private:
+    std::vector<std::string> strings;
+    std::vector<uint8_t> keyword;       // of some language; never reclaimed
+    std::unordered_map<const Grammar*, std::vector<uint32_t>> languages;  // keyword ids by id
+    std::vector<uint32_t> refs;         // occurrences in all documents
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<uint32_t> sorted;       // ids ordered by text
+    std::vector<uint32_t> recent;       // interned since the last compaction, unordered
+    std::vector<uint32_t> freeIds;
+    size_t dead = 0;                    // ids in the tables with no uses
+
+    bool live(uint32_t id) const { return refs[id] > 0 || keyword[id]; }
+    void use(uint32_t id);
+    void unuse(uint32_t id);
+    void compact();
+    uint32_t intern(const std::string& word);
+    void scanLine(const std::string& line, std::vector<uint32_t>& out);
+    void addLine(DocWords& words, size_t row, const std::string& line);
+    void removeLine(DocWords& words, size_t row);
+
+public:
+    // Interns the keywords and types of `grammar`, offered in its documents.
+    void addLanguage(const Grammar* grammar);
+    // Drops `words`, e.g. when its document is closed.
+    void release(DocWords& words);
+    // Replays `edits` against `words`; the caller clears the log.
+    void sync(const std::vector<std::string>& lines, const std::vector<LineEdit>& edits, DocWords& words);
+    std::vector<std::string> complete(const std::string& prefix, const DocWords& current,
+                                      const std::vector<const DocWords*>& others, const Grammar* grammar, size_t max) const;
+    size_t memoryBytes() const;
+};
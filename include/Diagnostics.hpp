@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+enum class DiagKind { Error, Warning, Note };
+
+// One compiler message; line and col are 1-based like the compiler prints
+// them, col is 0 when the compiler gave none. `path` is made absolute so it
+// can be matched against open documents.
+struct Diagnostic {
+    std::string path;
+    int line = 0;
+    int col = 0;
+    DiagKind kind = DiagKind::Error;
+    std::string message;
+};
+
+// Picks GCC/Clang "file:line[:col]: error|warning|note: message" lines out of
+// build output as it streams in. Input may be split anywhere; colour escapes
+// are skipped and everything else on the line is ignored.
+class DiagnosticParser {
+private:
+    std::string partial;
+    std::unordered_map<std::string, std::string> resolved;   // as printed -> absolute
+
+    void parseLine(const std::string& line, std::vector<Diagnostic>& out);
+    const std::string& resolve(const std::string& path);
+
+public:
+    void feed(const char* data, size_t len, std::vector<Diagnostic>& out);
+    // Parses a last line that had no newline.
+    void finish(std::vector<Diagnostic>& out);
+};
+
+// Normalises a path the way diagnostics are keyed.
+std::string DiagnosticKey(const std::string& path);
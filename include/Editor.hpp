@@ -1,27 +1,66 @@
 #pragma once
 #include "Globals.hpp"
+#include "Diagnostics.hpp"
+#include "Completion.hpp"
+#include "BracketTree.hpp"
+#include "Grammar.hpp"
+#include "LspClient.hpp"
+#include "MemoryStats.hpp"
+#include "LinePrefetch.hpp"
+#include "ImageCache.hpp"
 #include <unordered_set>
 #include <deque>
 
 struct UndoState {
     std::vector<std::string> lines;
     int row, col;
+    size_t bytes = 0;                   // LinesBytes(lines), counted once on push
 };
 
+// What a preview tab shows in place of text
+enum class PreviewKind : uint8_t { None, Image, Audio };
+
 struct Document {
     std::string path;
     std::string filename;
     std::vector<std::string> lines;
     
+    uint64_t id = 0;                    // unique for the session, to match worker results
     int row = 0, col = 0;
     int scroll = 0;
+    float scrollFrac = 0.0f;            // how far into the `scroll` line the view starts
+    float scrollVel = 0.0f;             // lines per second, positive is down
     int selRowStart = -1, selColStart = -1;
     int selRowEnd = -1, selColEnd = -1;
     bool selecting = false;
     bool isDirty = false;
+    uint64_t version = 0;               // bumped on every edit
     std::deque<UndoState> undoStack;
+    std::vector<LineEdit> edits;        // since syncDoc last replayed them
+    DocWords words;
+    BracketTree brackets;
+    // Lexer state at the start of each line; the first lexValid are current
+    std::vector<uint8_t> lexStates;
+    size_t lexValid = 0;
+    const Grammar* lexGrammar = nullptr;
+    // Token runs per row at the editor's font size, for rows near the view
+    std::unordered_map<int, LineLayout> layouts;
+    // A tab left alone for settings.hibernateMinutes gives up its buffer,
+    // undo and indexes. What cannot be read back from disk is kept
+    // compressed in `packed`, or in swapPath once that is large.
+    bool hibernated = false;
+    double lastActive = 0.0;
+    std::vector<unsigned char> packed;
+    std::string swapPath;
+    std::vector<int> foldedRows;
+    float tabWidth = -1.0f;             // measured title width, -1 when stale
+    bool tabWidthDirty = false;         // isDirty when tabWidth was measured
+    uint64_t mruStamp = 0;              // higher = shown more recently
+    PreviewKind preview = PreviewKind::None;
 
     Document(std::string p = "");
+    // Every change to `lines` reports itself here.
+    void edited(int row, int removed = 1, int added = 1);
 };
 
 class Editor {
@@ -39,8 +78,67 @@ private:
     float backspaceDelay = 0.35f;
     float backspaceSpeed = 0.03f;
 
-    std::unordered_set<std::string> keywords;
-    std::unordered_set<std::string> types;
+    GrammarSet grammars;
+    std::vector<Token> tokens;
+    LinePrefetch prefetch;
+    LineLayout scratchLayout;
+    bool scrollTracked = false;         // a trackpad moved the view this frame
+
+    // Media preview: one tab, reused by the next image or sound opened.
+    // Images in the same folder are decoded ahead for Left/Right.
+    ImageCache images;
+    Music music = {};
+    bool musicLoaded = false;
+    std::string neighborsDir;
+    std::vector<std::string> neighbors; // images in neighborsDir, sorted
+
+    // Diagnostics from the last build: per file for drawing (sorted by line
+    // lazily, since they arrive in output order) and errors/warnings in output
+    // order for F8. diagKeys caches DiagnosticKey of document paths.
+    std::unordered_map<std::string, std::vector<Diagnostic>> diagnostics;
+    std::unordered_set<std::string> diagUnsorted;
+    std::vector<Diagnostic> diagList;
+    int diagCurrent = -1;
+    std::unordered_map<std::string, std::string> diagKeys;
+    int visibleLines = 20;
+
+    // Tab strip: title widths are cached per document and laid out as
+    // running offsets, so a frame only looks at the tabs in view.
+    std::vector<float> tabOffsets;      // left edge of each tab, then the total
+    bool tabLayoutStale = true;
+    float tabScroll = 0.0f;
+    int tabScrolledTo = -1;             // tab last brought into view
+    bool tabMenuOpen = false;
+    std::string tabFilter;
+    int tabMenuSel = 0;
+    uint64_t mruCounter = 0;
+    std::vector<int> mruCycle;          // Ctrl+Tab order, held while Ctrl is down
+    int mruPos = 0;
+    std::string definitionRequest;      // word under F12 / Ctrl+click, taken by popDefinitionRequest
+
+    CompletionIndex completion;
+    bool completionOpen = false;
+    std::vector<std::string> completionItems;
+    int completionSel = 0;
+    int completionRow = 0;
+    int completionCol = 0;              // where the word being completed starts
+    int completionTab = -1;
+
+    // Language server: hover popup, extra completions and Shift+F12 results.
+    // Only the newest request of each kind is waited for.
+    LspClient* lsp = nullptr;
+    int64_t hoverId = 0;
+    std::string hoverText;
+    int hoverTab = -1, hoverRow = 0, hoverCol = 0;
+    uint64_t hoverVersion = 0;
+    Vector2 hoverMouse = {0, 0};
+    float hoverStill = 0.0f;            // seconds the mouse has rested
+    bool hoverByMouse = false;
+    int64_t completionId = 0;
+    int64_t referencesId = 0;
+    std::string referencesWord;
+    std::vector<LspClient::Location> references;
+    bool referencesReady = false;
 
     Document& currentDoc();
     void pushUndo();
@@ -56,25 +154,105 @@ private:
     
     void deleteCharBackwards();
     void deleteWordBackwards();
-    void drawLine(const Document& doc, int lineIdx, int x, int y);
+    std::string wordAt(const Document& doc, int row, int col);
+    void jumpTo(Document& doc, int line, int col);
+    void updateCompletion(Document& doc);
+    void acceptCompletion(Document& doc);
+    void drawCompletion(Rectangle content, const Document& doc);
+    void requestHover(Document& doc, int row, int col);
+    void drawHover(Rectangle content, const Document& doc);
+    void closeTab(int index);
+    void layoutTabs();
+    std::vector<int> mruOrder();
+    // Tabs in MRU order whose name or path contains the filter.
+    std::vector<int> tabMenuItems();
+    // False when the strip or its menu took the input this frame.
+    bool updateTabs(Rectangle strip);
+    void drawTabs(Rectangle strip);
+    void drawTabMenu(Rectangle strip);
+    double hibernateCheck = 0.0;
+    uint64_t nextSwap = 1;
+    void hibernate(Document& doc);
+    void wake(Document& doc);
+    void hibernateIdle();
+    void stopAudio();
+    // Path of the image `step` places from `path` in its folder, or "".
+    std::string neighborImage(const std::string& path, int step);
+    void updatePreview(Rectangle content, Document& doc);
+    void drawPreview(Rectangle content, Document& doc);
+    // Brings the document's word index and bracket tree up to its edits.
+    void syncDoc(Document& doc);
+    void drawBrackets(Rectangle content, const Document& doc);
+    // Brings lexStates up to date through `row` for the document's grammar.
+    void lexUpTo(Document& doc, int row);
+    // Where `row` sits on screen, in lines below the top
+    int screenLine(const Document& doc, int row);
+    // Top of `row` in pixels, for content starting at `top`
+    float rowY(const Document& doc, float top, int row);
+    // Moves the view by whole and part lines, stopping at either end.
+    void scrollBy(Document& doc, float lines);
+    // Cached runs of `row`; laid out now if the worker has not got to it.
+    const LineLayout& lineLayout(Document& doc, int row);
+    // Queues the rows past the edge the view is moving towards.
+    void prefetchLines(Document& doc, int vis);
+    void applyPrefetch(LinePrefetch::Result& res);
+    void foldAt(Document& doc);
+    void foldAll(Document& doc);
+    const std::vector<Diagnostic>* diagnosticsFor(const Document& doc);
+    void drawLine(Document& doc, int lineIdx, int x, int y, const std::vector<Diagnostic>* diags);
+    void drawDiagnostics(const std::string& text, const std::vector<Diagnostic>& diags, int lineIdx, int x, int y);
 
 public:
     Editor();
+    ~Editor();
     void init(Font f);
     void updateFontMetrics();
     void reloadFont(Font f);
     
     void createNewFile();
     void loadFile(const std::string& path);
+    // Shows an image or sound file in the preview tab.
+    void setPreview(const std::string& path);
+    // Frees textures and the audio stream while the window is still open.
+    void cleanup();
     void saveFile(); 
     void saveAs(); 
 
     std::string getCurrentPath();
+    uint64_t getCurrentVersion();
+    std::string getCurrentText();
+    std::string popDefinitionRequest();
+    // Opens `path` (or its tab) with the cursor on a 1-based line and column.
+    void openAt(const std::string& path, int line, int col = 1);
     
     void selectAll();
     void copyToClipboard();
     void pasteFromClipboard(); 
 
+    void clearDiagnostics();
+    void addDiagnostics(std::vector<Diagnostic>& batch);
+    // Replaces whatever is shown for `path` with a background check's result.
+    void setFileDiagnostics(const std::string& path, const std::vector<Diagnostic>& diags);
+    // F8 / Shift+F8: opens the next or previous error or warning.
+    void nextDiagnostic(int direction);
+
+    // The editor keeps open C/C++ documents in step with the server and
+    // sends it hover, completion and reference requests.
+    void setLanguageClient(LspClient* client) { lsp = client; }
+    // Hover and completion answers; references are kept for popReferences.
+    void languageEvent(const LspClient::Event& ev);
+    // The result of the last Shift+F12, once it has arrived.
+    bool popReferences(std::string& word, std::vector<LspClient::Location>& out);
+
+    // Lexing speed per loaded grammar, as one line for a toast.
+    std::string benchmarkLexers();
+
+    // Bytes held per document: text, undo snapshots, indexes.
+    void memoryUsage(MemoryReport& report);
+    // Drops undo snapshots, oldest first and background tabs before the
+    // current one, until about `want` bytes are freed; returns what was.
+    size_t trimUndo(size_t want);
+
     void update(Rectangle bounds, bool isFocused);
     void render(Rectangle bounds);
 };
\ No newline at end of file
@@ -12,6 +12,7 @@ extern std::string SaveWindowsFileDialog(const char* defaultName = nullptr);
 class FileManager {
 private:
     fs::path currentPath;
+    std::string openedRoot;             // set when a folder is picked, taken by popOpenedRoot
     std::vector<fs::directory_entry> entries;
     int scrollIndex = 0;
     float itemHeight = 24.0f;
@@ -28,6 +29,7 @@ public:
     void openFolderDialog();
     void openFileDialog();
     std::string popSelectedFile();
+    std::string popOpenedRoot();
     
     void update(Rectangle bounds, bool isFocused);
     void render(Rectangle bounds, Font font);
@@ -55,6 +55,14 @@ struct Theme {
 
 enum class LayoutMode { Standard, Widescreen, Focus };
 
+// A named command for the task scheduler. $JOBS expands to the core count
+// and $FILE to the file open in the editor.
+struct TaskDef {
+    std::string name;
+    std::vector<std::string> deps;
+    std::string command;
+};
+
 struct AppSettings {
     int fontSize = Config::FONT_SIZE_EDITOR_DEFAULT;
     int sidebarWidth = 250;
@@ -66,6 +74,19 @@ struct AppSettings {
     std::string cFlags = "g++ \"$FILE\" -o temp_run && temp_run";
     bool imagePreview = true;
     bool audioPreview = true;
+    int scrollbackLines = 10000;
+    bool scrollbackSpill = false;       // keep evicted terminal lines on disk
+    int syntaxCheckDelay = 600;         // ms of quiet before a background check, 0 = off
+    std::string lspCommand = "clangd";  // language server for opened folders, empty = none
+    int memoryBudgetMB = 1024;          // undo, then scrollback, is trimmed past this; 0 = off
+    int hibernateMinutes = 10;          // background tabs untouched this long are packed away; 0 = off
+    int previewCacheMB = 128;           // decoded preview images kept as textures
+    std::vector<TaskDef> tasks = {
+        {"build", {}, "make -j$JOBS"},
+        {"test", {"build"}, "make -j$JOBS test"},
+        {"lint", {}, "make lint"},
+        {"run", {"build"}, "make run"},
+    };
     
     LayoutMode layout = LayoutMode::Standard;
     int themeIndex = 0; 
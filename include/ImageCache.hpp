@@ -0,0 +1,76 @@
+#pragma once
+#include "MemoryStats.hpp"
+#include <raylib.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Images for preview tabs. Files are read, decoded and scaled down to the
+// size they are shown at on a worker thread, newest request first; the main
+// thread only uploads the finished pixels. Textures stay in an LRU cache
+// under a byte budget, so going back to a recent image costs nothing.
+class ImageCache {
+public:
+    struct Entry {
+        Texture2D texture = {};
+        int sourceWidth = 0;            // before scaling down
+        int sourceHeight = 0;
+        bool failed = false;            // could not be read or decoded
+    };
+
+private:
+    struct Job {
+        std::string path;
+        int maxWidth, maxHeight;
+    };
+    struct Decoded {
+        std::string path;
+        Image image;
+        int sourceWidth, sourceHeight;
+    };
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Job> jobs;               // front is taken first
+    std::deque<Decoded> done;
+    bool stopping = false;
+
+    // Main thread only
+    std::list<std::string> lru;         // most recently used first
+    struct Slot {
+        Entry entry;
+        std::list<std::string>::iterator use;
+    };
+    std::unordered_map<std::string, Slot> entries;
+    std::unordered_set<std::string> loading;
+    size_t used = 0;
+    size_t budget = 128u << 20;
+
+    void workerLoop();
+    void queue(const std::string& path, int maxWidth, int maxHeight, bool urgent);
+    void evict(const std::string& keep);
+
+public:
+    ImageCache();
+    ~ImageCache();
+
+    void setBudget(size_t bytes);
+    // `path` fitted into maxWidth x maxHeight, or null while it decodes. A
+    // cached texture much smaller than now needed is decoded again and
+    // shown meanwhile.
+    const Entry* get(const std::string& path, int maxWidth, int maxHeight);
+    // Decodes `path` behind anything asked for with get(), if not cached.
+    void prefetch(const std::string& path, int maxWidth, int maxHeight);
+    // Turns one finished decode into a texture; call once a frame.
+    void upload();
+    void memoryUsage(MemoryReport& report);
+    // Unloads every texture; needs the window still open.
+    void clear();
+};
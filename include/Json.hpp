@@ -0,0 +1,62 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+// A JSON value, enough for the language server protocol. Objects keep their
+// members in order in a vector; messages are small and looked up a handful of
+// times, so that beats hashing. Lookups of absent keys or out of range items
+// give null instead of throwing, so optional fields read as defaults.
+class Json {
+public:
+    enum Type : uint8_t { Null, Bool, Number, String, Array, Object };
+
+private:
+    Type kind = Null;
+    bool flag = false;
+    double number = 0.0;
+    std::string text;
+    std::vector<Json> list;
+    std::vector<std::pair<std::string, Json>> fields;
+
+    void dumpTo(std::string& out) const;
+
+public:
+    Json() {}
+    Json(bool b) : kind(Bool), flag(b) {}
+    Json(int n) : kind(Number), number(n) {}
+    Json(int64_t n) : kind(Number), number((double)n) {}
+    Json(double n) : kind(Number), number(n) {}
+    Json(const char* s) : kind(String), text(s) {}
+    Json(std::string s) : kind(String), text(std::move(s)) {}
+    static Json array();
+    static Json object();
+
+    Type type() const { return kind; }
+    bool isNull() const { return kind == Null; }
+    bool isString() const { return kind == String; }
+    bool isArray() const { return kind == Array; }
+    bool isObject() const { return kind == Object; }
+
+    const Json& operator[](const std::string& key) const;
+    const Json& operator[](size_t index) const;
+    bool has(const std::string& key) const;
+    size_t size() const { return kind == Array ? list.size() : fields.size(); }
+    const std::vector<Json>& items() const { return list; }
+    const std::vector<std::pair<std::string, Json>>& members() const { return fields; }
+
+    // The value, or `fallback` when it is of another type.
+    const std::string& str() const;
+    double num(double fallback = 0.0) const { return kind == Number ? number : fallback; }
+    int64_t integer(int64_t fallback = 0) const { return kind == Number ? (int64_t)number : fallback; }
+    bool boolean(bool fallback = false) const { return kind == Bool ? flag : fallback; }
+
+    // Builders; set replaces a member of the same name.
+    Json& set(const std::string& key, Json value);
+    Json& push(Json value);
+
+    std::string dump() const;
+    // False when `text` is not one complete JSON value.
+    static bool parse(const std::string& text, Json& out);
+};
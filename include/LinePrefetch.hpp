@@ -0,0 +1,75 @@
+#pragma once
+#include "Grammar.hpp"
+#include <raylib.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+// A line cut into token runs, with where each run starts in pixels from the
+// line's left edge at one font size.
+struct LineLayout {
+    std::vector<Token> tokens;
+    std::vector<float> runX;
+};
+
+// Lexes `text` from `state` (plain text without a grammar) and measures its
+// runs. Returns the state the next line starts in.
+uint8_t LayoutLine(const std::string& text, const Grammar* grammar, uint8_t state, Font font, float fontSize, LineLayout& out);
+
+// Lays out the lines just past the edge the editor is scrolling towards on a
+// worker thread, so a fast flick does not lex and measure a screenful of new
+// lines in one frame. Requests carry copies of their lines; only the newest
+// one waits, and the editor checks a result's document version before use.
+class LinePrefetch {
+public:
+    struct Request {
+        uint64_t doc = 0;               // Document::id
+        uint64_t version = 0;
+        const Grammar* grammar = nullptr;
+        Font font = {};
+        float fontSize = 0.0f;
+        int first = 0;                  // row of lines[0]
+        uint8_t state = 0;              // lexer state at the start of `first`
+        int layoutFrom = 0;             // rows above this are lexed for their states only
+        std::vector<std::string> lines;
+    };
+    struct Result {
+        uint64_t doc = 0;
+        uint64_t version = 0;
+        const Grammar* grammar = nullptr;
+        float fontSize = 0.0f;
+        int first = 0;
+        std::vector<uint8_t> states;    // at the start of rows first+1, first+2, ...
+        int layoutFrom = 0;
+        std::vector<LineLayout> layouts;
+    };
+
+private:
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::condition_variable idle;
+    Request queued;
+    bool hasQueued = false;
+    bool busy = false;
+    bool stopping = false;
+    std::deque<Result> results;
+
+    void workerLoop();
+
+public:
+    LinePrefetch();
+    ~LinePrefetch();
+
+    void submit(Request req);
+    bool takeResult(Result& out);
+    // True from submit until its result has been taken.
+    bool pending();
+    // Drops the queued request and waits out the running one, e.g. before
+    // the font it measures with is unloaded.
+    void cancel();
+};
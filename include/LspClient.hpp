@@ -0,0 +1,134 @@
+#pragma once
+#include "Diagnostics.hpp"
+#include "Completion.hpp"
+#include "Json.hpp"
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+// A language server (clangd by default) run as a child process and spoken to
+// with JSON-RPC over its stdin and stdout. The UI thread only queues
+// operations and drains finished events; framing, serializing, parsing and
+// answering the server's own requests all happen on an I/O thread, so a slow
+// or dead server never holds up a frame. Open documents are kept in step
+// with incremental didChange ranges built from the Document edit log.
+class LspClient {
+public:
+    enum class EventKind { Diagnostics, Hover, Completion, References, Exited };
+    struct Location {
+        std::string path;
+        int line = 0;                   // 1-based
+        int col = 0;
+    };
+    struct Event {
+        EventKind kind = EventKind::Diagnostics;
+        int64_t id = 0;                 // the request answered, 0 for notifications
+        std::string path;
+        std::string text;               // hover text, or why the server exited
+        std::vector<std::string> items;             // completion insert texts
+        std::vector<Diagnostic> diagnostics;
+        std::vector<Location> locations;
+    };
+
+private:
+    enum class OpKind { Open, Change, Close, Hover, Completion, References, Shutdown };
+    // A position in both encodings; which one is sent depends on what the
+    // server picks during initialize, which may still be pending when queued.
+    struct Position {
+        int line = 0;
+        int col8 = 0;
+        int col16 = 0;
+    };
+    struct Op {
+        OpKind kind = OpKind::Open;
+        int64_t id = 0;
+        std::string uri;
+        std::string text;               // full text, or what replaces the range
+        int version = 0;
+        bool ranged = false;
+        Position start, end;
+    };
+    struct Pending {
+        OpKind kind;
+        std::string path;
+    };
+    struct DocState {
+        int version = 0;
+        int lineCount = 0;
+        Position lastEnd;               // end of the last line, as the server has it
+    };
+
+    std::thread io;
+#ifdef _WIN32
+    std::thread reader;
+    void* toServer = nullptr;           // pipe HANDLEs
+    void* fromServer = nullptr;
+#else
+    int toServer = -1;
+    int fromServer = -1;
+    int wake[2] = {-1, -1};
+#endif
+    intptr_t process = 0;               // pid, or the process HANDLE on Windows
+    std::string rootUri;
+
+    // Shared with the I/O thread
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Op> ops;
+    std::string replies;                // framed answers to requests from the server
+    std::deque<Event> events;
+    std::unordered_map<int64_t, Pending> inflight;
+    bool initialized = false;
+    bool utf8 = false;                  // positions in bytes rather than UTF-16 units
+    bool stopping = false;
+    std::atomic<bool> alive{false};
+
+    // UI thread only
+    std::unordered_map<std::string, DocState> docs;
+    int64_t nextId = 2;                 // 1 is initialize
+
+    void push(Op op);
+    void ioLoop();
+#ifdef _WIN32
+    void readLoop();
+#endif
+    // Appends the queued replies and operations to `out`, framed; operations
+    // wait until the server has answered initialize.
+    void drain(std::string& out);
+    std::string encode(const Op& op, bool utf8);
+    // Splits complete messages off the front of `in` and handles them.
+    void receive(std::string& in);
+    void handle(const Json& msg);
+    void exited(const std::string& why);
+    int64_t request(OpKind kind, const std::string& path, const std::vector<std::string>& lines, int row, int col);
+    static Position positionIn(const std::string& line, int row, int col);
+
+public:
+    ~LspClient();
+
+    // Starts `command` (program and arguments, quotes allowed) for the folder
+    // `root`; a server already running is stopped first.
+    bool start(const std::string& command, const std::string& root);
+    // Asks the server to shut down, giving it `grace` seconds before a kill.
+    void stop(double grace = 0.0);
+    bool running() const { return alive; }
+    // Whether `path` is something the server is sent.
+    bool serves(const std::string& path) const;
+
+    // Opens `path` with the server, or sends what `edits` changed since the
+    // last call; `lines` is the buffer after them.
+    void sync(const std::string& path, const std::vector<std::string>& lines, const std::vector<LineEdit>& edits);
+    void close(const std::string& path);
+    // Requests at a 0-based row and byte column; each returns the id its
+    // event will carry, or 0 when nothing was sent.
+    int64_t hover(const std::string& path, const std::vector<std::string>& lines, int row, int col);
+    int64_t completion(const std::string& path, const std::vector<std::string>& lines, int row, int col);
+    int64_t references(const std::string& path, const std::vector<std::string>& lines, int row, int col);
+    bool poll(Event& out);
+};
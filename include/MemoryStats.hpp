@@ -0,0 +1,42 @@
+#pragma once
+#include <raylib.h>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Bytes held by one thing the editor keeps: a document's text, its undo
+// snapshots, a terminal's scrollback, a texture. Sizes count what the
+// containers hold, not allocator overhead, so they add up to less than the
+// process's resident size; the difference is libraries, GPU driver state
+// and heap slack.
+struct MemoryEntry {
+    std::string group;                  // "Documents", "Undo", "Scrollback", ...
+    std::string name;
+    size_t bytes = 0;
+};
+
+class MemoryReport {
+private:
+    std::vector<MemoryEntry> entries;
+
+public:
+    void add(const std::string& group, const std::string& name, size_t bytes);
+    size_t total() const;
+    // Per group, largest first.
+    std::vector<MemoryEntry> groups() const;
+    // Entries largest first, at most `max`.
+    std::vector<MemoryEntry> largest(size_t max) const;
+    // Every entry by group, as text for data/memory.txt.
+    std::string dump() const;
+};
+
+size_t StringBytes(const std::string& s);
+size_t LinesBytes(const std::vector<std::string>& lines);
+size_t TextureBytes(const Texture2D& texture);
+// Colour texture plus the depth buffer raylib attaches.
+size_t RenderTextureBytes(const RenderTexture2D& target);
+size_t FontBytes(const Font& font);
+// "12.3 MB"
+std::string FormatBytes(size_t bytes);
+// Resident set size of the whole process, 0 where it cannot be read.
+size_t ProcessResidentBytes();
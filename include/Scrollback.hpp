@@ -0,0 +1,107 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Colour kinds live in the top byte of a packed colour, the low 24 bits hold
+// either a palette index (0-255) or 0xRRGGBB.
+enum : uint32_t {
+    TC_DEFAULT = 0,
+    TC_INDEXED = 1u << 24,
+    TC_RGB     = 2u << 24,
+    TC_KIND    = 0xFFu << 24
+};
+
+enum : uint8_t {
+    TA_BOLD      = 1,
+    TA_UNDERLINE = 2,
+    TA_INVERSE   = 4
+};
+
+#pragma pack(push, 1)
+struct TermStyle {
+    uint32_t fg = TC_DEFAULT;
+    uint32_t bg = TC_DEFAULT;
+    uint8_t attrs = 0;
+
+    bool operator==(const TermStyle& o) const { return fg == o.fg && bg == o.bg && attrs == o.attrs; }
+    bool operator!=(const TermStyle& o) const { return !(*this == o); }
+};
+
+// Style applies from byte `start` of the line up to the next run.
+struct StyleRun {
+    uint32_t start;
+    TermStyle style;
+};
+#pragma pack(pop)
+
+inline uint32_t TermIndexed(int idx) { return TC_INDEXED | (uint32_t)(idx & 0xFF); }
+inline uint32_t TermRgb(int r, int g, int b) { return TC_RGB | ((uint32_t)(r & 0xFF) << 16) | ((uint32_t)(g & 0xFF) << 8) | (uint32_t)(b & 0xFF); }
+
+// Read-only view of a stored line. Pointers stay valid until the next push.
+struct ScrollLine {
+    const char* text = nullptr;
+    uint32_t len = 0;
+    const StyleRun* runs = nullptr;
+    uint32_t runCount = 0;
+};
+
+// Receives lines as they fall off the front of a Scrollback. Called from
+// whichever thread modifies the scrollback, with the same locks held.
+class ScrollbackSink {
+public:
+    virtual ~ScrollbackSink() {}
+    virtual void evicted(uint64_t id, const ScrollLine& line) = 0;
+    virtual void cleared() = 0;
+};
+
+// Fixed-capacity ring of terminal lines. Text and style runs are stored in two
+// shared ring arenas addressed by monotonic offsets, so appending a line and
+// evicting the oldest one are both O(1) and nothing is reallocated per line.
+class Scrollback {
+private:
+    struct Slot {
+        uint64_t textOff;
+        uint64_t runOff;
+        uint32_t len;
+        uint32_t runCount;
+    };
+
+    std::vector<Slot> slots;
+    size_t head = 0;        // index of the oldest line in `slots`
+    size_t count = 0;
+    uint64_t evicted = 0;   // lines dropped so far, including cleared ones
+
+    std::vector<char> text;
+    uint64_t textEnd = 0;
+    std::vector<StyleRun> runs;
+    uint64_t runEnd = 0;
+    ScrollbackSink* sink = nullptr;
+
+    void evictOldest();
+
+public:
+    explicit Scrollback(size_t maxLines = 10000);
+
+    void setCapacity(size_t maxLines);
+    // Lowers the line limit, and the arenas with it, keeping the newest lines;
+    // the ones that no longer fit go to the sink as evictions. Ids do not move.
+    void shrink(size_t maxLines);
+    void setSink(ScrollbackSink* s) { sink = s; }
+    void clear();
+    void push(const char* str, size_t len, const StyleRun* lineRuns, size_t runCount);
+    // Extends the newest line, e.g. with the rest of a soft-wrapped row.
+    // Run starts are relative to the appended text.
+    void appendToLast(const char* str, size_t len, const StyleRun* lineRuns, size_t runCount);
+
+    ScrollLine line(size_t i) const;    // 0 = oldest
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t capacity() const { return slots.size(); }
+
+    // Absolute ids keep increasing across evictions; id - firstId() is the index.
+    uint64_t firstId() const { return evicted; }
+    uint64_t endId() const { return evicted + count; }
+
+    size_t memoryBytes() const;
+};
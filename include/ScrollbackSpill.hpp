@@ -0,0 +1,86 @@
+#pragma once
+#include "Scrollback.hpp"
+#include "TermScreen.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Keeps the lines a Scrollback evicts. They are packed into segments of a few
+// hundred KB; a writer thread deflates full segments with CompressData and
+// appends them to one file, and segments are paged back in (through a small
+// cache of decompressed ones) when the view scrolls into old history.
+class ScrollbackSpill : public ScrollbackSink {
+public:
+    // Packed lines: u32 length, u32 run count, text, runs
+    struct RawSegment {
+        uint64_t firstId = 0;
+        std::vector<unsigned char> data;
+        std::vector<uint32_t> offsets;
+    };
+
+    struct Segment {
+        uint64_t firstId;
+        uint32_t lines;
+        uint64_t fileOffset;
+        uint32_t compSize;
+    };
+
+    // Everything spilled at one moment, for writing out a log.
+    struct Snapshot {
+        std::vector<Segment> segments;
+        std::vector<std::shared_ptr<RawSegment>> pending;
+        uint64_t end = 0;
+    };
+
+private:
+    std::string path;
+    FILE* writeFile = nullptr;
+    FILE* readFile = nullptr;
+    uint64_t fileEnd = 0;               // only touched by the writer thread
+
+    mutable std::mutex mutex;
+    std::vector<Segment> segments;                  // on disk, oldest first
+    std::deque<std::shared_ptr<RawSegment>> sealed; // full, waiting for the writer
+    std::shared_ptr<RawSegment> open;               // being filled
+    uint64_t first = 0;
+    uint64_t end = 0;
+    std::vector<std::pair<size_t, std::shared_ptr<RawSegment>>> cache;  // most recent last
+    bool failing = false;               // the last write did not make it to disk
+    bool rewind = false;                // nothing on disk is needed: truncate it
+
+    std::thread writer;
+    std::condition_variable writerCv;
+    bool stopping = false;
+
+    void writerLoop();
+    std::shared_ptr<RawSegment> load(size_t index);
+    std::shared_ptr<RawSegment> readSegment(FILE* f, const Segment& seg) const;
+
+public:
+    static const size_t WRITE_BLOCK = 4 << 20;    // log output is written in blocks this big
+
+    explicit ScrollbackSpill(const std::string& path);
+    ~ScrollbackSpill();
+
+    // False if the file could not be opened, and while writes to it fail.
+    bool ok() const;
+    bool empty() const;
+    uint64_t firstId() const;
+    uint64_t endId() const;
+
+    // Copies a spilled line out; false if `id` is not held.
+    bool line(uint64_t id, TerminalLine& out);
+
+    Snapshot snapshot() const;
+    // Appends the text of every line in `snap` to `buffer`, handing it to
+    // `out` in large blocks as it fills.
+    bool writeText(const Snapshot& snap, std::string& buffer, FILE* out) const;
+
+    void evicted(uint64_t id, const ScrollLine& line) override;
+    void cleared() override;
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include <cstring>
+#include <cstddef>
+
+// Lock-free single-producer/single-consumer byte ring. One thread may call
+// write() while another calls read(); the capacity is rounded up to a power
+// of two so positions wrap with a mask.
+class SpscRing {
+private:
+    std::vector<char> buf;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{0};   // advanced by the producer
+    alignas(64) std::atomic<size_t> tail{0};   // advanced by the consumer
+
+public:
+    explicit SpscRing(size_t capacity = 1 << 20) {
+        size_t cap = 1024;
+        while (cap < capacity) cap <<= 1;
+        buf.resize(cap);
+        mask = cap - 1;
+    }
+
+    size_t capacity() const { return buf.size(); }
+    size_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+    size_t space() const { return buf.size() - size(); }
+
+    // Producer side: copies as much as fits and returns the byte count.
+    size_t write(const char* data, size_t len) {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t t = tail.load(std::memory_order_acquire);
+        size_t n = std::min(len, buf.size() - (h - t));
+        size_t pos = h & mask;
+        size_t first = std::min(n, buf.size() - pos);
+        memcpy(&buf[pos], data, first);
+        memcpy(&buf[0], data + first, n - first);
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+
+    // Consumer side: copies up to len bytes out and returns the byte count.
+    size_t read(char* out, size_t len) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t h = head.load(std::memory_order_acquire);
+        size_t n = std::min(len, h - t);
+        size_t pos = t & mask;
+        size_t first = std::min(n, buf.size() - pos);
+        memcpy(out, &buf[pos], first);
+        memcpy(out + first, &buf[0], n - first);
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+    // Only valid while neither side is running.
+    void reset() {
+        head.store(0);
+        tail.store(0);
+    }
+};
@@ -0,0 +1,77 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+enum class SymbolKind : uint8_t { Function, Class, Struct, Enum, Macro, Namespace };
+
+struct Symbol {
+    std::string name;                   // unqualified, what go-to-definition matches
+    std::string scope;                  // "A::" for out-of-class member definitions
+    int line = 0;                       // 1-based
+    SymbolKind kind = SymbolKind::Function;
+};
+
+struct SymbolLocation {
+    Symbol symbol;
+    std::string path;                   // root joined with the file's path
+};
+
+// Definitions across the open folder, found by a hand-written C/C++ scanner
+// (no preprocessing, no types: good enough to jump to a definition). Files
+// are scanned in parallel on background threads; the result is saved under
+// data/index/ and reloaded on the next open, where only files whose size or
+// mtime changed are scanned again. Queries read an immutable snapshot, so the
+// UI never waits on the indexer.
+class SymbolIndex {
+public:
+    struct File {
+        std::string path;               // relative to the root
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        std::vector<Symbol> symbols;
+    };
+    struct Snapshot {
+        std::string root;
+        std::vector<File> files;
+        // (file, symbol) pairs sorted by name, for lookups by exact name
+        std::vector<std::pair<uint32_t, uint32_t>> byName;
+        // The same pairs sorted by lowercased name, for search(): the
+        // lowercased names, each ended by '\n', and where each one starts
+        std::vector<std::pair<uint32_t, uint32_t>> byLower;
+        std::string lowerText;
+        std::vector<uint32_t> lowerStart;
+    };
+
+private:
+    std::thread worker;
+    std::atomic<bool> cancel{false};
+    std::atomic<bool> busy{false};
+    std::mutex mutex;
+    std::shared_ptr<const Snapshot> current;
+
+    void build(std::string root);
+    static std::string cachePath(const std::string& root);
+    static bool load(const std::string& path, Snapshot& out);
+    static void save(const std::string& path, const Snapshot& snap);
+
+public:
+    ~SymbolIndex();
+
+    // Starts (re)indexing `root`; a build already running is abandoned.
+    void open(const std::string& root);
+    bool indexing() const { return busy; }
+    std::shared_ptr<const Snapshot> snapshot();
+
+    std::vector<SymbolLocation> lookup(const std::string& name);
+    // Case-insensitive substring matches, prefix matches first.
+    std::vector<SymbolLocation> search(const std::string& query, size_t max);
+};
+
+// Scans one C/C++ source for definitions.
+void ScanSymbols(const std::string& text, std::vector<Symbol>& out);
+const char* SymbolKindName(SymbolKind kind);
@@ -0,0 +1,80 @@
+#pragma once
+#include "Diagnostics.hpp"
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+// Compile-as-you-type: once a buffer has been still for the configured delay
+// its text is piped to the compiler with -fsyntax-only on a small pool of
+// workers. A newer submit for the same file drops the queued run and kills the
+// running one. Results are cached by content hash, so undoing back to a text
+// that was checked before shows its diagnostics at once. The UI thread only
+// ever sees finished lists, through takeResult().
+class SyntaxChecker {
+public:
+    struct Result {
+        std::string path;
+        std::vector<Diagnostic> diagnostics;
+    };
+
+private:
+    struct Job {
+        std::string path;
+        std::string text;
+        std::vector<std::string> args;  // compiler and flags, without the input
+        uint64_t key = 0;
+        uint64_t generation = 0;
+    };
+    struct Running {
+        std::string path;
+        uint64_t generation = 0;
+        intptr_t process = 0;           // pid, or the process HANDLE on Windows
+        bool killed = false;
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Job> jobs;
+    std::vector<Running> running;
+    bool stopping = false;
+    // Latest submit per file; anything older is stale
+    std::unordered_map<std::string, uint64_t> generations;
+    uint64_t nextGeneration = 1;
+    std::deque<Result> results;
+
+    std::unordered_map<uint64_t, std::vector<Diagnostic>> cache;
+    std::deque<uint64_t> cacheOrder;
+
+    // Debounce state, UI thread only
+    std::string watchPath;
+    uint64_t watchVersion = 0;
+    uint64_t submittedVersion = 0;
+    bool submitted = false;
+    double changedAt = 0.0;
+
+    void workerLoop();
+    bool runCompiler(const Job& job, std::string& output);
+    void killRunning(uint64_t generation);
+    void deliver(const std::string& path, uint64_t generation, std::vector<Diagnostic> diags);
+
+public:
+    SyntaxChecker();
+    ~SyntaxChecker();
+
+    // Call every frame with the open buffer's path and edit counter; true
+    // once that version has settled for `delay` seconds and should be sent.
+    bool settle(const std::string& path, uint64_t version, double now, double delay);
+    // `buildTemplate` is settings.cFlags; the part before "&&" supplies the
+    // compiler and its flags.
+    void submit(const std::string& path, const std::string& text, const std::string& buildTemplate);
+    bool takeResult(Result& out);
+};
+
+// True for files the checker should look at.
+bool IsCheckableSource(const std::string& path);
@@ -0,0 +1,39 @@
+#pragma once
+#include "Globals.hpp"
+#include "Terminal.hpp"
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Runs the tasks from settings.tasks, each in its own terminal tab. A trigger
+// queues the task and everything it depends on; every frame update() starts
+// whatever has its dependencies done, up to one task per core, so
+// independent tasks run side by side.
+class TaskScheduler {
+public:
+    enum State { IDLE, WAITING, RUNNING, SUCCEEDED, FAILED, SKIPPED };
+
+private:
+    struct Entry {
+        State state = IDLE;
+        bool restart = false;           // cancelled so it can start over
+        bool show = false;              // bring its tab forward when it starts
+        std::string file;
+    };
+    std::unordered_map<std::string, Entry> entries;
+    int maxParallel = 1;
+
+    const TaskDef* find(const std::string& name) const;
+    bool collect(const std::string& name, std::vector<std::string>& order, std::vector<std::string>& path) const;
+    void start(const TaskDef& task, Entry& entry, Terminal& terminal);
+
+public:
+    TaskScheduler();
+
+    // Queues `name` and its dependencies. A running task is cancelled and
+    // restarted; running dependencies are waited for, not restarted.
+    void trigger(const std::string& name, const std::string& file, Terminal& terminal);
+    void cancel(const std::string& name, Terminal& terminal);
+    void update(Terminal& terminal);
+    State state(const std::string& name) const;
+};
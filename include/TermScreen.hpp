@@ -0,0 +1,109 @@
+#pragma once
+#include "Scrollback.hpp"
+#include "VtParser.hpp"
+#include <string>
+#include <vector>
+
+// A line as text plus style runs, used for rows that are still on screen.
+struct TerminalLine {
+    std::string text;
+    std::vector<StyleRun> runs;
+};
+
+struct TermCell {
+    uint32_t cp = ' ';
+    TermStyle style;
+};
+
+// Character grid driven by VtParser. Rows that scroll off the top of the
+// primary screen are committed to the attached Scrollback, with soft-wrapped
+// rows joined back into one logical line so the view can rewrap them at any
+// width; the alternate screen (used by less, top, vim...) never touches it.
+class TermScreen : public VtHandler {
+private:
+    struct Cursor {
+        int x = 0, y = 0;
+        TermStyle style;
+        bool lineDrawing = false;
+    };
+
+    int numCols = 80;
+    int numRows = 24;
+    std::vector<TermCell> grid;
+    std::vector<TermCell> savedGrid;   // primary grid while the alternate screen is shown
+    std::vector<uint8_t> wrapped;      // row continues on the next row (soft wrap)
+    std::vector<uint8_t> savedWrapped;
+    std::vector<uint64_t> stamps;      // batch in which each row last changed
+    uint64_t generation = 1;
+    Scrollback* scrollback = nullptr;
+    bool joinNext = false;             // row 0 continues the newest scrollback line
+    bool savedJoinNext = false;
+
+    Cursor cur;
+    Cursor saved;
+    bool wrapPending = false;
+    int top = 0, bottom = 23;          // scroll region, inclusive
+    bool alt = false;
+    bool autoWrap = true;
+    bool insertMode = false;
+    bool newlineMode = false;          // LNM: LF also returns the carriage
+    bool appCursor = false;
+    bool cursorShown = true;
+
+    uint32_t utf8Cp = 0;
+    int utf8Need = 0;
+    std::string responses;
+    TerminalLine scratch;
+
+    TermCell* row(int r) { return &grid[(size_t)r * numCols]; }
+    const TermCell* row(int r) const { return &grid[(size_t)r * numCols]; }
+    TermCell blank() const;
+
+    void putChar(uint32_t cp);
+    void newLine();
+    void index();
+    void reverseIndex();
+    void scrollUp(int n);
+    void scrollDown(int n);
+    void clearCells(int r, int c0, int c1);
+    void clearRows(int r0, int r1);
+    void moveTo(int x, int y);
+    void setMode(int mode, bool priv, bool on);
+    void setAltScreen(bool on);
+    void commitRow(int r);
+    void touchAll();
+
+public:
+    TermScreen(int cols = 80, int rows = 24);
+
+    void attach(Scrollback* sb) { scrollback = sb; }
+    void reset();
+    void resize(int cols, int rows);
+
+    int cols() const { return numCols; }
+    int rows() const { return numRows; }
+    int cursorX() const { return cur.x; }
+    int cursorY() const { return cur.y; }
+    bool altScreen() const { return alt; }
+    bool appCursorKeys() const { return appCursor; }
+    bool cursorVisible() const { return cursorShown; }
+
+    // Rows record the batch that last modified them so a reader can copy
+    // only what changed; call beginBatch() before each chunk of input.
+    void beginBatch() { generation++; }
+    uint64_t rowStamp(int r) const { return stamps[r]; }
+
+    // Rows worth showing below the scrollback: all rows on the alternate
+    // screen, otherwise up to the cursor or the last non-blank row.
+    int usedRows() const;
+    bool rowBlank(int r) const;
+    void rowLine(int r, TerminalLine& out) const;
+
+    // Replies to device queries (DSR, DA) that must be written back to the pty
+    std::string takeResponses();
+
+    void print(const char* text, size_t len) override;
+    void execute(uint8_t ctrl) override;
+    void csiDispatch(const int* params, int paramCount, const char* inter, int interCount, char final) override;
+    void escDispatch(const char* inter, int interCount, char final) override;
+};
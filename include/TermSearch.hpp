@@ -0,0 +1,58 @@
+#pragma once
+#include "Scrollback.hpp"
+#include "TermScreen.hpp"
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+// A hit in the terminal: absolute line id plus byte range within the line.
+struct TermMatch {
+    uint64_t id;
+    uint32_t start;
+    uint32_t len;
+};
+
+// Case-insensitive search over the scrollback on a worker thread. Committed
+// lines never change, so the worker remembers how far it got and only scans
+// lines appended since; the few on-screen rows are rescanned on each pass.
+class TermSearch {
+private:
+    std::mutex& modelMutex;
+    const Scrollback& history;
+    const TermScreen& screen;
+
+    std::thread worker;
+    std::atomic<bool> running{false};
+    std::mutex wakeMutex;
+    std::condition_variable wakeCv;
+    bool outputPending = false;
+
+    // Shared with the UI thread, guarded by resultMutex
+    std::mutex resultMutex;
+    std::string query;
+    uint64_t queryGen = 0;
+    uint64_t publishedGen = 0;          // query the worker last published for
+    uint64_t collectedGen = 0;          // query the UI last collected for
+    std::vector<TermMatch> pending;
+    std::vector<TermMatch> screenHits;
+    bool truncated = false;
+
+    void run();
+
+public:
+    static const size_t MAX_MATCHES = 100000;
+
+    TermSearch(std::mutex& modelMutex, const Scrollback& history, const TermScreen& screen);
+    ~TermSearch();
+
+    void stop();
+    void setQuery(const std::string& q);
+    void notifyOutput();
+
+    // UI thread: appends new scrollback hits to `matches` (cleared first when
+    // the query changed) and replaces `onScreen`. Returns true on a reset.
+    bool collect(std::vector<TermMatch>& matches, std::vector<TermMatch>& onScreen, bool& capped);
+};
@@ -0,0 +1,242 @@
+#pragma once
+#include "Globals.hpp"
+#include "Scrollback.hpp"
+#include "ScrollbackSpill.hpp"
+#include "TermScreen.hpp"
+#include "VtParser.hpp"
+#include "SpscRing.hpp"
+#include "TermSearch.hpp"
+#include "Diagnostics.hpp"
+#include "MemoryStats.hpp"
+#include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+// One styled piece of a row, positioned in pixels from the row's left edge.
+struct TermGlyphRun {
+    std::string text;
+    float x;
+    float w;
+    TermStyle style;
+};
+
+// UI-side copy of one visible row; `stamp` tells whether it is still current.
+// Scrollback lines are wrapped at draw time, so a row is the `sub`-th piece of
+// line `id`, starting `byteStart` bytes into it. The layout and the
+// render-cache slot live as long as the row is unchanged.
+struct TermViewRow {
+    uint64_t id = UINT64_MAX;
+    int sub = 0;
+    uint64_t stamp = 0;
+    uint32_t byteStart = 0;
+    TerminalLine line;
+    std::vector<TermGlyphRun> layout;
+    bool laidOut = false;
+    int slot = -1;
+};
+
+// A row-high strip of the render cache texture and the row it currently holds.
+struct TermRowSlot {
+    uint64_t id = UINT64_MAX;
+    int sub = 0;
+    uint64_t stamp = 0;
+    uint64_t lastFrame = 0;
+};
+
+// A shell on its own pty with its parsed model and view. The I/O threads in
+// Terminal move output through pump() and parsePending(); only the session
+// shown in the panel gets update()/render() calls.
+class TermSession {
+private:
+    // Parsed model, written by the parser thread and guarded by modelMutex
+    std::mutex modelMutex;
+    Scrollback displayHistory;
+    TermScreen screen;
+    VtParser parser;
+    double parseSeconds = 0.0;          // parser throughput for the current burst
+    size_t parseBytes = 0;
+    double lastOutputTime = -10.0;
+
+    // With the spill setting on, evicted lines go to disk and older history
+    // is read back from there; spillScratch holds the last line paged in.
+    std::unique_ptr<ScrollbackSpill> spill;
+    TerminalLine spillScratch;
+
+    // Session log, written on its own thread
+    std::thread logThread;
+    std::atomic<int> logState{0};
+
+    // Raw pty output travels I/O thread -> ring -> parser thread
+    SpscRing inputRing;
+
+    // Ctrl+F search; hits are kept sorted by line id, current is an index into
+    // the scrollback hits followed by the on-screen ones
+    TermSearch search{modelMutex, displayHistory, screen};
+    bool searchOpen = false;
+    std::string searchQuery;
+    std::vector<TermMatch> searchHits;
+    std::vector<TermMatch> searchScreenHits;
+    bool searchCapped = false;
+    int searchCurrent = -1;
+    bool searchJumpPending = false;
+
+    // Grid size last pushed to the pty, and a newer one waiting to settle
+    int gridCols = 0, gridRows = 0;
+    int wantCols = 0, wantRows = 0;
+    double wantSince = 0.0;
+
+    // Scroll position is the bottom visible row, unless following the output.
+    // Wheel moves and search jumps are resolved in syncView under the lock,
+    // which only counts wrapped rows for the lines it walks over.
+    struct ViewPos { uint64_t id; int sub; };
+    bool followOutput = true;
+    ViewPos anchor = {0, 0};
+    int scrollDelta = 0;
+    bool jumpPending = false;
+    TermMatch jumpTarget = {0, 0, 0};
+    int wrapCols = 0;
+    std::unordered_map<uint64_t, int> wrapCounts;   // rows per scrollback line at wrapCols
+
+    // UI thread state, refreshed from the model once per frame
+    std::vector<TermViewRow> viewRows;
+    uint64_t viewHistoryFirst = 0;
+    int viewVisibleRows = 0;
+    uint64_t viewCursorId = 0;
+    int viewCursorX = 0;
+    bool viewCursorShown = true;
+    bool viewAppCursor = false;
+    float viewRate = 0.0f;
+
+    // Rendered rows are cached in strips of one texture and only redrawn when
+    // they change; everything visible is blitted from it every frame.
+    RenderTexture2D rowCache = { 0 };
+    std::vector<TermRowSlot> slots;
+    uint64_t frameCounter = 0;
+    unsigned int layoutFontId = 0;
+    float rowH = 22.0f;
+    float cellW = 10.0f;
+    Color cacheBg = { 0 };
+    Color cacheText = { 0 };
+
+    std::vector<std::string> cmdHistory;
+    int historyIndex = -1;
+    std::string inputBuffer;
+    std::string shellName;
+#if defined(__APPLE__) || defined(__linux__)
+    int ptyFd = -1;                     // pty master, or the output pipe of a task
+    int shellPid = -1;                  // a task's pid is also its process group
+#endif
+
+    // A build/run task instead of a shell: output comes through a pipe and
+    // the tab reports how long it ran and how it ended.
+    bool task = false;
+    double taskStart = 0.0;
+    double taskEnd = 0.0;
+    int taskExit = -1;
+    int cancelCount = 0;
+    void* hJob = nullptr;               // Windows job holding the task's process tree
+    // Compiler messages found in a task's output, parsed on the parser thread
+    // under modelMutex; the UI takes them a batch at a time.
+    DiagnosticParser diagParser;
+    std::vector<Diagnostic> diagPending;
+    size_t diagTaken = 0;
+
+    // Use void* to avoid including windows.h here
+    void* hChildStd_IN_Rd = nullptr;
+    void* hChildStd_IN_Wr = nullptr;
+    void* hChildStd_OUT_Rd = nullptr;
+    void* hChildStd_OUT_Wr = nullptr;
+    void* hProcess = nullptr;
+
+    void prepare(int cols, int rows);
+    void createShellProcess();
+    bool createTaskProcess(const std::string& command);
+    void feed(const char* data, size_t len);
+    void applySize(int cols, int rows);
+    uint64_t historyFirst() const;
+    ScrollLine historyLine(uint64_t id);
+    int wrappedRows(uint64_t id);
+    bool stepBack(ViewPos& p);
+    bool stepForward(ViewPos& p, uint64_t lastId);
+    void syncView(int visibleRows);
+    void updateSearchInput();
+    void collectSearch();
+    int searchCount() const;
+    const TermMatch& searchMatch(int index) const;
+    void jumpToMatch(int index);
+    void drawSearchBar(Rectangle bounds, Font font);
+    void drawSearchHighlights(const TermViewRow& row, float x, float y);
+    void updateMetrics(Font font);
+    void ensureRowCache(int width, int slotCount);
+    void layoutRow(TermViewRow& row);
+    void drawRowToSlot(Font font, const TermViewRow& row, int slot);
+    void writeToPipe(const std::string& cmd);
+    void writeRawToPipe(const std::string& data);
+    bool writeLog(const std::string& path);
+
+public:
+    enum { LOG_IDLE, LOG_WRITING, LOG_DONE, LOG_FAILED };
+
+    const uint64_t id;
+    std::atomic<bool> exited{false};
+    std::atomic<bool> paused{false};        // ring was full, pty is not being watched
+    std::atomic<bool> unseenOutput{false};  // output arrived since the tab was last shown
+
+    explicit TermSession(uint64_t id);
+    ~TermSession();
+    TermSession(const TermSession&) = delete;
+    TermSession& operator=(const TermSession&) = delete;
+
+    void start(int cols, int rows);
+    // Runs `command` through the system shell with its output in this tab;
+    // false if it could not be started.
+    bool startTask(const std::string& title, const std::string& command, int cols, int rows);
+    void cleanup();
+    const std::string& name() const { return shellName; }
+    bool searchVisible() const { return searchOpen; }
+    int cols() const { return gridCols; }
+    int rows() const { return gridRows; }
+
+    bool isTask() const { return task; }
+    bool taskRunning() const { return task && taskEnd == 0.0; }
+    int taskExitCode() const { return taskExit; }
+    double taskElapsed() const;
+    // Ctrl+C: terminates the task's process group, kills it on a second press.
+    void cancelTask();
+    // UI thread: reaps a task whose output has ended and prints how it went.
+    void pollTask();
+    // Moves up to `max` newly found diagnostics into `out`.
+    void takeDiagnostics(std::vector<Diagnostic>& out, size_t max);
+
+#if defined(__APPLE__) || defined(__linux__)
+    int fd() const { return ptyFd; }
+#endif
+    // I/O thread: reads what the pty has ready into the ring. Returns the
+    // byte count, 0 when nothing is ready or the ring is full, -1 once the
+    // shell has gone away.
+    int pump(std::vector<char>& buffer);
+    bool ringFull() const { return inputRing.space() == 0; }
+    bool ringDrained() const { return inputRing.size() < inputRing.capacity() / 2; }
+
+    // Parser thread: parses one chunk of buffered output, false if none.
+    bool parsePending(std::vector<char>& chunk);
+
+    void update();
+    void render(Rectangle bounds, Font font);
+    void runCommand(const std::string& cmd);
+
+    // Writes the whole history, spilled part included, to `path` in the
+    // background; false if a log is already being written.
+    bool saveLog(const std::string& path);
+    // LOG_DONE or LOG_FAILED once per finished log, otherwise the current state.
+    int takeLogResult();
+
+    void memoryUsage(MemoryReport& report);
+    size_t historyCapacity();
+    // Lowers the scrollback limit to `maxLines`; returns the bytes released.
+    size_t trimHistory(size_t maxLines);
+};
@@ -1,51 +1,85 @@
 #pragma once
 #include "Globals.hpp"
+#include "TermSession.hpp"
 #include <vector>
 #include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 
-struct TerminalSegment {
-    std::string text;
-    Color color;
-};
-
-struct TerminalLine {
-    std::vector<TerminalSegment> segments;
-};
-
+// The terminal panel: a tab per shell session. One I/O thread waits on every
+// session's pty at once (epoll on Linux, poll elsewhere) and one parser thread
+// drains them all, so background tabs stay current without being drawn.
 class Terminal {
 private:
-    std::vector<TerminalLine> displayHistory;
-    std::vector<std::string> cmdHistory;
-    int historyIndex = -1;
-    std::string inputBuffer;
-    int scrollOffset = 0;
-    bool pendingCR = false;
+    std::mutex sessionsMutex;           // guards `sessions` against the I/O threads
+    std::vector<std::shared_ptr<TermSession>> sessions;
+    int active = -1;
+    uint64_t nextSessionId = 1;
+    int lastCols = 80, lastRows = 24;   // panel grid size, for new sessions
+    std::shared_ptr<TermSession> logging;   // session whose log is being saved
 
-    Color currentColor = WHITE;
+    std::thread ioThread;
+    std::thread parserThread;
+    std::atomic<bool> running{false};
+    std::mutex wakeMutex;
+    std::condition_variable wakeCv;
+    bool outputReady = false;
+    std::mutex pauseMutex;              // orders pausing/resuming a full ring
+#if defined(__linux__)
+    int epollFd = -1;
+#endif
 #if defined(__APPLE__) || defined(__linux__)
-    int ptyFd = -1;
-    int shellPid = -1;
+    int wakePipe[2] = {-1, -1};
 #endif
-    
-    // Use void* to avoid including windows.h here
-    void* hChildStd_IN_Rd = nullptr;
-    void* hChildStd_IN_Wr = nullptr;
-    void* hChildStd_OUT_Rd = nullptr;
-    void* hChildStd_OUT_Wr = nullptr;
-    void* hProcess = nullptr; 
 
-    void createShellProcess();
-    void readFromPipe();
-    void writeToPipe(const std::string& cmd);
-    void writeRawToPipe(const std::string& data);
+    std::vector<std::shared_ptr<TermSession>> snapshot();
+    std::shared_ptr<TermSession> activeSession();
+    void startThreads();
+    void stopThreads();
+    void ioLoop();
+    void parserLoop();
+    void watch(TermSession& s);
+    void unwatch(TermSession& s);
+    void pause(TermSession& s);
+    void resume(TermSession& s);
+    void wakeIo();
+    void drawTabs(Rectangle bounds, Font font, float limit);
+    int findTask(const std::string& title);
 
 public:
     Terminal();
     ~Terminal();
-    
+
     void init();
     void close();
+    void cleanup();
+    void newSession();
+    void closeSession(int index);
+    void switchTo(int index);
     void update(bool isFocused);
     void render(Rectangle bounds, Font font);
     void runCommand(const std::string& cmd);
+    void saveLog();
+
+    // Build/run tasks get a tab of their own, reused by the next run with the
+    // same title once the previous one has finished. `show` switches to it.
+    void runTask(const std::string& title, const std::string& command, bool show = true);
+    void cancelTask(const std::string& title);
+    // Seconds the named task has been running, or -1 if it is not running.
+    double taskRunningFor(const std::string& title);
+    // False while the named task runs; otherwise true with its exit code, or
+    // -1 if there is no such task (its tab was closed).
+    bool taskFinished(const std::string& title, int& exitCode);
+    // Hands over diagnostics found in the named task's output, a bounded
+    // number per call; `run` is set to an id that changes with every run.
+    void takeDiagnostics(const std::string& title, uint64_t& run, std::vector<Diagnostic>& out);
+
+    void memoryUsage(MemoryReport& report);
+    // Halves scrollback limits, background tabs before the shown one and
+    // never below MIN_SCROLLBACK lines, until about `want` bytes are freed;
+    // returns what was.
+    size_t trimScrollback(size_t want);
 };
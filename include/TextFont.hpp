@@ -0,0 +1,18 @@
+#pragma once
+#include <raylib.h>
+#include <string>
+
+// UI and editor text come from one signed distance field atlas: the shader
+// rebuilds each glyph edge per pixel, so a small atlas is sharp at every
+// draw size and zooming never reloads the font. Where the GPU cannot
+// compile the shader the font is a plain bitmap atlas instead.
+
+// Loads `path` as an SDF font, or as a bitmap font if that fails.
+Font LoadTextFont(const std::string& path);
+void UnloadTextFont(Font font);
+bool IsSdfFont(Font font);
+
+// Text drawn with `font` must sit between these. Shapes come out as usual,
+// but other textures must be drawn outside, and the pairs do not nest.
+void BeginText(Font font);
+void EndText(Font font);
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// Receives the actions produced by VtParser.
+class VtHandler {
+public:
+    virtual ~VtHandler() {}
+    // Run of printable bytes (ASCII or UTF-8, sequences may be split across calls)
+    virtual void print(const char* text, size_t len) = 0;
+    virtual void execute(uint8_t ctrl) = 0;
+    virtual void csiDispatch(const int* params, int paramCount, const char* inter, int interCount, char final) = 0;
+    virtual void escDispatch(const char* inter, int interCount, char final) = 0;
+    virtual void oscDispatch(const char* data, size_t len) { (void)data; (void)len; }
+};
+
+// DEC/xterm escape sequence parser following Paul Williams' state diagram
+// (vt100.net/emu/dec_ansi_parser). Every byte is looked up in a state x byte
+// transition table; runs of printable text in the ground state are scanned in
+// bulk and handed to the handler in one call. Runs in UTF-8 mode, so 8-bit C1
+// controls are treated as text.
+class VtParser {
+public:
+    enum State : uint8_t {
+        GROUND, ESCAPE, ESCAPE_INTERMEDIATE,
+        CSI_ENTRY, CSI_PARAM, CSI_INTERMEDIATE, CSI_IGNORE,
+        DCS_ENTRY, DCS_PARAM, DCS_INTERMEDIATE, DCS_PASSTHROUGH, DCS_IGNORE,
+        OSC_STRING, SOS_PM_APC_STRING,
+        STATE_COUNT
+    };
+
+    static const int MAX_PARAMS = 16;
+    static const int MAX_INTERMEDIATES = 4;
+    static const size_t MAX_OSC = 512;
+
+    void feed(const char* data, size_t len, VtHandler& handler);
+    void reset();
+    State currentState() const { return state; }
+
+private:
+    State state = GROUND;
+    int params[MAX_PARAMS] = {0};
+    int paramCount = 0;
+    char inter[MAX_INTERMEDIATES] = {0};
+    int interCount = 0;
+    char osc[MAX_OSC];
+    size_t oscLen = 0;
+
+    void clear();
+    void perform(uint8_t action, uint8_t byte, VtHandler& handler);
+    void enter(State next);
+};
+
+// Length of the leading run of bytes that print as text (>= 0x20, not DEL).
+size_t VtScanPrintable(const char* data, size_t len);
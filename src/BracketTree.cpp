@@ -0,0 +1,509 @@
+#include "../include/BracketTree.hpp"
+#include <algorithm>
+#include <cctype>
+
+static bool IsOpener(char c) { return c == '(' || c == '[' || c == '{' || c == '<'; }
+static int Channel(char c) { return c == '<' || c == '>' ? 1 : 0; }
+
+// Lexes `line` from `state` and reports the brackets in its code runs, so
+// strings and comments are whatever the grammar says they are. Without a
+// grammar the whole line is code. Returns the state the next line starts in.
+template <typename Out>
+static uint8_t Scan(const Grammar* grammar, const std::string& line, uint8_t state, std::vector<Token>& tokens, Out&& bracket) {
+    uint8_t end = 0;
+    tokens.clear();
+    if (grammar) end = grammar->lexLine(line, state, tokens);
+    else tokens.push_back({0, (uint32_t)line.size(), TokenKind::Text});
+    bool lineStart = true;
+    for (const Token& t : tokens) {
+        for (size_t i = t.start; i < t.start + t.length; i++) {
+            char c = line[i];
+            if (t.kind == TokenKind::Text) {
+                if (c == '#' && lineStart && grammar && grammar->directives) {
+                    size_t w = line.find_first_not_of(" \t", i + 1), e = w;
+                    while (e < line.size() && isalpha((unsigned char)line[e])) e++;
+                    std::string word = w == std::string::npos ? "" : line.substr(w, e - w);
+                    if (word == "if" || word == "ifdef" || word == "ifndef") bracket(i, '<');
+                    else if (word == "endif") bracket(i, '>');
+                }
+                else if (c == '(' || c == '[' || c == '{' || c == ')' || c == ']' || c == '}') bracket(i, c);
+            }
+            if (!isspace((unsigned char)c)) lineStart = false;
+        }
+    }
+    return end;
+}
+
+uint32_t BracketTree::random() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+int BracketTree::newNode() {
+    int n;
+    if (!freeNodes.empty()) {
+        n = freeNodes.back();
+        freeNodes.pop_back();
+        nodes[n] = Node();
+    } else {
+        n = (int)nodes.size();
+        nodes.emplace_back();
+    }
+    nodes[n].priority = random();
+    return n;
+}
+
+void BracketTree::release(int t) {
+    std::vector<int> stack;
+    if (t >= 0) stack.push_back(t);
+    while (!stack.empty()) {
+        int n = stack.back();
+        stack.pop_back();
+        if (nodes[n].left >= 0) stack.push_back(nodes[n].left);
+        if (nodes[n].right >= 0) stack.push_back(nodes[n].right);
+        nodes[n].brackets = {};
+        freeNodes.push_back(n);
+    }
+}
+
+// The depth over run `a` followed by run `b`
+BracketTree::Depth BracketTree::append(const Depth& a, const Depth& b) {
+    return {a.sum + b.sum, std::min(a.minPrefix, a.sum + b.minPrefix), std::max(b.maxSuffix, b.sum + a.maxSuffix)};
+}
+
+void BracketTree::pull(int n) {
+    Node& node = nodes[n];
+    node.size = 1;
+    node.visible = node.hidden ? 0 : 1;
+    node.folds = node.foldSpan > 0 ? 1 : 0;
+    for (int ch = 0; ch < 2; ch++) node.depth[ch] = node.line[ch];
+    if (node.left >= 0) {
+        const Node& l = nodes[node.left];
+        for (int ch = 0; ch < 2; ch++) node.depth[ch] = append(l.depth[ch], node.depth[ch]);
+        node.size += l.size;
+        node.visible += l.visible;
+        node.folds += l.folds;
+    }
+    if (node.right >= 0) {
+        const Node& r = nodes[node.right];
+        for (int ch = 0; ch < 2; ch++) node.depth[ch] = append(node.depth[ch], r.depth[ch]);
+        node.size += r.size;
+        node.visible += r.visible;
+        node.folds += r.folds;
+    }
+}
+
+void BracketTree::split(int t, int k, int& a, int& b) {
+    if (t < 0) { a = b = -1; return; }
+    int leftSize = nodes[t].left >= 0 ? nodes[nodes[t].left].size : 0;
+    if (k <= leftSize) {
+        int l;
+        split(nodes[t].left, k, a, l);
+        nodes[t].left = l;
+        b = t;
+    } else {
+        int r;
+        split(nodes[t].right, k - leftSize - 1, r, b);
+        nodes[t].right = r;
+        a = t;
+    }
+    pull(t);
+}
+
+int BracketTree::merge(int a, int b) {
+    if (a < 0) return b;
+    if (b < 0) return a;
+    if (nodes[a].priority > nodes[b].priority) {
+        int r = merge(nodes[a].right, b);
+        nodes[a].right = r;
+        pull(a);
+        return a;
+    }
+    int l = merge(a, nodes[b].left);
+    nodes[b].left = l;
+    pull(b);
+    return b;
+}
+
+int BracketTree::at(int index) const {
+    int t = root;
+    while (t >= 0) {
+        int leftSize = nodes[t].left >= 0 ? nodes[nodes[t].left].size : 0;
+        if (index < leftSize) t = nodes[t].left;
+        else if (index == leftSize) return t;
+        else { index -= leftSize + 1; t = nodes[t].right; }
+    }
+    return -1;
+}
+
+void BracketTree::lex(Node& node, const std::string& line, uint8_t state) {
+    node.brackets.clear();
+    node.startState = state;
+    for (Depth& d : node.line) d = Depth();
+    uint8_t end = Scan(grammar, line, state, tokens, [&](size_t col, char c) {
+        node.brackets.push_back({(uint32_t)col, c});
+        Depth& d = node.line[Channel(c)];
+        d.sum += IsOpener(c) ? 1 : -1;
+        d.minPrefix = std::min(d.minPrefix, d.sum);
+    });
+    int suffix[2] = {0, 0};
+    for (size_t i = node.brackets.size(); i-- > 0;) {
+        int ch = Channel(node.brackets[i].ch);
+        suffix[ch] += IsOpener(node.brackets[i].ch) ? 1 : -1;
+        node.line[ch].maxSuffix = std::max(node.line[ch].maxSuffix, suffix[ch]);
+    }
+    node.endState = end;
+    node.stale = false;
+}
+
+uint8_t BracketTree::relex(int t, int index, const std::string& line, uint8_t state) {
+    int leftSize = nodes[t].left >= 0 ? nodes[nodes[t].left].size : 0;
+    uint8_t end;
+    if (index < leftSize) end = relex(nodes[t].left, index, line, state);
+    else if (index > leftSize) end = relex(nodes[t].right, index - leftSize - 1, line, state);
+    else {
+        lex(nodes[t], line, state);
+        end = nodes[t].endState;
+    }
+    pull(t);
+    return end;
+}
+
+// Builds a balanced tree over lines [lo, hi) lexed in order. Priorities are
+// banded by height so the heap order holds and later inserts still balance.
+int BracketTree::build(int lo, int hi, const std::vector<std::string>& lines, uint8_t& state, int& height) {
+    if (lo >= hi) { height = 0; return -1; }
+    int mid = lo + (hi - lo) / 2, lh, rh;
+    int left = build(lo, mid, lines, state, lh);
+    int n = newNode();
+    lex(nodes[n], lines[mid], state);
+    state = nodes[n].endState;
+    int right = build(mid + 1, hi, lines, state, rh);
+    height = std::max(lh, rh) + 1;
+    nodes[n].left = left;
+    nodes[n].right = right;
+    nodes[n].priority = ((uint32_t)std::min(height, 63) << 26) | (random() >> 6);
+    pull(n);
+    return n;
+}
+
+
+void BracketTree::setGrammar(const Grammar* g) {
+    if (g == grammar) return;
+    grammar = g;
+    nodes.clear();
+    freeNodes.clear();
+    root = -1;
+}
+
+void BracketTree::sync(const std::vector<std::string>& lines, const std::vector<LineEdit>& edits) {
+    if (edits.empty() && lineCount() == (int)lines.size()) return;
+    bool full = root < 0;
+    // Rows [lo, hi) cover every line the edits touched, shifted as they go
+    int lo = INT32_MAX, hi = 0;
+    std::vector<int> opened;
+    for (const LineEdit& e : edits) {
+        if (full || e.removed < 0) { full = true; break; }
+        int count = lineCount();
+        int row = std::min(std::max(e.row, 0), count);
+        int removed = std::min(e.removed, count - row);
+        opened.clear();
+        collectFolds(root, 0, row, row + removed, opened);
+        for (int r : opened) unfold(r);
+        if (hi > row + removed) hi = hi + e.added - removed;
+        hi = std::max(hi, row + e.added);
+        lo = std::min(lo, row);
+        int same = std::min(removed, e.added);
+        for (int i = 0; i < same; i++) nodes[at(row + i)].stale = true;
+        int a, b, c;
+        if (removed > same) {
+            split(root, row + same, a, b);
+            split(b, removed - same, b, c);
+            release(b);
+            root = merge(a, c);
+        } else if (e.added > same) {
+            split(root, row + same, a, c);
+            for (int i = same; i < e.added; i++) a = merge(a, newNode());
+            root = merge(a, c);
+        }
+    }
+    // A new document, or a log that does not add up, is lexed whole
+    if (full || lineCount() != (int)lines.size()) {
+        nodes.clear();
+        freeNodes.clear();
+        nodes.reserve(lines.size() + lines.size() / 8);
+        uint8_t state = 0;
+        int height;
+        root = build(0, (int)lines.size(), lines, state, height);
+        return;
+    }
+    // Relex the touched lines, then onwards while a comment opened or
+    // closed by them changes how the following lines start
+    int count = lineCount();
+    uint8_t state = lo > 0 && lo < count ? nodes[at(lo - 1)].endState : 0;
+    for (int r = lo; r < count; r++) {
+        const Node& node = nodes[at(r)];
+        if (!node.stale && node.startState == state) {
+            if (r >= hi) break;
+            state = node.endState;
+            continue;
+        }
+        state = relex(root, r, lines[r], state);
+    }
+}
+
+int BracketTree::findForward(int t, int offset, int from, int channel, int& need) const {
+    if (t < 0) return -1;
+    const Node& node = nodes[t];
+    if (offset + node.size <= from) return -1;
+    const Depth& d = node.depth[channel];
+    if (offset >= from && need + d.minPrefix > 0) { need += d.sum; return -1; }
+    int self = offset + (node.left >= 0 ? nodes[node.left].size : 0);
+    int found = findForward(node.left, offset, from, channel, need);
+    if (found >= 0) return found;
+    if (self >= from) {
+        if (need + node.line[channel].minPrefix <= 0) return self;
+        need += node.line[channel].sum;
+    }
+    return findForward(node.right, self + 1, from, channel, need);
+}
+
+int BracketTree::findBackward(int t, int offset, int from, int channel, int& need) const {
+    if (t < 0) return -1;
+    const Node& node = nodes[t];
+    if (offset > from) return -1;
+    const Depth& d = node.depth[channel];
+    if (offset + node.size - 1 <= from && need - d.maxSuffix > 0) { need -= d.sum; return -1; }
+    int self = offset + (node.left >= 0 ? nodes[node.left].size : 0);
+    int found = findBackward(node.right, self + 1, from, channel, need);
+    if (found >= 0) return found;
+    if (self <= from) {
+        if (need - node.line[channel].maxSuffix <= 0) return self;
+        need -= node.line[channel].sum;
+    }
+    return findBackward(node.left, offset, from, channel, need);
+}
+
+BracketTree::Pos BracketTree::scanForward(int row, size_t first, int channel, int& need) const {
+    const std::vector<Bracket>& brackets = nodes[at(row)].brackets;
+    for (size_t i = first; i < brackets.size(); i++) {
+        if (Channel(brackets[i].ch) != channel) continue;
+        need += IsOpener(brackets[i].ch) ? 1 : -1;
+        if (need == 0) return {row, (int)brackets[i].col};
+    }
+    return {};
+}
+
+BracketTree::Pos BracketTree::scanBackward(int row, size_t end, int channel, int& need) const {
+    const std::vector<Bracket>& brackets = nodes[at(row)].brackets;
+    for (size_t i = std::min(end, brackets.size()); i-- > 0;) {
+        if (Channel(brackets[i].ch) != channel) continue;
+        need -= IsOpener(brackets[i].ch) ? 1 : -1;
+        if (need == 0) return {row, (int)brackets[i].col};
+    }
+    return {};
+}
+
+BracketTree::Pos BracketTree::match(int row, int col) const {
+    if (row < 0 || row >= lineCount()) return {};
+    const std::vector<Bracket>& brackets = nodes[at(row)].brackets;
+    auto it = std::lower_bound(brackets.begin(), brackets.end(), (uint32_t)col,
+                               [](const Bracket& b, uint32_t c) { return b.col < c; });
+    if (it == brackets.end() || it->col != (uint32_t)col) return {};
+    size_t i = it - brackets.begin();
+    int channel = Channel(it->ch), need = 1;
+    if (IsOpener(it->ch)) {
+        Pos p = scanForward(row, i + 1, channel, need);
+        if (p.valid()) return p;
+        int k = findForward(root, 0, row + 1, channel, need);
+        return k < 0 ? Pos{} : scanForward(k, 0, channel, need);
+    }
+    Pos p = scanBackward(row, i, channel, need);
+    if (p.valid()) return p;
+    int k = row > 0 ? findBackward(root, 0, row - 1, channel, need) : -1;
+    return k < 0 ? Pos{} : scanBackward(k, SIZE_MAX, channel, need);
+}
+
+BracketTree::Pos BracketTree::enclosing(int row, int col) const {
+    if (row < 0 || row >= lineCount()) return {};
+    const std::vector<Bracket>& brackets = nodes[at(row)].brackets;
+    auto it = std::lower_bound(brackets.begin(), brackets.end(), (uint32_t)col,
+                               [](const Bracket& b, uint32_t c) { return b.col < c; });
+    int need = 1;
+    Pos p = scanBackward(row, it - brackets.begin(), 0, need);
+    if (p.valid()) return p;
+    int k = row > 0 ? findBackward(root, 0, row - 1, 0, need) : -1;
+    return k < 0 ? Pos{} : scanBackward(k, SIZE_MAX, 0, need);
+}
+
+bool BracketTree::inCode(const std::string& line, int row, int col) const {
+    if (!grammar) return true;
+    int n = at(row);
+    uint8_t state = n >= 0 ? nodes[n].startState : 0;
+    // Lex what precedes `col` and a stand-in for the next character: it is
+    // code unless an open string or comment takes it in
+    std::string prefix = line.substr(0, std::min((size_t)std::max(col, 0), line.size())) + '\x01';
+    std::vector<Token> out;
+    grammar->lexLine(prefix, state, out);
+    return out.empty() || (out.back().kind != TokenKind::String && out.back().kind != TokenKind::Comment);
+}
+
+// Folding
+
+int BracketTree::foldable(int row, const std::vector<std::string>& lines) const {
+    int n = at(row);
+    if (n < 0) return 0;
+    // The last brace (else #if) on the line that is still open at its end
+    const std::vector<Bracket>& brackets = nodes[n].brackets;
+    for (int channel = 0; channel < 2; channel++) {
+        int depth = 0;
+        for (size_t i = brackets.size(); i-- > 0;) {
+            if (Channel(brackets[i].ch) != channel) continue;
+            if (!IsOpener(brackets[i].ch)) depth++;
+            else if (depth > 0) depth--;
+            else {
+                // The closing line stays visible
+                Pos end = match(row, (int)brackets[i].col);
+                if (end.valid() && end.row > row + 1) return end.row - row - 1;
+                break;
+            }
+        }
+    }
+    // Otherwise the lines indented deeper than this one, minus trailing
+    // blanks; directives sit in column 0 whatever they are nested in
+    auto indent = [](const std::string& s) {
+        size_t i = s.find_first_not_of(" \t");
+        return i == std::string::npos ? -1 : (int)i;
+    };
+    int base = indent(lines[row]), last = row;
+    if (base < 0 || lines[row][base] == '#') return 0;
+    for (int r = row + 1; r < (int)lines.size(); r++) {
+        int d = indent(lines[r]);
+        if (d < 0) continue;
+        if (d <= base) break;
+        last = r;
+    }
+    return last - row;
+}
+
+void BracketTree::setFoldSpan(int t, int index, int span) {
+    int leftSize = nodes[t].left >= 0 ? nodes[nodes[t].left].size : 0;
+    if (index < leftSize) setFoldSpan(nodes[t].left, index, span);
+    else if (index > leftSize) setFoldSpan(nodes[t].right, index - leftSize - 1, span);
+    else nodes[t].foldSpan = span;
+    pull(t);
+}
+
+void BracketTree::setHidden(int t, int offset, int lo, int hi, bool hide, int& hideUntil) {
+    if (t < 0) return;
+    Node& node = nodes[t];
+    if (offset >= hi || offset + node.size <= lo) return;
+    int self = offset + (node.left >= 0 ? nodes[node.left].size : 0);
+    setHidden(node.left, offset, lo, hi, hide, hideUntil);
+    if (self >= lo && self < hi) {
+        node.hidden = hide || self < hideUntil;
+        if (!node.hidden && node.foldSpan > 0) hideUntil = std::max(hideUntil, self + 1 + node.foldSpan);
+    }
+    setHidden(node.right, self + 1, lo, hi, hide, hideUntil);
+    pull(t);
+}
+
+void BracketTree::collectFolds(int t, int offset, int lo, int hi, std::vector<int>& out) const {
+    if (t < 0) return;
+    const Node& node = nodes[t];
+    if (node.folds == 0 || offset >= hi || offset + node.size <= lo) return;
+    int self = offset + (node.left >= 0 ? nodes[node.left].size : 0);
+    collectFolds(node.left, offset, lo, hi, out);
+    if (self >= lo && self < hi && node.foldSpan > 0) out.push_back(self);
+    collectFolds(node.right, self + 1, lo, hi, out);
+}
+
+void BracketTree::fold(int row, int span) {
+    span = std::min(span, lineCount() - row - 1);
+    if (row < 0 || span <= 0) return;
+    setFoldSpan(root, row, span);
+    int unused = 0;
+    setHidden(root, 0, row + 1, row + 1 + span, true, unused);
+}
+
+void BracketTree::unfold(int row) {
+    int n = at(row);
+    if (n < 0 || nodes[n].foldSpan == 0) return;
+    int span = nodes[n].foldSpan;
+    bool inside = nodes[n].hidden;
+    setFoldSpan(root, row, 0);
+    // Inside another fold the lines stay hidden by that one
+    if (inside) return;
+    int hideUntil = 0;
+    setHidden(root, 0, row + 1, row + 1 + span, false, hideUntil);
+}
+
+void BracketTree::unfoldAll() {
+    for (Node& node : nodes) {
+        node.hidden = false;
+        node.foldSpan = 0;
+    }
+    for (int n = 0; n < (int)nodes.size(); n++) {
+        nodes[n].visible = nodes[n].size;
+        nodes[n].folds = 0;
+    }
+}
+
+bool BracketTree::folded(int row) const {
+    int n = at(row);
+    return n >= 0 && nodes[n].foldSpan > 0;
+}
+
+bool BracketTree::hidden(int row) const {
+    int n = at(row);
+    return n >= 0 && nodes[n].hidden;
+}
+
+void BracketTree::reveal(int row) {
+    // The line shown last before a hidden one is the outermost fold over it
+    while (hidden(row)) {
+        int header = toRow(toVisible(row) - 1);
+        if (!folded(header)) break;
+        unfold(header);
+    }
+}
+
+int BracketTree::toVisible(int row) const {
+    int t = root, count = 0;
+    while (t >= 0) {
+        const Node& node = nodes[t];
+        int leftSize = node.left >= 0 ? nodes[node.left].size : 0;
+        if (row < leftSize) { t = node.left; continue; }
+        count += node.left >= 0 ? nodes[node.left].visible : 0;
+        if (row == leftSize) return count;
+        count += node.hidden ? 0 : 1;
+        row -= leftSize + 1;
+        t = node.right;
+    }
+    return count;
+}
+
+int BracketTree::toRow(int visible) const {
+    if (visibleCount() == 0) return 0;
+    visible = std::min(std::max(visible, 0), visibleCount() - 1);
+    int t = root, offset = 0;
+    while (t >= 0) {
+        const Node& node = nodes[t];
+        int leftVisible = node.left >= 0 ? nodes[node.left].visible : 0;
+        if (visible < leftVisible) { t = node.left; continue; }
+        offset += node.left >= 0 ? nodes[node.left].size : 0;
+        if (visible == leftVisible && !node.hidden) return offset;
+        visible -= leftVisible + (node.hidden ? 0 : 1);
+        offset++;
+        t = node.right;
+    }
+    return offset;
+}
+
+size_t BracketTree::memoryBytes() const {
+    size_t bytes = nodes.capacity() * sizeof(Node) + freeNodes.capacity() * sizeof(int);
+    for (const Node& node : nodes) bytes += node.brackets.capacity() * sizeof(Bracket);
+    return bytes;
+}
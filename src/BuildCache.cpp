@@ -0,0 +1,339 @@
+#include "../include/BuildCache.hpp"
+#include <filesystem>
+#include <fstream>
+#include <cstdio>
+#include <cinttypes>
+#include <algorithm>
+#include <map>
+
+namespace fs = std::filesystem;
+
+#ifdef _WIN32
+    #define popen _popen
+    #define pclose _pclose
+static const char* CACHE_DIR = "data\\cache\\";
+#else
+static const char* CACHE_DIR = "data/cache/";
+#endif
+
+// Past either, the least recently used binaries are deleted
+static const size_t MAX_ENTRIES = 32;
+static const uint64_t MAX_BYTES = 512ull << 20;
+
+static const uint64_t FNV_OFFSET = 1469598103934665603ull;
+static const uint64_t FNV_PRIME = 1099511628211ull;
+
+static uint64_t Fnv1a(const void* data, size_t len, uint64_t h = FNV_OFFSET) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+static uint64_t Fnv1a(const std::string& s, uint64_t h = FNV_OFFSET) {
+    // The terminating zero keeps "ab"+"c" apart from "a"+"bc"
+    return Fnv1a(s.c_str(), s.size() + 1, h);
+}
+
+static bool HashFile(const std::string& path, uint64_t& out) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    std::vector<char> buf(64 * 1024);
+    uint64_t h = FNV_OFFSET;
+    size_t n;
+    while ((n = fread(buf.data(), 1, buf.size(), f)) > 0) h = Fnv1a(buf.data(), n, h);
+    fclose(f);
+    out = h;
+    return true;
+}
+
+static std::string Hex(uint64_t v) {
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016" PRIx64, v);
+    return buf;
+}
+
+static std::string Quote(const std::string& s) { return "\"" + s + "\""; }
+
+static std::string Trim(const std::string& s) {
+    size_t a = s.find_first_not_of(" \t");
+    if (a == std::string::npos) return "";
+    size_t b = s.find_last_not_of(" \t");
+    return s.substr(a, b - a + 1);
+}
+
+// Shell-ish word split, enough to find the compiler and its -o argument.
+static std::vector<std::string> SplitArgs(const std::string& cmd) {
+    std::vector<std::string> args;
+    std::string cur;
+    bool inQuote = false, any = false;
+    for (char c : cmd) {
+        if (c == '"') { inQuote = !inQuote; any = true; continue; }
+        if (!inQuote && (c == ' ' || c == '\t')) {
+            if (any) args.push_back(cur);
+            cur.clear();
+            any = false;
+            continue;
+        }
+        cur += c;
+        any = true;
+    }
+    if (any) args.push_back(cur);
+    return args;
+}
+
+static bool IsGccLike(const std::string& compiler) {
+    std::string name = fs::path(compiler).filename().string();
+    for (const char* known : {"gcc", "g++", "clang", "c++", "cc"}) {
+        if (name.find(known) != std::string::npos) return true;
+    }
+    return false;
+}
+
+static std::string CopyCommand(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    return "copy /y " + Quote(from) + " " + Quote(to) + " >nul";
+#else
+    return "cp -f " + Quote(from) + " " + Quote(to);
+#endif
+}
+
+// Make-style dependency file: "target: dep dep \<newline> dep", with "\ " for spaces.
+static bool ReadDepFile(const std::string& path, std::vector<std::string>& deps) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return false;
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    size_t i = text.find(": ");
+    if (i == std::string::npos) return false;
+    std::string cur;
+    for (i += 2; i < text.size(); i++) {
+        char c = text[i];
+        if (c == '\\' && i + 1 < text.size()) {
+            char next = text[i + 1];
+            if (next == '\n' || next == '\r') { i++; continue; }
+            if (next == ' ') { cur += ' '; i++; continue; }
+        }
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            if (!cur.empty()) deps.push_back(cur);
+            cur.clear();
+            // An unescaped newline ends the rule; anything after (-MP) is not wanted
+            if (c == '\n') break;
+            continue;
+        }
+        cur += c;
+    }
+    if (!cur.empty()) deps.push_back(cur);
+    return !deps.empty();
+}
+
+// Every dependency listed in the manifest must still hash the same.
+static bool ManifestMatches(const std::string& path) {
+    std::ifstream in(path);
+    if (!in.is_open()) return false;
+    std::string line;
+    int count = 0;
+    while (std::getline(in, line)) {
+        if (line.size() < 18) return false;
+        uint64_t h;
+        if (!HashFile(line.substr(17), h) || Hex(h) != line.substr(0, 16)) return false;
+        count++;
+    }
+    return count > 0;
+}
+
+// Each edit of a source is a new key, so old binaries pile up. A hit touches
+// its .bin, which makes the .bin's mtime the entry's last use.
+static void PruneCache(const std::string& keep) {
+    struct Entry {
+        fs::file_time_type used;
+        uint64_t bytes = 0;
+        std::vector<fs::path> files;
+        bool complete = false;
+    };
+    std::map<std::string, Entry> entries;
+    std::error_code ec;
+    for (fs::directory_iterator it(CACHE_DIR, ec), end; !ec && it != end; it.increment(ec)) {
+        const fs::path& path = it->path();
+        Entry& e = entries[path.stem().string()];
+        e.files.push_back(path);
+        e.bytes += it->file_size(ec);
+        if (path.extension() == ".bin") {
+            e.used = it->last_write_time(ec);
+            e.complete = true;
+        }
+    }
+    // Keys without a .bin are builds still running, or left for them
+    std::vector<std::pair<fs::file_time_type, const Entry*>> order;
+    uint64_t total = 0;
+    for (const auto& e : entries) {
+        if (!e.second.complete) continue;
+        total += e.second.bytes;
+        if (e.first != keep) order.push_back({e.second.used, &e.second});
+    }
+    std::sort(order.begin(), order.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    size_t count = order.size() + (entries.count(keep) ? 1 : 0);
+    for (const auto& o : order) {
+        if (count <= MAX_ENTRIES && total <= MAX_BYTES) break;
+        for (const fs::path& f : o.second->files) fs::remove(f, ec);
+        total -= o.second->bytes;
+        count--;
+    }
+}
+
+BuildCache::BuildCache() {
+    worker = std::thread(&BuildCache::workerLoop, this);
+}
+
+BuildCache::~BuildCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (worker.joinable()) worker.join();
+}
+
+void BuildCache::post(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    cv.notify_one();
+}
+
+void BuildCache::workerLoop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
+
+void BuildCache::check(const std::string& buildTemplate, const std::string& file) {
+    state = CHECKING;
+    post([this, buildTemplate, file] {
+        Plan p = makePlan(buildTemplate, file);
+        std::lock_guard<std::mutex> lock(mutex);
+        plan = p;
+        planReady = true;
+        state = p.key.empty() ? UNCACHED : p.hit ? HIT : MISS;
+    });
+}
+
+bool BuildCache::takePlan(Plan& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!planReady) return false;
+    out = plan;
+    planReady = false;
+    return true;
+}
+
+void BuildCache::finished(const Plan& p) {
+    if (p.key.empty() || p.hit) return;
+    post([this, p] { store(p); });
+}
+
+const std::string& BuildCache::compilerVersion(const std::string& compiler) {
+    auto it = compilerVersions.find(compiler);
+    if (it != compilerVersions.end()) return it->second;
+    std::string out;
+    FILE* pipe = popen((Quote(compiler) + " --version 2>&1").c_str(), "r");
+    if (pipe) {
+        char buf[512];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), pipe)) > 0) out.append(buf, n);
+        if (pclose(pipe) != 0) out.clear();
+    }
+    return compilerVersions.emplace(compiler, out).first->second;
+}
+
+// Without a gcc-style compiler and an -o to cache, the command runs as is.
+BuildCache::Plan BuildCache::makePlan(const std::string& buildTemplate, const std::string& file) {
+    Plan p;
+    std::string cmd = buildTemplate;
+    // The default template already quotes $FILE
+    for (size_t pos = cmd.find("$FILE"); pos != std::string::npos; pos = cmd.find("$FILE", pos)) {
+        std::string with = (pos > 0 && cmd[pos - 1] == '"') ? file : Quote(file);
+        cmd.replace(pos, 5, with);
+        pos += with.size();
+    }
+    p.command = cmd;
+
+    size_t amp = cmd.find("&&");
+    std::string build = Trim(cmd.substr(0, amp));
+    std::string run = (amp == std::string::npos) ? "" : Trim(cmd.substr(amp + 2));
+    std::vector<std::string> args = SplitArgs(build);
+    if (args.empty() || !IsGccLike(args[0])) return p;
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args[i] == "-o" && i + 1 < args.size()) p.output = args[i + 1];
+        else if (args[i].size() > 2 && args[i].compare(0, 2, "-o") == 0) p.output = args[i].substr(2);
+    }
+    if (p.output.empty()) return p;
+    const std::string& version = compilerVersion(args[0]);
+    uint64_t source;
+    if (version.empty() || !HashFile(file, source)) return p;
+
+    std::error_code ec;
+    fs::create_directories(CACHE_DIR, ec);
+    uint64_t h = Fnv1a(build);
+    h = Fnv1a(version, h);
+    h = Fnv1a(&source, sizeof(source), h);
+    p.key = Hex(h);
+    std::string bin = CACHE_DIR + p.key + ".bin";
+    std::string dep = CACHE_DIR + p.key + ".d";
+    std::string then = run.empty() ? "" : " && " + run;
+
+    if (fs::exists(bin, ec) && ManifestMatches(CACHE_DIR + p.key + ".manifest")) {
+        p.hit = true;
+        fs::last_write_time(bin, fs::file_time_type::clock::now(), ec);
+        p.command = CopyCommand(bin, p.output) + then;
+        return p;
+    }
+    // Stale leftovers would otherwise be mistaken for this build's output
+    fs::remove(bin, ec);
+    fs::remove(dep, ec);
+    p.command = build + " -MD -MF " + Quote(dep) + " && " + CopyCommand(p.output, bin) + then;
+    return p;
+}
+
+// The binary was copied in after the build, so any dependency newer than it
+// changed mid-build and the entry is not trusted.
+void BuildCache::store(const Plan& p) {
+    std::string bin = CACHE_DIR + p.key + ".bin";
+    std::string dep = CACHE_DIR + p.key + ".d";
+    std::string manifest = CACHE_DIR + p.key + ".manifest";
+    std::error_code ec;
+    std::vector<std::string> deps;
+    bool ok = fs::exists(bin, ec) && ReadDepFile(dep, deps);
+    fs::remove(dep, ec);
+    if (!ok) return;
+    auto built = fs::last_write_time(bin, ec);
+    if (ec) return;
+
+    std::string lines;
+    for (const std::string& d : deps) {
+        uint64_t h;
+        auto changed = fs::last_write_time(d, ec);
+        if (ec || changed > built || !HashFile(d, h)) {
+            fs::remove(bin, ec);
+            return;
+        }
+        lines += Hex(h) + " " + d + "\n";
+    }
+    std::string tmp = manifest + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        if (!out.is_open()) return;
+        out << lines;
+    }
+    fs::rename(tmp, manifest, ec);
+    PruneCache(p.key);
+}
@@ -0,0 +1,230 @@
+#include "../include/Completion.hpp"
+#include "../include/MemoryStats.hpp"
+#include "../include/Grammar.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+
+// Prefix matches looked at per query; enough for ranking, bounded for speed
+static const size_t SCAN_LIMIT = 4000;
+// New words are merged into the sorted table, and unused ones reclaimed,
+// once this many have piled up
+static const size_t COMPACT_AT = 512;
+
+static bool IsWordStart(char c) { return isalpha((unsigned char)c) || c == '_'; }
+static bool IsWordChar(char c) { return isalnum((unsigned char)c) || c == '_'; }
+
+// A new word starts out dead until a line that holds it is counted
+uint32_t CompletionIndex::intern(const std::string& word) {
+    auto it = ids.find(word);
+    if (it != ids.end()) return it->second;
+    uint32_t id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+        strings[id] = word;
+        keyword[id] = 0;
+        refs[id] = 0;
+    } else {
+        id = (uint32_t)strings.size();
+        strings.push_back(word);
+        keyword.push_back(0);
+        refs.push_back(0);
+    }
+    ids.emplace(word, id);
+    recent.push_back(id);
+    dead++;
+    return id;
+}
+
+void CompletionIndex::use(uint32_t id) {
+    if (!live(id)) dead--;
+    refs[id]++;
+}
+
+void CompletionIndex::unuse(uint32_t id) {
+    if (--refs[id] == 0 && !keyword[id]) dead++;
+}
+
+// Frees the ids nothing uses and merges the recent ones into `sorted`
+void CompletionIndex::compact() {
+    auto unused = [&](uint32_t id) {
+        if (live(id)) return false;
+        ids.erase(strings[id]);
+        std::string().swap(strings[id]);
+        freeIds.push_back(id);
+        return true;
+    };
+    sorted.erase(std::remove_if(sorted.begin(), sorted.end(), unused), sorted.end());
+    recent.erase(std::remove_if(recent.begin(), recent.end(), unused), recent.end());
+    dead = 0;
+    auto byText = [&](uint32_t a, uint32_t b) { return strings[a] < strings[b]; };
+    std::sort(recent.begin(), recent.end(), byText);
+    size_t mid = sorted.size();
+    sorted.insert(sorted.end(), recent.begin(), recent.end());
+    std::inplace_merge(sorted.begin(), sorted.begin() + mid, sorted.end(), byText);
+    recent.clear();
+}
+
+void CompletionIndex::addLanguage(const Grammar* grammar) {
+    std::vector<uint32_t>& words = languages[grammar];
+    for (const auto* list : {&grammar->keywords, &grammar->types}) {
+        for (const std::string& w : *list) {
+            uint32_t id = intern(w);
+            if (!live(id)) dead--;
+            keyword[id] = 1;
+            words.push_back(id);
+        }
+    }
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    compact();
+}
+
+void CompletionIndex::release(DocWords& words) {
+    for (const auto& line : words.lines) {
+        for (uint32_t id : line) unuse(id);
+    }
+    words = DocWords();
+}
+
+void CompletionIndex::scanLine(const std::string& line, std::vector<uint32_t>& out) {
+    out.clear();
+    std::string word;
+    for (size_t i = 0; i < line.size();) {
+        if (!IsWordStart(line[i])) {
+            // Skip the rest of a number so "0x1f" does not yield "x1f"
+            if (isdigit((unsigned char)line[i])) while (i < line.size() && IsWordChar(line[i])) i++;
+            else i++;
+            continue;
+        }
+        size_t start = i;
+        while (i < line.size() && IsWordChar(line[i])) i++;
+        if (i - start < 2) continue;
+        word.assign(line, start, i - start);
+        out.push_back(intern(word));
+    }
+}
+
+void CompletionIndex::addLine(DocWords& words, size_t row, const std::string& line) {
+    scanLine(line, words.lines[row]);
+    for (uint32_t id : words.lines[row]) {
+        words.counts[id]++;
+        use(id);
+    }
+    words.stale[row] = 0;
+}
+
+void CompletionIndex::removeLine(DocWords& words, size_t row) {
+    for (uint32_t id : words.lines[row]) {
+        unuse(id);
+        auto it = words.counts.find(id);
+        if (it != words.counts.end() && --it->second == 0) words.counts.erase(it);
+    }
+}
+
+void CompletionIndex::sync(const std::vector<std::string>& lines, const std::vector<LineEdit>& edits, DocWords& words) {
+    if (edits.empty() && words.lines.size() == lines.size()) return;
+    bool full = false;
+    // Rows [lo, hi) cover every line the edits touched, shifted as they go
+    size_t lo = SIZE_MAX, hi = 0;
+    for (const LineEdit& e : edits) {
+        if (e.removed < 0) { full = true; break; }
+        size_t row = std::min((size_t)std::max(e.row, 0), words.lines.size());
+        size_t removed = std::min((size_t)e.removed, words.lines.size() - row);
+        if (hi > row + removed) hi = hi + e.added - removed;
+        hi = std::max(hi, row + e.added);
+        lo = std::min(lo, row);
+        for (size_t r = row; r < row + removed; r++) {
+            removeLine(words, r);
+            words.lines[r].clear();
+            words.stale[r] = 1;
+        }
+        // Lines replaced one for one stay where they are; only the difference shifts
+        size_t added = (size_t)e.added;
+        if (added < removed) {
+            words.lines.erase(words.lines.begin() + row + added, words.lines.begin() + row + removed);
+            words.stale.erase(words.stale.begin() + row + added, words.stale.begin() + row + removed);
+        } else if (added > removed) {
+            words.lines.insert(words.lines.begin() + row + removed, added - removed, {});
+            words.stale.insert(words.stale.begin() + row + removed, added - removed, 1);
+        }
+    }
+    // A new document, or a log that does not add up, is scanned whole
+    if (full || words.lines.size() != lines.size()) {
+        for (size_t r = 0; r < words.lines.size(); r++) removeLine(words, r);
+        words.counts.clear();
+        // Headroom so the first inserted lines do not reallocate a large file
+        words.lines.reserve(lines.size() + lines.size() / 8);
+        words.lines.assign(lines.size(), {});
+        words.stale.assign(lines.size(), 1);
+        lo = 0;
+        hi = lines.size();
+    }
+    for (size_t r = lo; r < std::min(hi, lines.size()); r++) {
+        if (words.stale[r]) addLine(words, r, lines[r]);
+    }
+    if (recent.size() >= COMPACT_AT || dead >= COMPACT_AT + sorted.size() / 4) compact();
+}
+
+std::vector<std::string> CompletionIndex::complete(const std::string& prefix, const DocWords& current,
+                                                   const std::vector<const DocWords*>& others, const Grammar* grammar, size_t max) const {
+    struct Ranked { uint32_t id; uint32_t score; };
+    std::vector<Ranked> found;
+    auto count = [](const DocWords& w, uint32_t id) -> uint32_t {
+        auto it = w.counts.find(id);
+        return it == w.counts.end() ? 0 : it->second;
+    };
+    auto words = languages.find(grammar);
+    const std::vector<uint32_t>* language = words == languages.end() ? nullptr : &words->second;
+    auto consider = [&](uint32_t id) {
+        const std::string& s = strings[id];
+        if (s.size() == prefix.size()) return;
+        uint32_t score = count(current, id) * 4;
+        for (const DocWords* w : others) score += count(*w, id);
+        if (language && std::binary_search(language->begin(), language->end(), id)) score += 2;
+        if (score > 0) found.push_back({id, score});
+    };
+    auto lo = std::lower_bound(sorted.begin(), sorted.end(), prefix, [&](uint32_t a, const std::string& p) { return strings[a] < p; });
+    size_t scanned = 0;
+    // Dead ids waiting for compaction are passed over without counting
+    for (auto it = lo; it != sorted.end() && scanned < SCAN_LIMIT; ++it) {
+        if (strings[*it].compare(0, prefix.size(), prefix) != 0) break;
+        if (!live(*it)) continue;
+        consider(*it);
+        scanned++;
+    }
+    for (uint32_t id : recent) {
+        if (live(id) && strings[id].compare(0, prefix.size(), prefix) == 0) consider(id);
+    }
+    size_t n = std::min(max, found.size());
+    std::partial_sort(found.begin(), found.begin() + n, found.end(), [&](const Ranked& a, const Ranked& b) {
+        if (a.score != b.score) return a.score > b.score;
+        if (strings[a.id].size() != strings[b.id].size()) return strings[a.id].size() < strings[b.id].size();
+        return strings[a.id] < strings[b.id];
+    });
+    std::vector<std::string> out;
+    for (size_t i = 0; i < n; i++) out.push_back(strings[found[i].id]);
+    return out;
+}
+
+// A hash node is the pair plus a next pointer and the cached hash
+template <class K, class V>
+static size_t MapBytes(const std::unordered_map<K, V>& m) {
+    return m.size() * (sizeof(std::pair<const K, V>) + 2 * sizeof(void*)) + m.bucket_count() * sizeof(void*);
+}
+
+size_t DocWords::memoryBytes() const {
+    size_t bytes = lines.capacity() * sizeof(lines[0]) + stale.capacity() + MapBytes(counts);
+    for (const auto& line : lines) bytes += line.capacity() * sizeof(uint32_t);
+    return bytes;
+}
+
+size_t CompletionIndex::memoryBytes() const {
+    size_t bytes = keyword.capacity() + (refs.capacity() + sorted.capacity() + recent.capacity() + freeIds.capacity()) * sizeof(uint32_t) + MapBytes(ids) + MapBytes(languages);
+    for (const auto& l : languages) bytes += l.second.capacity() * sizeof(uint32_t);
+    for (const std::string& s : strings) bytes += StringBytes(s);
+    // The map's keys are copies of the strings
+    for (const auto& id : ids) bytes += StringBytes(id.first) - sizeof(std::string);
+    return bytes;
+}
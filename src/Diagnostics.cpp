@@ -0,0 +1,93 @@
+#include "../include/Diagnostics.hpp"
+#include <filesystem>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+// Lines longer than this are not diagnostics worth keeping whole
+static const size_t MAX_LINE = 64 * 1024;
+
+std::string DiagnosticKey(const std::string& path) {
+    if (path.empty()) return path;
+    std::error_code ec;
+    std::filesystem::path p = std::filesystem::absolute(path, ec);
+    if (ec) return path;
+    std::filesystem::path resolved = std::filesystem::weakly_canonical(p, ec);
+    return (ec ? p.lexically_normal() : resolved).generic_string();
+}
+
+const std::string& DiagnosticParser::resolve(const std::string& path) {
+    auto it = resolved.find(path);
+    if (it != resolved.end()) return it->second;
+    return resolved.emplace(path, DiagnosticKey(path)).first->second;
+}
+
+void DiagnosticParser::feed(const char* data, size_t len, std::vector<Diagnostic>& out) {
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != '\n') continue;
+        if (partial.size() < MAX_LINE) partial.append(data + start, std::min(i - start, MAX_LINE - partial.size()));
+        parseLine(partial, out);
+        partial.clear();
+        start = i + 1;
+    }
+    if (start < len && partial.size() < MAX_LINE) partial.append(data + start, std::min(len - start, MAX_LINE - partial.size()));
+}
+
+void DiagnosticParser::finish(std::vector<Diagnostic>& out) {
+    if (!partial.empty()) parseLine(partial, out);
+    partial.clear();
+}
+
+static bool ReadNumber(const std::string& s, size_t& i, int& value) {
+    size_t begin = i;
+    value = 0;
+    while (i < s.size() && isdigit((unsigned char)s[i]) && i - begin < 9) value = value * 10 + (s[i++] - '0');
+    return i > begin;
+}
+
+void DiagnosticParser::parseLine(const std::string& raw, std::vector<Diagnostic>& out) {
+    // Drop colour escapes and the CR of CRLF output
+    std::string line;
+    line.reserve(raw.size());
+    for (size_t i = 0; i < raw.size(); i++) {
+        if (raw[i] == '\x1b' && i + 1 < raw.size() && raw[i + 1] == '[') {
+            i += 2;
+            while (i < raw.size() && !(raw[i] >= 0x40 && raw[i] <= 0x7e)) i++;
+            continue;
+        }
+        if (raw[i] != '\r') line += raw[i];
+    }
+
+    // The path ends at the first ":<digits>:"; start at 2 to step over "C:"
+    for (size_t colon = line.find(':', 2); colon != std::string::npos; colon = line.find(':', colon + 1)) {
+        size_t i = colon + 1;
+        Diagnostic d;
+        if (!ReadNumber(line, i, d.line) || i >= line.size() || line[i] != ':') continue;
+        i++;
+        size_t afterLine = i;
+        if (!ReadNumber(line, i, d.col) || i >= line.size() || line[i] != ':') { i = afterLine; d.col = 0; }
+        else i++;
+        while (i < line.size() && line[i] == ' ') i++;
+
+        static const struct { const char* word; DiagKind kind; } KINDS[] = {
+            {"fatal error:", DiagKind::Error}, {"error:", DiagKind::Error},
+            {"warning:", DiagKind::Warning}, {"note:", DiagKind::Note},
+        };
+        bool matched = false;
+        for (const auto& k : KINDS) {
+            size_t n = strlen(k.word);
+            if (line.compare(i, n, k.word) != 0) continue;
+            d.kind = k.kind;
+            i += n;
+            matched = true;
+            break;
+        }
+        if (!matched) return;
+        while (i < line.size() && line[i] == ' ') i++;
+        d.path = resolve(line.substr(0, colon));
+        d.message = line.substr(i);
+        out.push_back(std::move(d));
+        return;
+    }
+}
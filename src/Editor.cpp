@@ -1,8 +1,12 @@
 #include "../include/Editor.hpp"
 #include "../include/FileManager.hpp" 
+#include "../include/TextFont.hpp"
 #include <fstream>
 #include <cmath>
+#include <cstring>
+#include <climits>
 #include <algorithm>
+#include <ctime>
 
 Theme theme; 
 AppSettings settings; 
@@ -46,6 +50,19 @@ void SaveSettings() {
         out << "sidebarW=" << settings.sidebarWidth << "\n";
         out << "layout=" << (int)settings.layout << "\n";
         out << "theme=" << settings.themeIndex << "\n";
+        out << "scrollback=" << settings.scrollbackLines << "\n";
+        out << "scrollbackSpill=" << (settings.scrollbackSpill ? 1 : 0) << "\n";
+        out << "syntaxCheckDelay=" << settings.syntaxCheckDelay << "\n";
+        out << "lsp=" << settings.lspCommand << "\n";
+        out << "memoryBudget=" << settings.memoryBudgetMB << "\n";
+        out << "hibernateAfter=" << settings.hibernateMinutes << "\n";
+        out << "previewCache=" << settings.previewCacheMB << "\n";
+        // task=name|dep,dep|command
+        for (const TaskDef& t : settings.tasks) {
+            out << "task=" << t.name << "|";
+            for (size_t i = 0; i < t.deps.size(); i++) out << (i ? "," : "") << t.deps[i];
+            out << "|" << t.command << "\n";
+        }
         out.close();
     }
 }
@@ -54,6 +71,7 @@ void LoadSettings() {
     std::ifstream in("data/settings.cfg");
     if (!in.is_open()) return;
     std::string line;
+    bool ownTasks = false;
     while (std::getline(in, line)) {
         size_t eq = line.find('=');
         if (eq == std::string::npos) continue;
@@ -65,6 +83,31 @@ void LoadSettings() {
         else if (key == "sidebarW") settings.sidebarWidth = std::stoi(val);
         else if (key == "layout") settings.layout = (LayoutMode)std::stoi(val);
         else if (key == "theme") settings.themeIndex = std::stoi(val);
+        else if (key == "scrollback") settings.scrollbackLines = std::stoi(val);
+        else if (key == "scrollbackSpill") settings.scrollbackSpill = std::stoi(val) != 0;
+        else if (key == "syntaxCheckDelay") settings.syntaxCheckDelay = std::max(0, std::stoi(val));
+        else if (key == "lsp") settings.lspCommand = val;
+        else if (key == "memoryBudget") settings.memoryBudgetMB = std::max(0, std::stoi(val));
+        else if (key == "hibernateAfter") settings.hibernateMinutes = std::max(0, std::stoi(val));
+        else if (key == "previewCache") settings.previewCacheMB = std::max(0, std::stoi(val));
+        else if (key == "task") {
+            // Tasks in the file replace the defaults
+            size_t a = val.find('|');
+            size_t b = (a == std::string::npos) ? a : val.find('|', a + 1);
+            if (b == std::string::npos) continue;
+            if (!ownTasks) { settings.tasks.clear(); ownTasks = true; }
+            TaskDef t;
+            t.name = val.substr(0, a);
+            std::string deps = val.substr(a + 1, b - a - 1);
+            for (size_t p = 0; p < deps.size();) {
+                size_t c = deps.find(',', p);
+                if (c == std::string::npos) c = deps.size();
+                if (c > p) t.deps.push_back(deps.substr(p, c - p));
+                p = c + 1;
+            }
+            t.command = val.substr(b + 1);
+            settings.tasks.push_back(t);
+        }
     }
 }
 
@@ -78,6 +121,8 @@ void ApplyThemePreset(int index) {
 }
 
 Document::Document(std::string p) : path(p) {
+    static uint64_t nextId = 1;
+    id = nextId++;
     if (path.empty()) filename = "Untitled";
     else {
         size_t pos = path.find_last_of("/\\");
@@ -86,35 +131,67 @@ Document::Document(std::string p) : path(p) {
     lines.push_back("");
 }
 
+void Document::edited(int row, int removed, int added) {
+    isDirty = true;
+    version++;
+    edits.push_back({row, removed, added});
+}
+
 Editor::Editor() { createNewFile(); }
 
+// Seconds the mouse rests on a word before its hover is asked for
+static const float HOVER_DELAY = 0.6f;
+
+static bool IsWordChar(int c) { return c < 128 && (isalnum(c) || c == '_'); }
+
 void Editor::init(Font f) {
     font = f;
-    keywords = {"if", "else", "while", "for", "return", "using", "namespace", "class", "true", "false", "new", "delete", "include", "void", "int", "float", "double", "bool", "char", "string", "vector", "auto", "template", "typename", "const", "static", "public", "private", "std"};
-    types = {"Editor", "FileManager", "Terminal", "Theme", "Document", "vector", "string", "map", "uint8_t", "cout", "cin", "endl"};
+    std::string errors = grammars.load("data/grammars/");
+    if (!errors.empty()) ShowToast("Grammar: " + errors.substr(0, errors.find('\n')));
+    for (const auto& g : grammars.all()) completion.addLanguage(g.get());
     updateFontMetrics();
 }
 
-void Editor::reloadFont(Font f) { font = f; updateFontMetrics(); }
+void Editor::reloadFont(Font f) {
+    // The worker may still be measuring with the old font
+    prefetch.cancel();
+    font = f;
+    updateFontMetrics();
+    for (Document& doc : docs) doc.tabWidth = -1.0f;
+    tabLayoutStale = true;
+}
 
 void Editor::updateFontMetrics() {
     Vector2 m = MeasureTextEx(font, "M", (float)settings.fontSize, 1.0f);
     charWidth = m.x; 
     lineHeight = (int)m.y;
+    for (Document& doc : docs) doc.layouts.clear();
 }
 
 Document& Editor::currentDoc() {
     if (docs.empty()) createNewFile();
     if (activeTab >= (int)docs.size()) activeTab = (int)docs.size() - 1;
-    return docs[activeTab];
+    Document& doc = docs[activeTab];
+    if (doc.hibernated) wake(doc);
+    doc.lastActive = GetTime();
+    if (mruCycle.empty() && doc.mruStamp != mruCounter) doc.mruStamp = ++mruCounter;
+    return doc;
 }
 
 std::string Editor::getCurrentPath() { return currentDoc().path; }
+uint64_t Editor::getCurrentVersion() { return currentDoc().version; }
+
+std::string Editor::getCurrentText() {
+    const Document& doc = currentDoc();
+    std::string text;
+    for (size_t i = 0; i < doc.lines.size(); i++) { text += doc.lines[i]; text += '\n'; }
+    return text;
+}
 
 void Editor::pushUndo() {
     Document& doc = currentDoc();
     if (doc.undoStack.size() > 50) doc.undoStack.pop_front();
-    doc.undoStack.push_back({doc.lines, doc.row, doc.col});
+    doc.undoStack.push_back({doc.lines, doc.row, doc.col, LinesBytes(doc.lines)});
 }
 
 void Editor::performUndo() {
@@ -123,7 +200,7 @@ void Editor::performUndo() {
         UndoState state = doc.undoStack.back();
         doc.undoStack.pop_back();
         doc.lines = state.lines;
-        doc.row = state.row; doc.col = state.col; doc.isDirty = true;
+        doc.row = state.row; doc.col = state.col; doc.edited(0, -1, -1);
     }
 }
 
@@ -158,7 +235,7 @@ void Editor::deleteSelection(Document& doc) {
         doc.lines[r1].erase(c1); doc.lines[r1] += tail;
         doc.lines.erase(doc.lines.begin() + r1 + 1, doc.lines.begin() + r2 + 1);
     }
-    doc.row = r1; doc.col = c1; clearSelection(doc); doc.isDirty = true;
+    doc.row = r1; doc.col = c1; clearSelection(doc); doc.edited(r1, r2 - r1 + 1, 1);
 }
 
 void Editor::selectAll() {
@@ -185,6 +262,7 @@ void Editor::pasteFromClipboard() {
     Document& doc = currentDoc();
     pushUndo();
     if (hasSelection(doc)) deleteSelection(doc);
+    int startRow = doc.row;
     size_t pos = 0;
     while (pos < str.length()) {
         size_t next = str.find('\n', pos);
@@ -199,7 +277,7 @@ void Editor::pasteFromClipboard() {
             doc.row++; doc.col = 0;
         }
     }
-    doc.isDirty = true;
+    doc.edited(startRow, 1, doc.row - startRow + 1);
 }
 
 // Navigation
@@ -208,7 +286,7 @@ void Editor::moveLeft(Document& doc) {
         doc.col--;
         while (doc.col > 0 && IsContinuationByte(doc.lines[doc.row][doc.col])) doc.col--;
     } else if (doc.row > 0) {
-        doc.row--; doc.col = doc.lines[doc.row].size();
+        doc.row = doc.brackets.toRow(doc.brackets.toVisible(doc.row) - 1); doc.col = doc.lines[doc.row].size();
     }
 }
 
@@ -216,8 +294,8 @@ void Editor::moveRight(Document& doc) {
     if (doc.col < (int)doc.lines[doc.row].size()) {
         doc.col++;
         while (doc.col < (int)doc.lines[doc.row].size() && IsContinuationByte(doc.lines[doc.row][doc.col])) doc.col++;
-    } else if (doc.row < (int)doc.lines.size() - 1) {
-        doc.row++; doc.col = 0;
+    } else if (doc.brackets.toVisible(doc.row) + 1 < doc.brackets.visibleCount()) {
+        doc.row = doc.brackets.toRow(doc.brackets.toVisible(doc.row) + 1); doc.col = 0;
     }
 }
 
@@ -228,11 +306,11 @@ void Editor::deleteCharBackwards() {
         moveLeft(doc);
         int bytesToDelete = originalCol - doc.col;
         doc.lines[doc.row].erase(doc.col, bytesToDelete);
-        doc.isDirty = true;
+        doc.edited(doc.row);
     } else if (doc.row > 0) {
         doc.col = doc.lines[doc.row - 1].size();
         doc.lines[doc.row - 1] += doc.lines[doc.row];
-        doc.lines.erase(doc.lines.begin() + doc.row); doc.row--; doc.isDirty = true;
+        doc.lines.erase(doc.lines.begin() + doc.row); doc.row--; doc.edited(doc.row, 2, 1);
     }
 }
 
@@ -250,38 +328,549 @@ void Editor::deleteWordBackwards() {
             start--;
         }
     }
-    line.erase(start, doc.col - start); doc.col = start; doc.isDirty = true;
+    line.erase(start, doc.col - start); doc.col = start; doc.edited(doc.row);
 }
 
 // File IO
-void Editor::createNewFile() { docs.push_back(Document()); activeTab = (int)docs.size() - 1; }
+void Editor::createNewFile() { docs.push_back(Document()); activeTab = (int)docs.size() - 1; tabLayoutStale = true; }
+
+void Editor::closeTab(int index) {
+    if (index < 0 || index >= (int)docs.size()) return;
+    if (lsp) lsp->close(docs[index].path);
+    if (!docs[index].swapPath.empty()) remove(docs[index].swapPath.c_str());
+    if (docs[index].preview == PreviewKind::Audio) stopAudio();
+    completion.release(docs[index].words);
+    docs.erase(docs.begin() + index);
+    if (activeTab > index || activeTab >= (int)docs.size()) activeTab = std::max(0, activeTab - 1);
+    mruCycle.clear();
+    tabLayoutStale = true;
+    if (docs.empty()) createNewFile();
+}
+
+// Tab strip
+static const float TAB_MENU_W = 28.0f;          // the overflow button at the right end
+static const float TAB_MENU_LIST_W = 360.0f;
+static const int TAB_MENU_ROWS = 14;
+static const float TAB_MENU_ROW_H = 24.0f;
+
+static std::string TabTitle(const Document& doc) { return doc.filename + (doc.isDirty ? "*" : ""); }
+
+static std::string Lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+}
+
+// Only the current document can have been edited or saved since the last
+// layout; opening, closing, renaming and font changes mark it stale.
+void Editor::layoutTabs() {
+    const Document& cur = docs[std::min(activeTab, (int)docs.size() - 1)];
+    if (cur.tabWidth >= 0 && cur.tabWidthDirty != cur.isDirty) tabLayoutStale = true;
+    if (!tabLayoutStale && tabOffsets.size() == docs.size() + 1) return;
+    tabOffsets.resize(docs.size() + 1);
+    float x = 0;
+    for (size_t i = 0; i < docs.size(); i++) {
+        Document& doc = docs[i];
+        if (doc.tabWidth < 0 || doc.tabWidthDirty != doc.isDirty) {
+            doc.tabWidth = MeasureTextEx(font, TabTitle(doc).c_str(), Config::FONT_SIZE_UI, 1).x + 40;
+            doc.tabWidthDirty = doc.isDirty;
+        }
+        tabOffsets[i] = x;
+        x += doc.tabWidth + 2;
+    }
+    tabOffsets[docs.size()] = x;
+    tabLayoutStale = false;
+}
+
+std::vector<int> Editor::mruOrder() {
+    std::vector<int> order(docs.size());
+    for (int i = 0; i < (int)order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return docs[a].mruStamp > docs[b].mruStamp; });
+    return order;
+}
+
+std::vector<int> Editor::tabMenuItems() {
+    std::string filter = Lower(tabFilter);
+    std::vector<int> items;
+    for (int i : mruOrder()) {
+        if (filter.empty() || Lower(docs[i].filename).find(filter) != std::string::npos || Lower(docs[i].path).find(filter) != std::string::npos) items.push_back(i);
+    }
+    return items;
+}
+
+static Rectangle TabMenuRect(Rectangle bounds, int rows) {
+    float w = std::min(TAB_MENU_LIST_W, bounds.width);
+    return {bounds.x + bounds.width - w, bounds.y + Config::TAB_HEIGHT, w, 32 + std::max(rows, 1) * TAB_MENU_ROW_H + 4};
+}
+
+static int TabMenuFirst(int sel, int count) {
+    return std::max(0, std::min(sel - TAB_MENU_ROWS / 2, count - TAB_MENU_ROWS));
+}
+
+bool Editor::updateTabs(Rectangle bounds) {
+    layoutTabs();
+    float tabH = Config::TAB_HEIGHT;
+    Rectangle strip = {bounds.x, bounds.y, bounds.width - TAB_MENU_W, tabH};
+    Rectangle menuBtn = {strip.x + strip.width, bounds.y, TAB_MENU_W, tabH};
+    Vector2 m = GetMousePosition();
+
+    // The overflow menu: type to filter, arrows and Enter or a click to pick
+    if (tabMenuOpen) {
+        int c;
+        while ((c = GetCharPressed()) > 0) { tabFilter += CodepointToUTF8(c); tabMenuSel = 0; }
+        if (IsKeyPressed(KEY_BACKSPACE) && !tabFilter.empty()) {
+            do tabFilter.pop_back(); while (!tabFilter.empty() && IsContinuationByte(tabFilter.back()));
+            tabMenuSel = 0;
+        }
+        std::vector<int> items = tabMenuItems();
+        int n = (int)items.size();
+        if (n > 0 && IsKeyPressed(KEY_DOWN)) tabMenuSel = (tabMenuSel + 1) % n;
+        if (n > 0 && IsKeyPressed(KEY_UP)) tabMenuSel = (tabMenuSel + n - 1) % n;
+        tabMenuSel = std::min(tabMenuSel, std::max(0, n - 1));
+        int chosen = IsKeyPressed(KEY_ENTER) && n > 0 ? items[tabMenuSel] : -1;
+        int shown = std::min(n, TAB_MENU_ROWS);
+        Rectangle list = TabMenuRect(bounds, shown);
+        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+            int row = (int)((m.y - list.y - 32) / TAB_MENU_ROW_H);
+            if (!CheckCollisionPointRec(m, list)) tabMenuOpen = false;
+            else if (m.y >= list.y + 32 && row < shown) chosen = items[TabMenuFirst(tabMenuSel, n) + row];
+        }
+        if (IsKeyPressed(KEY_ESCAPE)) tabMenuOpen = false;
+        if (chosen >= 0) { activeTab = chosen; tabMenuOpen = false; }
+        return false;
+    }
+    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && CheckCollisionPointRec(m, menuBtn)) {
+        tabMenuOpen = true;
+        tabFilter.clear();
+        tabMenuSel = docs.size() > 1 ? 1 : 0;   // the previous tab, as with Ctrl+Tab
+        return false;
+    }
+
+    float maxScroll = std::max(0.0f, tabOffsets.back() - strip.width);
+    if (CheckCollisionPointRec(m, strip)) tabScroll -= GetMouseWheelMove() * 60.0f;
+    // Switching tabs by any route brings the new one into view once
+    if (activeTab != tabScrolledTo && activeTab < (int)docs.size()) {
+        float left = tabOffsets[activeTab], right = tabOffsets[activeTab + 1] - 2;
+        if (left < tabScroll) tabScroll = left;
+        else if (right > tabScroll + strip.width) tabScroll = right - strip.width;
+        tabScrolledTo = activeTab;
+    }
+    tabScroll = Clamp(tabScroll, 0.0f, maxScroll);
+
+    if (!IsMouseButtonPressed(MOUSE_LEFT_BUTTON) || !CheckCollisionPointRec(m, strip)) return true;
+    float x = m.x - strip.x + tabScroll;
+    int i = (int)(std::upper_bound(tabOffsets.begin(), tabOffsets.end(), x) - tabOffsets.begin()) - 1;
+    if (i < 0 || i >= (int)docs.size() || x > tabOffsets[i] + docs[i].tabWidth) return true;
+    if (x >= tabOffsets[i] + docs[i].tabWidth - 25) { closeTab(i); return false; }
+    activeTab = i;
+    return true;
+}
+
+void Editor::drawTabs(Rectangle bounds) {
+    layoutTabs();
+    float tabH = Config::TAB_HEIGHT;
+    Rectangle strip = {bounds.x, bounds.y, bounds.width - TAB_MENU_W, tabH};
+    Vector2 mouse = GetMousePosition();
+    DrawRectangleRec({bounds.x, bounds.y, bounds.width, tabH}, theme.panelBg);
+
+    BeginScissorMode((int)strip.x, (int)strip.y, (int)strip.width, (int)strip.height);
+    int first = (int)(std::upper_bound(tabOffsets.begin(), tabOffsets.end(), tabScroll) - tabOffsets.begin()) - 1;
+    for (int i = std::max(first, 0); i < (int)docs.size() && tabOffsets[i] - tabScroll < strip.width; i++) {
+        float tabX = strip.x + tabOffsets[i] - tabScroll;
+        float tabW = docs[i].tabWidth;
+        Rectangle tabRect = {tabX, bounds.y, tabW, tabH}; 
+        bool isHover = CheckCollisionPointRec(mouse, tabRect) && CheckCollisionPointRec(mouse, strip);
+        
+        DrawRectangleRec(tabRect, (i==activeTab) ? theme.tabActive : theme.tabInactive);
+        if (i==activeTab) DrawRectangle((int)tabX, (int)bounds.y, (int)tabW, 2, theme.keyword);
+        
+        DrawTextEx(font, TabTitle(docs[i]).c_str(), {tabX+10, bounds.y+5}, Config::FONT_SIZE_UI, 1, (i==activeTab) ? WHITE : docs[i].hibernated ? Fade(GRAY, 0.6f) : GRAY);
+        if (isHover) DrawTextEx(font, "x", {tabX + tabW - 20, bounds.y + 5}, 18, 1, theme.closeBtn);
+        DrawLine((int)(tabX+tabW), (int)bounds.y, (int)(tabX+tabW), (int)(bounds.y+tabH), theme.border);
+    }
+    EndScissorMode();
+
+    // Fades at an edge that hides tabs, and the overflow button
+    if (tabScroll > 0) DrawRectangleGradientH((int)strip.x, (int)strip.y, 16, (int)tabH, theme.panelBg, Fade(theme.panelBg, 0.0f));
+    if (tabOffsets.back() - tabScroll > strip.width) DrawRectangleGradientH((int)(strip.x + strip.width - 16), (int)strip.y, 16, (int)tabH, Fade(theme.panelBg, 0.0f), theme.panelBg);
+    Rectangle menuBtn = {strip.x + strip.width, bounds.y, TAB_MENU_W, tabH};
+    if (CheckCollisionPointRec(mouse, menuBtn) || tabMenuOpen) DrawRectangleRec(menuBtn, theme.menuHover);
+    DrawLine((int)menuBtn.x, (int)bounds.y, (int)menuBtn.x, (int)(bounds.y + tabH), theme.border);
+    DrawTextEx(font, "v", {menuBtn.x + 9, bounds.y + 4}, Config::FONT_SIZE_UI, 1, theme.menuText);
+}
+
+void Editor::drawTabMenu(Rectangle bounds) {
+    std::vector<int> items = tabMenuItems();
+    int n = (int)items.size();
+    int shown = std::min(n, TAB_MENU_ROWS);
+    Rectangle list = TabMenuRect(bounds, shown);
+    DrawRectangleRec(list, theme.panelBg);
+    DrawRectangleLinesEx(list, 1, theme.border);
+    std::string filter = tabFilter + ((int)(GetTime() * 2) % 2 == 0 ? "|" : "");
+    DrawTextEx(font, tabFilter.empty() ? "Type to filter open tabs" : filter.c_str(), {list.x + 10, list.y + 6}, Config::FONT_SIZE_SMALL, 1, tabFilter.empty() ? GRAY : theme.text);
+    DrawLine((int)list.x, (int)(list.y + 30), (int)(list.x + list.width), (int)(list.y + 30), theme.border);
+    if (n == 0) DrawTextEx(font, "No matching tabs", {list.x + 10, list.y + 34}, 16, 1, GRAY);
+    int first = TabMenuFirst(tabMenuSel, n);
+    BeginScissorMode((int)list.x, (int)list.y, (int)list.width, (int)list.height);
+    for (int k = 0; k < shown; k++) {
+        const Document& doc = docs[items[first + k]];
+        Rectangle row = {list.x + 1, list.y + 32 + k * TAB_MENU_ROW_H, list.width - 2, TAB_MENU_ROW_H};
+        if (first + k == tabMenuSel || CheckCollisionPointRec(GetMousePosition(), row)) DrawRectangleRec(row, theme.selection);
+        DrawTextEx(font, TabTitle(doc).c_str(), {row.x + 9, row.y + 3}, 18, 1, items[first + k] == activeTab ? WHITE : theme.text);
+        float nameW = MeasureTextEx(font, TabTitle(doc).c_str(), 18, 1).x;
+        std::string dir = fs::path(doc.path).parent_path().string();
+        DrawTextEx(font, dir.c_str(), {row.x + 20 + nameW, row.y + 5}, 14, 1, GRAY);
+    }
+    EndScissorMode();
+}
+
+Editor::~Editor() {
+    for (const Document& doc : docs) {
+        if (!doc.swapPath.empty()) remove(doc.swapPath.c_str());
+    }
+}
+
+static bool ReadLines(const std::string& path, std::vector<std::string>& out) {
+    std::ifstream in(path);
+    if (!in.is_open()) return false;
+    out.clear();
+    std::string line;
+    while (std::getline(in, line)) { if (!line.empty() && line.back() == '\r') line.pop_back(); out.push_back(line); }
+    if (out.empty()) out.push_back("");
+    return true;
+}
+
+// Hibernation. A packed tab is one compressed blob: a flag, the lines when
+// they cannot be re-read from disk, then the undo snapshots.
+static const double HIBERNATE_CHECK = 5.0;      // seconds between sweeps
+static const size_t SWAP_BYTES = 256 * 1024;    // larger blobs go to data/swap
+
+static void PutU32(std::vector<unsigned char>& out, uint32_t v) {
+    unsigned char b[4];
+    memcpy(b, &v, 4);
+    out.insert(out.end(), b, b + 4);
+}
+
+static void PutLines(std::vector<unsigned char>& out, const std::vector<std::string>& lines) {
+    PutU32(out, (uint32_t)lines.size());
+    for (const std::string& line : lines) {
+        PutU32(out, (uint32_t)line.size());
+        out.insert(out.end(), line.begin(), line.end());
+    }
+}
+
+struct Unpacker {
+    const unsigned char* p;
+    const unsigned char* end;
+    bool ok = true;
+
+    uint32_t u32() {
+        uint32_t v = 0;
+        if (end - p < 4) { ok = false; return 0; }
+        memcpy(&v, p, 4);
+        p += 4;
+        return v;
+    }
+    void lines(std::vector<std::string>& out) {
+        uint32_t n = u32();
+        out.clear();
+        out.reserve(std::min<size_t>(n, (size_t)(end - p) / 4));
+        for (uint32_t i = 0; i < n && ok; i++) {
+            uint32_t len = u32();
+            if ((size_t)(end - p) < len) { ok = false; break; }
+            out.emplace_back((const char*)p, len);
+            p += len;
+        }
+    }
+};
+
+void Editor::hibernate(Document& doc) {
+    syncDoc(doc);
+    bool reread = !doc.path.empty() && !doc.isDirty;
+    std::vector<unsigned char> raw;
+    PutU32(raw, reread ? 0 : 1);
+    if (!reread) PutLines(raw, doc.lines);
+    PutU32(raw, (uint32_t)doc.undoStack.size());
+    for (const UndoState& u : doc.undoStack) {
+        PutU32(raw, (uint32_t)u.row);
+        PutU32(raw, (uint32_t)u.col);
+        PutLines(raw, u.lines);
+    }
+    std::vector<unsigned char> packed;
+    if (!reread || !doc.undoStack.empty()) {
+        int compSize = 0;
+        unsigned char* comp = CompressData(raw.data(), (int)raw.size(), &compSize);
+        if (!comp) return;
+        packed.assign(comp, comp + compSize);
+        MemFree(comp);
+    }
+    if (packed.size() >= SWAP_BYTES) {
+        static const std::string session = std::to_string((long long)time(nullptr));
+        std::error_code ec;
+        fs::create_directories("data/swap", ec);
+        std::string path = "data/swap/" + session + "-" + std::to_string(nextSwap++) + ".tab";
+        // Stays in memory if the disk will not take it
+        if (SaveFileData(path.c_str(), packed.data(), (int)packed.size())) {
+            doc.swapPath = path;
+            packed = std::vector<unsigned char>();
+        }
+    }
+
+    doc.foldedRows.clear();
+    for (int r = 0; r < (int)doc.lines.size(); r++) {
+        if (doc.brackets.folded(r)) doc.foldedRows.push_back(r);
+    }
+    if (lsp) lsp->close(doc.path);
+    doc.packed = std::move(packed);
+    doc.lines = std::vector<std::string>();
+    doc.undoStack = std::deque<UndoState>();
+    doc.edits = std::vector<LineEdit>();
+    completion.release(doc.words);
+    doc.brackets = BracketTree();
+    doc.lexStates = std::vector<uint8_t>();
+    doc.lexValid = 0;
+    doc.layouts = std::unordered_map<int, LineLayout>();
+    doc.scrollVel = 0.0f;
+    doc.hibernated = true;
+}
+
+void Editor::wake(Document& doc) {
+    doc.hibernated = false;
+    bool blob = !doc.swapPath.empty() || !doc.packed.empty();
+    std::vector<unsigned char> packed;
+    if (!doc.swapPath.empty()) {
+        int size = 0;
+        unsigned char* data = LoadFileData(doc.swapPath.c_str(), &size);
+        if (data) { packed.assign(data, data + size); UnloadFileData(data); }
+        remove(doc.swapPath.c_str());
+        doc.swapPath.clear();
+    } else {
+        packed.swap(doc.packed);
+    }
+    std::vector<unsigned char> raw;
+    if (!packed.empty()) {
+        int rawSize = 0;
+        unsigned char* data = DecompressData(packed.data(), (int)packed.size(), &rawSize);
+        if (data) { raw.assign(data, data + rawSize); MemFree(data); }
+    }
+
+    Unpacker in{raw.data(), raw.data() + raw.size()};
+    bool stored = !raw.empty() && in.u32() != 0;
+    if (stored) in.lines(doc.lines);
+    else if (!ReadLines(doc.path, doc.lines)) ShowToast("Could not reread " + doc.filename);
+    if (!stored) clearSelection(doc);
+    for (uint32_t n = raw.empty() ? 0 : in.u32(); n > 0 && in.ok; n--) {
+        UndoState u;
+        u.row = (int)in.u32();
+        u.col = (int)in.u32();
+        in.lines(u.lines);
+        u.bytes = LinesBytes(u.lines);
+        if (in.ok) doc.undoStack.push_back(std::move(u));
+    }
+    if (blob && (raw.empty() || !in.ok)) ShowToast("Could not restore " + doc.filename);
+    if (doc.lines.empty()) doc.lines.push_back("");
+
+    // Indexes are rebuilt from the text, then the folds laid back over it
+    syncDoc(doc);
+    for (int r : doc.foldedRows) {
+        int span = r < (int)doc.lines.size() ? doc.brackets.foldable(r, doc.lines) : 0;
+        if (span > 0) doc.brackets.fold(r, span);
+    }
+    doc.foldedRows.clear();
+    doc.row = Clamp(doc.row, 0, (int)doc.lines.size() - 1);
+    doc.col = Clamp(doc.col, 0, (int)doc.lines[doc.row].size());
+    doc.scroll = Clamp(doc.scroll, 0, std::max(0, doc.brackets.visibleCount() - 1));
+}
+
+void Editor::hibernateIdle() {
+    double now = GetTime();
+    if (settings.hibernateMinutes <= 0 || now < hibernateCheck) return;
+    hibernateCheck = now + HIBERNATE_CHECK;
+    for (int i = 0; i < (int)docs.size(); i++) {
+        Document& doc = docs[i];
+        if (i != activeTab && !doc.hibernated && doc.preview == PreviewKind::None && now - doc.lastActive >= settings.hibernateMinutes * 60.0) hibernate(doc);
+    }
+}
 
 void Editor::loadFile(const std::string& path) {
     for (size_t i = 0; i < docs.size(); i++) { if (docs[i].path == path) { activeTab = i; return; } }
-    std::ifstream in(path);
-    if (in.is_open()) {
-        Document newDoc(path); newDoc.lines.clear(); std::string line;
-        while (std::getline(in, line)) { if (!line.empty() && line.back() == '\r') line.pop_back(); newDoc.lines.push_back(line); }
-        if (newDoc.lines.empty()) newDoc.lines.push_back("");
+    Document newDoc(path);
+    if (ReadLines(path, newDoc.lines)) {
         Document& curr = currentDoc();
-        if (curr.path.empty() && curr.lines.size()==1 && curr.lines[0].empty() && !curr.isDirty) docs[activeTab] = newDoc;
+        if (curr.path.empty() && curr.lines.size()==1 && curr.lines[0].empty() && !curr.isDirty) { completion.release(curr.words); docs[activeTab] = newDoc; }
         else { docs.push_back(newDoc); activeTab = (int)docs.size()-1; }
+        tabLayoutStale = true;
+    }
+}
+
+// Media preview
+static bool IsImagePath(const std::string& path) {
+    std::string ext = Lower(fs::path(path).extension().string());
+    for (const char* known : {".png", ".jpg", ".jpeg", ".gif", ".bmp"}) {
+        if (ext == known) return true;
+    }
+    return false;
+}
+
+void Editor::setPreview(const std::string& path) {
+    for (size_t i = 0; i < docs.size(); i++) { if (docs[i].path == path) { activeTab = i; return; } }
+    Document doc(path);
+    doc.preview = IsImagePath(path) ? PreviewKind::Image : PreviewKind::Audio;
+    // Takes the place of the last preview, or of an untouched Untitled tab
+    int slot = -1;
+    for (int i = 0; i < (int)docs.size(); i++) { if (docs[i].preview != PreviewKind::None) slot = i; }
+    Document& curr = currentDoc();
+    if (slot < 0 && curr.path.empty() && curr.lines.size()==1 && curr.lines[0].empty() && !curr.isDirty) slot = activeTab;
+    if (slot >= 0 && docs[slot].preview == PreviewKind::Audio) stopAudio();
+    if (slot >= 0) {
+        completion.release(docs[slot].words);
+        docs[slot] = doc;
+    } else {
+        docs.push_back(doc);
+        slot = (int)docs.size() - 1;
+    }
+    activeTab = slot;
+    tabLayoutStale = true;
+    if (doc.preview == PreviewKind::Audio) {
+        music = LoadMusicStream(path.c_str());
+        musicLoaded = IsMusicReady(music);
+        music.looping = false;
+        if (musicLoaded) PlayMusicStream(music);
+    }
+}
+
+void Editor::stopAudio() {
+    if (!musicLoaded) return;
+    StopMusicStream(music);
+    UnloadMusicStream(music);
+    music = Music{};
+    musicLoaded = false;
+}
+
+void Editor::cleanup() {
+    stopAudio();
+    images.clear();
+}
+
+std::string Editor::neighborImage(const std::string& path, int step) {
+    std::string dir = fs::path(path).parent_path().string();
+    if (dir != neighborsDir) {
+        neighborsDir = dir;
+        neighbors.clear();
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator(dir.empty() ? "." : dir, ec)) {
+            if (entry.is_regular_file(ec) && IsImagePath(entry.path().string())) neighbors.push_back(entry.path().string());
+        }
+        std::sort(neighbors.begin(), neighbors.end());
+    }
+    auto it = std::lower_bound(neighbors.begin(), neighbors.end(), path);
+    if (it == neighbors.end() || *it != path) return "";
+    long i = (long)(it - neighbors.begin()) + step;
+    return i >= 0 && i < (long)neighbors.size() ? neighbors[i] : "";
+}
+
+// Room left around a previewed image, and below it for its size
+static const float PREVIEW_MARGIN = 16.0f;
+static const float PREVIEW_INFO_H = 24.0f;
+
+static Rectangle AudioButton(Rectangle content) {
+    return {content.x + content.width / 2 - 200, content.y + content.height / 2, 80, 30};
+}
+
+static Rectangle AudioBar(Rectangle content) {
+    return {content.x + content.width / 2 - 100, content.y + content.height / 2 + 11, 300, 8};
+}
+
+void Editor::updatePreview(Rectangle content, Document& doc) {
+    if (doc.preview == PreviewKind::Image) {
+        // Left/Right step through the images in the same folder
+        int step = (IsKeyPressed(KEY_RIGHT) || IsKeyPressed(KEY_DOWN)) ? 1 : (IsKeyPressed(KEY_LEFT) || IsKeyPressed(KEY_UP)) ? -1 : 0;
+        if (step == 0) return;
+        neighborsDir.clear();
+        std::string next = neighborImage(doc.path, step);
+        if (!next.empty()) setPreview(next);
+        return;
+    }
+    if (!musicLoaded) return;
+    Vector2 m = GetMousePosition();
+    bool toggle = IsKeyPressed(KEY_SPACE) || (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && CheckCollisionPointRec(m, AudioButton(content)));
+    if (toggle) {
+        if (IsMusicStreamPlaying(music)) PauseMusicStream(music);
+        else if (GetMusicTimePlayed(music) > 0.0f) ResumeMusicStream(music);
+        else PlayMusicStream(music);
+    }
+    Rectangle bar = AudioBar(content);
+    Rectangle grab = {bar.x, bar.y - 8, bar.width, bar.height + 16};
+    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && CheckCollisionPointRec(m, grab)) {
+        SeekMusicStream(music, (m.x - bar.x) / bar.width * GetMusicTimeLength(music));
+    }
+}
+
+void Editor::drawPreview(Rectangle content, Document& doc) {
+    float infoY = content.y + content.height - PREVIEW_INFO_H;
+    if (doc.preview == PreviewKind::Image) {
+        images.setBudget((size_t)settings.previewCacheMB << 20);
+        int maxW = std::max(1, (int)(content.width - 2 * PREVIEW_MARGIN));
+        int maxH = std::max(1, (int)(content.height - 2 * PREVIEW_MARGIN - PREVIEW_INFO_H));
+        const ImageCache::Entry* e = images.get(doc.path, maxW, maxH);
+        std::string info;
+        if (!e) info = "Loading " + doc.filename + "...";
+        else if (e->failed) info = "Cannot open " + doc.filename;
+        else {
+            // Shown at the source size, or shrunk to fit; never enlarged
+            float scale = std::min(1.0f, std::min((float)maxW / e->sourceWidth, (float)maxH / e->sourceHeight));
+            float w = e->sourceWidth * scale, h = e->sourceHeight * scale;
+            Rectangle dst = {content.x + (content.width - w) / 2, content.y + (content.height - PREVIEW_INFO_H - h) / 2, w, h};
+            Texture2D t = e->texture;
+            EndText(font);
+            DrawTexturePro(t, {0, 0, (float)t.width, (float)t.height}, dst, {0, 0}, 0.0f, WHITE);
+            BeginText(font);
+            info = TextFormat("%d x %d", e->sourceWidth, e->sourceHeight);
+            if (scale < 1.0f) info += TextFormat("  %d%%", (int)(scale * 100));
+            // Decoded next, so Left/Right shows them at once
+            for (int step : {1, -1}) {
+                std::string n = neighborImage(doc.path, step);
+                if (!n.empty()) images.prefetch(n, maxW, maxH);
+            }
+        }
+        DrawTextEx(font, info.c_str(), {content.x + PREVIEW_MARGIN, infoY + 3}, Config::FONT_SIZE_SMALL, 1, theme.comment);
+        return;
+    }
+
+    Rectangle btn = AudioButton(content), bar = AudioBar(content);
+    DrawTextEx(font, doc.filename.c_str(), {btn.x, btn.y - 40}, Config::FONT_SIZE_UI, 1, theme.text);
+    if (!musicLoaded) {
+        DrawTextEx(font, "Cannot play this file", {btn.x, btn.y}, Config::FONT_SIZE_UI, 1, theme.comment);
+        return;
     }
+    bool playing = IsMusicStreamPlaying(music);
+    DrawRectangleRec(btn, CheckCollisionPointRec(GetMousePosition(), btn) ? theme.btnNormal : theme.border);
+    DrawTextEx(font, playing ? "Pause" : "Play", {btn.x + 12, btn.y + 5}, 18, 1, theme.text);
+    float length = GetMusicTimeLength(music), played = GetMusicTimePlayed(music);
+    DrawRectangleRec(bar, theme.border);
+    if (length > 0.0f) DrawRectangleRec({bar.x, bar.y, bar.width * std::min(1.0f, played / length), bar.height}, theme.keyword);
+    int at = (int)played, total = (int)length;
+    DrawTextEx(font, TextFormat("%d:%02d / %d:%02d", at / 60, at % 60, total / 60, total % 60), {bar.x, bar.y + 14}, Config::FONT_SIZE_SMALL, 1, theme.comment);
+    DrawTextEx(font, "Space: play / pause", {content.x + PREVIEW_MARGIN, infoY + 3}, Config::FONT_SIZE_SMALL, 1, theme.comment);
 }
 
 void Editor::saveAs() {
     Document& doc = currentDoc();
+    if (doc.preview != PreviewKind::None) return;
     std::string newPath = SaveWindowsFileDialog(doc.filename.c_str());
     if (!newPath.empty()) {
+        if (lsp) lsp->close(doc.path);
         doc.path = newPath;
         size_t pos = doc.path.find_last_of("/\\");
         doc.filename = (pos == std::string::npos) ? doc.path : doc.path.substr(pos + 1);
+        doc.tabWidth = -1.0f;
+        tabLayoutStale = true;
         saveFile();
     }
 }
 
 void Editor::saveFile() {
     Document& doc = currentDoc();
+    if (doc.preview != PreviewKind::None) return;
     if (doc.path.empty()) { saveAs(); return; }
     std::ofstream out(doc.path);
     if (out.is_open()) {
@@ -290,41 +879,559 @@ void Editor::saveFile() {
     } else { ShowToast("Save Failed!"); }
 }
 
+// Diagnostics
+void Editor::clearDiagnostics() {
+    diagnostics.clear();
+    diagUnsorted.clear();
+    diagList.clear();
+    diagCurrent = -1;
+}
+
+void Editor::addDiagnostics(std::vector<Diagnostic>& batch) {
+    for (Diagnostic& d : batch) {
+        if (d.kind != DiagKind::Note) diagList.push_back(d);
+        diagUnsorted.insert(d.path);
+        diagnostics[d.path].push_back(std::move(d));
+    }
+}
+
+void Editor::setFileDiagnostics(const std::string& path, const std::vector<Diagnostic>& diags) {
+    std::string key = DiagnosticKey(path);
+    diagList.erase(std::remove_if(diagList.begin(), diagList.end(), [&](const Diagnostic& d) { return d.path == key; }), diagList.end());
+    diagCurrent = -1;
+    diagnostics.erase(key);
+    for (const Diagnostic& d : diags) {
+        if (d.kind != DiagKind::Note) diagList.push_back(d);
+        diagnostics[key].push_back(d);
+    }
+    diagUnsorted.insert(key);
+}
+
+const std::vector<Diagnostic>* Editor::diagnosticsFor(const Document& doc) {
+    if (diagnostics.empty() || doc.path.empty()) return nullptr;
+    auto key = diagKeys.find(doc.path);
+    if (key == diagKeys.end()) key = diagKeys.emplace(doc.path, DiagnosticKey(doc.path)).first;
+    auto it = diagnostics.find(key->second);
+    if (it == diagnostics.end()) return nullptr;
+    if (diagUnsorted.erase(key->second)) {
+        std::stable_sort(it->second.begin(), it->second.end(), [](const Diagnostic& a, const Diagnostic& b) {
+            return a.line < b.line || (a.line == b.line && a.col < b.col);
+        });
+    }
+    return &it->second;
+}
+
+void Editor::nextDiagnostic(int direction) {
+    if (diagList.empty()) { ShowToast("No errors or warnings"); return; }
+    int n = (int)diagList.size();
+    diagCurrent = (diagCurrent < 0) ? (direction > 0 ? 0 : n - 1) : ((diagCurrent + direction) % n + n) % n;
+    const Diagnostic& d = diagList[diagCurrent];
+    int found = -1;
+    for (int i = 0; i < (int)docs.size() && found < 0; i++) {
+        if (!docs[i].path.empty() && diagnosticsFor(docs[i]) == &diagnostics[d.path]) found = i;
+    }
+    if (found >= 0) activeTab = found;
+    else {
+        loadFile(d.path);
+        if (DiagnosticKey(currentDoc().path) != d.path) return;
+    }
+    jumpTo(currentDoc(), d.line, d.col);
+}
+
+void Editor::jumpTo(Document& doc, int line, int col) {
+    doc.row = Clamp(line - 1, 0, (int)doc.lines.size() - 1);
+    doc.col = Clamp(col - 1, 0, (int)doc.lines[doc.row].size());
+    clearSelection(doc);
+    syncDoc(doc);
+    doc.brackets.reveal(doc.row);
+    doc.scroll = std::max(0, doc.brackets.toVisible(doc.row) - visibleLines / 2);
+    doc.scrollFrac = 0.0f;
+    doc.scrollVel = 0.0f;
+}
+
+void Editor::openAt(const std::string& path, int line, int col) {
+    loadFile(path);
+    if (currentDoc().path != path) return;
+    jumpTo(currentDoc(), line, col);
+}
+
+std::string Editor::wordAt(const Document& doc, int row, int col) {
+    if (row < 0 || row >= (int)doc.lines.size()) return "";
+    const std::string& line = doc.lines[row];
+    auto isWord = [&](int i) { return i >= 0 && i < (int)line.size() && (isalnum((unsigned char)line[i]) || line[i] == '_'); };
+    int start = std::min(col, (int)line.size());
+    if (!isWord(start) && isWord(start - 1)) start--;
+    if (!isWord(start)) return "";
+    int end = start;
+    while (isWord(start - 1)) start--;
+    while (isWord(end)) end++;
+    return line.substr(start, end - start);
+}
+
+std::string Editor::popDefinitionRequest() {
+    std::string s = definitionRequest;
+    definitionRequest = "";
+    return s;
+}
+
+void Editor::syncDoc(Document& doc) {
+    if (lsp) lsp->sync(doc.path, doc.lines, doc.edits);
+    // Brackets in strings and comments, as the grammar has them, do not count
+    doc.brackets.setGrammar(grammars.forPath(doc.path));
+    if (doc.edits.empty() && doc.brackets.lineCount() == (int)doc.lines.size()) return;
+    completion.sync(doc.lines, doc.edits, doc.words);
+    doc.brackets.sync(doc.lines, doc.edits);
+    // A line's start state depends only on the lines above it
+    for (const LineEdit& e : doc.edits) doc.lexValid = std::min(doc.lexValid, e.removed < 0 ? 0 : (size_t)std::max(e.row, 0) + 1);
+    // ...and so does its layout, through the lexer state it starts in
+    int firstEdit = INT_MAX;
+    for (const LineEdit& e : doc.edits) firstEdit = std::min(firstEdit, e.removed < 0 ? 0 : e.row);
+    for (auto it = doc.layouts.begin(); it != doc.layouts.end();) {
+        if (it->first >= firstEdit) it = doc.layouts.erase(it);
+        else ++it;
+    }
+    doc.edits.clear();
+}
+
+void Editor::lexUpTo(Document& doc, int row) {
+    const Grammar* g = grammars.forPath(doc.path);
+    if (g != doc.lexGrammar) { doc.lexGrammar = g; doc.lexValid = 0; doc.layouts.clear(); }
+    if (!g) return;
+    doc.lexStates.resize(doc.lines.size() + 1);
+    doc.lexValid = std::min(doc.lexValid, doc.lines.size());
+    if (doc.lexValid == 0) { doc.lexStates[0] = 0; doc.lexValid = 1; }
+    size_t last = std::min((size_t)row, doc.lines.size() - 1);
+    for (size_t r = doc.lexValid - 1; r < last; r++) doc.lexStates[r + 1] = g->lexLine(doc.lines[r], doc.lexStates[r], tokens);
+    doc.lexValid = std::max(doc.lexValid, last + 1);
+}
+
+// Kinetic scrolling: a wheel notch sets the view moving and friction brings
+// it to rest SCROLL_PUSH / SCROLL_FRICTION lines later, the old three.
+static const float SCROLL_PUSH = 24.0f;         // lines per second per notch
+static const float SCROLL_FRICTION = 8.0f;      // per second, exponential
+static const float SCROLL_STOP = 0.5f;          // lines per second
+static const float TRACKPAD_LINES = 3.0f;       // per unit of a fractional wheel move
+// Prefetch runs this many screens ahead; a window further than
+// PREFETCH_LEX_MAX rows past what is lexed is left to lexUpTo.
+static const int PREFETCH_SCREENS = 2;
+static const int PREFETCH_LEX_MAX = 20000;
+
+void Editor::scrollBy(Document& doc, float lines) {
+    float last = (float)std::max(0, doc.brackets.visibleCount() - 1);
+    float pos = doc.scroll + doc.scrollFrac + lines;
+    if (pos <= 0.0f || pos >= last) { pos = std::max(0.0f, std::min(pos, last)); doc.scrollVel = 0.0f; }
+    doc.scroll = (int)pos;
+    doc.scrollFrac = pos - doc.scroll;
+}
+
+const LineLayout& Editor::lineLayout(Document& doc, int row) {
+    auto it = doc.layouts.find(row);
+    if (it != doc.layouts.end()) return it->second;
+    // A row the lexer has not reached yet is drawn plain and not kept
+    bool lexed = doc.lexGrammar && (size_t)row < doc.lexValid;
+    LineLayout& out = (lexed || !doc.lexGrammar) ? doc.layouts[row] : scratchLayout;
+    LayoutLine(doc.lines[row], lexed ? doc.lexGrammar : nullptr, lexed ? doc.lexStates[row] : 0, font, (float)settings.fontSize, out);
+    return out;
+}
+
+void Editor::prefetchLines(Document& doc, int vis) {
+    LinePrefetch::Result res;
+    while (prefetch.takeResult(res)) applyPrefetch(res);
+
+    int shown = doc.brackets.visibleCount();
+    int ahead = vis * PREFETCH_SCREENS;
+    int lo = std::max(0, doc.scroll - ahead), hi = std::min(shown, doc.scroll + vis + ahead);
+    if (lo >= hi) return;
+    // Forget rows well out of reach
+    if ((int)doc.layouts.size() > 2 * (hi - lo)) {
+        int keepFrom = doc.brackets.toRow(lo), keepTo = doc.brackets.toRow(hi - 1);
+        for (auto it = doc.layouts.begin(); it != doc.layouts.end();) {
+            if (it->first < keepFrom || it->first > keepTo) it = doc.layouts.erase(it);
+            else ++it;
+        }
+    }
+    if (prefetch.pending()) return;
+
+    // Ahead in the direction of travel; down when standing still
+    int from = doc.scrollVel < 0.0f ? lo : std::min(shown, doc.scroll + vis);
+    int to = doc.scrollVel < 0.0f ? doc.scroll : hi;
+    if (from >= to) return;
+    int first = doc.brackets.toRow(from), last = doc.brackets.toRow(to - 1);
+    while (first <= last && doc.layouts.count(first)) first++;
+    if (first > last) return;
+
+    LinePrefetch::Request req;
+    req.doc = doc.id;
+    req.version = doc.version;
+    req.grammar = doc.lexGrammar;
+    req.font = font;
+    req.fontSize = (float)settings.fontSize;
+    req.layoutFrom = first;
+    req.first = first;
+    if (doc.lexGrammar) {
+        // Start from the last row whose state is known
+        if (doc.lexValid == 0) return;
+        req.first = std::min(first, (int)doc.lexValid - 1);
+        if (first - req.first > PREFETCH_LEX_MAX) return;
+        req.state = doc.lexStates[req.first];
+    }
+    req.lines.assign(doc.lines.begin() + req.first, doc.lines.begin() + last + 1);
+    prefetch.submit(std::move(req));
+}
+
+void Editor::applyPrefetch(LinePrefetch::Result& res) {
+    for (Document& doc : docs) {
+        if (doc.id != res.doc) continue;
+        // Edited, relexed or resized since it was asked for
+        if (doc.hibernated || doc.version != res.version || doc.lexGrammar != res.grammar || res.fontSize != (float)settings.fontSize) return;
+        if (res.grammar) {
+            if ((size_t)res.first >= doc.lexValid || doc.lexStates.size() < res.first + res.states.size() + 1) return;
+            for (size_t i = 0; i < res.states.size(); i++) doc.lexStates[res.first + 1 + i] = res.states[i];
+            doc.lexValid = std::max(doc.lexValid, std::min(res.first + res.states.size() + 1, doc.lines.size()));
+        }
+        for (size_t i = 0; i < res.layouts.size(); i++) doc.layouts.emplace(res.layoutFrom + (int)i, std::move(res.layouts[i]));
+        return;
+    }
+}
+
+std::string Editor::benchmarkLexers() {
+    if (grammars.all().empty()) return "No grammars loaded from data/grammars/";
+    std::string out = "Lexing (MB/s):";
+    for (const auto& g : grammars.all()) out += " " + g->name + " " + std::to_string((int)g->throughput(8 << 20));
+    return out;
+}
+
+void Editor::memoryUsage(MemoryReport& report) {
+    for (const Document& doc : docs) {
+        std::string name = doc.path.empty() ? doc.filename : doc.path;
+        if (doc.hibernated) {
+            report.add("Hibernated", name + (doc.swapPath.empty() ? "" : " (swapped out)"), doc.packed.capacity());
+            continue;
+        }
+        report.add("Documents", name, LinesBytes(doc.lines) + doc.lexStates.capacity());
+        size_t undo = 0;
+        for (const UndoState& s : doc.undoStack) undo += s.bytes;
+        if (undo) report.add("Undo", name + " (" + std::to_string(doc.undoStack.size()) + " steps)", undo);
+        size_t layouts = doc.layouts.size() * (sizeof(std::pair<int, LineLayout>) + 2 * sizeof(void*));
+        for (const auto& l : doc.layouts) layouts += l.second.tokens.capacity() * sizeof(Token) + l.second.runX.capacity() * sizeof(float);
+        report.add("Indexes", name, doc.words.memoryBytes() + doc.brackets.memoryBytes() + layouts);
+    }
+    report.add("Indexes", "completion words", completion.memoryBytes());
+    images.memoryUsage(report);
+}
+
+// The current document keeps its last few steps whatever the budget says
+static const size_t KEEP_UNDO = 10;
+
+size_t Editor::trimUndo(size_t want) {
+    size_t freed = 0;
+    auto trim = [&](Document& doc, size_t keep) {
+        while (freed < want && doc.undoStack.size() > keep) {
+            freed += doc.undoStack.front().bytes;
+            doc.undoStack.pop_front();
+        }
+        doc.undoStack.shrink_to_fit();
+    };
+    for (int i = 0; i < (int)docs.size() && freed < want; i++) {
+        if (i != activeTab) trim(docs[i], 0);
+    }
+    if (freed < want && !docs.empty()) trim(currentDoc(), KEEP_UNDO);
+    return freed;
+}
+
+// Outlines the bracket pair at the cursor; otherwise underlines the pair
+// around the block the cursor is in.
+void Editor::drawBrackets(Rectangle content, const Document& doc) {
+    BracketTree::Pos a{doc.row, doc.col}, b = doc.brackets.match(doc.row, doc.col);
+    if (!b.valid() && doc.col > 0) { a.col = doc.col - 1; b = doc.brackets.match(a.row, a.col); }
+    bool atCursor = b.valid();
+    if (!atCursor) {
+        a = doc.brackets.enclosing(doc.row, doc.col);
+        if (!a.valid()) return;
+        b = doc.brackets.match(a.row, a.col);
+    }
+    for (const BracketTree::Pos& p : {a, b}) {
+        int line = p.valid() && !doc.brackets.hidden(p.row) ? screenLine(doc, p.row) : -1;
+        if (line < 0 || line > visibleLines) continue;
+        const std::string& text = doc.lines[p.row];
+        float x = content.x + MeasureTextEx(font, text.substr(0, p.col).c_str(), settings.fontSize, 1.0f).x;
+        float w = MeasureTextEx(font, text.substr(p.col, 1).c_str(), settings.fontSize, 1.0f).x;
+        float y = rowY(doc, content.y, p.row);
+        if (atCursor) DrawRectangleLinesEx({x - 1, y, w + 2, (float)lineHeight}, 1, theme.keyword);
+        else DrawRectangle((int)x, (int)y + lineHeight - 2, (int)w, 2, Fade(theme.comment, 0.6f));
+    }
+}
+
+// Folding
+int Editor::screenLine(const Document& doc, int row) {
+    return doc.brackets.toVisible(row) - doc.scroll;
+}
+
+float Editor::rowY(const Document& doc, float top, int row) {
+    return top + (screenLine(doc, row) - doc.scrollFrac) * lineHeight;
+}
+
+// Folds the innermost block the cursor is in that can fold
+void Editor::foldAt(Document& doc) {
+    int row = doc.row, col = doc.col;
+    while (row >= 0) {
+        int span = doc.brackets.foldable(row, doc.lines);
+        if (span > 0 && !doc.brackets.folded(row) && row + span + 1 >= doc.row) {
+            doc.brackets.fold(row, span);
+            doc.row = row;
+            doc.col = std::min(doc.col, (int)doc.lines[row].size());
+            clearSelection(doc);
+            return;
+        }
+        BracketTree::Pos p = doc.brackets.enclosing(row, col);
+        row = p.row;
+        col = p.col;
+    }
+}
+
+// Innermost first, so opening an outer block later shows its inner ones folded
+void Editor::foldAll(Document& doc) {
+    for (int r = (int)doc.lines.size() - 1; r >= 0; r--) {
+        int span = doc.brackets.foldable(r, doc.lines);
+        if (span > 0) doc.brackets.fold(r, span);
+    }
+    clearSelection(doc);
+}
+
+// Completion
+void Editor::updateCompletion(Document& doc) {
+    completionOpen = false;
+    const std::string& line = doc.lines[doc.row];
+    int start = doc.col;
+    while (start > 0 && IsWordChar((unsigned char)line[start - 1])) start--;
+    if (doc.col - start < 2 || isdigit((unsigned char)line[start])) return;
+    std::vector<const DocWords*> others;
+    for (int i = 0; i < (int)docs.size(); i++) {
+        syncDoc(docs[i]);
+        if (i != activeTab) others.push_back(&docs[i].words);
+    }
+    completionItems = completion.complete(line.substr(start, doc.col - start), doc.words, others, grammars.forPath(doc.path), 8);
+    completionOpen = !completionItems.empty();
+    completionSel = 0;
+    completionRow = doc.row;
+    completionCol = start;
+    completionTab = activeTab;
+    // The server's answer is merged in when it arrives
+    if (lsp) completionId = lsp->completion(doc.path, doc.lines, doc.row, doc.col);
+}
+
+void Editor::acceptCompletion(Document& doc) {
+    const std::string& item = completionItems[completionSel];
+    pushUndo();
+    doc.lines[doc.row].replace(completionCol, doc.col - completionCol, item);
+    doc.col = completionCol + (int)item.size();
+    doc.edited(doc.row);
+    completionOpen = false;
+}
+
+void Editor::drawCompletion(Rectangle content, const Document& doc) {
+    float x = content.x + MeasureTextEx(font, doc.lines[doc.row].substr(0, completionCol).c_str(), settings.fontSize, 1.0f).x;
+    float y = rowY(doc, content.y, doc.row) + lineHeight;
+    float w = 0;
+    for (const std::string& item : completionItems) w = std::max(w, MeasureTextEx(font, item.c_str(), settings.fontSize, 1.0f).x);
+    w += 16;
+    float h = completionItems.size() * lineHeight + 4.0f;
+    // Flip above the line when there is no room below
+    if (y + h > content.y + content.height) y -= h + lineHeight;
+    x = std::min(x, content.x + content.width - w);
+    DrawRectangleRec({x, y, w, h}, theme.panelBg);
+    DrawRectangleLinesEx({x, y, w, h}, 1, theme.border);
+    for (int i = 0; i < (int)completionItems.size(); i++) {
+        float iy = y + 2 + i * lineHeight;
+        if (i == completionSel) DrawRectangle((int)x + 1, (int)iy, (int)w - 2, lineHeight, theme.selection);
+        DrawTextEx(font, completionItems[i].c_str(), {x + 8, iy}, settings.fontSize, 1.0f, theme.text);
+    }
+}
+
+// Language server
+void Editor::requestHover(Document& doc, int row, int col) {
+    if (!lsp || wordAt(doc, row, col).empty()) return;
+    syncDoc(doc);
+    hoverId = lsp->hover(doc.path, doc.lines, row, col);
+    hoverText.clear();
+    hoverTab = activeTab;
+    hoverRow = row;
+    hoverCol = col;
+    hoverVersion = doc.version;
+}
+
+void Editor::languageEvent(const LspClient::Event& ev) {
+    if (ev.kind == LspClient::EventKind::Hover && ev.id == hoverId) {
+        hoverId = 0;
+        hoverText = ev.text;
+    } else if (ev.kind == LspClient::EventKind::Completion && ev.id == completionId) {
+        completionId = 0;
+        if (completionTab != activeTab) return;
+        Document& doc = currentDoc();
+        if (doc.row != completionRow || doc.col < completionCol) return;
+        std::string prefix = doc.lines[doc.row].substr(completionCol, doc.col - completionCol);
+        auto lower = [](std::string s) { std::transform(s.begin(), s.end(), s.begin(), ::tolower); return s; };
+        std::string want = lower(prefix);
+        // The server's matches first, then the words not among them
+        std::vector<std::string> merged;
+        for (const std::string& item : ev.items) {
+            if (item.size() <= prefix.size() || lower(item.substr(0, want.size())) != want) continue;
+            if (std::find(merged.begin(), merged.end(), item) == merged.end()) merged.push_back(item);
+        }
+        if (merged.empty()) return;
+        for (const std::string& item : completionItems) {
+            if (std::find(merged.begin(), merged.end(), item) == merged.end()) merged.push_back(item);
+        }
+        if (merged.size() > 8) merged.resize(8);
+        completionItems = merged;
+        completionSel = std::min(completionSel, (int)merged.size() - 1);
+        completionOpen = true;
+    } else if (ev.kind == LspClient::EventKind::References && ev.id == referencesId) {
+        referencesId = 0;
+        references = ev.locations;
+        referencesReady = true;
+    }
+}
+
+bool Editor::popReferences(std::string& word, std::vector<LspClient::Location>& out) {
+    if (!referencesReady) return false;
+    referencesReady = false;
+    word = referencesWord;
+    out.swap(references);
+    references.clear();
+    return true;
+}
+
+void Editor::drawHover(Rectangle content, const Document& doc) {
+    std::vector<std::string> rows;
+    float w = 0;
+    for (size_t start = 0; start <= hoverText.size();) {
+        size_t end = hoverText.find('\n', start);
+        if (end == std::string::npos) end = hoverText.size();
+        rows.push_back(hoverText.substr(start, end - start));
+        w = std::max(w, MeasureTextEx(font, rows.back().c_str(), Config::FONT_SIZE_SMALL, 1).x);
+        start = end + 1;
+    }
+    w += 16;
+    float rowH = Config::FONT_SIZE_SMALL + 4.0f;
+    float h = rows.size() * rowH + 8;
+    float x = content.x + MeasureTextEx(font, doc.lines[hoverRow].substr(0, std::min((size_t)hoverCol, doc.lines[hoverRow].size())).c_str(), settings.fontSize, 1.0f).x;
+    float y = rowY(doc, content.y, hoverRow) - h;
+    // Below the line when there is no room above
+    if (y < content.y) y += h + lineHeight;
+    x = std::max(content.x, std::min(x, content.x + content.width - w));
+    DrawRectangleRec({x, y, w, h}, theme.panelBg);
+    DrawRectangleLinesEx({x, y, w, h}, 1, theme.border);
+    for (size_t i = 0; i < rows.size(); i++) DrawTextEx(font, rows[i].c_str(), {x + 8, y + 4 + i * rowH}, Config::FONT_SIZE_SMALL, 1, theme.text);
+}
+
 // Update Loop
 void Editor::update(Rectangle bounds, bool isFocused) {
-    if (!isFocused) return;
-    Document& doc = currentDoc();
-
+    hibernateIdle();
     bool ctrl = IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL);
     bool shift = IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
+    // Letting go of Ctrl settles on the tab Ctrl+Tab reached
+    if (!ctrl) mruCycle.clear();
+    if (!isFocused) { tabMenuOpen = false; return; }
+    int shownTab = activeTab;
+    if (!updateTabs(bounds) || activeTab != shownTab) return;
+    Document& doc = currentDoc();
+
+    // Ctrl+Tab / Ctrl+Shift+Tab walk the tabs from most to least recently shown
+    if (ctrl && IsKeyPressed(KEY_TAB) && docs.size() > 1) {
+        if (mruCycle.empty()) { mruCycle = mruOrder(); mruPos = 0; }
+        int n = (int)mruCycle.size();
+        mruPos = (mruPos + (shift ? n - 1 : 1)) % n;
+        activeTab = mruCycle[mruPos];
+        return;
+    }
+
+    if (doc.preview != PreviewKind::None) {
+        if (ctrl && IsKeyPressed(KEY_W)) closeTab(activeTab);
+        else if (ctrl && IsKeyPressed(KEY_N)) createNewFile();
+        else updatePreview({bounds.x, bounds.y + Config::TAB_HEIGHT, bounds.width, bounds.height - Config::TAB_HEIGHT}, doc);
+        return;
+    }
 
     // Shortcuts
     if (ctrl) {
         if (IsKeyPressed(KEY_S)) saveFile();
         if (IsKeyPressed(KEY_Z)) { performUndo(); return; }
         if (IsKeyPressed(KEY_N)) createNewFile();
-        if (IsKeyPressed(KEY_W)) { if (!docs.empty()) { docs.erase(docs.begin() + activeTab); if (activeTab >= (int)docs.size()) activeTab = (int)docs.size() - 1; if (docs.empty()) createNewFile(); } }
+        if (IsKeyPressed(KEY_W)) closeTab(activeTab);
         if (IsKeyPressed(KEY_A)) selectAll();
         if (IsKeyPressed(KEY_C)) copyToClipboard();
         if (IsKeyPressed(KEY_V)) pasteFromClipboard();
         float wheel = GetMouseWheelMove();
         if (wheel != 0) { settings.fontSize += (int)wheel * 2; if (settings.fontSize < 10) settings.fontSize = 10; updateFontMetrics(); return; }
     } else {
-        float wheel = GetMouseWheelMove(); doc.scroll -= (int)wheel * 3; if (doc.scroll < 0) doc.scroll = 0;
+        float wheel = GetMousePosition().y >= bounds.y + Config::TAB_HEIGHT ? GetMouseWheelMove() : 0.0f;
+        if (wheel != 0.0f && wheel == std::floor(wheel)) {
+            // Turning the wheel back stops the view before pushing it
+            float push = -wheel * SCROLL_PUSH;
+            if (push * doc.scrollVel < 0.0f) doc.scrollVel = 0.0f;
+            doc.scrollVel += push;
+        } else if (wheel != 0.0f) {
+            // Trackpads send fractions: follow the fingers, then glide on at their speed
+            float lines = -wheel * TRACKPAD_LINES;
+            scrollBy(doc, lines);
+            doc.scrollVel = 0.5f * doc.scrollVel + 0.5f * lines / std::max(GetFrameTime(), 1.0f / 240.0f);
+            scrollTracked = true;
+        }
+    }
+
+    if (IsKeyPressed(KEY_F12) && !shift) definitionRequest = wordAt(doc, doc.row, doc.col);
+    if (IsKeyPressed(KEY_F12) && shift) {
+        referencesWord = wordAt(doc, doc.row, doc.col);
+        syncDoc(doc);
+        referencesId = (lsp && !referencesWord.empty()) ? lsp->references(doc.path, doc.lines, doc.row, doc.col) : 0;
+        if (!referencesId && !referencesWord.empty()) ShowToast("Find references needs a language server for this file");
+    }
+    // Hover: Ctrl+I at the cursor, or the mouse resting on a word
+    if (IsKeyPressed(KEY_ESCAPE) || IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) { hoverId = 0; hoverText.clear(); }
+    if (ctrl && IsKeyPressed(KEY_I)) { requestHover(doc, doc.row, doc.col); hoverByMouse = false; }
+
+    // The completion popup takes the keys it needs before editing sees them
+    if (completionOpen && completionTab != activeTab) completionOpen = false;
+    bool completing = completionOpen;
+    if (completing) {
+        int n = (int)completionItems.size();
+        if (IsKeyPressed(KEY_DOWN)) completionSel = (completionSel + 1) % n;
+        if (IsKeyPressed(KEY_UP)) completionSel = (completionSel + n - 1) % n;
+        if (IsKeyPressed(KEY_ESCAPE)) completionOpen = false;
+        if (IsKeyPressed(KEY_ENTER) || IsKeyPressed(KEY_TAB)) acceptCompletion(doc);
     }
+    uint64_t versionBefore = doc.version;
+    int typed = 0;
+    bool wordTyped = false;
 
     // Input text
     int c = GetCharPressed();
     if (c > 0) { pushUndo(); deleteSelection(doc); } 
     while (c > 0) {
+        typed++;
+        wordTyped = IsWordChar(c);
+        syncDoc(doc);
+        std::string& line = doc.lines[doc.row];
+        char next = doc.col < (int)line.size() ? line[doc.col] : 0;
+        bool code = doc.brackets.inCode(line, doc.row, doc.col);
+        // Type over a closer already there: a matched bracket, or the end of a string
+        bool closer = c == ')' || c == ']' || c == '}';
+        if (next == c && ((closer && code && doc.brackets.match(doc.row, doc.col).valid()) || (c == '"' && !code))) {
+            doc.col++;
+            c = GetCharPressed();
+            continue;
+        }
         std::string utf8Str = CodepointToUTF8(c);
-        doc.lines[doc.row].insert(doc.col, utf8Str);
+        line.insert(doc.col, utf8Str);
         doc.col += utf8Str.length();
-        if (c=='{') doc.lines[doc.row].insert(doc.col, "}");
-        if (c=='(') doc.lines[doc.row].insert(doc.col, ")");
-        if (c=='[') doc.lines[doc.row].insert(doc.col, "]");
-        if (c=='"') doc.lines[doc.row].insert(doc.col, "\"");
-        doc.isDirty = true;
+        // Close brackets and quotes opened in code, unless that runs into a word
+        bool close = code && (next == 0 || isspace((unsigned char)next) || strchr(")]};,", next));
+        if (close && c=='{') line.insert(doc.col, "}");
+        if (close && c=='(') line.insert(doc.col, ")");
+        if (close && c=='[') line.insert(doc.col, "]");
+        if (close && c=='"' && !(doc.col > 1 && IsWordChar((unsigned char)line[doc.col - 2]))) line.insert(doc.col, "\"");
+        doc.edited(doc.row);
         c = GetCharPressed();
     }
 
@@ -343,34 +1450,48 @@ void Editor::update(Rectangle bounds, bool isFocused) {
     } else backspaceTimer = 0.0f;
 
     // Enter
-    if (IsKeyPressed(KEY_ENTER)) {
+    if (IsKeyPressed(KEY_ENTER) && !completing) {
         pushUndo(); deleteSelection(doc);
+        int startRow = doc.row, before = (int)doc.lines.size();
         std::string cur = doc.lines[doc.row]; std::string rest = cur.substr(doc.col); doc.lines[doc.row] = cur.substr(0, doc.col);
         int indent = 0; while(indent < (int)doc.lines[doc.row].size() && doc.lines[doc.row][indent] == ' ') indent++;
         if (doc.col > 0 && doc.lines[doc.row][doc.col-1] == '{') {
              if (!rest.empty() && rest[0] == '}') { doc.lines.insert(doc.lines.begin() + doc.row + 1, std::string(indent, ' ') + rest); doc.lines.insert(doc.lines.begin() + doc.row + 1, std::string(indent + 4, ' ')); doc.row++; doc.col = indent + 4; }
              else { indent += 4; doc.lines.insert(doc.lines.begin() + doc.row + 1, std::string(indent, ' ') + rest); doc.row++; doc.col = indent; }
         } else { doc.lines.insert(doc.lines.begin() + doc.row + 1, std::string(indent, ' ') + rest); doc.row++; doc.col = indent; }
-        doc.isDirty = true;
+        doc.edited(startRow, 1, 1 + (int)doc.lines.size() - before);
     }
     
-    if (IsKeyPressed(KEY_TAB) && !ctrl) { pushUndo(); deleteSelection(doc); doc.lines[doc.row].insert(doc.col, "    "); doc.col += 4; doc.isDirty = true; }
+    if (IsKeyPressed(KEY_TAB) && !ctrl && !completing) { pushUndo(); deleteSelection(doc); doc.lines[doc.row].insert(doc.col, "    "); doc.col += 4; doc.edited(doc.row); }
+
+    // Keep the completion index current and the popup in step with typing
+    syncDoc(doc);
+    if (typed) { if (wordTyped) updateCompletion(doc); else completionOpen = false; }
+    else if (completionOpen && doc.version != versionBefore) updateCompletion(doc);
+
+    // Folding: Ctrl+Shift+[ and ] at the cursor, Ctrl+Shift+- and = for the file
+    if (ctrl && shift && IsKeyPressed(KEY_LEFT_BRACKET)) foldAt(doc);
+    if (ctrl && shift && IsKeyPressed(KEY_RIGHT_BRACKET)) doc.brackets.unfold(doc.row);
+    if (ctrl && shift && IsKeyPressed(KEY_MINUS)) foldAll(doc);
+    if (ctrl && shift && IsKeyPressed(KEY_EQUAL)) doc.brackets.unfoldAll();
 
     // Navigation
     bool moved = false;
-    if (IsKeyPressed(KEY_LEFT) || IsKeyPressed(KEY_RIGHT) || IsKeyPressed(KEY_UP) || IsKeyPressed(KEY_DOWN)) moved = true;
+    bool vertical = !completing && (IsKeyPressed(KEY_UP) || IsKeyPressed(KEY_DOWN));
+    if (IsKeyPressed(KEY_LEFT) || IsKeyPressed(KEY_RIGHT) || vertical) moved = true;
     if (moved) { if (shift && !doc.selecting) { doc.selecting = true; doc.selRowStart = doc.row; doc.selColStart = doc.col; } if (!shift && !doc.selecting) clearSelection(doc); }
     
     if (IsKeyPressed(KEY_LEFT)) moveLeft(doc);
     if (IsKeyPressed(KEY_RIGHT)) moveRight(doc);
     
     // Safety check for out of bounds
-    if (IsKeyPressed(KEY_UP)) { 
-        if (doc.row > 0) doc.row--; 
+    // Up and down step over folded lines
+    if (IsKeyPressed(KEY_UP) && !completing) { 
+        doc.row = doc.brackets.toRow(doc.brackets.toVisible(doc.row) - 1);
         if (doc.col > (int)doc.lines[doc.row].size()) doc.col = doc.lines[doc.row].size();
     }
-    if (IsKeyPressed(KEY_DOWN)) { 
-        if (doc.row < (int)doc.lines.size() - 1) doc.row++; 
+    if (IsKeyPressed(KEY_DOWN) && !completing) { 
+        doc.row = doc.brackets.toRow(doc.brackets.toVisible(doc.row) + 1);
         if (doc.col > (int)doc.lines[doc.row].size()) doc.col = doc.lines[doc.row].size();
     }
     
@@ -379,78 +1500,144 @@ void Editor::update(Rectangle bounds, bool isFocused) {
 
     // Mouse click
     Vector2 m = GetMousePosition();
-    float tabX = bounds.x; 
     float tabH = Config::TAB_HEIGHT;
-    for (int i=0; i<docs.size(); i++) {
-        std::string t = docs[i].filename + (docs[i].isDirty?"*":""); 
-        float tW = MeasureTextEx(font, t.c_str(), Config::FONT_SIZE_UI, 1).x + 40;
-        Rectangle tabR = {tabX, bounds.y, tW, tabH};
-        if (CheckCollisionPointRec(m, tabR)) {
-            Rectangle closeR = {tabX + tW - 25, bounds.y + 5, 20, 20};
-            if (CheckCollisionPointRec(m, closeR)) {
-                if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) { docs.erase(docs.begin() + i); if (activeTab >= (int)docs.size()) activeTab = (int)docs.size()-1; if (docs.empty()) createNewFile(); return; }
-            } else if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) activeTab = i;
-        }
-        tabX += tW + 2;
-    }
     
     Rectangle contentR = {bounds.x, bounds.y + tabH, bounds.width, bounds.height - tabH};
     if (CheckCollisionPointRec(m, contentR)) {
         float relY = m.y - contentR.y; float relX = m.x - contentR.x;
-        int r = (int)(relY / lineHeight) + doc.scroll; r = Clamp(r, 0, (int)doc.lines.size() - 1);
+        int r = doc.brackets.toRow((int)(relY / lineHeight + doc.scrollFrac) + doc.scroll);
         int c = (int)round(relX / charWidth); 
+        // Clicking past the end of a folded line opens it
+        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && !ctrl && doc.brackets.folded(r) && c > (int)doc.lines[r].size()) doc.brackets.unfold(r);
         c = Clamp(c, 0, (int)doc.lines[r].size());
         
-        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) { doc.row = r; doc.col = c; doc.selecting = true; doc.selRowStart = r; doc.selColStart = c; doc.selRowEnd = r; doc.selColEnd = c; }
+        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && ctrl) { doc.row = r; doc.col = c; clearSelection(doc); definitionRequest = wordAt(doc, r, c); }
+        else if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) { doc.row = r; doc.col = c; doc.selecting = true; doc.selRowStart = r; doc.selColStart = c; doc.selRowEnd = r; doc.selColEnd = c; }
         else if (IsMouseButtonDown(MOUSE_LEFT_BUTTON) && doc.selecting) { doc.selRowEnd = r; doc.selColEnd = c; doc.row = r; doc.col = c; }
         else if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) { if (doc.selRowStart == doc.selRowEnd && doc.selColStart == doc.selColEnd) clearSelection(doc); }
     }
+    Vector2 delta = {m.x - hoverMouse.x, m.y - hoverMouse.y};
+    if (delta.x * delta.x + delta.y * delta.y > 16) {
+        hoverMouse = m;
+        hoverStill = 0.0f;
+        if (hoverByMouse) { hoverId = 0; hoverText.clear(); }
+    } else if (hoverStill < HOVER_DELAY && (hoverStill += GetFrameTime()) >= HOVER_DELAY && CheckCollisionPointRec(m, contentR)) {
+        int r = doc.brackets.toRow((int)((m.y - contentR.y) / lineHeight + doc.scrollFrac) + doc.scroll);
+        int c = (int)((m.x - contentR.x) / charWidth);
+        if (c < (int)doc.lines[r].size()) { requestHover(doc, r, c); hoverByMouse = true; }
+    }
+    if (!hoverByMouse && (doc.row != hoverRow || doc.col != hoverCol)) { hoverId = 0; hoverText.clear(); }
+    if (completionOpen && (doc.row != completionRow || doc.col < completionCol || IsKeyPressed(KEY_LEFT) || IsKeyPressed(KEY_RIGHT) ||
+                           IsMouseButtonPressed(MOUSE_LEFT_BUTTON))) completionOpen = false;
+    doc.brackets.reveal(doc.row);
     blink += GetFrameTime(); if (blink > 0.5f) { blink = 0; showCursor = !showCursor; }
 }
 
 void Editor::render(Rectangle bounds) {
     float tabH = Config::TAB_HEIGHT; 
-    Vector2 mouse = GetMousePosition();
-    float tabX = bounds.x;
-    
-    // Render Tabs
-    for (int i=0; i<docs.size(); i++) {
-        std::string title = docs[i].filename + (docs[i].isDirty ? "*" : "");
-        float textW = MeasureTextEx(font, title.c_str(), Config::FONT_SIZE_UI, 1).x; 
-        float tabW = textW + 40;
-        Rectangle tabRect = {tabX, bounds.y, tabW, tabH}; 
-        bool isHover = CheckCollisionPointRec(mouse, tabRect);
-        
-        DrawRectangleRec(tabRect, (i==activeTab) ? theme.tabActive : theme.tabInactive);
-        if (i==activeTab) DrawRectangle((int)tabX, (int)bounds.y, (int)tabW, 2, theme.keyword);
-        
-        DrawTextEx(font, title.c_str(), {tabX+10, bounds.y+5}, Config::FONT_SIZE_UI, 1, (i==activeTab)?WHITE:GRAY);
-        if (isHover) DrawTextEx(font, "x", {tabX + tabW - 20, bounds.y + 5}, 18, 1, theme.closeBtn);
-        DrawLine((int)(tabX+tabW), (int)bounds.y, (int)(tabX+tabW), (int)(bounds.y+tabH), theme.border);
-        tabX += tabW + 2;
-    }
-    DrawRectangle((int)tabX, (int)bounds.y, (int)(bounds.width-(tabX-bounds.x)), (int)tabH, theme.panelBg);
+    // Fed here since update() is skipped while a dialog is open
+    if (musicLoaded) UpdateMusicStream(music);
+    images.upload();
+    BeginText(font);
+    drawTabs(bounds);
 
     // Render Content
     Rectangle content = {bounds.x, bounds.y+tabH, bounds.width, bounds.height-tabH};
     Document& doc = currentDoc(); DrawRectangleRec(content, theme.bg);
+    if (doc.preview != PreviewKind::None) {
+        drawPreview(content, doc);
+        if (tabMenuOpen) drawTabMenu(bounds);
+        EndText(font);
+        return;
+    }
+    syncDoc(doc);
     BeginScissorMode((int)content.x, (int)content.y, (int)content.width, (int)content.height);
         int vis = (int)(content.height / lineHeight) + 1;
-        for (int i=0; i<vis; i++) {
-            int idx = i + doc.scroll; if (idx >= doc.lines.size()) break;
-            drawLine(doc, idx, (int)content.x, (int)(content.y + i*lineHeight));
+        visibleLines = vis;
+        const std::vector<Diagnostic>* diags = diagnosticsFor(doc);
+        // Scrolling and drawing count visible lines only; folded ones cost nothing
+        int shown = doc.brackets.visibleCount();
+        if (doc.scrollVel != 0.0f && !scrollTracked) {
+            float dt = GetFrameTime();
+            scrollBy(doc, doc.scrollVel * dt);
+            doc.scrollVel *= expf(-SCROLL_FRICTION * dt);
+            if (fabsf(doc.scrollVel) < SCROLL_STOP) doc.scrollVel = 0.0f;
+        }
+        scrollTracked = false;
+        if (doc.scroll >= shown - 1) doc.scrollFrac = 0.0f;
+        doc.scroll = std::max(0, std::min(doc.scroll, shown - 1));
+        lexUpTo(doc, doc.brackets.toRow(doc.scroll + vis));
+        // One row more than fits, for the part lines at top and bottom
+        float top = content.y - doc.scrollFrac * lineHeight;
+        for (int i=0; i<=vis && doc.scroll + i < shown; i++) {
+            int idx = doc.brackets.toRow(doc.scroll + i);
+            int y = (int)(top + i*lineHeight);
+            drawLine(doc, idx, (int)content.x, y, diags);
+            if (doc.brackets.folded(idx)) {
+                float x = content.x + MeasureTextEx(font, doc.lines[idx].c_str(), settings.fontSize, 1.0f).x + charWidth;
+                float w = MeasureTextEx(font, "...", settings.fontSize, 1.0f).x + 8;
+                DrawRectangleRec({x, (float)y + 2, w, (float)lineHeight - 4}, theme.selection);
+                DrawTextEx(font, "...", {x + 4, (float)y}, settings.fontSize, 1.0f, theme.comment);
+            }
         }
+        prefetchLines(doc, vis);
+        drawBrackets(content, doc);
         if (showCursor) {
             std::string sub = doc.lines[doc.row].substr(0, doc.col);
             float cursorX = MeasureTextEx(font, sub.c_str(), settings.fontSize, 1.0f).x;
             int cx = (int)(content.x + cursorX);
-            int cy = (int)(content.y + (doc.row - doc.scroll) * lineHeight);
-            if (cy >= content.y && cy < content.y + content.height) DrawRectangle(cx, cy, 2, lineHeight, theme.cursor);
+            int cy = (int)rowY(doc, content.y, doc.row);
+            if (cy + lineHeight > content.y && cy < content.y + content.height) DrawRectangle(cx, cy, 2, lineHeight, theme.cursor);
+        }
+        if (completionOpen && completionTab == activeTab) drawCompletion(content, doc);
+        if (!hoverText.empty() && hoverTab == activeTab && hoverVersion == doc.version && hoverRow < (int)doc.lines.size()) drawHover(content, doc);
+        // Message of the first diagnostic on the cursor's line
+        if (diags) {
+            auto it = std::lower_bound(diags->begin(), diags->end(), doc.row + 1, [](const Diagnostic& d, int line) { return d.line < line; });
+            if (it != diags->end() && it->line == doc.row + 1) {
+                const char* label = it->kind == DiagKind::Error ? "error" : it->kind == DiagKind::Warning ? "warning" : "note";
+                std::string msg = std::string(label) + ": " + it->message;
+                float by = content.y + content.height - Config::FOOTER_HEIGHT;
+                DrawRectangle((int)content.x, (int)by, (int)content.width, Config::FOOTER_HEIGHT, theme.panelBg);
+                DrawTextEx(font, msg.c_str(), {content.x + 8, by + 3}, Config::FONT_SIZE_SMALL, 1, it->kind == DiagKind::Error ? theme.closeBtn : theme.text);
+            }
         }
     EndScissorMode();
+    if (tabMenuOpen) drawTabMenu(bounds);
+    EndText(font);
 }
 
-void Editor::drawLine(const Document& doc, int lineIdx, int x, int y) {
+// Gutter mark in the first pixels of the line and a squiggle under the token
+// the compiler pointed at (the whole line if it gave no column).
+void Editor::drawDiagnostics(const std::string& text, const std::vector<Diagnostic>& diags, int lineIdx, int x, int y) {
+    auto it = std::lower_bound(diags.begin(), diags.end(), lineIdx + 1, [](const Diagnostic& d, int line) { return d.line < line; });
+    bool marked = false;
+    for (; it != diags.end() && it->line == lineIdx + 1; ++it) {
+        Color c = it->kind == DiagKind::Error ? theme.closeBtn : it->kind == DiagKind::Warning ? ORANGE : theme.comment;
+        if (!marked) { DrawRectangle(x, y, 3, lineHeight, c); marked = true; }
+        if (it->kind == DiagKind::Note) continue;
+        size_t start = 0, end = text.size();
+        if (it->col > 0) {
+            start = std::min((size_t)it->col - 1, text.size());
+            end = start;
+            while (end < text.size() && (isalnum((unsigned char)text[end]) || text[end] == '_')) end++;
+            if (end == start && end < text.size()) end++;
+        } else {
+            while (start < end && (text[start] == ' ' || text[start] == '\t')) start++;
+        }
+        float x0 = x + MeasureTextEx(font, text.substr(0, start).c_str(), settings.fontSize, 1.0f).x;
+        float x1 = x + MeasureTextEx(font, text.substr(0, end).c_str(), settings.fontSize, 1.0f).x;
+        if (x1 - x0 < charWidth) x1 = x0 + charWidth;
+        float base = (float)(y + lineHeight - 3);
+        for (float sx = x0; sx < x1; sx += 3) {
+            float ex = std::min(sx + 3, x1);
+            bool up = ((int)((sx - x0) / 3)) % 2 == 0;
+            DrawLineV({sx, up ? base : base + 2}, {ex, up ? base + 2 : base}, c);
+        }
+    }
+}
+
+void Editor::drawLine(Document& doc, int lineIdx, int x, int y, const std::vector<Diagnostic>* diags) {
     std::string text = doc.lines[lineIdx];
     float cx = (float)x;
     
@@ -468,33 +1655,22 @@ void Editor::drawLine(const Document& doc, int lineIdx, int x, int y) {
         }
     }
     
-    // Draw text with highlighting
-    size_t pos = 0;
-    while (pos < text.length()) {
-        size_t nextSpace = text.find_first_of(" \t", pos);
-        if (nextSpace == std::string::npos) nextSpace = text.length();
-        
-        std::string word = text.substr(pos, nextSpace - pos);
+    // Draw text in runs of one token kind, from the document's grammar
+    const LineLayout& layout = lineLayout(doc, lineIdx);
+    for (size_t i = 0; i < layout.tokens.size(); i++) {
+        const Token& t = layout.tokens[i];
         Color c = theme.text;
-        if (keywords.count(word)) c = theme.keyword;
-        else if (types.count(word)) c = theme.type;
-        else if (isdigit(word[0])) c = theme.number;
-        else if (word.find("//") == 0) c = theme.comment;
-        else if (word.find("\"") != std::string::npos) c = theme.string;
-
-        DrawTextEx(font, word.c_str(), {cx, (float)y}, (float)settings.fontSize, 1.0f, c);
-        cx += MeasureTextEx(font, word.c_str(), settings.fontSize, 1.0f).x;
-        
-        // Add spacing manual adjust
-        if (word.length() > 0 && nextSpace < text.length()) cx += 1.0f; 
-
-        if (nextSpace < text.length()) {
-            char delim = text[nextSpace];
-            std::string dStr(1, delim);
-            DrawTextEx(font, dStr.c_str(), {cx, (float)y}, (float)settings.fontSize, 1.0f, theme.text);
-            cx += MeasureTextEx(font, dStr.c_str(), settings.fontSize, 1.0f).x;
-            if (nextSpace + 1 < text.length()) cx += 1.0f;
-            pos = nextSpace + 1;
-        } else pos = nextSpace;
+        switch (t.kind) {
+            case TokenKind::Keyword: c = theme.keyword; break;
+            case TokenKind::Type: c = theme.type; break;
+            case TokenKind::Number: c = theme.number; break;
+            case TokenKind::String: c = theme.string; break;
+            case TokenKind::Comment: c = theme.comment; break;
+            default: break;
+        }
+        std::string run = text.substr(t.start, t.length);
+        DrawTextEx(font, run.c_str(), {cx + layout.runX[i], (float)y}, (float)settings.fontSize, 1.0f, c);
     }
+
+    if (diags) drawDiagnostics(text, *diags, lineIdx, x, y);
 }
\ No newline at end of file
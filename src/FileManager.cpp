@@ -1,4 +1,5 @@
 #include "../include/FileManager.hpp"
+#include "../include/TextFont.hpp"
 
 void FileManager::init() { 
     isLoaded = false; 
@@ -23,6 +24,7 @@ void FileManager::openFolderDialog() {
     std::string path = OpenWindowsFolderPicker();
     if (!path.empty()) { 
         currentPath = path; 
+        openedRoot = path;
         isLoaded = true; 
         scrollIndex = 0; 
         refresh(); 
@@ -53,6 +55,12 @@ std::string FileManager::popSelectedFile() {
     return s;
 }
 
+std::string FileManager::popOpenedRoot() {
+    std::string s = openedRoot;
+    openedRoot = "";
+    return s;
+}
+
 void FileManager::update(Rectangle bounds, bool isFocused) {
     if (isLoaded) {
         if (isFocused) {
@@ -100,55 +108,67 @@ void FileManager::render(Rectangle bounds, Font font) {
     DrawRectangleLinesEx(bounds, 1, theme.border);
     
     // Header
+    BeginText(font);
     DrawRectangle(bounds.x, bounds.y - 25, bounds.width, 25, theme.border);
     DrawTextEx(font, "EXPLORER", {bounds.x + 5, bounds.y - 22}, Config::FONT_SIZE_UI, 1, theme.menuText);
+    EndText(font);
     
     BeginScissorMode((int)bounds.x, (int)bounds.y, (int)bounds.width, (int)bounds.height);
         if (!isLoaded) {
+            BeginText(font);
             DrawTextEx(font, "No Folder.", {bounds.x + 10, bounds.y + 10}, Config::FONT_SIZE_UI, 1, GRAY);
             Rectangle btnRect = {bounds.x + 10, bounds.y + 40, 120, 30};
             bool hover = CheckCollisionPointRec(GetMousePosition(), btnRect);
             DrawRectangleRec(btnRect, hover ? theme.btnNormal : theme.border);
             DrawTextEx(font, "Open Folder", {btnRect.x + 10, btnRect.y + 5}, 18, 1, WHITE);
+            EndText(font);
         } else {
             float y = bounds.y; 
             float x = bounds.x + 5; 
             Vector2 mouse = GetMousePosition();
             
-            // Draw ".."
-            Rectangle upRect = {bounds.x, y, bounds.width, itemHeight};
-            if (CheckCollisionPointRec(mouse, upRect)) DrawRectangleRec(upRect, theme.fileHover);
-            
-            if (folderIcon.id > 0) DrawTexture(folderIcon, (int)x, (int)y + 2, WHITE);
-            else DrawTextEx(font, "^", {x, y}, Config::FONT_SIZE_UI, 1, theme.keyword);
-            
-            DrawTextEx(font, "..", {x + 25, y}, Config::FONT_SIZE_UI, 1, theme.keyword); 
-            
-            // Draw files
-            for (int i = 0; i < entries.size(); i++) {
-                float dy = y + (i + 1 - scrollIndex) * itemHeight;
-                if (dy < bounds.y - itemHeight) continue; 
-                if (dy > bounds.y + bounds.height) break;
+            // Highlights and icons first, then all text under the text shader
+            for (int pass = 0; pass < 2; pass++) {
+                bool text = pass == 1;
+                if (text) BeginText(font);
+
+                // Draw ".."
+                Rectangle upRect = {bounds.x, y, bounds.width, itemHeight};
+                if (!text && CheckCollisionPointRec(mouse, upRect)) DrawRectangleRec(upRect, theme.fileHover);
                 
-                Rectangle itemRect = {bounds.x, dy, bounds.width, itemHeight};
-                if (CheckCollisionPointRec(mouse, itemRect)) DrawRectangleRec(itemRect, theme.fileHover);
+                if (folderIcon.id > 0) { if (!text) DrawTexture(folderIcon, (int)x, (int)y + 2, WHITE); }
+                else if (text) DrawTextEx(font, "^", {x, y}, Config::FONT_SIZE_UI, 1, theme.keyword);
                 
-                std::string n = entries[i].path().filename().string();
-                bool isDir = entries[i].is_directory();
-                Color c = isDir ? theme.folder : theme.text;
-                float textX = x;
+                if (text) DrawTextEx(font, "..", {x + 25, y}, Config::FONT_SIZE_UI, 1, theme.keyword); 
                 
-                if (isDir && folderIcon.id > 0) {
-                    DrawTexture(folderIcon, (int)x, (int)dy + 2, WHITE); 
-                    textX += 25; 
-                } else if (isDir) {
-                    DrawTextEx(font, "[D]", {x, dy}, Config::FONT_SIZE_UI, 1, theme.keyword);
-                    textX += 35;
-                } else {
-                    textX += 25; 
-                }
+                // Draw files
+                for (int i = 0; i < entries.size(); i++) {
+                    float dy = y + (i + 1 - scrollIndex) * itemHeight;
+                    if (dy < bounds.y - itemHeight) continue; 
+                    if (dy > bounds.y + bounds.height) break;
+                    
+                    Rectangle itemRect = {bounds.x, dy, bounds.width, itemHeight};
+                    if (!text && CheckCollisionPointRec(mouse, itemRect)) DrawRectangleRec(itemRect, theme.fileHover);
+                    
+                    bool isDir = entries[i].is_directory();
+                    float textX = x;
+                    
+                    if (isDir && folderIcon.id > 0) {
+                        if (!text) DrawTexture(folderIcon, (int)x, (int)dy + 2, WHITE); 
+                        textX += 25; 
+                    } else if (isDir) {
+                        if (text) DrawTextEx(font, "[D]", {x, dy}, Config::FONT_SIZE_UI, 1, theme.keyword);
+                        textX += 35;
+                    } else {
+                        textX += 25; 
+                    }
 
-                DrawTextEx(font, n.c_str(), {textX, dy}, Config::FONT_SIZE_UI, 1, c);
+                    if (!text) continue;
+                    std::string n = entries[i].path().filename().string();
+                    Color c = isDir ? theme.folder : theme.text;
+                    DrawTextEx(font, n.c_str(), {textX, dy}, Config::FONT_SIZE_UI, 1, c);
+                }
+                if (text) EndText(font);
             }
         }
     EndScissorMode();
@@ -0,0 +1,407 @@
+#include "../include/Grammar.hpp"
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+// Thompson NFA: a state either moves on a byte set to `next` or has only
+// epsilon moves; `rule` marks the accepting end of a rule's fragment.
+struct NfaState {
+    std::bitset<256> set;
+    int next = -1;
+    std::vector<int> eps;
+    int rule = -1;
+};
+
+struct Fragment {
+    int start, end;
+};
+
+class NfaBuilder {
+public:
+    std::vector<NfaState> states;
+    std::string error;
+
+    int add() { states.emplace_back(); return (int)states.size() - 1; }
+
+    Fragment bytes(const std::bitset<256>& set) {
+        int a = add(), b = add();
+        states[a].set = set;
+        states[a].next = b;
+        return {a, b};
+    }
+    Fragment empty() { int a = add(); return {a, a}; }
+    Fragment concat(Fragment a, Fragment b) { states[a.end].eps.push_back(b.start); return {a.start, b.end}; }
+    Fragment alternate(Fragment a, Fragment b) {
+        int s = add(), e = add();
+        states[s].eps = {a.start, b.start};
+        states[a.end].eps.push_back(e);
+        states[b.end].eps.push_back(e);
+        return {s, e};
+    }
+    Fragment repeat(Fragment f, char op) {
+        int s = add(), e = add();
+        states[s].eps = {f.start};
+        if (op != '+') states[s].eps.push_back(e);
+        states[f.end].eps.push_back(e);
+        if (op != '?') states[f.end].eps.push_back(f.start);
+        return {s, e};
+    }
+    Fragment literal(const std::string& text) {
+        Fragment f = empty();
+        for (unsigned char c : text) {
+            std::bitset<256> set;
+            set.set(c);
+            f = concat(f, bytes(set));
+        }
+        return f;
+    }
+
+    // Regular expressions: | * + ? ( ) [...] [^...] . and the escapes \d \w \s
+    Fragment parse(const std::string& re) {
+        pattern = &re;
+        pos = 0;
+        Fragment f = alternation();
+        if (pos < re.size() && error.empty()) error = "unexpected '" + std::string(1, re[pos]) + "' in " + re;
+        return f;
+    }
+
+private:
+    const std::string* pattern = nullptr;
+    size_t pos = 0;
+
+    bool more() const { return pos < pattern->size(); }
+    char peek() const { return (*pattern)[pos]; }
+
+    static std::bitset<256> escapeSet(char c) {
+        std::bitset<256> set;
+        for (int b = 0; b < 256; b++) {
+            bool in = c == 'd' ? isdigit(b) : c == 'w' ? (isalnum(b) || b == '_') : c == 's' ? isspace(b) : false;
+            if (b < 128 && in) set.set(b);
+        }
+        if (c == 'n') set.set('\n');
+        else if (c == 't') set.set('\t');
+        else if (c != 'd' && c != 'w' && c != 's') set.set((unsigned char)c);
+        return set;
+    }
+
+    Fragment alternation() {
+        Fragment f = sequence();
+        while (more() && peek() == '|') {
+            pos++;
+            f = alternate(f, sequence());
+        }
+        return f;
+    }
+
+    Fragment sequence() {
+        Fragment f = empty();
+        while (more() && peek() != '|' && peek() != ')') {
+            Fragment a = atom();
+            while (more() && (peek() == '*' || peek() == '+' || peek() == '?')) a = repeat(a, (*pattern)[pos++]);
+            f = concat(f, a);
+        }
+        return f;
+    }
+
+    Fragment atom() {
+        char c = (*pattern)[pos++];
+        if (c == '(') {
+            Fragment f = alternation();
+            if (!more() || peek() != ')') error = "missing ')' in " + *pattern;
+            else pos++;
+            return f;
+        }
+        if (c == '[') return bytes(charClass());
+        if (c == '.') {
+            std::bitset<256> set;
+            set.set();
+            set.reset('\n');
+            return bytes(set);
+        }
+        if (c == '\\' && more()) return bytes(escapeSet((*pattern)[pos++]));
+        std::bitset<256> set;
+        set.set((unsigned char)c);
+        return bytes(set);
+    }
+
+    std::bitset<256> charClass() {
+        std::bitset<256> set;
+        bool negate = more() && peek() == '^';
+        if (negate) pos++;
+        bool first = true;
+        while (more() && (peek() != ']' || first)) {
+            first = false;
+            unsigned char lo = (unsigned char)(*pattern)[pos++];
+            if (lo == '\\' && more()) {
+                set |= escapeSet((*pattern)[pos++]);
+                continue;
+            }
+            unsigned char hi = lo;
+            if (pos + 1 < pattern->size() && peek() == '-' && (*pattern)[pos + 1] != ']') {
+                hi = (unsigned char)(*pattern)[pos + 1];
+                pos += 2;
+            }
+            for (int b = lo; b <= hi; b++) set.set(b);
+        }
+        if (!more()) error = "missing ']' in " + *pattern;
+        else pos++;
+        return negate ? ~set : set;
+    }
+};
+
+// Splits on spaces and tabs
+static std::vector<std::string> Fields(const std::string& s) {
+    std::vector<std::string> out;
+    std::istringstream in(s);
+    std::string f;
+    while (in >> f) out.push_back(f);
+    return out;
+}
+
+bool Grammar::load(const std::string& path, std::string& error) {
+    std::ifstream in(path);
+    if (!in) { error = "cannot read " + path; return false; }
+    NfaBuilder nfa;
+    int start = nfa.add();
+    auto addRule = [&](Fragment f, TokenKind kind, int span) {
+        nfa.states[start].eps.push_back(f.start);
+        nfa.states[f.end].rule = (int)rules.size();
+        rules.push_back({kind, span});
+    };
+    auto addSpan = [&](Span span) {
+        spans.push_back(span);
+        addRule(nfa.literal(span.open), span.kind, (int)spans.size() - 1);
+    };
+    std::string number = "[0-9][0-9A-Za-z_.]*", identifier = "[A-Za-z_][A-Za-z0-9_]*";
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(in, line)) {
+        lineNo++;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t eq = line.find('=');
+        if (line.empty() || line[0] == '#' || eq == std::string::npos) continue;
+        std::string key = line.substr(0, eq), val = line.substr(eq + 1);
+        std::vector<std::string> f = Fields(val);
+        if (key == "name") name = val;
+        else if (key == "extensions") extensions = f;
+        else if (key == "keywords") keywords.insert(keywords.end(), f.begin(), f.end());
+        else if (key == "types") types.insert(types.end(), f.begin(), f.end());
+        else if (key == "default") isDefault = val == "1" || val == "true";
+        else if (key == "directives") directives = val == "1" || val == "true";
+        else if (key == "number") number = val;
+        else if (key == "identifier") identifier = val;
+        else if (key == "lineComment" && f.size() == 1) addSpan({f[0], "", 0, false, TokenKind::Comment});
+        else if (key == "blockComment" && f.size() == 2) addSpan({f[0], f[1], 0, true, TokenKind::Comment});
+        else if ((key == "string" || key == "multilineString") && (f.size() == 2 || f.size() == 3)) {
+            addSpan({f[0], f[1], f.size() == 3 ? f[2][0] : (char)0, key == "multilineString", TokenKind::String});
+        } else {
+            error = path + ":" + std::to_string(lineNo) + ": bad entry '" + key + "'";
+            return false;
+        }
+    }
+    // Rule order is priority: delimiters, keywords, types, then patterns
+    for (const std::string& k : keywords) addRule(nfa.literal(k), TokenKind::Keyword, -1);
+    for (const std::string& t : types) addRule(nfa.literal(t), TokenKind::Type, -1);
+    addRule(nfa.parse(number), TokenKind::Number, -1);
+    addRule(nfa.parse(identifier), TokenKind::Text, -1);
+    if (!nfa.error.empty()) { error = path + ": " + nfa.error; return false; }
+    if (spans.size() > 254) { error = path + ": too many comment and string kinds"; return false; }
+
+    // Bytes no set tells apart share a class, which keeps the table narrow
+    std::unordered_set<std::bitset<256>> sets;
+    for (const NfaState& s : nfa.states) if (s.next >= 0) sets.insert(s.set);
+    std::vector<int> cls(256, 0);
+    classCount = 1;
+    for (const std::bitset<256>& set : sets) {
+        // Each class splits into the bytes in the set and those outside
+        std::vector<int> split(classCount * 2, -1);
+        int count = 0;
+        for (int b = 0; b < 256; b++) {
+            int& id = split[cls[b] * 2 + set[b]];
+            if (id < 0) id = count++;
+            cls[b] = id;
+        }
+        classCount = count;
+    }
+    std::vector<int> representative(classCount);
+    for (int b = 255; b >= 0; b--) {
+        byteClass[b] = (uint8_t)cls[b];
+        representative[cls[b]] = b;
+    }
+    if (classCount > 256) { error = path + ": too many byte classes"; return false; }
+
+    // Subset construction
+    auto closure = [&](std::vector<int> set) {
+        std::vector<char> seen(nfa.states.size(), 0);
+        std::vector<int> stack = set;
+        for (int s : set) seen[s] = 1;
+        while (!stack.empty()) {
+            int s = stack.back();
+            stack.pop_back();
+            for (int e : nfa.states[s].eps) {
+                if (!seen[e]) { seen[e] = 1; set.push_back(e); stack.push_back(e); }
+            }
+        }
+        std::sort(set.begin(), set.end());
+        return set;
+    };
+    std::map<std::vector<int>, int> ids;
+    std::vector<std::vector<int>> dfa;
+    auto intern = [&](std::vector<int> set) {
+        auto it = ids.find(set);
+        if (it != ids.end()) return it->second;
+        int id = (int)dfa.size();
+        ids.emplace(set, id);
+        int best = -1;
+        for (int s : set) {
+            int r = nfa.states[s].rule;
+            if (r >= 0 && (best < 0 || r < best)) best = r;
+        }
+        accept.push_back((int16_t)best);
+        dfa.push_back(std::move(set));
+        return id;
+    };
+    intern(closure({start}));
+    for (size_t d = 0; d < dfa.size(); d++) {
+        next.resize((d + 1) * classCount, -1);
+        for (int c = 0; c < classCount; c++) {
+            std::vector<int> moved;
+            for (int s : dfa[d]) {
+                const NfaState& st = nfa.states[s];
+                if (st.next >= 0 && st.set[representative[c]]) moved.push_back(st.next);
+            }
+            if (moved.empty()) continue;
+            int target = intern(closure(moved));
+            next[d * classCount + c] = target;
+        }
+    }
+    return true;
+}
+
+size_t Grammar::closeSpan(const std::string& line, size_t from, const Span& span, bool& closed) const {
+    closed = true;
+    if (span.close.empty()) return line.size();
+    for (size_t j = from; j < line.size(); j++) {
+        if (span.escape && line[j] == span.escape) { j++; continue; }
+        if (line.compare(j, span.close.size(), span.close) == 0) return j + span.close.size();
+    }
+    closed = false;
+    return line.size();
+}
+
+uint8_t Grammar::lexLine(const std::string& line, uint8_t state, std::vector<Token>& out) const {
+    out.clear();
+    auto emit = [&](size_t start, size_t length, TokenKind kind) {
+        if (length == 0) return;
+        if (!out.empty() && out.back().kind == kind) out.back().length += (uint32_t)length;
+        else out.push_back({(uint32_t)start, (uint32_t)length, kind});
+    };
+    size_t i = 0, n = line.size();
+    // Finish the comment or string the previous line left open
+    if (state > 0 && state <= spans.size()) {
+        const Span& span = spans[state - 1];
+        bool closed;
+        i = closeSpan(line, 0, span, closed);
+        emit(0, i, span.kind);
+        if (!closed) return state;
+    }
+    const int32_t* table = next.data();
+    while (i < n) {
+        // Longest match from i
+        int s = 0, rule = -1;
+        size_t length = 0;
+        for (size_t j = i; j < n; j++) {
+            s = table[s * classCount + byteClass[(unsigned char)line[j]]];
+            if (s < 0) break;
+            if (accept[s] >= 0) { rule = accept[s]; length = j - i + 1; }
+        }
+        if (rule < 0) {
+            emit(i, 1, TokenKind::Text);
+            i++;
+            continue;
+        }
+        const Rule& r = rules[rule];
+        if (r.span < 0) {
+            emit(i, length, r.kind);
+            i += length;
+            continue;
+        }
+        const Span& span = spans[r.span];
+        bool closed;
+        size_t end = closeSpan(line, i + length, span, closed);
+        emit(i, end - i, span.kind);
+        i = end;
+        if (!closed && span.multiline) return (uint8_t)(r.span + 1);
+    }
+    return 0;
+}
+
+double Grammar::throughput(size_t bytes) const {
+    // Text in this language: words, numbers, strings and comments in turn
+    std::vector<std::string> lines;
+    std::string opener[2], closer[2];
+    for (const Span& span : spans) {
+        int k = span.kind == TokenKind::Comment ? 0 : 1;
+        if (opener[k].empty()) { opener[k] = span.open; closer[k] = span.close; }
+    }
+    uint32_t seed = 12345;
+    auto pick = [&](const std::vector<std::string>& v, const char* other) -> std::string {
+        seed = seed * 1103515245 + 12345;
+        return v.empty() ? other : v[(seed >> 8) % v.size()];
+    };
+    size_t total = 0;
+    while (total < bytes) {
+        std::string l = "    " + pick(keywords, "let") + " value_" + std::to_string(lines.size() % 97) + " = " +
+                        pick(types, "Type") + "(" + std::to_string(lines.size() * 31) + ", 0.5);";
+        if (!opener[1].empty()) l += " " + opener[1] + "text in a string" + closer[1];
+        if (!opener[0].empty()) l += " " + opener[0] + " a comment " + closer[0];
+        total += l.size() + 1;
+        lines.push_back(std::move(l));
+    }
+    std::vector<Token> tokens;
+    uint8_t state = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (const std::string& l : lines) state = lexLine(l, state, tokens);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return seconds > 0 ? total / seconds / 1e6 : 0;
+}
+
+std::string GrammarSet::load(const std::string& dir) {
+    std::string errors;
+    std::error_code ec;
+    std::vector<fs::path> files;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->path().extension() == ".grammar") files.push_back(it->path());
+    }
+    std::sort(files.begin(), files.end());
+    for (const fs::path& p : files) {
+        auto g = std::make_unique<Grammar>();
+        std::string error;
+        if (!g->load(p.string(), error)) { errors += error + "\n"; continue; }
+        for (std::string ext : g->extensions) {
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            byExtension[ext] = g.get();
+        }
+        if (g->isDefault) fallback = g.get();
+        grammars.push_back(std::move(g));
+    }
+    return errors;
+}
+
+const Grammar* GrammarSet::forPath(const std::string& path) const {
+    if (path.empty()) return fallback;
+    size_t dot = path.find_last_of('.'), slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return nullptr;
+    std::string ext = path.substr(dot);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    auto it = byExtension.find(ext);
+    return it == byExtension.end() ? nullptr : it->second;
+}
@@ -0,0 +1,143 @@
+#include "../include/ImageCache.hpp"
+#include <algorithm>
+
+// Requests past this are dropped from the back, prefetches first
+static const size_t MAX_QUEUED = 8;
+// A texture shown this much larger than it was decoded is decoded again
+static const float RESCALE = 1.25f;
+
+ImageCache::ImageCache() {
+    worker = std::thread(&ImageCache::workerLoop, this);
+}
+
+ImageCache::~ImageCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (worker.joinable()) worker.join();
+    for (Decoded& d : done) UnloadImage(d.image);
+}
+
+void ImageCache::setBudget(size_t bytes) {
+    budget = bytes;
+    evict(lru.empty() ? std::string() : lru.front());
+}
+
+const ImageCache::Entry* ImageCache::get(const std::string& path, int maxWidth, int maxHeight) {
+    auto it = entries.find(path);
+    if (it == entries.end()) {
+        queue(path, maxWidth, maxHeight, true);
+        return nullptr;
+    }
+    lru.splice(lru.begin(), lru, it->second.use);
+    const Entry& e = it->second.entry;
+    if (!e.failed && e.texture.width < e.sourceWidth && !loading.count(path)) {
+        float fit = std::min((float)maxWidth / e.texture.width, (float)maxHeight / e.texture.height);
+        if (fit > RESCALE) queue(path, maxWidth, maxHeight, true);
+    }
+    return &e;
+}
+
+void ImageCache::prefetch(const std::string& path, int maxWidth, int maxHeight) {
+    if (!entries.count(path)) queue(path, maxWidth, maxHeight, false);
+}
+
+void ImageCache::queue(const std::string& path, int maxWidth, int maxHeight, bool urgent) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto queued = std::find_if(jobs.begin(), jobs.end(), [&](const Job& j) { return j.path == path; });
+    // Already being decoded, or waiting where it belongs
+    if (loading.count(path) && (queued == jobs.end() || !urgent)) return;
+    if (queued != jobs.end()) jobs.erase(queued);
+    Job job{path, std::max(1, maxWidth), std::max(1, maxHeight)};
+    if (urgent) jobs.push_front(job);
+    else jobs.push_back(job);
+    loading.insert(path);
+    while (jobs.size() > MAX_QUEUED) {
+        loading.erase(jobs.back().path);
+        jobs.pop_back();
+    }
+    cv.notify_one();
+}
+
+void ImageCache::workerLoop() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+        Decoded d{job.path, LoadImage(job.path.c_str()), 0, 0};
+        d.sourceWidth = d.image.width;
+        d.sourceHeight = d.image.height;
+        if (d.image.data) {
+            float scale = std::min((float)job.maxWidth / d.image.width, (float)job.maxHeight / d.image.height);
+            if (scale < 1.0f) ImageResize(&d.image, std::max(1, (int)(d.image.width * scale)), std::max(1, (int)(d.image.height * scale)));
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        done.push_back(d);
+    }
+}
+
+void ImageCache::upload() {
+    Decoded d;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (done.empty()) return;
+        d = done.front();
+        done.pop_front();
+    }
+    loading.erase(d.path);
+    Entry e;
+    e.sourceWidth = d.sourceWidth;
+    e.sourceHeight = d.sourceHeight;
+    if (d.image.data) {
+        e.texture = LoadTextureFromImage(d.image);
+        SetTextureFilter(e.texture, TEXTURE_FILTER_BILINEAR);
+        UnloadImage(d.image);
+    }
+    e.failed = e.texture.id == 0;
+
+    auto it = entries.find(d.path);
+    if (it != entries.end()) {
+        used -= TextureBytes(it->second.entry.texture);
+        if (it->second.entry.texture.id) UnloadTexture(it->second.entry.texture);
+        it->second.entry = e;
+        lru.splice(lru.begin(), lru, it->second.use);
+    } else {
+        lru.push_front(d.path);
+        entries[d.path] = Slot{e, lru.begin()};
+    }
+    used += TextureBytes(e.texture);
+    evict(d.path);
+}
+
+void ImageCache::evict(const std::string& keep) {
+    while (used > budget && !lru.empty() && lru.back() != keep) {
+        auto it = entries.find(lru.back());
+        used -= TextureBytes(it->second.entry.texture);
+        if (it->second.entry.texture.id) UnloadTexture(it->second.entry.texture);
+        entries.erase(it);
+        lru.pop_back();
+    }
+}
+
+void ImageCache::memoryUsage(MemoryReport& report) {
+    for (const std::string& path : lru) {
+        const Entry& e = entries[path].entry;
+        if (e.texture.id) report.add("Textures", "preview " + path, TextureBytes(e.texture));
+    }
+}
+
+void ImageCache::clear() {
+    for (auto& slot : entries) {
+        if (slot.second.entry.texture.id) UnloadTexture(slot.second.entry.texture);
+    }
+    entries.clear();
+    lru.clear();
+    used = 0;
+}
@@ -0,0 +1,291 @@
+#include "../include/Json.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+// Deeper nesting than this is not a protocol message
+static const int MAX_DEPTH = 200;
+
+static const Json& NullValue() {
+    static const Json null;
+    return null;
+}
+
+Json Json::array() { Json j; j.kind = Array; return j; }
+Json Json::object() { Json j; j.kind = Object; return j; }
+
+const Json& Json::operator[](const std::string& key) const {
+    for (const auto& f : fields) {
+        if (f.first == key) return f.second;
+    }
+    return NullValue();
+}
+
+const Json& Json::operator[](size_t index) const {
+    return index < list.size() ? list[index] : NullValue();
+}
+
+bool Json::has(const std::string& key) const {
+    for (const auto& f : fields) {
+        if (f.first == key) return true;
+    }
+    return false;
+}
+
+const std::string& Json::str() const {
+    static const std::string empty;
+    return kind == String ? text : empty;
+}
+
+Json& Json::set(const std::string& key, Json value) {
+    kind = Object;
+    for (auto& f : fields) {
+        if (f.first == key) { f.second = std::move(value); return *this; }
+    }
+    fields.emplace_back(key, std::move(value));
+    return *this;
+}
+
+Json& Json::push(Json value) {
+    kind = Array;
+    list.push_back(std::move(value));
+    return *this;
+}
+
+static void DumpString(const std::string& s, std::string& out) {
+    out += '"';
+    for (unsigned char c : s) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += (char)c;
+                }
+        }
+    }
+    out += '"';
+}
+
+void Json::dumpTo(std::string& out) const {
+    switch (kind) {
+        case Null: out += "null"; break;
+        case Bool: out += flag ? "true" : "false"; break;
+        case Number: {
+            char buf[32];
+            if (std::isfinite(number) && number == std::floor(number) && std::fabs(number) < 1e15) snprintf(buf, sizeof(buf), "%lld", (long long)number);
+            else if (std::isfinite(number)) snprintf(buf, sizeof(buf), "%.17g", number);
+            else snprintf(buf, sizeof(buf), "null");
+            out += buf;
+            break;
+        }
+        case String: DumpString(text, out); break;
+        case Array:
+            out += '[';
+            for (size_t i = 0; i < list.size(); i++) {
+                if (i) out += ',';
+                list[i].dumpTo(out);
+            }
+            out += ']';
+            break;
+        case Object:
+            out += '{';
+            for (size_t i = 0; i < fields.size(); i++) {
+                if (i) out += ',';
+                DumpString(fields[i].first, out);
+                out += ':';
+                fields[i].second.dumpTo(out);
+            }
+            out += '}';
+            break;
+    }
+}
+
+std::string Json::dump() const {
+    std::string out;
+    dumpTo(out);
+    return out;
+}
+
+namespace {
+
+struct Parser {
+    const char* p;
+    const char* end;
+
+    void skipSpace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    }
+
+    bool literal(const char* word) {
+        size_t n = strlen(word);
+        if ((size_t)(end - p) < n || memcmp(p, word, n) != 0) return false;
+        p += n;
+        return true;
+    }
+
+    bool hex4(uint32_t& out) {
+        if (end - p < 4) return false;
+        out = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = *p++;
+            out <<= 4;
+            if (c >= '0' && c <= '9') out |= c - '0';
+            else if (c >= 'a' && c <= 'f') out |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') out |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    static void appendUtf8(uint32_t cp, std::string& out) {
+        if (cp < 0x80) out += (char)cp;
+        else if (cp < 0x800) {
+            out += (char)(0xC0 | (cp >> 6));
+            out += (char)(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += (char)(0xE0 | (cp >> 12));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        } else {
+            out += (char)(0xF0 | (cp >> 18));
+            out += (char)(0x80 | ((cp >> 12) & 0x3F));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+    }
+
+    bool string(std::string& out) {
+        p++;    // opening quote
+        while (p < end) {
+            char c = *p++;
+            if (c == '"') return true;
+            if ((unsigned char)c < 0x20) return false;
+            if (c != '\\') { out += c; continue; }
+            if (p >= end) return false;
+            char e = *p++;
+            switch (e) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    uint32_t cp;
+                    if (!hex4(cp)) return false;
+                    // A surrogate pair spells one code point; a lone half becomes U+FFFD
+                    if (cp >= 0xD800 && cp < 0xDC00) {
+                        uint32_t low;
+                        if (end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                            const char* save = p;
+                            p += 2;
+                            if (hex4(low) && low >= 0xDC00 && low < 0xE000) cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                            else { p = save; cp = 0xFFFD; }
+                        } else {
+                            cp = 0xFFFD;
+                        }
+                    } else if (cp >= 0xDC00 && cp < 0xE000) {
+                        cp = 0xFFFD;
+                    }
+                    appendUtf8(cp, out);
+                    break;
+                }
+                default: return false;
+            }
+        }
+        return false;
+    }
+
+    bool number(double& out) {
+        const char* start = p;
+        if (p < end && *p == '-') p++;
+        if (p >= end || !isdigit((unsigned char)*p)) return false;
+        while (p < end && (isdigit((unsigned char)*p) || *p == '.' || *p == 'e' || *p == 'E' || *p == '+' || *p == '-')) p++;
+        std::string digits(start, p);
+        char* stop = nullptr;
+        out = strtod(digits.c_str(), &stop);
+        return stop == digits.c_str() + digits.size();
+    }
+
+    bool value(Json& out, int depth) {
+        if (depth > MAX_DEPTH) return false;
+        skipSpace();
+        if (p >= end) return false;
+        switch (*p) {
+            case 'n': out = Json(); return literal("null");
+            case 't': out = Json(true); return literal("true");
+            case 'f': out = Json(false); return literal("false");
+            case '"': {
+                std::string s;
+                if (!string(s)) return false;
+                out = Json(std::move(s));
+                return true;
+            }
+            case '[': {
+                p++;
+                out = Json::array();
+                skipSpace();
+                if (p < end && *p == ']') { p++; return true; }
+                while (true) {
+                    Json item;
+                    if (!value(item, depth + 1)) return false;
+                    out.push(std::move(item));
+                    skipSpace();
+                    if (p >= end) return false;
+                    if (*p == ',') { p++; continue; }
+                    if (*p == ']') { p++; return true; }
+                    return false;
+                }
+            }
+            case '{': {
+                p++;
+                out = Json::object();
+                skipSpace();
+                if (p < end && *p == '}') { p++; return true; }
+                while (true) {
+                    skipSpace();
+                    std::string key;
+                    if (p >= end || *p != '"' || !string(key)) return false;
+                    skipSpace();
+                    if (p >= end || *p != ':') return false;
+                    p++;
+                    Json item;
+                    if (!value(item, depth + 1)) return false;
+                    out.set(key, std::move(item));
+                    skipSpace();
+                    if (p >= end) return false;
+                    if (*p == ',') { p++; continue; }
+                    if (*p == '}') { p++; return true; }
+                    return false;
+                }
+            }
+            default: {
+                double n;
+                if (!number(n)) return false;
+                out = Json(n);
+                return true;
+            }
+        }
+    }
+};
+
+}
+
+bool Json::parse(const std::string& text, Json& out) {
+    Parser parser{text.data(), text.data() + text.size()};
+    if (!parser.value(out, 0)) return false;
+    parser.skipSpace();
+    return parser.p == parser.end;
+}
@@ -0,0 +1,101 @@
+#include "../include/LinePrefetch.hpp"
+
+uint8_t LayoutLine(const std::string& text, const Grammar* grammar, uint8_t state, Font font, float fontSize, LineLayout& out) {
+    uint8_t next = 0;
+    out.tokens.clear();
+    out.runX.clear();
+    if (grammar) next = grammar->lexLine(text, state, out.tokens);
+    else out.tokens.push_back({0, (uint32_t)text.size(), TokenKind::Text});
+    float x = 0.0f;
+    std::string run;
+    for (const Token& t : out.tokens) {
+        out.runX.push_back(x);
+        run.assign(text, t.start, t.length);
+        // Spacing between runs matches MeasureTextEx over the whole line
+        x += MeasureTextEx(font, run.c_str(), fontSize, 1.0f).x + 1.0f;
+    }
+    return next;
+}
+
+LinePrefetch::LinePrefetch() {
+    worker = std::thread(&LinePrefetch::workerLoop, this);
+}
+
+LinePrefetch::~LinePrefetch() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (worker.joinable()) worker.join();
+}
+
+void LinePrefetch::submit(Request req) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued = std::move(req);
+        hasQueued = true;
+    }
+    cv.notify_one();
+}
+
+bool LinePrefetch::takeResult(Result& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (results.empty()) return false;
+    out = std::move(results.front());
+    results.pop_front();
+    return true;
+}
+
+bool LinePrefetch::pending() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hasQueued || busy || !results.empty();
+}
+
+void LinePrefetch::cancel() {
+    std::unique_lock<std::mutex> lock(mutex);
+    hasQueued = false;
+    idle.wait(lock, [this] { return !busy; });
+    results.clear();
+}
+
+void LinePrefetch::workerLoop() {
+    while (true) {
+        Request req;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this] { return stopping || hasQueued; });
+            if (stopping) return;
+            req = std::move(queued);
+            hasQueued = false;
+            busy = true;
+        }
+
+        Result res;
+        res.doc = req.doc;
+        res.version = req.version;
+        res.grammar = req.grammar;
+        res.fontSize = req.fontSize;
+        res.first = req.first;
+        res.layoutFrom = req.layoutFrom;
+        uint8_t state = req.state;
+        std::vector<Token> scratch;
+        for (size_t i = 0; i < req.lines.size(); i++) {
+            int row = req.first + (int)i;
+            if (row < req.layoutFrom) {
+                state = req.grammar ? req.grammar->lexLine(req.lines[i], state, scratch) : 0;
+            } else {
+                res.layouts.emplace_back();
+                state = LayoutLine(req.lines[i], req.grammar, state, req.font, req.fontSize, res.layouts.back());
+            }
+            res.states.push_back(state);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            results.push_back(std::move(res));
+            busy = false;
+        }
+        idle.notify_all();
+    }
+}
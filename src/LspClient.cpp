@@ -0,0 +1,749 @@
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOGDI
+    #include <windows.h>
+    #undef ERROR
+#else
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <signal.h>
+    #include <poll.h>
+    #include <spawn.h>
+    #include <sys/wait.h>
+    extern char** environ;
+#endif
+
+#include "../include/LspClient.hpp"
+#include "../include/SyntaxChecker.hpp"
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+
+namespace fs = std::filesystem;
+
+// A header promising more than this is a broken stream, not a message
+static const size_t MAX_MESSAGE = 64 * 1024 * 1024;
+// Enough for a popup; servers can return thousands
+static const size_t MAX_COMPLETIONS = 100;
+static const int MAX_HOVER_LINES = 16;
+
+static std::vector<std::string> SplitCommand(const std::string& command) {
+    std::vector<std::string> args;
+    std::string cur;
+    bool inQuote = false, any = false;
+    for (char c : command + " ") {
+        if (c == '"') { inQuote = !inQuote; any = true; continue; }
+        if (!inQuote && (c == ' ' || c == '\t')) {
+            if (any) args.push_back(cur);
+            cur.clear();
+            any = false;
+            continue;
+        }
+        cur += c;
+        any = true;
+    }
+    return args;
+}
+
+static std::string PathToUri(const std::string& path) {
+    std::error_code ec;
+    fs::path abs = fs::absolute(path, ec);
+    std::string p = (ec ? fs::path(path) : abs).lexically_normal().generic_string();
+    std::string uri = "file://";
+    if (p.empty() || p[0] != '/') uri += '/';
+    for (unsigned char c : p) {
+        if (isalnum(c) || strchr("/-._~:", c)) {
+            uri += (char)c;
+        } else {
+            char buf[4];
+            snprintf(buf, sizeof(buf), "%%%02X", c);
+            uri += buf;
+        }
+    }
+    return uri;
+}
+
+static std::string UriToPath(const std::string& uri) {
+    if (uri.compare(0, 7, "file://") != 0) return "";
+    std::string path;
+    for (size_t i = 7; i < uri.size(); i++) {
+        if (uri[i] == '%' && i + 2 < uri.size() && isxdigit((unsigned char)uri[i + 1]) && isxdigit((unsigned char)uri[i + 2])) {
+            path += (char)std::stoi(uri.substr(i + 1, 2), nullptr, 16);
+            i += 2;
+        } else {
+            path += uri[i];
+        }
+    }
+#ifdef _WIN32
+    // file:///C:/x is C:/x
+    if (path.size() > 2 && path[0] == '/' && path[2] == ':') path.erase(0, 1);
+#endif
+    return path;
+}
+
+static std::string Frame(const Json& msg) {
+    std::string body = msg.dump();
+    return "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+static Json Message(const char* method) {
+    Json msg = Json::object();
+    msg.set("jsonrpc", "2.0").set("method", method);
+    return msg;
+}
+
+static std::string Join(const std::vector<std::string>& lines, size_t from, size_t to, bool newlineFirst) {
+    size_t size = 0;
+    for (size_t i = from; i < to; i++) size += lines[i].size() + 1;
+    std::string text;
+    text.reserve(size);
+    for (size_t i = from; i < to; i++) {
+        if (newlineFirst || i > from) text += '\n';
+        text += lines[i];
+    }
+    return text;
+}
+
+static std::string LanguageId(const std::string& path) {
+    std::string ext = fs::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".c" ? "c" : "cpp";
+}
+
+// Hover contents come as a string, {kind, value}, {language, value}, or a
+// list of those; code fences are dropped since the popup is plain text.
+static void HoverText(const Json& contents, std::string& out) {
+    if (contents.isArray()) {
+        for (const Json& part : contents.items()) HoverText(part, out);
+        return;
+    }
+    const std::string& text = contents.isString() ? contents.str() : contents["value"].str();
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) end = text.size();
+        if (text.compare(start, 3, "```") != 0) {
+            if (!out.empty() && out.back() != '\n') out += '\n';
+            out.append(text, start, end - start);
+        }
+        start = end + 1;
+    }
+}
+
+LspClient::~LspClient() { stop(0.5); }
+
+bool LspClient::serves(const std::string& path) const {
+    return IsCheckableSource(path);
+}
+
+LspClient::Position LspClient::positionIn(const std::string& line, int row, int col) {
+    Position pos;
+    pos.line = row;
+    pos.col8 = std::clamp(col, 0, (int)line.size());
+    // UTF-16 units: one per code point, two past the BMP
+    for (int i = 0; i < pos.col8; i++) {
+        unsigned char c = (unsigned char)line[i];
+        if ((c & 0xC0) != 0x80) pos.col16++;
+        if (c >= 0xF0) pos.col16++;
+    }
+    return pos;
+}
+
+bool LspClient::start(const std::string& command, const std::string& root) {
+    stop();
+    std::vector<std::string> args = SplitCommand(command);
+    if (args.empty()) return false;
+    rootUri = PathToUri(root);
+
+#ifdef _WIN32
+    SECURITY_ATTRIBUTES sa = {sizeof(SECURITY_ATTRIBUTES), NULL, TRUE};
+    HANDLE inRd, inWr, outRd, outWr;
+    if (!CreatePipe(&inRd, &inWr, &sa, 0)) return false;
+    if (!CreatePipe(&outRd, &outWr, &sa, 0)) { CloseHandle(inRd); CloseHandle(inWr); return false; }
+    SetHandleInformation(inWr, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(outRd, HANDLE_FLAG_INHERIT, 0);
+    // Servers log to stderr freely; nobody reads it, so it must not fill a pipe
+    HANDLE nul = CreateFileA("NUL", GENERIC_WRITE, FILE_SHARE_WRITE, &sa, OPEN_EXISTING, 0, NULL);
+
+    std::string cmdLine;
+    for (const std::string& a : args) cmdLine += (cmdLine.empty() ? "\"" : " \"") + a + "\"";
+    std::vector<char> cmdBuf(cmdLine.begin(), cmdLine.end());
+    cmdBuf.push_back('\0');
+    STARTUPINFOA si;
+    PROCESS_INFORMATION pi;
+    ZeroMemory(&si, sizeof(si));
+    ZeroMemory(&pi, sizeof(pi));
+    si.cb = sizeof(si);
+    si.hStdInput = inRd;
+    si.hStdOutput = outWr;
+    si.hStdError = nul;
+    si.dwFlags |= STARTF_USESTDHANDLES;
+    bool ok = CreateProcessA(NULL, cmdBuf.data(), NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, root.empty() ? NULL : root.c_str(), &si, &pi);
+    CloseHandle(inRd);
+    CloseHandle(outWr);
+    if (nul != INVALID_HANDLE_VALUE) CloseHandle(nul);
+    if (!ok) { CloseHandle(inWr); CloseHandle(outRd); return false; }
+    CloseHandle(pi.hThread);
+    process = (intptr_t)pi.hProcess;
+    toServer = inWr;
+    fromServer = outRd;
+#else
+    int in[2], out[2];
+    if (pipe(in) != 0) return false;
+    if (pipe(out) != 0) { ::close(in[0]); ::close(in[1]); return false; }
+    if (pipe(wake) != 0) { for (int fd : {in[0], in[1], out[0], out[1]}) ::close(fd); return false; }
+    for (int fd : {in[0], in[1], out[0], out[1], wake[0], wake[1]}) fcntl(fd, F_SETFD, FD_CLOEXEC);
+    for (int fd : {in[1], wake[0], wake[1]}) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in[0], 0);
+    posix_spawn_file_actions_adddup2(&actions, out[1], 1);
+    // Servers log to stderr freely; nobody reads it, so it must not fill a pipe
+    posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+    std::vector<char*> argv;
+    for (std::string& a : args) argv.push_back(&a[0]);
+    argv.push_back(nullptr);
+    // The server starts with an unblocked, default SIGPIPE
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t noSignals, pipeSignal;
+    sigemptyset(&noSignals);
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    posix_spawnattr_setsigmask(&attr, &noSignals);
+    posix_spawnattr_setsigdefault(&attr, &pipeSignal);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+    pid_t pid = -1;
+    int err = posix_spawnp(&pid, argv[0], &actions, &attr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    ::close(in[0]);
+    ::close(out[1]);
+    if (err != 0) {
+        for (int fd : {in[1], out[0], wake[0], wake[1]}) ::close(fd);
+        wake[0] = wake[1] = -1;
+        return false;
+    }
+    process = pid;
+    toServer = in[1];
+    fromServer = out[0];
+#endif
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ops.clear();
+        replies.clear();
+        events.clear();
+        inflight.clear();
+        initialized = false;
+        utf8 = false;
+        stopping = false;
+    }
+    docs.clear();
+    nextId = 2;
+    alive = true;
+    io = std::thread(&LspClient::ioLoop, this);
+#ifdef _WIN32
+    reader = std::thread(&LspClient::readLoop, this);
+#endif
+    return true;
+}
+
+void LspClient::stop(double grace) {
+    if (!io.joinable()) return;
+    if (alive && grace > 0) {
+        Op op;
+        op.kind = OpKind::Shutdown;
+        op.id = nextId++;
+        push(op);
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait_for(lock, std::chrono::duration<double>(grace), [&] { return !alive; });
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+#ifdef _WIN32
+    TerminateProcess((HANDLE)process, 1);
+    cv.notify_all();
+    io.join();
+    reader.join();
+    WaitForSingleObject((HANDLE)process, INFINITE);
+    CloseHandle((HANDLE)process);
+    CloseHandle((HANDLE)toServer);
+    CloseHandle((HANDLE)fromServer);
+    toServer = fromServer = nullptr;
+#else
+    kill((pid_t)process, SIGKILL);
+    char b = 1;
+    if (write(wake[1], &b, 1) < 0) {}
+    io.join();
+    int status = 0;
+    while (waitpid((pid_t)process, &status, 0) < 0 && errno == EINTR) {}
+    for (int fd : {toServer, fromServer, wake[0], wake[1]}) if (fd >= 0) ::close(fd);
+    toServer = fromServer = wake[0] = wake[1] = -1;
+#endif
+    process = 0;
+    alive = false;
+    docs.clear();
+}
+
+void LspClient::push(Op op) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ops.push_back(std::move(op));
+    }
+#ifdef _WIN32
+    cv.notify_all();
+#else
+    char b = 1;
+    if (write(wake[1], &b, 1) < 0) {}
+#endif
+}
+
+bool LspClient::poll(Event& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (events.empty()) return false;
+    out = std::move(events.front());
+    events.pop_front();
+    return true;
+}
+
+void LspClient::sync(const std::string& path, const std::vector<std::string>& lines, const std::vector<LineEdit>& edits) {
+    if (!alive || lines.empty()) return;
+    auto it = docs.find(path);
+    if (it != docs.end() && edits.empty()) return;
+    if (it == docs.end() && !serves(path)) return;
+    Position lastEnd = positionIn(lines.back(), (int)lines.size() - 1, (int)lines.back().size());
+    if (it == docs.end()) {
+        DocState& doc = docs[path];
+        doc.version = 1;
+        doc.lineCount = (int)lines.size();
+        doc.lastEnd = lastEnd;
+        Op op;
+        op.kind = OpKind::Open;
+        op.uri = PathToUri(path);
+        op.text = Join(lines, 0, lines.size(), false);
+        op.version = 1;
+        push(std::move(op));
+        return;
+    }
+    DocState& doc = it->second;
+    // Lines [lo, hi) of the new text replace [lo, hi - growth) of the old
+    int count = doc.lineCount, lo = INT_MAX, hi = -1;
+    bool full = false;
+    for (const LineEdit& e : edits) {
+        if (e.removed < 0) { full = true; break; }
+        int row = std::clamp(e.row, 0, count);
+        int removed = std::min(e.removed, count - row);
+        if (hi < 0) hi = row + e.added;
+        else if (hi >= row + removed) hi += e.added - removed;
+        else if (hi > row) hi = row + e.added;
+        hi = std::max(hi, row + e.added);
+        lo = std::min(lo, row);
+        count += e.added - removed;
+    }
+    int n = (int)lines.size();
+    Op op;
+    op.kind = OpKind::Change;
+    op.uri = PathToUri(path);
+    op.version = ++doc.version;
+    if (full || count != n) {
+        op.text = Join(lines, 0, lines.size(), false);
+    } else if (hi < n) {
+        // Whole lines, each with its newline
+        op.ranged = true;
+        op.start = {lo, 0, 0};
+        op.end = {hi - (n - doc.lineCount), 0, 0};
+        for (int r = lo; r < hi; r++) op.text += lines[r] + "\n";
+    } else if (lo > 0) {
+        // Up to the end of the file, which has no newline to end on: start
+        // from the end of the line before instead
+        op.ranged = true;
+        op.start = positionIn(lines[lo - 1], lo - 1, (int)lines[lo - 1].size());
+        op.end = doc.lastEnd;
+        op.text = Join(lines, lo, n, true);
+    } else {
+        op.text = Join(lines, 0, lines.size(), false);
+    }
+    doc.lineCount = n;
+    doc.lastEnd = lastEnd;
+    push(std::move(op));
+}
+
+void LspClient::close(const std::string& path) {
+    if (!docs.erase(path) || !alive) return;
+    Op op;
+    op.kind = OpKind::Close;
+    op.uri = PathToUri(path);
+    push(std::move(op));
+}
+
+int64_t LspClient::request(OpKind kind, const std::string& path, const std::vector<std::string>& lines, int row, int col) {
+    if (!alive || !serves(path) || row < 0 || row >= (int)lines.size()) return 0;
+    if (!docs.count(path)) sync(path, lines, {});
+    Op op;
+    op.kind = kind;
+    op.id = nextId++;
+    op.uri = PathToUri(path);
+    op.start = positionIn(lines[row], row, col);
+    push(op);
+    return op.id;
+}
+
+int64_t LspClient::hover(const std::string& path, const std::vector<std::string>& lines, int row, int col) {
+    return request(OpKind::Hover, path, lines, row, col);
+}
+
+int64_t LspClient::completion(const std::string& path, const std::vector<std::string>& lines, int row, int col) {
+    return request(OpKind::Completion, path, lines, row, col);
+}
+
+int64_t LspClient::references(const std::string& path, const std::vector<std::string>& lines, int row, int col) {
+    return request(OpKind::References, path, lines, row, col);
+}
+
+// I/O thread from here on
+
+std::string LspClient::encode(const Op& op, bool utf8) {
+    auto position = [&](const Position& p) {
+        Json pos = Json::object();
+        pos.set("line", p.line).set("character", utf8 ? p.col8 : p.col16);
+        return pos;
+    };
+    Json doc = Json::object();
+    doc.set("uri", op.uri);
+    Json params = Json::object();
+    std::string out;
+    const char* method = "";
+    switch (op.kind) {
+        case OpKind::Open:
+            method = "textDocument/didOpen";
+            doc.set("languageId", LanguageId(UriToPath(op.uri))).set("version", op.version).set("text", op.text);
+            params.set("textDocument", doc);
+            break;
+        case OpKind::Change: {
+            method = "textDocument/didChange";
+            doc.set("version", op.version);
+            Json change = Json::object();
+            if (op.ranged) {
+                Json range = Json::object();
+                range.set("start", position(op.start)).set("end", position(op.end));
+                change.set("range", range);
+            }
+            change.set("text", op.text);
+            params.set("textDocument", doc).set("contentChanges", Json::array().push(change));
+            break;
+        }
+        case OpKind::Close:
+            method = "textDocument/didClose";
+            params.set("textDocument", doc);
+            break;
+        case OpKind::Hover:
+        case OpKind::Completion:
+        case OpKind::References:
+            method = op.kind == OpKind::Hover ? "textDocument/hover" : op.kind == OpKind::Completion ? "textDocument/completion" : "textDocument/references";
+            params.set("textDocument", doc).set("position", position(op.start));
+            if (op.kind == OpKind::References) params.set("context", Json::object().set("includeDeclaration", true));
+            break;
+        case OpKind::Shutdown:
+            method = "shutdown";
+            break;
+    }
+    Json msg = Message(method);
+    if (op.id) {
+        msg.set("id", op.id);
+        std::lock_guard<std::mutex> lock(mutex);
+        // Only the newest hover or completion matters; cancel older ones
+        for (auto it = inflight.begin(); it != inflight.end();) {
+            if (it->second.kind == op.kind && (op.kind == OpKind::Hover || op.kind == OpKind::Completion)) {
+                Json cancel = Message("$/cancelRequest");
+                cancel.set("params", Json::object().set("id", it->first));
+                out += Frame(cancel);
+                it = inflight.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        inflight[op.id] = {op.kind, UriToPath(op.uri)};
+    }
+    if (op.kind != OpKind::Shutdown) msg.set("params", params);
+    return out + Frame(msg);
+}
+
+void LspClient::drain(std::string& out) {
+    std::deque<Op> taken;
+    bool bytes;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        out += replies;
+        replies.clear();
+        if (!initialized) return;
+        taken.swap(ops);
+        bytes = utf8;
+    }
+    for (const Op& op : taken) out += encode(op, bytes);
+}
+
+void LspClient::receive(std::string& in) {
+    size_t pos = 0;
+    while (true) {
+        size_t headerEnd = in.find("\r\n\r\n", pos);
+        if (headerEnd == std::string::npos) break;
+        size_t length = SIZE_MAX;
+        for (size_t line = pos; line < headerEnd;) {
+            size_t eol = in.find("\r\n", line);
+            if (eol == std::string::npos || eol > headerEnd) eol = headerEnd;
+            std::string header = in.substr(line, eol - line);
+            std::transform(header.begin(), header.end(), header.begin(), ::tolower);
+            if (header.compare(0, 15, "content-length:") == 0) length = strtoull(header.c_str() + 15, nullptr, 10);
+            line = eol + 2;
+        }
+        size_t body = headerEnd + 4;
+        if (length == SIZE_MAX || length > MAX_MESSAGE) { pos = body; continue; }
+        if (in.size() - body < length) break;
+        Json msg;
+        if (Json::parse(in.substr(body, length), msg)) handle(msg);
+        pos = body + length;
+    }
+    in.erase(0, pos);
+}
+
+void LspClient::handle(const Json& msg) {
+    const std::string& method = msg["method"].str();
+    if (!method.empty()) {
+        if (msg.has("id")) {
+            // The server asking us something: nothing configured, nothing to report
+            Json result;
+            if (method == "workspace/configuration") {
+                result = Json::array();
+                for (size_t i = 0; i < msg["params"]["items"].size(); i++) result.push(Json());
+            }
+            Json reply = Json::object();
+            reply.set("jsonrpc", "2.0").set("id", msg["id"]).set("result", result);
+            std::lock_guard<std::mutex> lock(mutex);
+            replies += Frame(reply);
+            cv.notify_all();
+            return;
+        }
+        if (method != "textDocument/publishDiagnostics") return;
+        const Json& params = msg["params"];
+        Event ev;
+        ev.kind = EventKind::Diagnostics;
+        ev.path = UriToPath(params["uri"].str());
+        std::string key = DiagnosticKey(ev.path);
+        for (const Json& d : params["diagnostics"].items()) {
+            Diagnostic diag;
+            diag.path = key;
+            diag.line = (int)d["range"]["start"]["line"].integer() + 1;
+            diag.col = (int)d["range"]["start"]["character"].integer() + 1;
+            int64_t severity = d["severity"].integer(1);
+            diag.kind = severity == 1 ? DiagKind::Error : severity == 2 ? DiagKind::Warning : DiagKind::Note;
+            diag.message = d["message"].str();
+            diag.message = diag.message.substr(0, diag.message.find('\n'));
+            ev.diagnostics.push_back(std::move(diag));
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(std::move(ev));
+        return;
+    }
+
+    int64_t id = msg["id"].integer(-1);
+    const Json& result = msg["result"];
+    if (id == 1) {
+        // Columns in bytes if the server agreed to it, else UTF-16 as the
+        // protocol says. Incoming columns are taken as bytes either way,
+        // which only differs on lines with non-ASCII text.
+        std::string encoding = result["capabilities"]["positionEncoding"].str();
+        if (encoding.empty()) encoding = result["offsetEncoding"].str();
+        std::lock_guard<std::mutex> lock(mutex);
+        utf8 = encoding == "utf-8";
+        initialized = true;
+        replies += Frame(Message("initialized").set("params", Json::object()));
+        cv.notify_all();
+        return;
+    }
+    Pending pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = inflight.find(id);
+        if (it == inflight.end()) return;
+        pending = it->second;
+        inflight.erase(it);
+        if (pending.kind == OpKind::Shutdown) {
+            replies += Frame(Message("exit"));
+            cv.notify_all();
+            return;
+        }
+    }
+    Event ev;
+    ev.id = id;
+    ev.path = pending.path;
+    if (pending.kind == OpKind::Hover) {
+        ev.kind = EventKind::Hover;
+        if (result.isObject()) HoverText(result["contents"], ev.text);
+        // Trim to what fits a popup
+        size_t end = 0;
+        for (int lines = 0; (end = ev.text.find('\n', end)) != std::string::npos; end++) {
+            if (++lines == MAX_HOVER_LINES) { ev.text.resize(end); break; }
+        }
+        while (!ev.text.empty() && isspace((unsigned char)ev.text.back())) ev.text.pop_back();
+    } else if (pending.kind == OpKind::Completion) {
+        ev.kind = EventKind::Completion;
+        const Json& list = result.isArray() ? result : result["items"];
+        for (const Json& item : list.items()) {
+            std::string text = item["textEdit"]["newText"].str();
+            if (text.empty()) text = item["insertText"].str();
+            if (text.empty()) text = item["label"].str();
+            size_t a = text.find_first_not_of(" \t"), b = text.find_last_not_of(" \t");
+            if (a == std::string::npos || text.find('\n') != std::string::npos) continue;
+            ev.items.push_back(text.substr(a, b - a + 1));
+            if (ev.items.size() == MAX_COMPLETIONS) break;
+        }
+    } else if (pending.kind == OpKind::References) {
+        ev.kind = EventKind::References;
+        for (const Json& loc : result.items()) {
+            Location l;
+            l.path = UriToPath(loc["uri"].str());
+            l.line = (int)loc["range"]["start"]["line"].integer() + 1;
+            l.col = (int)loc["range"]["start"]["character"].integer() + 1;
+            if (!l.path.empty()) ev.locations.push_back(std::move(l));
+        }
+    } else {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back(std::move(ev));
+}
+
+void LspClient::exited(const std::string& why) {
+    std::lock_guard<std::mutex> lock(mutex);
+    alive = false;
+    if (!stopping) {
+        Event ev;
+        ev.kind = EventKind::Exited;
+        ev.text = why;
+        events.push_back(std::move(ev));
+    }
+    cv.notify_all();
+}
+
+static Json InitializeRequest(const std::string& rootUri) {
+    Json encodings = Json::array().push("utf-8").push("utf-16");
+    Json text = Json::object();
+    text.set("synchronization", Json::object().set("didSave", false))
+        .set("hover", Json::object().set("contentFormat", Json::array().push("plaintext")))
+        .set("completion", Json::object().set("completionItem", Json::object().set("snippetSupport", false)))
+        .set("references", Json::object())
+        .set("publishDiagnostics", Json::object());
+    Json caps = Json::object();
+    caps.set("general", Json::object().set("positionEncodings", encodings))
+        .set("textDocument", text)
+        .set("workspace", Json::object().set("configuration", true))
+        .set("offsetEncoding", encodings);     // clangd before LSP 3.17
+    std::string name = UriToPath(rootUri);
+    name = fs::path(name).filename().string();
+    Json folder = Json::object();
+    folder.set("uri", rootUri).set("name", name);
+    Json params = Json::object();
+#ifdef _WIN32
+    params.set("processId", (int64_t)GetCurrentProcessId());
+#else
+    params.set("processId", (int64_t)getpid());
+#endif
+    params.set("clientInfo", Json::object().set("name", "ctom"))
+          .set("rootUri", rootUri)
+          .set("workspaceFolders", Json::array().push(folder))
+          .set("capabilities", caps);
+    Json msg = Message("initialize");
+    msg.set("id", 1).set("params", params);
+    return msg;
+}
+
+#ifdef _WIN32
+
+// Writes here; readLoop reads. Blocking writes are fine on their own thread.
+void LspClient::ioLoop() {
+    std::string out = Frame(InitializeRequest(rootUri));
+    while (true) {
+        size_t sent = 0;
+        DWORD n;
+        while (sent < out.size() && WriteFile((HANDLE)toServer, out.data() + sent, (DWORD)std::min<size_t>(out.size() - sent, 64 * 1024), &n, NULL)) sent += n;
+        if (sent < out.size()) return;
+        out.clear();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return !alive || stopping || !replies.empty() || (initialized && !ops.empty()); });
+            if (!alive || stopping) return;
+        }
+        drain(out);
+    }
+}
+
+void LspClient::readLoop() {
+    std::string in;
+    char buf[65536];
+    DWORD n;
+    while (ReadFile((HANDLE)fromServer, buf, sizeof(buf), &n, NULL) && n > 0) {
+        in.append(buf, n);
+        receive(in);
+    }
+    exited("Language server exited");
+}
+
+#else
+
+void LspClient::ioLoop() {
+    // A write to a server that has exited fails with EPIPE on this thread
+    // instead of raising SIGPIPE; the process-wide disposition is untouched
+    sigset_t pipeSignal;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, nullptr);
+    std::string out = Frame(InitializeRequest(rootUri));
+    std::string in;
+    char buf[65536];
+    int inFd = toServer;
+    while (true) {
+        drain(out);
+        if (inFd < 0) out.clear();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) break;
+        }
+        struct pollfd fds[3];
+        int nfds = 0;
+        fds[nfds++] = {fromServer, POLLIN, 0};
+        fds[nfds++] = {wake[0], POLLIN, 0};
+        if (inFd >= 0 && !out.empty()) fds[nfds++] = {inFd, POLLOUT, 0};
+        if (::poll(fds, nfds, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents) while (read(wake[0], buf, sizeof(buf)) > 0) {}
+        if (nfds > 2 && fds[2].revents) {
+            ssize_t w = write(inFd, out.data(), out.size());
+            if (w > 0) out.erase(0, (size_t)w);
+            // The server stopped reading; what it still says is worth having
+            else if (w < 0 && errno != EAGAIN && errno != EINTR) inFd = -1;
+        }
+        if (fds[0].revents) {
+            ssize_t r = read(fromServer, buf, sizeof(buf));
+            if (r > 0) {
+                in.append(buf, (size_t)r);
+                receive(in);
+            } else if (r == 0 || (errno != EAGAIN && errno != EINTR)) {
+                break;
+            }
+        }
+    }
+    exited("Language server exited");
+}
+
+#endif
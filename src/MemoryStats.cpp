@@ -0,0 +1,123 @@
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOGDI
+    #define NOUSER
+    #include <windows.h>
+    #include <psapi.h>
+    #undef ERROR
+#elif defined(__APPLE__)
+    #include <mach/mach.h>
+#else
+    #include <unistd.h>
+    #include <cstdio>
+#endif
+
+#include "../include/MemoryStats.hpp"
+#include <algorithm>
+#include <map>
+#include <cstdio>
+
+void MemoryReport::add(const std::string& group, const std::string& name, size_t bytes) {
+    entries.push_back({group, name, bytes});
+}
+
+size_t MemoryReport::total() const {
+    size_t sum = 0;
+    for (const MemoryEntry& e : entries) sum += e.bytes;
+    return sum;
+}
+
+std::vector<MemoryEntry> MemoryReport::groups() const {
+    std::map<std::string, size_t> sums;
+    for (const MemoryEntry& e : entries) sums[e.group] += e.bytes;
+    std::vector<MemoryEntry> out;
+    for (const auto& s : sums) out.push_back({s.first, "", s.second});
+    std::stable_sort(out.begin(), out.end(), [](const MemoryEntry& a, const MemoryEntry& b) { return a.bytes > b.bytes; });
+    return out;
+}
+
+std::vector<MemoryEntry> MemoryReport::largest(size_t max) const {
+    std::vector<MemoryEntry> out = entries;
+    std::stable_sort(out.begin(), out.end(), [](const MemoryEntry& a, const MemoryEntry& b) { return a.bytes > b.bytes; });
+    if (out.size() > max) out.resize(max);
+    return out;
+}
+
+std::string MemoryReport::dump() const {
+    std::string out = "accounted " + FormatBytes(total());
+    size_t rss = ProcessResidentBytes();
+    if (rss) out += ", process resident " + FormatBytes(rss);
+    out += "\n";
+    for (const MemoryEntry& g : groups()) {
+        out += "\n" + g.group + " " + FormatBytes(g.bytes) + "\n";
+        std::vector<MemoryEntry> items;
+        for (const MemoryEntry& e : entries) if (e.group == g.group) items.push_back(e);
+        std::stable_sort(items.begin(), items.end(), [](const MemoryEntry& a, const MemoryEntry& b) { return a.bytes > b.bytes; });
+        for (const MemoryEntry& e : items) {
+            char size[32];
+            snprintf(size, sizeof(size), "%12zu  ", e.bytes);
+            out += "  " + std::string(size) + e.name + "\n";
+        }
+    }
+    return out;
+}
+
+size_t StringBytes(const std::string& s) {
+    // Short strings live inside the object itself
+    return sizeof(std::string) + (s.capacity() > 15 ? s.capacity() + 1 : 0);
+}
+
+size_t LinesBytes(const std::vector<std::string>& lines) {
+    size_t bytes = (lines.capacity() - lines.size()) * sizeof(std::string);
+    for (const std::string& line : lines) bytes += StringBytes(line);
+    return bytes;
+}
+
+size_t TextureBytes(const Texture2D& texture) {
+    if (texture.id == 0) return 0;
+    return (size_t)GetPixelDataSize(texture.width, texture.height, texture.format);
+}
+
+size_t RenderTextureBytes(const RenderTexture2D& target) {
+    if (target.id == 0) return 0;
+    return TextureBytes(target.texture) + (target.depth.id ? (size_t)target.depth.width * target.depth.height * 4 : 0);
+}
+
+size_t FontBytes(const Font& font) {
+    size_t bytes = TextureBytes(font.texture);
+    // Glyph bitmaps are kept in memory as well as in the atlas
+    for (int i = 0; font.glyphs && i < font.glyphCount; i++) {
+        const Image& img = font.glyphs[i].image;
+        if (img.data) bytes += (size_t)GetPixelDataSize(img.width, img.height, img.format);
+    }
+    return bytes + font.glyphCount * (sizeof(GlyphInfo) + sizeof(Rectangle));
+}
+
+std::string FormatBytes(size_t bytes) {
+    char buf[32];
+    if (bytes >= 1024ull * 1024 * 1024) snprintf(buf, sizeof(buf), "%.2f GB", bytes / (1024.0 * 1024 * 1024));
+    else if (bytes >= 1024 * 1024) snprintf(buf, sizeof(buf), "%.1f MB", bytes / (1024.0 * 1024));
+    else if (bytes >= 1024) snprintf(buf, sizeof(buf), "%.1f KB", bytes / 1024.0);
+    else snprintf(buf, sizeof(buf), "%zu B", bytes);
+    return buf;
+}
+
+size_t ProcessResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return pmc.WorkingSetSize;
+    return 0;
+#elif defined(__APPLE__)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) == KERN_SUCCESS) return info.resident_size;
+    return 0;
+#else
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    unsigned long pages = 0, resident = 0;
+    int n = fscanf(f, "%lu %lu", &pages, &resident);
+    fclose(f);
+    return n == 2 ? resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
@@ -0,0 +1,154 @@
+#include "../include/Scrollback.hpp"
+#include <cstring>
+#include <algorithm>
+
+// Arena sizes are derived from the line limit; a line that does not fit in
+// what is left of the arena evicts the oldest lines until it does.
+static const size_t AVG_LINE_BYTES = 96;
+static const size_t AVG_LINE_RUNS = 2;
+
+Scrollback::Scrollback(size_t maxLines) {
+    setCapacity(maxLines);
+}
+
+void Scrollback::setCapacity(size_t maxLines) {
+    if (maxLines < 16) maxLines = 16;
+    slots.assign(maxLines, Slot{0, 0, 0, 0});
+    text.assign(std::max<size_t>(64 * 1024, maxLines * AVG_LINE_BYTES), 0);
+    runs.assign(std::max<size_t>(1024, maxLines * AVG_LINE_RUNS), StyleRun{0, TermStyle{}});
+    clear();
+}
+
+void Scrollback::shrink(size_t maxLines) {
+    if (maxLines < 16) maxLines = 16;
+    if (maxLines >= slots.size()) return;
+    while (count > maxLines) evictOldest();
+    // Lines that still overflow the smaller arenas are evicted by `kept`
+    // itself, under the ids they had here.
+    Scrollback kept(maxLines);
+    kept.evicted = evicted;
+    kept.sink = sink;
+    for (size_t i = 0; i < count; i++) {
+        ScrollLine l = line(i);
+        kept.push(l.text, l.len, l.runs, l.runCount);
+    }
+    *this = std::move(kept);
+}
+
+void Scrollback::clear() {
+    // Ids stay monotonic across clears so readers never see one reused
+    if (sink) sink->cleared();
+    evicted += count;
+    head = 0;
+    count = 0;
+    textEnd = 0;
+    runEnd = 0;
+}
+
+void Scrollback::evictOldest() {
+    if (count == 0) return;
+    if (sink) sink->evicted(evicted, line(0));
+    head = (head + 1) % slots.size();
+    count--;
+    evicted++;
+}
+
+void Scrollback::push(const char* str, size_t len, const StyleRun* lineRuns, size_t runCount) {
+    if (slots.empty()) return;
+    if (len > text.size()) len = text.size();
+    if (runCount > runs.size()) runCount = runs.size();
+    if (count == slots.size()) evictOldest();
+
+    // Keep every line contiguous in the arenas so views are plain pointers.
+    uint64_t tStart = textEnd;
+    size_t tPos = (size_t)(tStart % text.size());
+    if (tPos + len > text.size()) tStart += text.size() - tPos;
+
+    uint64_t rStart = runEnd;
+    size_t rPos = (size_t)(rStart % runs.size());
+    if (rPos + runCount > runs.size()) rStart += runs.size() - rPos;
+
+    while (count > 0) {
+        const Slot& old = slots[head];
+        bool textClash = tStart + len > old.textOff + text.size();
+        bool runClash = rStart + runCount > old.runOff + runs.size();
+        if (!textClash && !runClash) break;
+        evictOldest();
+    }
+
+    if (len > 0) memcpy(&text[tStart % text.size()], str, len);
+    if (runCount > 0) memcpy(&runs[rStart % runs.size()], lineRuns, runCount * sizeof(StyleRun));
+
+    slots[(head + count) % slots.size()] = {tStart, rStart, (uint32_t)len, (uint32_t)runCount};
+    count++;
+    textEnd = tStart + len;
+    runEnd = rStart + runCount;
+}
+
+void Scrollback::appendToLast(const char* str, size_t len, const StyleRun* lineRuns, size_t runCount) {
+    if (count == 0) {
+        push(str, len, lineRuns, runCount);
+        return;
+    }
+    size_t lastIdx = (head + count - 1) % slots.size();
+    Slot last = slots[lastIdx];
+    if (last.len + len > text.size()) len = text.size() - last.len;
+
+    // Appended text without a run at its start is in the default style, which
+    // may differ from the style the line currently ends in.
+    TermStyle prevStyle = last.runCount ? runs[(last.runOff + last.runCount - 1) % runs.size()].style : TermStyle{};
+    std::vector<StyleRun> added;
+    if (runCount == 0 || lineRuns[0].start != 0) added.push_back({last.len, TermStyle{}});
+    for (size_t i = 0; i < runCount; i++) added.push_back({last.len + lineRuns[i].start, lineRuns[i].style});
+    if (added[0].style == prevStyle) added.erase(added.begin());
+    if (last.runCount + added.size() > runs.size()) added.clear();
+
+    size_t newLen = last.len + len;
+    size_t newRuns = last.runCount + added.size();
+
+    // The newest line sits at the end of both arenas; it only has to move
+    // when growing would carry it past the physical end.
+    uint64_t tStart = last.textOff;
+    if (tStart % text.size() + newLen > text.size()) tStart = textEnd + (text.size() - textEnd % text.size());
+    uint64_t rStart = last.runOff;
+    if (rStart % runs.size() + newRuns > runs.size()) rStart = runEnd + (runs.size() - runEnd % runs.size());
+
+    while (count > 1) {
+        const Slot& old = slots[head];
+        bool textClash = tStart + newLen > old.textOff + text.size();
+        bool runClash = rStart + newRuns > old.runOff + runs.size();
+        if (!textClash && !runClash) break;
+        evictOldest();
+    }
+
+    if (tStart != last.textOff && last.len > 0) {
+        std::vector<char> moved(&text[last.textOff % text.size()], &text[last.textOff % text.size()] + last.len);
+        memcpy(&text[tStart % text.size()], moved.data(), last.len);
+    }
+    if (rStart != last.runOff && last.runCount > 0) {
+        std::vector<StyleRun> moved(&runs[last.runOff % runs.size()], &runs[last.runOff % runs.size()] + last.runCount);
+        memcpy(&runs[rStart % runs.size()], moved.data(), last.runCount * sizeof(StyleRun));
+    }
+    if (len > 0) memcpy(&text[(tStart + last.len) % text.size()], str, len);
+
+    if (!added.empty()) memcpy(&runs[(rStart + last.runCount) % runs.size()], added.data(), added.size() * sizeof(StyleRun));
+
+    slots[lastIdx] = {tStart, rStart, (uint32_t)newLen, (uint32_t)newRuns};
+    textEnd = tStart + newLen;
+    runEnd = rStart + newRuns;
+}
+
+ScrollLine Scrollback::line(size_t i) const {
+    ScrollLine view;
+    if (i >= count) return view;
+    const Slot& s = slots[(head + i) % slots.size()];
+    view.text = &text[s.textOff % text.size()];
+    view.len = s.len;
+    view.runs = &runs[s.runOff % runs.size()];
+    view.runCount = s.runCount;
+    return view;
+}
+
+size_t Scrollback::memoryBytes() const {
+    return slots.size() * sizeof(Slot) + text.size() + runs.size() * sizeof(StyleRun);
+}
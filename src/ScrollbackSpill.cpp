@@ -0,0 +1,296 @@
+#ifdef _WIN32
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+
+#include "../include/ScrollbackSpill.hpp"
+#include <raylib.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// Segments are sealed at this size; the compressor sees a few hundred KB at once
+static const size_t SEGMENT_BYTES = 256 * 1024;
+static const size_t CACHE_SEGMENTS = 4;
+// Sealed segments held in memory while the writer is failing or behind;
+// past this the oldest history is dropped
+static const size_t MAX_SEALED = 32;
+// Wait after a failed write before trying the disk again
+static const int RETRY_SECONDS = 5;
+
+static void PutU32(std::vector<unsigned char>& out, uint32_t v) {
+    unsigned char b[4];
+    memcpy(b, &v, 4);
+    out.insert(out.end(), b, b + 4);
+}
+
+static uint32_t GetU32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+// Rebuilds the per-line offsets of a decompressed segment.
+static bool IndexLines(ScrollbackSpill::RawSegment& seg, uint32_t lines) {
+    seg.offsets.clear();
+    size_t pos = 0;
+    for (uint32_t i = 0; i < lines; i++) {
+        if (pos + 8 > seg.data.size()) return false;
+        seg.offsets.push_back((uint32_t)pos);
+        pos += 8 + GetU32(&seg.data[pos]) + (size_t)GetU32(&seg.data[pos + 4]) * sizeof(StyleRun);
+    }
+    return pos <= seg.data.size();
+}
+
+static bool TruncateFile(FILE* f, uint64_t size) {
+#ifdef _WIN32
+    return _chsize_s(_fileno(f), (long long)size) == 0;
+#else
+    return ftruncate(fileno(f), (off_t)size) == 0;
+#endif
+}
+
+// The file outgrows a 32-bit long in a long session; long is 32-bit on Windows
+static bool SeekFile(FILE* f, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(f, (long long)offset, SEEK_SET) == 0;
+#else
+    return fseeko(f, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+static void UnpackLine(const ScrollbackSpill::RawSegment& seg, size_t index, TerminalLine& out) {
+    const unsigned char* p = &seg.data[seg.offsets[index]];
+    uint32_t len = GetU32(p);
+    uint32_t runCount = GetU32(p + 4);
+    out.text.assign((const char*)p + 8, len);
+    out.runs.resize(runCount);
+    if (runCount > 0) memcpy(out.runs.data(), p + 8 + len, runCount * sizeof(StyleRun));
+}
+
+ScrollbackSpill::ScrollbackSpill(const std::string& path) : path(path) {
+    writeFile = fopen(path.c_str(), "wb");
+    // Segments go out in one write each; unbuffered, a failed one leaves
+    // nothing behind to be flushed later
+    if (writeFile) setvbuf(writeFile, nullptr, _IONBF, 0);
+    readFile = fopen(path.c_str(), "rb");
+    open = std::make_shared<RawSegment>();
+    writer = std::thread(&ScrollbackSpill::writerLoop, this);
+}
+
+// The segment file is only a cache of this session's output, so it goes too.
+ScrollbackSpill::~ScrollbackSpill() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    writerCv.notify_all();
+    if (writer.joinable()) writer.join();
+    if (writeFile) fclose(writeFile);
+    if (readFile) fclose(readFile);
+    remove(path.c_str());
+}
+
+bool ScrollbackSpill::ok() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return writeFile != nullptr && readFile != nullptr && !failing;
+}
+
+bool ScrollbackSpill::empty() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return first == end;
+}
+
+uint64_t ScrollbackSpill::firstId() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return first;
+}
+
+uint64_t ScrollbackSpill::endId() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return end;
+}
+
+void ScrollbackSpill::evicted(uint64_t id, const ScrollLine& line) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!writeFile || !readFile) return;
+    if (id != end) {
+        // A gap (the scrollback was resized) starts the spill over
+        segments.clear();
+        sealed.clear();
+        cache.clear();
+        open = std::make_shared<RawSegment>();
+        first = end = id;
+        rewind = true;
+    }
+    if (open->offsets.empty()) open->firstId = id;
+    open->offsets.push_back((uint32_t)open->data.size());
+    PutU32(open->data, line.len);
+    PutU32(open->data, line.runCount);
+    open->data.insert(open->data.end(), (const unsigned char*)line.text, (const unsigned char*)line.text + line.len);
+    const unsigned char* runs = (const unsigned char*)line.runs;
+    open->data.insert(open->data.end(), runs, runs + line.runCount * sizeof(StyleRun));
+    end = id + 1;
+    if (open->data.size() >= SEGMENT_BYTES) {
+        sealed.push_back(open);
+        open = std::make_shared<RawSegment>();
+        // While writes fail, memory stays bounded by dropping the oldest
+        // history; what is on disk is older still, so it goes first
+        while (sealed.size() > MAX_SEALED) {
+            sealed.pop_front();
+            if (!segments.empty()) {
+                segments.clear();
+                cache.clear();
+                rewind = true;
+            }
+            first = sealed.front()->firstId;
+        }
+        writerCv.notify_one();
+    }
+}
+
+void ScrollbackSpill::cleared() {
+    std::lock_guard<std::mutex> lock(mutex);
+    segments.clear();
+    sealed.clear();
+    cache.clear();
+    open = std::make_shared<RawSegment>();
+    first = end;
+    rewind = true;
+    writerCv.notify_one();
+}
+
+// Compresses sealed segments outside the lock and appends them to the file;
+// a segment moves from `sealed` to `segments` once it can be read back. A
+// failed write is cut off the file and retried a while later.
+void ScrollbackSpill::writerLoop() {
+    bool retry = false;
+    while (true) {
+        std::shared_ptr<RawSegment> seg;
+        bool truncate;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (retry) writerCv.wait_for(lock, std::chrono::seconds(RETRY_SECONDS), [&] { return stopping || rewind; });
+            writerCv.wait(lock, [&] { return stopping || rewind || !sealed.empty(); });
+            if (stopping) return;
+            truncate = rewind;
+            rewind = false;
+            if (!sealed.empty()) seg = sealed.front();
+        }
+        if (truncate && TruncateFile(writeFile, 0) && SeekFile(writeFile, 0)) fileEnd = 0;
+        if (!seg) continue;
+
+        int compSize = 0;
+        unsigned char* comp = CompressData(seg->data.data(), (int)seg->data.size(), &compSize);
+        bool written = comp && fwrite(comp, 1, compSize, writeFile) == (size_t)compSize;
+        if (comp) MemFree(comp);
+        if (!written) {
+            TruncateFile(writeFile, fileEnd);
+            clearerr(writeFile);
+            SeekFile(writeFile, fileEnd);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        failing = !written;
+        retry = !written;
+        if (!written) continue;
+        if (!sealed.empty() && sealed.front() == seg) {
+            segments.push_back({seg->firstId, (uint32_t)seg->offsets.size(), fileEnd, (uint32_t)compSize});
+            sealed.pop_front();
+        }
+        fileEnd += compSize;
+    }
+}
+
+std::shared_ptr<ScrollbackSpill::RawSegment> ScrollbackSpill::readSegment(FILE* f, const Segment& seg) const {
+    std::vector<unsigned char> comp(seg.compSize);
+    if (!SeekFile(f, seg.fileOffset)) return nullptr;
+    if (fread(comp.data(), 1, comp.size(), f) != comp.size()) return nullptr;
+    int rawSize = 0;
+    unsigned char* raw = DecompressData(comp.data(), (int)comp.size(), &rawSize);
+    if (!raw) return nullptr;
+    auto out = std::make_shared<RawSegment>();
+    out->firstId = seg.firstId;
+    out->data.assign(raw, raw + rawSize);
+    MemFree(raw);
+    if (!IndexLines(*out, seg.lines)) return nullptr;
+    return out;
+}
+
+// Called with `mutex` held.
+std::shared_ptr<ScrollbackSpill::RawSegment> ScrollbackSpill::load(size_t index) {
+    for (size_t i = 0; i < cache.size(); i++) {
+        if (cache[i].first != index) continue;
+        auto hit = cache[i];
+        cache.erase(cache.begin() + i);
+        cache.push_back(hit);
+        return hit.second;
+    }
+    auto seg = readSegment(readFile, segments[index]);
+    if (!seg) return nullptr;
+    if (cache.size() >= CACHE_SEGMENTS) cache.erase(cache.begin());
+    cache.push_back({index, seg});
+    return seg;
+}
+
+bool ScrollbackSpill::line(uint64_t id, TerminalLine& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (id < first || id >= end) return false;
+    if (!open->offsets.empty() && id >= open->firstId) {
+        UnpackLine(*open, (size_t)(id - open->firstId), out);
+        return true;
+    }
+    for (const auto& seg : sealed) {
+        if (id >= seg->firstId && id < seg->firstId + seg->offsets.size()) {
+            UnpackLine(*seg, (size_t)(id - seg->firstId), out);
+            return true;
+        }
+    }
+    auto it = std::upper_bound(segments.begin(), segments.end(), id, [](uint64_t v, const Segment& s) { return v < s.firstId; });
+    if (it == segments.begin()) return false;
+    size_t index = (size_t)(it - segments.begin()) - 1;
+    if (id >= segments[index].firstId + segments[index].lines) return false;
+    auto seg = load(index);
+    if (!seg) return false;
+    UnpackLine(*seg, (size_t)(id - seg->firstId), out);
+    return true;
+}
+
+ScrollbackSpill::Snapshot ScrollbackSpill::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Snapshot snap;
+    snap.segments = segments;
+    snap.pending.assign(sealed.begin(), sealed.end());
+    if (!open->offsets.empty()) snap.pending.push_back(std::make_shared<RawSegment>(*open));
+    snap.end = end;
+    return snap;
+}
+
+// Reads the file front to back with its own handle, so paging in the view
+// and writing new segments carry on meanwhile.
+bool ScrollbackSpill::writeText(const Snapshot& snap, std::string& buffer, FILE* out) const {
+    FILE* in = snap.segments.empty() ? nullptr : fopen(path.c_str(), "rb");
+    if (!snap.segments.empty() && !in) return false;
+    TerminalLine line;
+    auto emit = [&](const RawSegment& seg) {
+        for (size_t i = 0; i < seg.offsets.size(); i++) {
+            UnpackLine(seg, i, line);
+            buffer += line.text;
+            buffer += '\n';
+        }
+        if (buffer.size() >= WRITE_BLOCK) {
+            fwrite(buffer.data(), 1, buffer.size(), out);
+            buffer.clear();
+        }
+    };
+    bool ok = true;
+    for (const Segment& s : snap.segments) {
+        auto seg = readSegment(in, s);
+        if (!seg) { ok = false; break; }
+        emit(*seg);
+    }
+    if (in) fclose(in);
+    for (const auto& seg : snap.pending) emit(*seg);
+    return ok;
+}
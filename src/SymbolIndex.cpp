@@ -0,0 +1,544 @@
+#include "../include/SymbolIndex.hpp"
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+#include <cctype>
+#include <cstdio>
+#include <cinttypes>
+
+namespace fs = std::filesystem;
+
+static const char* INDEX_DIR = "data/index/";
+static const uint32_t INDEX_MAGIC = 0x58495443;    // "CTIX"
+static const uint32_t INDEX_VERSION = 1;
+// Generated or vendored blobs this big are not worth scanning
+static const uint64_t MAX_FILE_SIZE = 4 * 1024 * 1024;
+// Lowercased names search() looks through for matches past the prefix ones
+static const size_t SUBSTRING_SCAN_BYTES = 4 * 1024 * 1024;
+
+static std::string Lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+}
+
+const char* SymbolKindName(SymbolKind kind) {
+    switch (kind) {
+        case SymbolKind::Function: return "function";
+        case SymbolKind::Class: return "class";
+        case SymbolKind::Struct: return "struct";
+        case SymbolKind::Enum: return "enum";
+        case SymbolKind::Macro: return "macro";
+        case SymbolKind::Namespace: return "namespace";
+    }
+    return "";
+}
+
+// --- Scanner ---
+
+namespace {
+
+struct Token {
+    const char* s;
+    uint32_t n;
+    int line;
+};
+
+bool IsIdentStart(char c) { return isalpha((unsigned char)c) || c == '_' || (unsigned char)c >= 0x80; }
+bool IsIdentChar(char c) { return isalnum((unsigned char)c) || c == '_' || (unsigned char)c >= 0x80; }
+
+// Identifiers and single punctuation characters; comments, literals, numbers
+// and preprocessor lines are dropped, except that #define names are recorded.
+void Tokenize(const std::string& text, std::vector<Token>& toks, std::vector<Symbol>& out) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    int line = 1;
+    bool lineStart = true;
+    while (p < end) {
+        char c = *p;
+        if (c == '\n') { line++; lineStart = true; p++; continue; }
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') { p++; continue; }
+        if (c == '/' && p + 1 < end && p[1] == '/') {
+            while (p < end && *p != '\n') p++;
+            continue;
+        }
+        if (c == '/' && p + 1 < end && p[1] == '*') {
+            p += 2;
+            while (p + 1 < end && !(p[0] == '*' && p[1] == '/')) { if (*p == '\n') line++; p++; }
+            p = std::min(p + 2, end);
+            continue;
+        }
+        if (c == '#' && lineStart) {
+            p++;
+            while (p < end && (*p == ' ' || *p == '\t')) p++;
+            const char* word = p;
+            while (p < end && IsIdentChar(*p)) p++;
+            if (p - word == 6 && memcmp(word, "define", 6) == 0) {
+                while (p < end && (*p == ' ' || *p == '\t')) p++;
+                const char* name = p;
+                while (p < end && IsIdentChar(*p)) p++;
+                if (p > name) {
+                    Symbol sym;
+                    sym.name.assign(name, p - name);
+                    sym.line = line;
+                    sym.kind = SymbolKind::Macro;
+                    out.push_back(std::move(sym));
+                }
+            }
+            // Rest of the directive, following backslash continuations
+            while (p < end && *p != '\n') {
+                if (*p == '\\' && p + 1 < end && (p[1] == '\n' || p[1] == '\r')) {
+                    p++;
+                    if (*p == '\r' && p + 1 < end && p[1] == '\n') p++;
+                    line++;
+                }
+                p++;
+            }
+            continue;
+        }
+        lineStart = false;
+        if (c == '"' || c == '\'') {
+            p++;
+            while (p < end && *p != c && *p != '\n') p += (*p == '\\' && p + 1 < end) ? 2 : 1;
+            if (p < end && *p == c) p++;
+            continue;
+        }
+        if (isdigit((unsigned char)c) || (c == '.' && p + 1 < end && isdigit((unsigned char)p[1]))) {
+            while (p < end && (IsIdentChar(*p) || *p == '.' || *p == '\'' ||
+                   ((*p == '+' || *p == '-') && (p[-1] == 'e' || p[-1] == 'E' || p[-1] == 'p' || p[-1] == 'P')))) p++;
+            continue;
+        }
+        if (IsIdentStart(c)) {
+            const char* start = p;
+            while (p < end && IsIdentChar(*p)) p++;
+            // R"delim( ... )delim", also with u8/u/U/L prefixes
+            if (p < end && *p == '"' && p[-1] == 'R' && p - start <= 3) {
+                const char* open = p + 1;
+                const char* paren = open;
+                while (paren < end && *paren != '(' && paren - open < 16) paren++;
+                std::string close = ")" + std::string(open, paren) + "\"";
+                const char* found = std::search(paren, end, close.begin(), close.end());
+                for (const char* q = p; q < found; q++) if (*q == '\n') line++;
+                p = (found == end) ? end : found + close.size();
+                continue;
+            }
+            toks.push_back({start, (uint32_t)(p - start), line});
+            continue;
+        }
+        toks.push_back({p, 1, line});
+        p++;
+    }
+}
+
+class Parser {
+    enum Scope { NAMESPACE, CLASS, BLOCK };
+    const std::vector<Token>& t;
+    std::vector<Symbol>& out;
+    std::vector<Scope> stack;
+    Scope pending = BLOCK;
+
+    bool is(size_t i, char c) const { return i < t.size() && t[i].n == 1 && t[i].s[0] == c; }
+    bool isIdent(size_t i) const { return i < t.size() && IsIdentStart(t[i].s[0]); }
+    bool word(size_t i, const char* w) const {
+        size_t n = strlen(w);
+        return i < t.size() && t[i].n == n && memcmp(t[i].s, w, n) == 0;
+    }
+    std::string text(size_t i) const { return std::string(t[i].s, t[i].n); }
+
+    // Index of the token closing the bracket at `i`, or t.size().
+    size_t match(size_t i, char open, char close) const {
+        int depth = 0;
+        for (size_t j = i; j < t.size(); j++) {
+            if (is(j, open)) depth++;
+            else if (is(j, close) && --depth == 0) return j;
+        }
+        return t.size();
+    }
+
+    bool keyword(size_t i) const {
+        static const char* const WORDS[] = {
+            "if", "for", "while", "switch", "return", "sizeof", "catch", "decltype", "alignof", "alignas",
+            "static_assert", "__attribute__", "__declspec", "defined", "typeid", "noexcept", "throw", "new",
+            "delete", "case", "do", "else", "try", "operator", "requires",
+        };
+        for (const char* w : WORDS) if (word(i, w)) return true;
+        return false;
+    }
+
+    void add(size_t i, SymbolKind kind, std::string scope = "") {
+        Symbol sym;
+        sym.name = text(i);
+        sym.scope = std::move(scope);
+        sym.line = t[i].line;
+        sym.kind = kind;
+        out.push_back(std::move(sym));
+    }
+
+    // "namespace a::b {"; returns the index to continue from.
+    size_t parseNamespace(size_t i) {
+        size_t j = i + 1;
+        size_t last = 0;
+        std::string scope;
+        while (isIdent(j) || is(j, ':')) {
+            if (isIdent(j)) { if (last) scope += text(last) + "::"; last = j; }
+            j++;
+        }
+        if (!is(j, '{')) return i;
+        if (last) add(last, SymbolKind::Namespace, scope);
+        pending = NAMESPACE;
+        return j - 1;
+    }
+
+    // "class [attrs] Name [final] [: bases] {"
+    size_t parseRecord(size_t i) {
+        SymbolKind kind = word(i, "enum") ? SymbolKind::Enum : word(i, "class") ? SymbolKind::Class : SymbolKind::Struct;
+        size_t j = i + 1;
+        if (kind == SymbolKind::Enum && (word(j, "class") || word(j, "struct"))) j++;
+        size_t name = 0;
+        while (j < t.size()) {
+            if (is(j, '[') && is(j + 1, '[')) { j = match(j, '[', ']') + 1; continue; }
+            if (word(j, "alignas") || word(j, "__declspec") || word(j, "__attribute__")) { j = match(j + 1, '(', ')') + 1; continue; }
+            if (!isIdent(j)) break;
+            if (!word(j, "final")) name = j;
+            j++;
+        }
+        if (is(j, '<')) j = match(j, '<', '>') + 1;
+        if (is(j, ':') && !is(j + 1, ':')) {
+            while (j < t.size() && !is(j, '{') && !is(j, ';') && !is(j, '(')) j++;
+        }
+        if (!is(j, '{')) return i;
+        if (name) add(name, kind);
+        pending = (kind == SymbolKind::Enum) ? BLOCK : CLASS;
+        return j - 1;
+    }
+
+    // name(...) [qualifiers] [-> type] [: inits] {
+    size_t parseFunction(size_t i) {
+        size_t close = match(i + 1, '(', ')');
+        size_t j = close + 1;
+        while (j < t.size()) {
+            if (is(j, '{') || is(j, ';') || is(j, '=') || is(j, ',')) break;
+            if (is(j, '(')) { j = match(j, '(', ')') + 1; continue; }
+            if (is(j, '[') && is(j + 1, '[')) { j = match(j, '[', ']') + 1; continue; }
+            if (is(j, ':') && !is(j + 1, ':') && !is(j - 1, ':')) {
+                // Constructor initializers: member(args) or member{args}, comma separated
+                j++;
+                while (j < t.size()) {
+                    while (isIdent(j) || is(j, ':') || is(j, '.')) j++;
+                    if (is(j, '<')) j = match(j, '<', '>') + 1;
+                    if (is(j, '(')) j = match(j, '(', ')') + 1;
+                    else if (is(j, '{')) j = match(j, '{', '}') + 1;
+                    else break;
+                    if (is(j, '.') && is(j + 1, '.') && is(j + 2, '.')) j += 3;
+                    if (!is(j, ',')) break;
+                    j++;
+                }
+                break;
+            }
+            if (isIdent(j) || is(j, '&') || is(j, '*') || is(j, '<') || is(j, '>') || is(j, '-') || is(j, ':') || is(j, '.')) { j++; continue; }
+            break;
+        }
+        if (!is(j, '{')) return close;
+        std::string scope;
+        size_t k = i;
+        bool dtor = k > 0 && is(k - 1, '~');
+        if (dtor) k--;
+        while (k >= 3 && is(k - 1, ':') && is(k - 2, ':') && isIdent(k - 3)) {
+            scope = text(k - 3) + "::" + scope;
+            k -= 3;
+        }
+        add(i, SymbolKind::Function, scope);
+        if (dtor) out.back().name = "~" + out.back().name;
+        pending = BLOCK;
+        return j - 1;
+    }
+
+public:
+    Parser(const std::vector<Token>& toks, std::vector<Symbol>& syms) : t(toks), out(syms) {}
+
+    void run() {
+        for (size_t i = 0; i < t.size(); i++) {
+            if (is(i, '{')) { stack.push_back(pending); pending = BLOCK; continue; }
+            if (is(i, '}')) { if (!stack.empty()) stack.pop_back(); continue; }
+            if (is(i, ';')) { pending = BLOCK; continue; }
+            // Only declarations at namespace or class level can be definitions
+            if (!stack.empty() && stack.back() == BLOCK) continue;
+            if (!isIdent(i)) continue;
+            if (word(i, "namespace")) i = parseNamespace(i);
+            else if (word(i, "extern") && is(i + 1, '{')) pending = NAMESPACE;
+            else if (word(i, "class") || word(i, "struct") || word(i, "union") || word(i, "enum")) {
+                if (!is(i - 1, '<') && !is(i - 1, ',') && !word(i - 1, "friend")) i = parseRecord(i);
+            }
+            else if (is(i + 1, '(') && !keyword(i) && !is(i - 1, '.') && !is(i - 1, '>')) i = parseFunction(i);
+        }
+    }
+};
+
+}
+
+void ScanSymbols(const std::string& text, std::vector<Symbol>& out) {
+    std::vector<Token> toks;
+    toks.reserve(text.size() / 6);
+    Tokenize(text, toks, out);
+    Parser(toks, out).run();
+}
+
+// --- Index ---
+
+static bool IsIndexedSource(const fs::path& p) {
+    std::string ext = p.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    for (const char* known : {".c", ".cc", ".cpp", ".cxx", ".c++", ".h", ".hh", ".hpp", ".hxx", ".inl", ".ipp"}) {
+        if (ext == known) return true;
+    }
+    return false;
+}
+
+SymbolIndex::~SymbolIndex() {
+    cancel = true;
+    if (worker.joinable()) worker.join();
+}
+
+void SymbolIndex::open(const std::string& root) {
+    cancel = true;
+    if (worker.joinable()) worker.join();
+    cancel = false;
+    busy = true;
+    worker = std::thread(&SymbolIndex::build, this, root);
+}
+
+std::shared_ptr<const SymbolIndex::Snapshot> SymbolIndex::snapshot() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return current;
+}
+
+std::string SymbolIndex::cachePath(const std::string& root) {
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : root) { h ^= c; h *= 1099511628211ull; }
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 ".idx", h);
+    return INDEX_DIR + std::string(name);
+}
+
+void SymbolIndex::build(std::string root) {
+    Snapshot previous;
+    load(cachePath(root), previous);
+    if (previous.root != root) previous.files.clear();
+    std::unordered_map<std::string, File*> known;
+    for (File& f : previous.files) known[f.path] = &f;
+
+    auto snap = std::make_shared<Snapshot>();
+    snap->root = root;
+    std::vector<size_t> stale;
+    size_t reused = 0;
+    std::error_code ec;
+    fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end;
+    for (; !ec && it != end; it.increment(ec)) {
+        if (cancel) { busy = false; return; }
+        const fs::directory_entry& entry = *it;
+        std::string name = entry.path().filename().string();
+        if (entry.is_directory(ec)) {
+            if (name.empty() || name[0] == '.' || name == "node_modules") it.disable_recursion_pending();
+            continue;
+        }
+        if (!IsIndexedSource(entry.path()) || !entry.is_regular_file(ec)) continue;
+        File file;
+        file.path = entry.path().string().substr(root.size());
+        while (!file.path.empty() && (file.path[0] == '/' || file.path[0] == '\\')) file.path.erase(0, 1);
+        file.size = entry.file_size(ec);
+        file.mtime = (int64_t)entry.last_write_time(ec).time_since_epoch().count();
+        auto old = known.find(file.path);
+        if (old != known.end() && old->second->size == file.size && old->second->mtime == file.mtime) {
+            file.symbols = std::move(old->second->symbols);
+            reused++;
+        } else {
+            stale.push_back(snap->files.size());
+        }
+        snap->files.push_back(std::move(file));
+    }
+
+    // Changed files are scanned in parallel, each worker taking the next one
+    std::atomic<size_t> next{0};
+    auto scan = [&] {
+        std::string text;
+        for (size_t i = next++; i < stale.size() && !cancel; i = next++) {
+            File& file = snap->files[stale[i]];
+            if (file.size > MAX_FILE_SIZE) continue;
+            std::ifstream in(fs::path(root) / file.path, std::ios::binary);
+            if (!in.is_open()) continue;
+            text.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            ScanSymbols(text, file.symbols);
+        }
+    };
+    int threads = std::max(1, std::min((int)std::thread::hardware_concurrency(), (int)stale.size() / 8 + 1));
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; i++) pool.emplace_back(scan);
+    scan();
+    for (std::thread& t : pool) t.join();
+    if (cancel) { busy = false; return; }
+
+    for (uint32_t f = 0; f < snap->files.size(); f++) {
+        for (uint32_t s = 0; s < snap->files[f].symbols.size(); s++) snap->byName.push_back({f, s});
+    }
+    const Snapshot& sorted = *snap;
+    std::sort(snap->byName.begin(), snap->byName.end(), [&](const auto& a, const auto& b) {
+        return sorted.files[a.first].symbols[a.second].name < sorted.files[b.first].symbols[b.second].name;
+    });
+    std::vector<std::pair<std::string, std::pair<uint32_t, uint32_t>>> lowered;
+    lowered.reserve(snap->byName.size());
+    for (const auto& e : snap->byName) lowered.push_back({Lower(sorted.files[e.first].symbols[e.second].name), e});
+    std::stable_sort(lowered.begin(), lowered.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    snap->byLower.reserve(lowered.size());
+    snap->lowerStart.reserve(lowered.size());
+    for (const auto& l : lowered) {
+        snap->byLower.push_back(l.second);
+        snap->lowerStart.push_back((uint32_t)snap->lowerText.size());
+        snap->lowerText += l.first;
+        snap->lowerText += '\n';
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = snap;
+    }
+    if (!stale.empty() || reused != previous.files.size()) save(cachePath(root), *snap);
+    busy = false;
+}
+
+// Native-endian binary: header, then per file its path, size, mtime and
+// symbols. Anything that does not parse is treated as no cache at all.
+namespace {
+
+struct Writer {
+    std::string buf;
+    template <typename T> void put(T v) { buf.append((const char*)&v, sizeof(v)); }
+    void str(const std::string& s) { put((uint32_t)s.size()); buf += s; }
+};
+
+struct Reader {
+    const std::string& buf;
+    size_t pos = 0;
+    bool ok = true;
+    explicit Reader(const std::string& b) : buf(b) {}
+    template <typename T> T get() {
+        T v{};
+        if (pos + sizeof(v) > buf.size()) { ok = false; return v; }
+        memcpy(&v, buf.data() + pos, sizeof(v));
+        pos += sizeof(v);
+        return v;
+    }
+    std::string str() {
+        uint32_t n = get<uint32_t>();
+        if (!ok || pos + n > buf.size()) { ok = false; return ""; }
+        pos += n;
+        return buf.substr(pos - n, n);
+    }
+};
+
+}
+
+bool SymbolIndex::load(const std::string& path, Snapshot& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return false;
+    std::string buf((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    Reader r(buf);
+    if (r.get<uint32_t>() != INDEX_MAGIC || r.get<uint32_t>() != INDEX_VERSION) return false;
+    out.root = r.str();
+    uint32_t files = r.get<uint32_t>();
+    for (uint32_t f = 0; f < files && r.ok; f++) {
+        File file;
+        file.path = r.str();
+        file.size = r.get<uint64_t>();
+        file.mtime = r.get<int64_t>();
+        uint32_t count = r.get<uint32_t>();
+        for (uint32_t s = 0; s < count && r.ok; s++) {
+            Symbol sym;
+            sym.kind = (SymbolKind)r.get<uint8_t>();
+            sym.line = (int)r.get<uint32_t>();
+            sym.name = r.str();
+            sym.scope = r.str();
+            file.symbols.push_back(std::move(sym));
+        }
+        out.files.push_back(std::move(file));
+    }
+    if (!r.ok) out.files.clear();
+    return r.ok;
+}
+
+void SymbolIndex::save(const std::string& path, const Snapshot& snap) {
+    Writer w;
+    w.put(INDEX_MAGIC);
+    w.put(INDEX_VERSION);
+    w.str(snap.root);
+    w.put((uint32_t)snap.files.size());
+    for (const File& f : snap.files) {
+        w.str(f.path);
+        w.put(f.size);
+        w.put(f.mtime);
+        w.put((uint32_t)f.symbols.size());
+        for (const Symbol& s : f.symbols) {
+            w.put((uint8_t)s.kind);
+            w.put((uint32_t)s.line);
+            w.str(s.name);
+            w.str(s.scope);
+        }
+    }
+    std::error_code ec;
+    fs::create_directories(INDEX_DIR, ec);
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        if (!out.is_open()) return;
+        out.write(w.buf.data(), (std::streamsize)w.buf.size());
+    }
+    fs::rename(tmp, path, ec);
+}
+
+std::vector<SymbolLocation> SymbolIndex::lookup(const std::string& name) {
+    std::vector<SymbolLocation> found;
+    auto snap = snapshot();
+    if (!snap) return found;
+    auto nameOf = [&](const std::pair<uint32_t, uint32_t>& e) -> const std::string& {
+        return snap->files[e.first].symbols[e.second].name;
+    };
+    auto lo = std::lower_bound(snap->byName.begin(), snap->byName.end(), name, [&](const auto& e, const std::string& n) { return nameOf(e) < n; });
+    for (auto it = lo; it != snap->byName.end() && nameOf(*it) == name; ++it) {
+        const File& file = snap->files[it->first];
+        found.push_back({file.symbols[it->second], (fs::path(snap->root) / file.path).string()});
+    }
+    return found;
+}
+
+std::vector<SymbolLocation> SymbolIndex::search(const std::string& query, size_t max) {
+    std::vector<SymbolLocation> found;
+    auto snap = snapshot();
+    if (!snap || query.empty() || query.find('\n') != std::string::npos) return found;
+    std::string q = Lower(query);
+    const std::string& text = snap->lowerText;
+    auto add = [&](size_t entry) {
+        const File& file = snap->files[snap->byLower[entry].first];
+        found.push_back({file.symbols[snap->byLower[entry].second], (fs::path(snap->root) / file.path).string()});
+    };
+
+    // Prefix matches are one run of the sorted table
+    size_t n = snap->byLower.size();
+    auto lo = std::lower_bound(snap->lowerStart.begin(), snap->lowerStart.end(), q, [&](uint32_t at, const std::string& p) {
+        return text.compare(at, p.size(), p) < 0;
+    });
+    for (size_t i = lo - snap->lowerStart.begin(); i < n && found.size() < max; i++) {
+        if (text.compare(snap->lowerStart[i], q.size(), q) != 0) break;
+        add(i);
+    }
+
+    // Then names holding the query further in, found in one pass over the
+    // text and bounded so a huge index cannot stall a keystroke
+    size_t limit = std::min(text.size(), SUBSTRING_SCAN_BYTES);
+    for (size_t at = text.find(q); at != std::string::npos && at < limit && found.size() < max; at = text.find(q, at + 1)) {
+        size_t entry = std::upper_bound(snap->lowerStart.begin(), snap->lowerStart.end(), (uint32_t)at) - snap->lowerStart.begin() - 1;
+        if (snap->lowerStart[entry] == at) continue;
+        add(entry);
+        // One match per name
+        at = entry + 1 < n ? snap->lowerStart[entry + 1] - 1 : text.size();
+    }
+    return found;
+}
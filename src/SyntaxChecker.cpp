@@ -0,0 +1,387 @@
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOGDI
+    #include <windows.h>
+    #undef ERROR
+#else
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <signal.h>
+    #include <poll.h>
+    #include <spawn.h>
+    #include <sys/wait.h>
+    extern char** environ;
+#endif
+
+#include "../include/SyntaxChecker.hpp"
+#include <filesystem>
+#include <algorithm>
+#include <cerrno>
+
+namespace fs = std::filesystem;
+
+static const size_t CACHE_ENTRIES = 128;
+// Compiler output past this is not worth reading
+static const size_t MAX_OUTPUT = 1024 * 1024;
+
+static uint64_t Fnv1a(const void* data, size_t len, uint64_t h = 1469598103934665603ull) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static std::string ExtensionOf(const std::string& path) {
+    std::string ext = fs::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext;
+}
+
+bool IsCheckableSource(const std::string& path) {
+    std::string ext = ExtensionOf(path);
+    for (const char* known : {".c", ".cc", ".cpp", ".cxx", ".h", ".hh", ".hpp", ".hxx"}) {
+        if (ext == known) return true;
+    }
+    return false;
+}
+
+// The compiler and flags from the build part of the Run template, minus the
+// input file and the -o output.
+static std::vector<std::string> CompilerArgs(const std::string& buildTemplate) {
+    std::string build = buildTemplate.substr(0, buildTemplate.find("&&"));
+    std::vector<std::string> args;
+    std::string cur;
+    bool inQuote = false, any = false;
+    for (char c : build + " ") {
+        if (c == '"') { inQuote = !inQuote; any = true; continue; }
+        if (!inQuote && (c == ' ' || c == '\t')) {
+            if (any) args.push_back(cur);
+            cur.clear();
+            any = false;
+            continue;
+        }
+        cur += c;
+        any = true;
+    }
+    std::vector<std::string> out;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i].find("$FILE") != std::string::npos) continue;
+        if (args[i] == "-o") { i++; continue; }
+        if (args[i].compare(0, 2, "-o") == 0) continue;
+        out.push_back(args[i]);
+    }
+    if (out.empty()) return out;
+    std::string name = fs::path(out[0]).filename().string();
+    bool gccLike = false;
+    for (const char* known : {"gcc", "g++", "clang", "c++", "cc"}) {
+        if (name.find(known) != std::string::npos) gccLike = true;
+    }
+    if (!gccLike) out.clear();
+    return out;
+}
+
+SyntaxChecker::SyntaxChecker() {
+    int n = std::clamp((int)std::thread::hardware_concurrency() / 2, 1, 4);
+    for (int i = 0; i < n; i++) workers.emplace_back(&SyntaxChecker::workerLoop, this);
+}
+
+SyntaxChecker::~SyntaxChecker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        jobs.clear();
+        for (const Running& r : running) killRunning(r.generation);
+    }
+    cv.notify_all();
+    for (std::thread& t : workers) t.join();
+}
+
+bool SyntaxChecker::settle(const std::string& path, uint64_t version, double now, double delay) {
+    if (path != watchPath) {
+        watchPath = path;
+        watchVersion = version;
+        changedAt = now;
+        submitted = false;
+    } else if (version != watchVersion) {
+        watchVersion = version;
+        changedAt = now;
+    }
+    if (path.empty() || (submitted && submittedVersion == version) || now - changedAt < delay) return false;
+    submitted = true;
+    submittedVersion = version;
+    return true;
+}
+
+void SyntaxChecker::submit(const std::string& path, const std::string& text, const std::string& buildTemplate) {
+    Job job;
+    job.path = path;
+    job.args = CompilerArgs(buildTemplate);
+    if (job.args.empty()) return;
+    uint64_t h = Fnv1a(path.c_str(), path.size() + 1);
+    for (const std::string& a : job.args) h = Fnv1a(a.c_str(), a.size() + 1, h);
+    job.key = Fnv1a(text.data(), text.size(), h);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    job.generation = nextGeneration++;
+    generations[path] = job.generation;
+    jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [&](const Job& j) { return j.path == path; }), jobs.end());
+    for (Running& r : running) {
+        if (r.path == path) killRunning(r.generation);
+    }
+    auto hit = cache.find(job.key);
+    if (hit != cache.end()) {
+        results.push_back({path, hit->second});
+        return;
+    }
+    job.text = text;
+    jobs.push_back(std::move(job));
+    cv.notify_one();
+}
+
+bool SyntaxChecker::takeResult(Result& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (results.empty()) return false;
+    out = std::move(results.front());
+    results.pop_front();
+    return true;
+}
+
+// Caller holds the mutex.
+void SyntaxChecker::killRunning(uint64_t generation) {
+    for (Running& r : running) {
+        if (r.generation != generation || r.killed || !r.process) continue;
+        r.killed = true;
+#ifdef _WIN32
+        TerminateProcess((HANDLE)r.process, 1);
+#else
+        kill((pid_t)r.process, SIGKILL);
+#endif
+    }
+}
+
+void SyntaxChecker::deliver(const std::string& path, uint64_t generation, std::vector<Diagnostic> diags) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = generations.find(path);
+    if (it == generations.end() || it->second != generation) return;
+    results.push_back({path, std::move(diags)});
+}
+
+void SyntaxChecker::workerLoop() {
+#ifndef _WIN32
+    // A compiler that dies mid-write must not take the editor with it. Only
+    // this thread blocks SIGPIPE, so its write fails with EPIPE instead; the
+    // process-wide disposition, which shells and tasks inherit, is untouched
+    sigset_t pipeSignal;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, nullptr);
+#endif
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            running.push_back({job.path, job.generation, 0, false});
+        }
+        std::string output;
+        bool complete = runCompiler(job, output);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = std::find_if(running.begin(), running.end(), [&](const Running& r) { return r.generation == job.generation; });
+            if (it != running.end()) {
+                complete = complete && !it->killed;
+                running.erase(it);
+            }
+        }
+        if (!complete) continue;
+
+        // Input came from stdin, so point the messages back at the file
+        std::string fixed;
+        size_t start = 0;
+        while (start < output.size()) {
+            size_t end = output.find('\n', start);
+            if (end == std::string::npos) end = output.size();
+            std::string line = output.substr(start, end - start);
+            if (line.compare(0, 8, "<stdin>:") == 0) line = job.path + line.substr(7);
+            fixed += line + "\n";
+            start = end + 1;
+        }
+        DiagnosticParser parser;
+        std::vector<Diagnostic> diags;
+        parser.feed(fixed.data(), fixed.size(), diags);
+        parser.finish(diags);
+        std::string key = DiagnosticKey(job.path);
+        diags.erase(std::remove_if(diags.begin(), diags.end(), [&](const Diagnostic& d) {
+            return d.path != key || d.message.find("#pragma once in main file") != std::string::npos;
+        }), diags.end());
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (cache.emplace(job.key, diags).second) cacheOrder.push_back(job.key);
+            while (cacheOrder.size() > CACHE_ENTRIES) {
+                cache.erase(cacheOrder.front());
+                cacheOrder.pop_front();
+            }
+        }
+        deliver(job.path, job.generation, std::move(diags));
+    }
+}
+
+// Runs "compiler flags -fsyntax-only -x lang -" with the text on stdin and
+// collects stdout and stderr. False if the compiler could not be started.
+bool SyntaxChecker::runCompiler(const Job& job, std::string& output) {
+    std::vector<std::string> args = job.args;
+    std::string dir = fs::path(job.path).parent_path().string();
+    args.push_back("-fsyntax-only");
+    if (!dir.empty()) { args.push_back("-iquote"); args.push_back(dir); }
+    args.push_back("-x");
+    args.push_back(ExtensionOf(job.path) == ".c" ? "c" : "c++");
+    args.push_back("-");
+
+#ifdef _WIN32
+    SECURITY_ATTRIBUTES sa = {sizeof(SECURITY_ATTRIBUTES), NULL, TRUE};
+    HANDLE inRd, inWr, outRd, outWr;
+    if (!CreatePipe(&inRd, &inWr, &sa, 0)) return false;
+    if (!CreatePipe(&outRd, &outWr, &sa, 0)) { CloseHandle(inRd); CloseHandle(inWr); return false; }
+    SetHandleInformation(inWr, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(outRd, HANDLE_FLAG_INHERIT, 0);
+
+    std::string cmdLine;
+    for (const std::string& a : args) cmdLine += (cmdLine.empty() ? "\"" : " \"") + a + "\"";
+    std::vector<char> cmdBuf(cmdLine.begin(), cmdLine.end());
+    cmdBuf.push_back('\0');
+    STARTUPINFOA si;
+    PROCESS_INFORMATION pi;
+    ZeroMemory(&si, sizeof(si));
+    ZeroMemory(&pi, sizeof(pi));
+    si.cb = sizeof(si);
+    si.hStdInput = inRd;
+    si.hStdOutput = outWr;
+    si.hStdError = outWr;
+    si.dwFlags |= STARTF_USESTDHANDLES;
+    bool ok = CreateProcessA(NULL, cmdBuf.data(), NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, NULL, &si, &pi);
+    CloseHandle(inRd);
+    CloseHandle(outWr);
+    if (!ok) { CloseHandle(inWr); CloseHandle(outRd); return false; }
+    CloseHandle(pi.hThread);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Running& r : running) {
+            if (r.generation == job.generation) r.process = (intptr_t)pi.hProcess;
+        }
+        if (generations[job.path] != job.generation) killRunning(job.generation);
+    }
+    // The compiler reads all of its input before it reports anything, so
+    // writing first and reading after cannot deadlock.
+    DWORD n;
+    size_t sent = 0;
+    while (sent < job.text.size() && WriteFile(inWr, job.text.data() + sent, (DWORD)std::min<size_t>(job.text.size() - sent, 64 * 1024), &n, NULL)) sent += n;
+    CloseHandle(inWr);
+    char buf[4096];
+    while (ReadFile(outRd, buf, sizeof(buf), &n, NULL) && n > 0) {
+        if (output.size() < MAX_OUTPUT) output.append(buf, n);
+    }
+    CloseHandle(outRd);
+    WaitForSingleObject(pi.hProcess, INFINITE);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Running& r : running) {
+            if (r.generation == job.generation) r.process = 0;
+        }
+    }
+    CloseHandle(pi.hProcess);
+    return true;
+#else
+    int in[2], out[2];
+    if (pipe(in) != 0) return false;
+    if (pipe(out) != 0) { ::close(in[0]); ::close(in[1]); return false; }
+    for (int fd : {in[0], in[1], out[0], out[1]}) fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in[0], 0);
+    posix_spawn_file_actions_adddup2(&actions, out[1], 1);
+    posix_spawn_file_actions_adddup2(&actions, out[1], 2);
+    // The compiler gets an unblocked, default SIGPIPE, not this thread's mask
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t noSignals, pipeSignal;
+    sigemptyset(&noSignals);
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    posix_spawnattr_setsigmask(&attr, &noSignals);
+    posix_spawnattr_setsigdefault(&attr, &pipeSignal);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+    std::vector<char*> argv;
+    for (std::string& a : args) argv.push_back(&a[0]);
+    argv.push_back(nullptr);
+    pid_t pid = -1;
+    int err = posix_spawnp(&pid, argv[0], &actions, &attr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    ::close(in[0]);
+    ::close(out[1]);
+    if (err != 0) {
+        ::close(in[1]);
+        ::close(out[0]);
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Running& r : running) {
+            if (r.generation == job.generation) r.process = pid;
+        }
+        if (generations[job.path] != job.generation) killRunning(job.generation);
+    }
+
+    // Feed stdin and drain the output together, so neither side can stall
+    fcntl(in[1], F_SETFL, fcntl(in[1], F_GETFL, 0) | O_NONBLOCK);
+    int inFd = in[1];
+    size_t sent = 0;
+    if (job.text.empty()) { ::close(inFd); inFd = -1; }
+    char buf[4096];
+    while (true) {
+        struct pollfd fds[2];
+        int nfds = 0;
+        fds[nfds++] = {out[0], POLLIN, 0};
+        if (inFd >= 0) fds[nfds++] = {inFd, POLLOUT, 0};
+        if (poll(fds, nfds, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (inFd >= 0 && fds[1].revents) {
+            ssize_t w = write(inFd, job.text.data() + sent, job.text.size() - sent);
+            if (w > 0) sent += (size_t)w;
+            if ((w < 0 && errno != EAGAIN && errno != EINTR) || sent == job.text.size()) {
+                ::close(inFd);
+                inFd = -1;
+            }
+        }
+        if (fds[0].revents) {
+            ssize_t r = read(out[0], buf, sizeof(buf));
+            if (r > 0) {
+                if (output.size() < MAX_OUTPUT) output.append(buf, (size_t)r);
+            } else if (r == 0 || (errno != EAGAIN && errno != EINTR)) {
+                break;
+            }
+        }
+    }
+    if (inFd >= 0) ::close(inFd);
+    ::close(out[0]);
+    // Forget the pid before reaping it, so a late kill cannot hit a reused one
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Running& r : running) {
+            if (r.generation == job.generation) r.process = 0;
+        }
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+    return WIFEXITED(status);
+#endif
+}
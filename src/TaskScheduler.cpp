@@ -0,0 +1,119 @@
+#include "../include/TaskScheduler.hpp"
+#include <thread>
+#include <algorithm>
+
+TaskScheduler::TaskScheduler() {
+    maxParallel = std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+const TaskDef* TaskScheduler::find(const std::string& name) const {
+    for (const TaskDef& t : settings.tasks) if (t.name == name) return &t;
+    return nullptr;
+}
+
+// Dependencies first; `path` is the chain being followed, to catch cycles.
+bool TaskScheduler::collect(const std::string& name, std::vector<std::string>& order, std::vector<std::string>& path) const {
+    if (std::find(order.begin(), order.end(), name) != order.end()) return true;
+    if (std::find(path.begin(), path.end(), name) != path.end()) {
+        ShowToast("Task dependency cycle at " + name);
+        return false;
+    }
+    const TaskDef* t = find(name);
+    if (!t) {
+        ShowToast("Unknown task: " + name);
+        return false;
+    }
+    path.push_back(name);
+    for (const std::string& dep : t->deps) if (!collect(dep, order, path)) return false;
+    path.pop_back();
+    order.push_back(name);
+    return true;
+}
+
+void TaskScheduler::trigger(const std::string& name, const std::string& file, Terminal& terminal) {
+    std::vector<std::string> order, path;
+    if (!collect(name, order, path)) return;
+    for (const std::string& n : order) {
+        Entry& e = entries[n];
+        e.file = file;
+        e.show = n == name;
+        if (e.state == RUNNING) {
+            if (n == name && !e.restart) {
+                e.restart = true;
+                terminal.cancelTask(n);
+            }
+            continue;
+        }
+        e.state = WAITING;
+        e.restart = false;
+    }
+    update(terminal);
+}
+
+void TaskScheduler::cancel(const std::string& name, Terminal& terminal) {
+    auto it = entries.find(name);
+    if (it == entries.end()) return;
+    if (it->second.state == WAITING) it->second.state = IDLE;
+    if (it->second.state == RUNNING) {
+        it->second.restart = false;
+        terminal.cancelTask(name);
+    }
+}
+
+void TaskScheduler::start(const TaskDef& task, Entry& entry, Terminal& terminal) {
+    std::string cmd = task.command;
+    std::string jobs = std::to_string(maxParallel);
+    for (size_t pos = cmd.find("$JOBS"); pos != std::string::npos; pos = cmd.find("$JOBS", pos + jobs.size())) cmd.replace(pos, 5, jobs);
+    for (size_t pos = cmd.find("$FILE"); pos != std::string::npos; pos = cmd.find("$FILE", pos)) {
+        std::string with = (pos > 0 && cmd[pos - 1] == '"') ? entry.file : "\"" + entry.file + "\"";
+        cmd.replace(pos, 5, with);
+        pos += with.size();
+    }
+    terminal.runTask(task.name, cmd, entry.show);
+    entry.state = terminal.taskRunningFor(task.name) >= 0 ? RUNNING : FAILED;
+}
+
+// Tasks are started in settings order, so earlier ones get the free cores first.
+void TaskScheduler::update(Terminal& terminal) {
+    int running = 0;
+    for (auto& kv : entries) {
+        Entry& e = kv.second;
+        if (e.state != RUNNING) continue;
+        int code;
+        if (!terminal.taskFinished(kv.first, code)) { running++; continue; }
+        if (e.restart) {
+            e.restart = false;
+            e.state = WAITING;
+        } else {
+            e.state = code == 0 ? SUCCEEDED : FAILED;
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const TaskDef& t : settings.tasks) {
+            auto it = entries.find(t.name);
+            if (it == entries.end() || it->second.state != WAITING) continue;
+            bool ready = true, blocked = false;
+            for (const std::string& dep : t.deps) {
+                State s = state(dep);
+                if (s == FAILED || s == SKIPPED || s == IDLE) blocked = true;
+                else if (s != SUCCEEDED) ready = false;
+            }
+            if (blocked) {
+                it->second.state = SKIPPED;
+                changed = true;
+            } else if (ready && running < maxParallel) {
+                start(t, it->second, terminal);
+                if (it->second.state == RUNNING) running++;
+                changed = true;
+            }
+        }
+    }
+}
+
+TaskScheduler::State TaskScheduler::state(const std::string& name) const {
+    auto it = entries.find(name);
+    return it == entries.end() ? IDLE : it->second.state;
+}
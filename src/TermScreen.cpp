@@ -0,0 +1,490 @@
+#include "../include/TermScreen.hpp"
+#include <algorithm>
+#include <cstring>
+
+// DEC special graphics (ESC ( 0) for 0x60-0x7E, used for box drawing by TUIs
+static const uint16_t DEC_GRAPHICS[31] = {
+    0x25C6, 0x2592, 0x2409, 0x240C, 0x240D, 0x240A, 0x00B0, 0x00B1,
+    0x2424, 0x240B, 0x2518, 0x2510, 0x250C, 0x2514, 0x253C, 0x23BA,
+    0x23BB, 0x2500, 0x23BC, 0x23BD, 0x251C, 0x2524, 0x2534, 0x252C,
+    0x2502, 0x2264, 0x2265, 0x03C0, 0x2260, 0x00A3, 0x00B7
+};
+
+static void AppendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) out += (char)cp;
+    else if (cp < 0x800) {
+        out += (char)(0xC0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += (char)(0xE0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else {
+        out += (char)(0xF0 | (cp >> 18));
+        out += (char)(0x80 | ((cp >> 12) & 0x3F));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+}
+
+// Reads an extended colour (38/48 ; 5 ; n  or  38/48 ; 2 ; r ; g ; b) starting at p[i].
+static bool ParseExtendedColor(const int* p, int n, int& i, uint32_t& out) {
+    if (i + 1 >= n) return false;
+    if (p[i + 1] == 5 && i + 2 < n) {
+        out = TermIndexed(p[i + 2]);
+        i += 2;
+        return true;
+    }
+    if (p[i + 1] == 2 && i + 4 < n) {
+        out = TermRgb(p[i + 2], p[i + 3], p[i + 4]);
+        i += 4;
+        return true;
+    }
+    return false;
+}
+
+static void ApplySgr(TermStyle& style, const int* p, int n) {
+    if (n == 0) { style = TermStyle{}; return; }
+    for (int i = 0; i < n; i++) {
+        int code = p[i];
+        if (code == 0) style = TermStyle{};
+        else if (code == 1) style.attrs |= TA_BOLD;
+        else if (code == 4) style.attrs |= TA_UNDERLINE;
+        else if (code == 7) style.attrs |= TA_INVERSE;
+        else if (code == 22) style.attrs &= ~TA_BOLD;
+        else if (code == 24) style.attrs &= ~TA_UNDERLINE;
+        else if (code == 27) style.attrs &= ~TA_INVERSE;
+        else if (code >= 30 && code <= 37) style.fg = TermIndexed(code - 30);
+        else if (code == 38) { if (!ParseExtendedColor(p, n, i, style.fg)) break; }
+        else if (code == 39) style.fg = TC_DEFAULT;
+        else if (code >= 40 && code <= 47) style.bg = TermIndexed(code - 40);
+        else if (code == 48) { if (!ParseExtendedColor(p, n, i, style.bg)) break; }
+        else if (code == 49) style.bg = TC_DEFAULT;
+        else if (code >= 90 && code <= 97) style.fg = TermIndexed(code - 90 + 8);
+        else if (code >= 100 && code <= 107) style.bg = TermIndexed(code - 100 + 8);
+    }
+}
+
+TermScreen::TermScreen(int cols, int rows) {
+    resize(cols, rows);
+}
+
+TermCell TermScreen::blank() const {
+    // Erased cells keep the current background colour (xterm behaviour)
+    TermCell c;
+    c.style.bg = cur.style.bg;
+    return c;
+}
+
+void TermScreen::reset() {
+    grid.assign((size_t)numCols * numRows, TermCell{});
+    wrapped.assign(numRows, 0);
+    savedGrid.clear();
+    savedWrapped.clear();
+    cur = Cursor{};
+    saved = Cursor{};
+    wrapPending = false;
+    top = 0;
+    bottom = numRows - 1;
+    alt = false;
+    autoWrap = true;
+    insertMode = false;
+    newlineMode = false;
+    appCursor = false;
+    cursorShown = true;
+    utf8Need = 0;
+    joinNext = false;
+    touchAll();
+}
+
+void TermScreen::touchAll() {
+    stamps.assign(numRows, ++generation);
+}
+
+void TermScreen::resize(int cols, int rows) {
+    cols = std::max(2, cols);
+    rows = std::max(2, rows);
+    if (grid.empty()) {
+        numCols = cols;
+        numRows = rows;
+        reset();
+        return;
+    }
+    auto regrid = [&](std::vector<TermCell>& g) {
+        if (g.empty()) return;
+        std::vector<TermCell> ng((size_t)cols * rows, TermCell{});
+        for (int r = 0; r < std::min(rows, numRows); r++)
+            for (int c = 0; c < std::min(cols, numCols); c++)
+                ng[(size_t)r * cols + c] = g[(size_t)r * numCols + c];
+        g.swap(ng);
+    };
+    // Shrinking keeps the rows around the cursor: push the top ones to history
+    if (rows < numRows && cur.y >= rows) {
+        int drop = cur.y - rows + 1;
+        int oldTop = top, oldBottom = bottom;
+        top = 0; bottom = numRows - 1;
+        scrollUp(drop);
+        top = oldTop; bottom = oldBottom;
+        cur.y -= drop;
+    }
+    regrid(grid);
+    regrid(savedGrid);
+    wrapped.resize(rows, 0);
+    if (!savedWrapped.empty()) savedWrapped.resize(rows, 0);
+    numCols = cols;
+    numRows = rows;
+    top = 0;
+    bottom = numRows - 1;
+    cur.x = std::min(cur.x, numCols - 1);
+    cur.y = std::min(cur.y, numRows - 1);
+    touchAll();
+    saved.x = std::min(saved.x, numCols - 1);
+    saved.y = std::min(saved.y, numRows - 1);
+    wrapPending = false;
+}
+
+bool TermScreen::rowBlank(int r) const {
+    const TermCell* cells = row(r);
+    for (int c = 0; c < numCols; c++) {
+        if (cells[c].cp != ' ' || cells[c].style.bg != TC_DEFAULT || (cells[c].style.attrs & TA_INVERSE)) return false;
+    }
+    return true;
+}
+
+int TermScreen::usedRows() const {
+    if (alt) return numRows;
+    int last = cur.y;
+    for (int r = numRows - 1; r > last; r--) {
+        if (!rowBlank(r)) { last = r; break; }
+    }
+    return last + 1;
+}
+
+void TermScreen::rowLine(int r, TerminalLine& out) const {
+    out.text.clear();
+    out.runs.clear();
+    const TermCell* cells = row(r);
+    // A soft-wrapped row keeps its trailing blanks; they are part of the line
+    int end = numCols;
+    while (!wrapped[r] && end > 0 && cells[end - 1].cp == ' ' && cells[end - 1].style.bg == TC_DEFAULT && !(cells[end - 1].style.attrs & TA_INVERSE)) end--;
+    for (int c = 0; c < end; c++) {
+        const TermCell& cell = cells[c];
+        if (out.runs.empty() || out.runs.back().style != cell.style) {
+            out.runs.push_back({(uint32_t)out.text.size(), cell.style});
+        }
+        if (cell.cp < 0x80) out.text += (char)cell.cp;
+        else AppendUtf8(out.text, cell.cp);
+    }
+    if (out.runs.size() == 1 && out.runs[0].style == TermStyle{}) out.runs.clear();
+}
+
+std::string TermScreen::takeResponses() {
+    std::string r;
+    r.swap(responses);
+    return r;
+}
+
+void TermScreen::commitRow(int r) {
+    if (!scrollback || alt) return;
+    rowLine(r, scratch);
+    if (joinNext) scrollback->appendToLast(scratch.text.data(), scratch.text.size(), scratch.runs.data(), scratch.runs.size());
+    else scrollback->push(scratch.text.data(), scratch.text.size(), scratch.runs.data(), scratch.runs.size());
+    joinNext = wrapped[r] != 0;
+}
+
+void TermScreen::clearCells(int r, int c0, int c1) {
+    c0 = std::max(0, c0);
+    c1 = std::min(numCols, c1);
+    TermCell b = blank();
+    TermCell* cells = row(r);
+    for (int c = c0; c < c1; c++) cells[c] = b;
+    stamps[r] = generation;
+}
+
+void TermScreen::clearRows(int r0, int r1) {
+    if (r0 <= 0) joinNext = false;
+    for (int r = std::max(0, r0); r <= std::min(numRows - 1, r1); r++) {
+        clearCells(r, 0, numCols);
+        wrapped[r] = 0;
+    }
+}
+
+void TermScreen::scrollUp(int n) {
+    int height = bottom - top + 1;
+    n = std::min(n, height);
+    if (n <= 0) return;
+    // Committed rows shift every row id by n, so stamps can move with their
+    // rows; any other scroll changes what an id shows and restamps the region.
+    bool commits = top == 0 && scrollback && !alt;
+    if (commits) {
+        for (int r = 0; r < n; r++) commitRow(r);
+    }
+    if (n < height) {
+        memmove(row(top), row(top + n), (size_t)(height - n) * numCols * sizeof(TermCell));
+        memmove(&wrapped[top], &wrapped[top + n], height - n);
+        if (commits) memmove(&stamps[top], &stamps[top + n], (height - n) * sizeof(uint64_t));
+    }
+    if (!commits) std::fill(stamps.begin() + top, stamps.begin() + bottom + 1, generation);
+    else if (bottom < numRows - 1) std::fill(stamps.begin() + bottom + 1, stamps.end(), generation);
+    clearRows(bottom - n + 1, bottom);
+}
+
+void TermScreen::scrollDown(int n) {
+    int height = bottom - top + 1;
+    n = std::min(n, height);
+    if (n <= 0) return;
+    if (top == 0) joinNext = false;
+    if (n < height) {
+        memmove(row(top + n), row(top), (size_t)(height - n) * numCols * sizeof(TermCell));
+        memmove(&wrapped[top + n], &wrapped[top], height - n);
+    }
+    std::fill(stamps.begin() + top, stamps.begin() + bottom + 1, generation);
+    clearRows(top, top + n - 1);
+}
+
+void TermScreen::index() {
+    if (cur.y == bottom) scrollUp(1);
+    else if (cur.y < numRows - 1) cur.y++;
+}
+
+void TermScreen::reverseIndex() {
+    if (cur.y == top) scrollDown(1);
+    else if (cur.y > 0) cur.y--;
+}
+
+void TermScreen::newLine() {
+    cur.x = 0;
+    index();
+}
+
+void TermScreen::moveTo(int x, int y) {
+    cur.x = std::max(0, std::min(numCols - 1, x));
+    cur.y = std::max(0, std::min(numRows - 1, y));
+    wrapPending = false;
+}
+
+void TermScreen::putChar(uint32_t cp) {
+    if (cur.lineDrawing && cp >= 0x60 && cp <= 0x7E) cp = DEC_GRAPHICS[cp - 0x60];
+    if (wrapPending) {
+        if (autoWrap) {
+            wrapped[cur.y] = 1;
+            newLine();
+        }
+        wrapPending = false;
+    }
+    TermCell* cells = row(cur.y);
+    if (insertMode && cur.x < numCols - 1) {
+        memmove(&cells[cur.x + 1], &cells[cur.x], (size_t)(numCols - cur.x - 1) * sizeof(TermCell));
+    }
+    cells[cur.x].cp = cp;
+    cells[cur.x].style = cur.style;
+    stamps[cur.y] = generation;
+    if (cur.x == numCols - 1) wrapPending = true;
+    else cur.x++;
+}
+
+void TermScreen::print(const char* text, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        uint8_t b = (uint8_t)text[i];
+        if (utf8Need == 0 && b < 0x80 && !wrapPending && !insertMode && !cur.lineDrawing) {
+            // ASCII fast path: fill cells up to the end of the row in one go
+            TermCell* cells = row(cur.y);
+            int x = cur.x;
+            size_t j = i;
+            while (j < len && (uint8_t)text[j] < 0x80 && x < numCols) {
+                cells[x].cp = (uint8_t)text[j];
+                cells[x].style = cur.style;
+                x++; j++;
+            }
+            if (x == numCols) { cur.x = numCols - 1; wrapPending = true; }
+            else cur.x = x;
+            stamps[cur.y] = generation;
+            i = j - 1;
+            continue;
+        }
+        if (utf8Need == 0) {
+            if (b < 0x80) { putChar(b); continue; }
+            if ((b & 0xE0) == 0xC0) { utf8Cp = b & 0x1F; utf8Need = 1; }
+            else if ((b & 0xF0) == 0xE0) { utf8Cp = b & 0x0F; utf8Need = 2; }
+            else if ((b & 0xF8) == 0xF0) { utf8Cp = b & 0x07; utf8Need = 3; }
+            else putChar(0xFFFD);
+        } else if ((b & 0xC0) == 0x80) {
+            utf8Cp = (utf8Cp << 6) | (b & 0x3F);
+            if (--utf8Need == 0) putChar(utf8Cp);
+        } else {
+            // Broken sequence: emit a replacement and reprocess this byte
+            utf8Need = 0;
+            putChar(0xFFFD);
+            i--;
+        }
+    }
+}
+
+void TermScreen::execute(uint8_t ctrl) {
+    switch (ctrl) {
+        case 0x08: // BS
+            if (cur.x > 0) cur.x--;
+            wrapPending = false;
+            break;
+        case 0x09: // HT, fixed stops every 8 columns
+            cur.x = std::min(numCols - 1, (cur.x / 8 + 1) * 8);
+            break;
+        case 0x0A: case 0x0B: case 0x0C: // LF, VT, FF
+            index();
+            if (newlineMode) cur.x = 0;
+            wrapPending = false;
+            break;
+        case 0x0D: // CR
+            cur.x = 0;
+            wrapPending = false;
+            break;
+        default:
+            break;
+    }
+}
+
+void TermScreen::setAltScreen(bool on) {
+    if (on == alt) {
+        if (on) clearRows(0, numRows - 1);
+        return;
+    }
+    if (on) {
+        savedGrid = grid;
+        savedWrapped = wrapped;
+        savedJoinNext = joinNext;
+        alt = true;
+        clearRows(0, numRows - 1);
+    } else {
+        grid.swap(savedGrid);
+        wrapped.swap(savedWrapped);
+        savedGrid.clear();
+        savedWrapped.clear();
+        joinNext = savedJoinNext;
+        alt = false;
+    }
+    touchAll();
+}
+
+void TermScreen::setMode(int mode, bool priv, bool on) {
+    if (!priv) {
+        if (mode == 4) insertMode = on;
+        else if (mode == 20) newlineMode = on;
+        return;
+    }
+    switch (mode) {
+        case 1: appCursor = on; break;
+        case 7: autoWrap = on; break;
+        case 25: cursorShown = on; break;
+        case 47: case 1047: setAltScreen(on); break;
+        case 1048: if (on) saved = cur; else cur = saved; break;
+        case 1049:
+            if (on) { saved = cur; setAltScreen(true); }
+            else { setAltScreen(false); cur = saved; }
+            wrapPending = false;
+            break;
+        default: break;
+    }
+}
+
+void TermScreen::csiDispatch(const int* p, int n, const char* inter, int interCount, char final) {
+    auto arg = [&](int i, int def) { return (i < n && p[i] > 0) ? p[i] : def; };
+    bool priv = interCount > 0 && inter[0] == '?';
+    if (interCount > 0 && !priv) {
+        if (inter[0] == '>' && final == 'c') responses += "\x1b[>0;0;0c";
+        return;
+    }
+
+    switch (final) {
+        case '@': { // ICH
+            int k = std::min(arg(0, 1), numCols - cur.x);
+            TermCell* cells = row(cur.y);
+            memmove(&cells[cur.x + k], &cells[cur.x], (size_t)(numCols - cur.x - k) * sizeof(TermCell));
+            clearCells(cur.y, cur.x, cur.x + k);
+            break;
+        }
+        case 'A': moveTo(cur.x, std::max(cur.y >= top ? top : 0, cur.y - arg(0, 1))); break;
+        case 'B': case 'e': moveTo(cur.x, std::min(cur.y <= bottom ? bottom : numRows - 1, cur.y + arg(0, 1))); break;
+        case 'C': case 'a': moveTo(cur.x + arg(0, 1), cur.y); break;
+        case 'D': moveTo(cur.x - arg(0, 1), cur.y); break;
+        case 'E': moveTo(0, cur.y + arg(0, 1)); break;
+        case 'F': moveTo(0, cur.y - arg(0, 1)); break;
+        case 'G': case '`': moveTo(arg(0, 1) - 1, cur.y); break;
+        case 'H': case 'f': moveTo(arg(1, 1) - 1, arg(0, 1) - 1); break;
+        case 'I': for (int k = arg(0, 1); k > 0; k--) execute(0x09); break;
+        case 'Z': for (int k = arg(0, 1); k > 0; k--) moveTo(cur.x > 0 ? ((cur.x - 1) / 8) * 8 : 0, cur.y); break;
+        case 'd': moveTo(cur.x, arg(0, 1) - 1); break;
+        case 'J': {
+            int mode = (n > 0) ? p[0] : 0;
+            if (mode == 0) { clearCells(cur.y, cur.x, numCols); clearRows(cur.y + 1, numRows - 1); }
+            else if (mode == 1) { clearRows(0, cur.y - 1); clearCells(cur.y, 0, cur.x + 1); }
+            else if (mode == 2) clearRows(0, numRows - 1);
+            else if (mode == 3 && scrollback && !alt) scrollback->clear();
+            break;
+        }
+        case 'K': {
+            int mode = (n > 0) ? p[0] : 0;
+            if (mode == 0) clearCells(cur.y, cur.x, numCols);
+            else if (mode == 1) clearCells(cur.y, 0, cur.x + 1);
+            else if (mode == 2) clearCells(cur.y, 0, numCols);
+            break;
+        }
+        case 'L': case 'M': { // IL / DL inside the scroll region
+            if (cur.y < top || cur.y > bottom) break;
+            int oldTop = top;
+            top = cur.y;
+            // Deleting from inside the region must not feed the scrollback
+            Scrollback* sb = scrollback;
+            scrollback = nullptr;
+            if (final == 'L') scrollDown(arg(0, 1)); else scrollUp(arg(0, 1));
+            scrollback = sb;
+            top = oldTop;
+            cur.x = 0;
+            break;
+        }
+        case 'P': { // DCH
+            int k = std::min(arg(0, 1), numCols - cur.x);
+            TermCell* cells = row(cur.y);
+            memmove(&cells[cur.x], &cells[cur.x + k], (size_t)(numCols - cur.x - k) * sizeof(TermCell));
+            clearCells(cur.y, numCols - k, numCols);
+            break;
+        }
+        case 'X': clearCells(cur.y, cur.x, cur.x + arg(0, 1)); break;
+        case 'S': scrollUp(arg(0, 1)); break;
+        case 'T': scrollDown(arg(0, 1)); break;
+        case 'c': responses += "\x1b[?1;2c"; break;
+        case 'n':
+            if (arg(0, 0) == 5) responses += "\x1b[0n";
+            else if (arg(0, 0) == 6) responses += "\x1b[" + std::to_string(cur.y + 1) + ";" + std::to_string(cur.x + 1) + "R";
+            break;
+        case 'h': case 'l':
+            for (int i = 0; i < std::max(n, 1); i++) setMode(i < n ? p[i] : 0, priv, final == 'h');
+            break;
+        case 'm': if (!priv) ApplySgr(cur.style, p, n); break;
+        case 'r': {
+            int t = arg(0, 1) - 1, b = arg(1, numRows) - 1;
+            if (t < b && b < numRows) { top = t; bottom = b; }
+            else { top = 0; bottom = numRows - 1; }
+            moveTo(0, 0);
+            break;
+        }
+        case 's': if (!priv) saved = cur; break;
+        case 'u': if (!priv) { cur = saved; wrapPending = false; } break;
+        default: break;
+    }
+}
+
+void TermScreen::escDispatch(const char* inter, int interCount, char final) {
+    if (interCount > 0) {
+        if (inter[0] == '(') cur.lineDrawing = (final == '0');
+        return;
+    }
+    switch (final) {
+        case '7': saved = cur; break;
+        case '8': cur = saved; wrapPending = false; break;
+        case 'D': index(); break;
+        case 'E': newLine(); break;
+        case 'M': reverseIndex(); break;
+        case 'c': reset(); break;
+        default: break;
+    }
+}
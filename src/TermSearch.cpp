@@ -0,0 +1,163 @@
+#include "../include/TermSearch.hpp"
+#include <algorithm>
+#include <chrono>
+
+// Lines scanned per hold of the model lock, so the parser is never held up
+static const uint64_t CHUNK_LINES = 4096;
+
+static inline char LowerAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c + 32) : c;
+}
+
+static void FindAll(const char* text, size_t len, const std::string& needle, uint64_t id, std::vector<TermMatch>& out) {
+    size_t n = needle.size();
+    if (n == 0 || n > len) return;
+    char first = needle[0];
+    size_t i = 0;
+    while (i + n <= len) {
+        if (LowerAscii(text[i]) != first) { i++; continue; }
+        size_t k = 1;
+        while (k < n && LowerAscii(text[i + k]) == needle[k]) k++;
+        if (k == n) {
+            out.push_back({id, (uint32_t)i, (uint32_t)n});
+            i += n;
+        } else {
+            i++;
+        }
+    }
+}
+
+TermSearch::TermSearch(std::mutex& modelMutex, const Scrollback& history, const TermScreen& screen)
+    : modelMutex(modelMutex), history(history), screen(screen) {}
+
+TermSearch::~TermSearch() {
+    stop();
+}
+
+void TermSearch::stop() {
+    running = false;
+    wakeCv.notify_all();
+    if (worker.joinable()) worker.join();
+    std::lock_guard<std::mutex> lock(resultMutex);
+    query.clear();
+    queryGen++;
+}
+
+// The worker only starts once something is searched for.
+void TermSearch::setQuery(const std::string& q) {
+    {
+        std::lock_guard<std::mutex> lock(resultMutex);
+        if (q == query) return;
+        query = q;
+        queryGen++;
+    }
+    if (!running) {
+        running = true;
+        worker = std::thread(&TermSearch::run, this);
+    }
+    notifyOutput();
+}
+
+void TermSearch::notifyOutput() {
+    if (!running) return;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        outputPending = true;
+    }
+    wakeCv.notify_one();
+}
+
+bool TermSearch::collect(std::vector<TermMatch>& matches, std::vector<TermMatch>& onScreen, bool& capped) {
+    std::lock_guard<std::mutex> lock(resultMutex);
+    bool reset = collectedGen != queryGen;
+    if (reset) {
+        matches.clear();
+        onScreen.clear();
+        capped = false;
+        collectedGen = queryGen;
+    }
+    // Until the worker publishes for the current query `pending` is stale
+    if (publishedGen == queryGen) {
+        matches.insert(matches.end(), pending.begin(), pending.end());
+        pending.clear();
+        onScreen = screenHits;
+        capped = truncated;
+    }
+    return reset;
+}
+
+// Scans from where the previous pass stopped up to the newest committed line,
+// a chunk at a time, then rescans the live screen rows.
+void TermSearch::run() {
+    uint64_t gen = UINT64_MAX;
+    std::string needle;
+    uint64_t scanned = 0;
+    size_t found = 0;
+    std::vector<TermMatch> hits, onScreen;
+    TerminalLine scratch;
+
+    while (running) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wakeCv.wait_for(lock, std::chrono::milliseconds(250), [&] { return !running || outputPending; });
+            outputPending = false;
+        }
+        if (!running) break;
+        {
+            std::lock_guard<std::mutex> lock(resultMutex);
+            if (queryGen != gen) {
+                gen = queryGen;
+                needle = query;
+                for (char& c : needle) c = LowerAscii(c);
+                scanned = 0;
+                found = 0;
+            }
+        }
+        if (needle.empty()) continue;
+
+        bool done = false;
+        while (running && !done) {
+            hits.clear();
+            onScreen.clear();
+            {
+                std::lock_guard<std::mutex> lock(modelMutex);
+                uint64_t first = history.firstId();
+                uint64_t from = std::max(scanned, first);
+                uint64_t to = std::min(from + CHUNK_LINES, history.endId());
+                if (found < MAX_MATCHES) {
+                    for (uint64_t id = from; id < to; id++) {
+                        ScrollLine line = history.line((size_t)(id - first));
+                        FindAll(line.text, line.len, needle, id, hits);
+                    }
+                }
+                scanned = to;
+                done = to == history.endId();
+                if (done) {
+                    uint64_t base = history.endId();
+                    int used = screen.usedRows();
+                    for (int r = 0; r < used; r++) {
+                        screen.rowLine(r, scratch);
+                        FindAll(scratch.text.data(), scratch.text.size(), needle, base + r, onScreen);
+                    }
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(resultMutex);
+            if (queryGen != gen) break;   // superseded; the next wait returns at once
+            if (publishedGen != gen) {
+                pending.clear();
+                screenHits.clear();
+                truncated = false;
+                publishedGen = gen;
+            }
+            size_t room = found < MAX_MATCHES ? MAX_MATCHES - found : 0;
+            if (hits.size() > room) {
+                hits.resize(room);
+                truncated = true;
+            }
+            found += hits.size();
+            pending.insert(pending.end(), hits.begin(), hits.end());
+            if (done) screenHits = onScreen;
+        }
+    }
+}
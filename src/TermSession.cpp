@@ -0,0 +1,1176 @@
+#ifdef _WIN32
+    // 1. Rename conflicting functions to something harmless
+    #define CloseWindow Win32_CloseWindow
+    #define ShowCursor  Win32_ShowCursor
+    #define PlaySound   Win32_PlaySound
+    #define LoadImage   Win32_LoadImage
+    #define DrawText    Win32_DrawText
+    #define DrawTextEx  Win32_DrawTextEx
+    
+    // 2. Block GDI Rectangle
+    #define NOGDI 
+    #define Rectangle Win32_Rectangle_Dummy
+    
+    // 3. Include Windows
+    #include <windows.h>
+    
+    // 4. Undefine everything so Raylib can use the names
+    #undef CloseWindow
+    #undef ShowCursor
+    #undef PlaySound
+    #undef LoadImage
+    #undef DrawText
+    #undef DrawTextEx
+    #undef Rectangle
+    #undef ERROR 
+#elif defined(__APPLE__)
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <signal.h>
+    #include <poll.h>
+    #include <sys/wait.h>
+    #include <util.h>
+    #include <termios.h>
+    #include <sys/ioctl.h>
+    #include <spawn.h>
+#elif defined(__linux__)
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <signal.h>
+    #include <poll.h>
+    #include <sys/wait.h>
+    #include <pty.h>
+    #include <termios.h>
+    #include <sys/ioctl.h>
+    #include <spawn.h>
+#else
+    #include <unistd.h>
+#endif
+
+// Now it is safe to include Raylib
+#include "../include/TermSession.hpp"
+#include "../include/TextFont.hpp"
+
+#include <iostream>
+#include <cstdio>
+#include <memory>
+#include <array>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+
+#if defined(__APPLE__) || defined(__linux__)
+extern char** environ;
+#endif
+
+static double NowSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Standard 16-colour ANSI palette (30-37 / 90-97 map to 0-7 / 8-15).
+static const Color ANSI_PALETTE[16] = {
+    {0, 0, 0, 255},       {220, 50, 47, 255},   {133, 153, 0, 255},   {181, 137, 0, 255},
+    {38, 139, 210, 255},  {211, 54, 130, 255},  {42, 161, 152, 255},  {245, 245, 245, 255},
+    {80, 80, 80, 255},    {255, 85, 85, 255},   {152, 195, 121, 255}, {229, 192, 123, 255},
+    {97, 175, 239, 255},  {198, 120, 221, 255}, {86, 182, 194, 255},  {255, 255, 255, 255}
+};
+
+static Color AnsiColor(int idx) {
+    idx &= 0xFF;
+    if (idx < 16) return ANSI_PALETTE[idx];
+    if (idx < 232) {
+        // 6x6x6 colour cube
+        static const unsigned char level[6] = {0, 95, 135, 175, 215, 255};
+        idx -= 16;
+        return (Color){level[idx / 36], level[(idx / 6) % 6], level[idx % 6], 255};
+    }
+    unsigned char v = (unsigned char)(8 + (idx - 232) * 10);
+    return (Color){v, v, v, 255};
+}
+
+static Color ResolveTermColor(uint32_t c, Color fallback) {
+    switch (c & TC_KIND) {
+        case TC_INDEXED: return AnsiColor((int)(c & 0xFF));
+        case TC_RGB: return (Color){(unsigned char)(c >> 16), (unsigned char)(c >> 8), (unsigned char)c, 255};
+        default: return fallback;
+    }
+}
+
+static void ResolveStyle(const TermStyle& style, Color& fg, Color& bg, bool& hasBg) {
+    uint32_t fgc = style.fg;
+    // Bold brightens the basic eight colours like xterm does
+    if ((style.attrs & TA_BOLD) && (fgc & TC_KIND) == TC_INDEXED && (fgc & 0xFF) < 8) fgc += 8;
+    fg = ResolveTermColor(fgc, theme.text);
+    bg = ResolveTermColor(style.bg, theme.panelBg);
+    hasBg = (style.bg & TC_KIND) != TC_DEFAULT;
+    if (style.attrs & TA_INVERSE) {
+        std::swap(fg, bg);
+        hasBg = true;
+    }
+}
+
+static void AppendPlainLine(Scrollback& lines, const std::string& text) {
+    lines.push(text.data(), text.size(), nullptr, 0);
+}
+
+// Resize requests settle for this long before the pty hears about them
+static const double RESIZE_DEBOUNCE = 0.15;
+
+// Scrollback row stamps are the line length (only the newest line grows),
+// tagged so they never equal a screen row's batch number.
+static const uint64_t HISTORY_STAMP = 1ull << 63;
+
+static size_t NextChar(const char* text, size_t len, size_t i) {
+    i++;
+    while (i < len && ((unsigned char)text[i] & 0xC0) == 0x80) i++;
+    return i;
+}
+
+static int CountCells(const char* text, size_t len) {
+    int cells = 0;
+    for (size_t i = 0; i < len; i++) if (((unsigned char)text[i] & 0xC0) != 0x80) cells++;
+    return cells;
+}
+
+// Copies `cellCount` cells of a stored line starting at cell `cellStart`,
+// with the style runs that cover them.
+static void SliceLine(const ScrollLine& sl, int cellStart, int cellCount, TerminalLine& out, uint32_t& byteStart) {
+    size_t b = 0;
+    for (int c = 0; c < cellStart && b < sl.len; c++) b = NextChar(sl.text, sl.len, b);
+    size_t e = b;
+    for (int c = 0; c < cellCount && e < sl.len; c++) e = NextChar(sl.text, sl.len, e);
+    out.text.assign(sl.text + b, e - b);
+    out.runs.clear();
+    TermStyle style;
+    for (uint32_t r = 0; r < sl.runCount; r++) {
+        uint32_t start = sl.runs[r].start;
+        if (start <= b) { style = sl.runs[r].style; continue; }
+        if (start >= e) break;
+        if (out.runs.empty()) out.runs.push_back({0, style});
+        out.runs.push_back({(uint32_t)(start - b), sl.runs[r].style});
+    }
+    if (out.runs.empty() && style != TermStyle{}) out.runs.push_back({0, style});
+    byteStart = (uint32_t)b;
+}
+
+// Lines are copied into the log under the lock this many at a time
+static const uint64_t LOG_CHUNK_LINES = 4096;
+
+static unsigned long ProcessId() {
+#ifdef _WIN32
+    return (unsigned long)GetCurrentProcessId();
+#else
+    return (unsigned long)getpid();
+#endif
+}
+
+TermSession::TermSession(uint64_t id) : id(id) {}
+
+// Stops the search worker and the shell. Nothing here touches the GPU, so the
+// last reference may be dropped on any thread.
+TermSession::~TermSession() {
+    if (logThread.joinable()) logThread.join();
+    search.stop();
+#ifdef _WIN32
+    if (hJob) {
+        TerminateJobObject(hJob, 1);
+        CloseHandle(hJob);
+        hJob = nullptr;
+    }
+    if (hProcess) {
+        TerminateProcess(hProcess, 0);
+        CloseHandle(hProcess);
+        hProcess = nullptr;
+    }
+    if (hChildStd_IN_Wr) CloseHandle(hChildStd_IN_Wr);
+    if (hChildStd_OUT_Rd) CloseHandle(hChildStd_OUT_Rd);
+#endif
+#if defined(__APPLE__) || defined(__linux__)
+    if (shellPid > 0) {
+        // Give the shell a moment to leave on SIGHUP before forcing it; a
+        // task's whole process group goes with it
+        kill(task ? -shellPid : shellPid, task ? SIGTERM : SIGHUP);
+        int waited = 0;
+        while (waitpid(shellPid, nullptr, WNOHANG) == 0) {
+            if (waited++ == 20) {
+                kill(task ? -shellPid : shellPid, SIGKILL);
+                waitpid(shellPid, nullptr, 0);
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        shellPid = -1;
+    }
+    if (ptyFd >= 0) {
+        ::close(ptyFd);
+        ptyFd = -1;
+    }
+#endif
+}
+
+// Releases the row cache; must run on the UI thread while the window is open.
+void TermSession::cleanup() {
+    if (rowCache.id > 0) UnloadRenderTexture(rowCache);
+    rowCache = { 0 };
+    slots.clear();
+}
+
+void TermSession::prepare(int cols, int rows) {
+    displayHistory.setCapacity((size_t)std::max(100, settings.scrollbackLines));
+    if (settings.scrollbackSpill) {
+        std::error_code ec;
+        std::filesystem::create_directories("data/scrollback", ec);
+        spill = std::make_unique<ScrollbackSpill>("data/scrollback/" + std::to_string(ProcessId()) + "-" + std::to_string(id) + ".seg");
+        if (spill->ok()) displayHistory.setSink(spill.get());
+        else spill.reset();
+    }
+    screen.attach(&displayHistory);
+    screen.resize(cols, rows);
+    screen.reset();
+    parser.reset();
+    gridCols = screen.cols();
+    gridRows = screen.rows();
+}
+
+// The shell starts at the size the panel had last, so its first prompt fits.
+void TermSession::start(int cols, int rows) {
+    prepare(cols, rows);
+    createShellProcess();
+#ifdef _WIN32
+    AppendPlainLine(displayHistory, "Microsoft Windows [CMD Session]");
+#elif defined(__APPLE__)
+    AppendPlainLine(displayHistory, "macOS Terminal");
+#else
+    AppendPlainLine(displayHistory, "POSIX Shell");
+#endif
+    AppendPlainLine(displayHistory, "Integrated Terminal Ready.");
+    AppendPlainLine(displayHistory, " ");
+}
+
+bool TermSession::startTask(const std::string& title, const std::string& command, int cols, int rows) {
+    task = true;
+    shellName = title;
+    prepare(cols, rows);
+    // Pipes do no newline translation, so LF gets to return the carriage (LNM)
+    std::string banner = "\x1b[20h\x1b[2m$ " + command + "\x1b[0m\n";
+    {
+        std::lock_guard<std::mutex> lock(modelMutex);
+        feed(banner.data(), banner.size());
+    }
+    taskStart = NowSeconds();
+    return createTaskProcess(command);
+}
+
+// The child gets its own process group (a job on Windows) so cancelling
+// reaches everything it started; stdin is empty and stdout/stderr share one pipe.
+bool TermSession::createTaskProcess(const std::string& command) {
+#ifdef _WIN32
+    SECURITY_ATTRIBUTES saAttr;
+    saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
+    saAttr.bInheritHandle = TRUE;
+    saAttr.lpSecurityDescriptor = NULL;
+    if (!CreatePipe(&hChildStd_OUT_Rd, &hChildStd_OUT_Wr, &saAttr, 0)) return false;
+    SetHandleInformation(hChildStd_OUT_Rd, HANDLE_FLAG_INHERIT, 0);
+
+    PROCESS_INFORMATION piProcInfo;
+    STARTUPINFOA siStartInfo;
+    ZeroMemory(&piProcInfo, sizeof(PROCESS_INFORMATION));
+    ZeroMemory(&siStartInfo, sizeof(STARTUPINFO));
+    siStartInfo.cb = sizeof(STARTUPINFO);
+    siStartInfo.hStdError = hChildStd_OUT_Wr;
+    siStartInfo.hStdOutput = hChildStd_OUT_Wr;
+    siStartInfo.hStdInput = NULL;
+    siStartInfo.dwFlags |= STARTF_USESTDHANDLES;
+
+    std::string cmdLine = "cmd.exe /c " + command;
+    std::vector<char> cmdBuf(cmdLine.begin(), cmdLine.end());
+    cmdBuf.push_back('\0');
+    bool ok = CreateProcessA(NULL, cmdBuf.data(), NULL, NULL, TRUE, CREATE_SUSPENDED | CREATE_NO_WINDOW, NULL, NULL, &siStartInfo, &piProcInfo);
+    CloseHandle(hChildStd_OUT_Wr);
+    hChildStd_OUT_Wr = nullptr;
+    if (!ok) return false;
+    hJob = CreateJobObjectA(NULL, NULL);
+    if (hJob) AssignProcessToJobObject(hJob, piProcInfo.hProcess);
+    ResumeThread(piProcInfo.hThread);
+    CloseHandle(piProcInfo.hThread);
+    hProcess = piProcInfo.hProcess;
+    return true;
+#elif defined(__APPLE__) || defined(__linux__)
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], 1);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], 2);
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    // Tasks start with a default SIGPIPE whatever the editor's threads block
+    sigset_t noSignals, pipeSignal;
+    sigemptyset(&noSignals);
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    posix_spawnattr_setsigmask(&attr, &noSignals);
+    posix_spawnattr_setsigdefault(&attr, &pipeSignal);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+    posix_spawnattr_setpgroup(&attr, 0);
+
+    const char* argv[] = {"/bin/sh", "-c", command.c_str(), nullptr};
+    pid_t pid = -1;
+    int err = posix_spawn(&pid, "/bin/sh", &actions, &attr, (char* const*)argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    ::close(fds[1]);
+    if (err != 0) {
+        ::close(fds[0]);
+        return false;
+    }
+    ptyFd = fds[0];
+    shellPid = (int)pid;
+    fcntl(ptyFd, F_SETFL, fcntl(ptyFd, F_GETFL, 0) | O_NONBLOCK);
+    return true;
+#else
+    (void)command;
+    return false;
+#endif
+}
+
+double TermSession::taskElapsed() const {
+    if (!task) return 0.0;
+    return (taskEnd > 0.0 ? taskEnd : NowSeconds()) - taskStart;
+}
+
+void TermSession::cancelTask() {
+    if (!taskRunning()) return;
+    cancelCount++;
+#ifdef _WIN32
+    if (hJob) TerminateJobObject(hJob, 1);
+    else if (hProcess) TerminateProcess(hProcess, 1);
+#elif defined(__APPLE__) || defined(__linux__)
+    if (shellPid > 0) kill(-shellPid, cancelCount > 1 ? SIGKILL : SIGTERM);
+#endif
+}
+
+// Runs once the I/O thread has seen the end of the output, so it has stopped
+// writing the ring and the footer can go in behind the last of it.
+void TermSession::pollTask() {
+    if (!task || taskEnd > 0.0 || !exited) return;
+#ifdef _WIN32
+    if (!hProcess || WaitForSingleObject(hProcess, 0) != WAIT_OBJECT_0) return;
+    DWORD code = 0;
+    GetExitCodeProcess(hProcess, &code);
+    taskExit = (int)code;
+#elif defined(__APPLE__) || defined(__linux__)
+    int status = 0;
+    if (shellPid <= 0 || waitpid(shellPid, &status, WNOHANG) != shellPid) return;
+    taskExit = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + (WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+    shellPid = -1;
+#endif
+    taskEnd = NowSeconds();
+    std::string footer;
+    if (cancelCount > 0) footer = TextFormat("\n\x1b[33m[cancelled after %.1fs]\x1b[0m\n", taskElapsed());
+    else if (taskExit == 0) footer = TextFormat("\n\x1b[32m[finished in %.1fs]\x1b[0m\n", taskElapsed());
+    else footer = TextFormat("\n\x1b[31m[exited with code %d after %.1fs]\x1b[0m\n", taskExit, taskElapsed());
+    inputRing.write(footer.data(), footer.size());
+}
+
+void TermSession::takeDiagnostics(std::vector<Diagnostic>& out, size_t max) {
+    std::lock_guard<std::mutex> lock(modelMutex);
+    size_t n = std::min(max, diagPending.size() - diagTaken);
+    for (size_t i = 0; i < n; i++) out.push_back(std::move(diagPending[diagTaken + i]));
+    diagTaken += n;
+    if (diagTaken == diagPending.size()) {
+        diagPending.clear();
+        diagTaken = 0;
+    }
+}
+
+void TermSession::createShellProcess() {
+#ifdef _WIN32
+    shellName = "cmd";
+    SECURITY_ATTRIBUTES saAttr;
+    saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
+    saAttr.bInheritHandle = TRUE;
+    saAttr.lpSecurityDescriptor = NULL;
+
+    if (!CreatePipe(&hChildStd_OUT_Rd, &hChildStd_OUT_Wr, &saAttr, 0)) return;
+    if (!SetHandleInformation(hChildStd_OUT_Rd, HANDLE_FLAG_INHERIT, 0)) return;
+
+    if (!CreatePipe(&hChildStd_IN_Rd, &hChildStd_IN_Wr, &saAttr, 0)) return;
+    if (!SetHandleInformation(hChildStd_IN_Wr, HANDLE_FLAG_INHERIT, 0)) return;
+
+    PROCESS_INFORMATION piProcInfo;
+    STARTUPINFOA siStartInfo;
+    ZeroMemory(&piProcInfo, sizeof(PROCESS_INFORMATION));
+    ZeroMemory(&siStartInfo, sizeof(STARTUPINFO));
+    siStartInfo.cb = sizeof(STARTUPINFO);
+    siStartInfo.hStdError = hChildStd_OUT_Wr;
+    siStartInfo.hStdOutput = hChildStd_OUT_Wr;
+    siStartInfo.hStdInput = hChildStd_IN_Rd;
+    siStartInfo.dwFlags |= STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
+    siStartInfo.wShowWindow = 0; // 0 is SW_HIDE
+
+    char cmdLine[] = "cmd.exe";
+    if (CreateProcessA(NULL, cmdLine, NULL, NULL, TRUE, 0, NULL, NULL, &siStartInfo, &piProcInfo)) {
+        hProcess = piProcInfo.hProcess;
+        CloseHandle(piProcInfo.hThread); 
+        CloseHandle(hChildStd_OUT_Wr);   
+        CloseHandle(hChildStd_IN_Rd);    
+    }
+#elif defined(__APPLE__)
+    const char* shell = settings.shellPath.empty() ? "/bin/zsh" : settings.shellPath.c_str();
+    const char* base = strrchr(shell, '/');
+    const char* name = base ? base + 1 : shell;
+    shellName = name;
+    int masterFd = -1;
+    struct winsize ws = {};
+    ws.ws_col = (unsigned short)gridCols;
+    ws.ws_row = (unsigned short)gridRows;
+    pid_t pid = forkpty(&masterFd, NULL, NULL, &ws);
+    if (pid == 0) {
+        // So `yes | head` in the shell ends quietly
+        sigset_t noSignals;
+        sigemptyset(&noSignals);
+        sigprocmask(SIG_SETMASK, &noSignals, nullptr);
+        signal(SIGPIPE, SIG_DFL);
+        setenv("TERM", "xterm-256color", 1);
+        execl(shell, name, "-l", (char*)NULL);
+        _exit(1);
+    } else if (pid > 0) {
+        ptyFd = masterFd;
+        shellPid = (int)pid;
+        int flags = fcntl(ptyFd, F_GETFL, 0);
+        fcntl(ptyFd, F_SETFL, flags | O_NONBLOCK);
+    }
+#elif defined(__linux__)
+    const char* shell = settings.shellPath.empty() ? "/bin/bash" : settings.shellPath.c_str();
+    const char* base = strrchr(shell, '/');
+    const char* name = base ? base + 1 : shell;
+    shellName = name;
+    int masterFd = -1;
+    struct winsize ws = {};
+    ws.ws_col = (unsigned short)gridCols;
+    ws.ws_row = (unsigned short)gridRows;
+    pid_t pid = forkpty(&masterFd, NULL, NULL, &ws);
+    if (pid == 0) {
+        // So `yes | head` in the shell ends quietly
+        sigset_t noSignals;
+        sigemptyset(&noSignals);
+        sigprocmask(SIG_SETMASK, &noSignals, nullptr);
+        signal(SIGPIPE, SIG_DFL);
+        setenv("TERM", "xterm-256color", 1);
+        execl(shell, name, "-l", (char*)NULL);
+        _exit(1);
+    } else if (pid > 0) {
+        ptyFd = masterFd;
+        shellPid = (int)pid;
+        int flags = fcntl(ptyFd, F_GETFL, 0);
+        fcntl(ptyFd, F_SETFL, flags | O_NONBLOCK);
+    }
+#endif
+}
+
+// Reads what the pty has ready without blocking, never more than the ring can take.
+int TermSession::pump(std::vector<char>& buffer) {
+    size_t room = std::min(buffer.size(), inputRing.space());
+    if (room == 0) return 0;
+    size_t got = 0;
+#ifdef _WIN32
+    DWORD avail = 0;
+    if (!hChildStd_OUT_Rd || !PeekNamedPipe(hChildStd_OUT_Rd, NULL, 0, NULL, &avail, NULL)) return -1;
+    if (avail == 0) return 0;
+    DWORD dwRead = 0;
+    if (!ReadFile(hChildStd_OUT_Rd, buffer.data(), (DWORD)std::min<size_t>(room, avail), &dwRead, NULL) || dwRead == 0) return -1;
+    got = dwRead;
+#elif defined(__APPLE__) || defined(__linux__)
+    if (ptyFd < 0) return -1;
+    ssize_t n = read(ptyFd, buffer.data(), room);
+    if (n < 0) return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+    if (n == 0) return -1; // shell exited
+    got = (size_t)n;
+#else
+    return -1;
+#endif
+    inputRing.write(buffer.data(), got);
+    return (int)got;
+}
+
+bool TermSession::parsePending(std::vector<char>& chunk) {
+    size_t n = inputRing.read(chunk.data(), chunk.size());
+    if (n == 0) return false;
+    std::string reply;
+    {
+        std::lock_guard<std::mutex> lock(modelMutex);
+        feed(chunk.data(), n);
+        reply = screen.takeResponses();
+        if (task) diagParser.feed(chunk.data(), n, diagPending);
+    }
+    if (!reply.empty()) writeRawToPipe(reply);
+    search.notifyOutput();
+    unseenOutput = true;
+    return true;
+}
+
+// Called with modelMutex held.
+void TermSession::feed(const char* data, size_t len) {
+    double start = NowSeconds();
+    if (start - lastOutputTime > 1.0) { parseSeconds = 0.0; parseBytes = 0; }
+    screen.beginBatch();
+    parser.feed(data, len, screen);
+    double end = NowSeconds();
+    parseSeconds += end - start;
+    parseBytes += len;
+    lastOutputTime = end;
+}
+
+// Resizes the grid and tells the shell, which redraws on SIGWINCH. The
+// scrollback is left alone; the view rewraps it as it comes into sight.
+void TermSession::applySize(int cols, int rows) {
+    {
+        std::lock_guard<std::mutex> lock(modelMutex);
+        screen.resize(cols, rows);
+    }
+    gridCols = cols;
+    gridRows = rows;
+#if defined(__APPLE__) || defined(__linux__)
+    if (ptyFd >= 0) {
+        struct winsize ws = {};
+        ws.ws_col = (unsigned short)cols;
+        ws.ws_row = (unsigned short)rows;
+        ioctl(ptyFd, TIOCSWINSZ, &ws);
+    }
+#endif
+}
+
+// Oldest line the view can reach: the spill continues the scrollback only
+// if nothing was lost between them. Called with modelMutex held.
+uint64_t TermSession::historyFirst() const {
+    uint64_t first = displayHistory.firstId();
+    if (spill && !spill->empty() && spill->endId() == first) return spill->firstId();
+    return first;
+}
+
+// A spilled line stays valid until the next call. Called with modelMutex held.
+ScrollLine TermSession::historyLine(uint64_t id) {
+    if (id >= displayHistory.firstId()) return displayHistory.line((size_t)(id - displayHistory.firstId()));
+    ScrollLine sl;
+    if (!spill || !spill->line(id, spillScratch)) return sl;
+    sl.text = spillScratch.text.data();
+    sl.len = (uint32_t)spillScratch.text.size();
+    sl.runs = spillScratch.runs.data();
+    sl.runCount = (uint32_t)spillScratch.runs.size();
+    return sl;
+}
+
+// Rows a scrollback line takes at the current width; screen rows take one.
+// Called with modelMutex held. Only lines the view walks over get counted.
+int TermSession::wrappedRows(uint64_t id) {
+    uint64_t sbEnd = displayHistory.endId();
+    if (id >= sbEnd) return 1;
+    bool newest = id + 1 == sbEnd;   // may still grow, so never cached
+    if (!newest) {
+        auto it = wrapCounts.find(id);
+        if (it != wrapCounts.end()) return it->second;
+    }
+    ScrollLine sl = historyLine(id);
+    int n = std::max(1, (CountCells(sl.text, sl.len) + wrapCols - 1) / wrapCols);
+    if (!newest) {
+        if (wrapCounts.size() > 65536) wrapCounts.clear();
+        wrapCounts[id] = n;
+    }
+    return n;
+}
+
+bool TermSession::stepBack(ViewPos& p) {
+    if (p.sub > 0) { p.sub--; return true; }
+    if (p.id <= historyFirst()) return false;
+    p.id--;
+    p.sub = wrappedRows(p.id) - 1;
+    return true;
+}
+
+bool TermSession::stepForward(ViewPos& p, uint64_t lastId) {
+    if (p.sub + 1 < wrappedRows(p.id)) { p.sub++; return true; }
+    if (p.id >= lastId) return false;
+    p.id++;
+    p.sub = 0;
+    return true;
+}
+
+// Copies the rows that will be drawn this frame, walking up from the scroll
+// anchor and reusing every row whose id, piece and stamp are unchanged.
+void TermSession::syncView(int visibleRows) {
+    std::lock_guard<std::mutex> lock(modelMutex);
+    if (wrapCols != screen.cols()) {
+        wrapCols = screen.cols();
+        wrapCounts.clear();
+        viewRows.clear();
+        for (TermRowSlot& slot : slots) slot = TermRowSlot{};
+    }
+    uint64_t sbFirst = historyFirst();
+    uint64_t sbEnd = displayHistory.endId();
+    uint64_t lastId = sbEnd + screen.usedRows() - 1;
+    ViewPos bottom = {lastId, 0};
+
+    if (jumpPending) {
+        // Park the hit mid-panel
+        jumpPending = false;
+        ViewPos p = {jumpTarget.id, 0};
+        if (p.id >= sbFirst && p.id <= lastId) {
+            if (p.id < sbEnd) {
+                ScrollLine sl = historyLine(p.id);
+                p.sub = CountCells(sl.text, std::min<size_t>(jumpTarget.start, sl.len)) / wrapCols;
+            }
+            for (int i = 0; i < visibleRows / 2 && stepForward(p, lastId); i++) {}
+            anchor = p;
+            followOutput = false;
+        }
+    }
+    if (scrollDelta > 0) {
+        if (followOutput) anchor = bottom;
+        followOutput = false;
+        for (int i = 0; i < scrollDelta && stepBack(anchor); i++) {}
+    } else if (scrollDelta < 0 && !followOutput) {
+        for (int i = 0; i < -scrollDelta && stepForward(anchor, lastId); i++) {}
+    }
+    scrollDelta = 0;
+
+    if (followOutput || anchor.id > lastId) anchor = bottom;
+    if (anchor.id < sbFirst) anchor = {sbFirst, 0};
+    anchor.sub = std::min(anchor.sub, wrappedRows(anchor.id) - 1);
+    if (anchor.id == bottom.id && anchor.sub == bottom.sub) followOutput = true;
+
+    std::vector<ViewPos> positions;
+    ViewPos p = anchor;
+    positions.push_back(p);
+    while ((int)positions.size() < visibleRows && stepBack(p)) positions.push_back(p);
+
+    std::vector<TermViewRow> next(positions.size());
+    for (size_t k = 0; k < positions.size(); k++) {
+        const ViewPos& pos = positions[positions.size() - 1 - k];
+        TermViewRow& row = next[k];
+        row.id = pos.id;
+        row.sub = pos.sub;
+        bool history = pos.id < sbEnd;
+        ScrollLine sl;
+        if (history) {
+            sl = historyLine(pos.id);
+            row.stamp = HISTORY_STAMP | sl.len;
+        } else {
+            row.stamp = screen.rowStamp((int)(pos.id - sbEnd));
+        }
+        auto old = std::lower_bound(viewRows.begin(), viewRows.end(), row, [](const TermViewRow& a, const TermViewRow& b) {
+            return a.id < b.id || (a.id == b.id && a.sub < b.sub);
+        });
+        if (old != viewRows.end() && old->id == row.id && old->sub == row.sub && old->stamp == row.stamp) {
+            row = std::move(*old);
+            continue;
+        }
+        if (history) SliceLine(sl, pos.sub * wrapCols, wrapCols, row.line, row.byteStart);
+        else screen.rowLine((int)(pos.id - sbEnd), row.line);
+    }
+    viewRows.swap(next);
+    viewHistoryFirst = sbFirst;
+    viewVisibleRows = visibleRows;
+
+    viewCursorId = sbEnd + screen.cursorY();
+    viewCursorX = screen.cursorX();
+    viewCursorShown = screen.cursorVisible();
+    viewAppCursor = screen.appCursorKeys();
+    bool streaming = NowSeconds() - lastOutputTime < 1.0 && parseSeconds > 0.0 && parseBytes > 64 * 1024;
+    viewRate = streaming ? (float)(parseBytes / parseSeconds / (1024.0 * 1024.0)) : 0.0f;
+}
+
+void TermSession::writeToPipe(const std::string& cmd) {
+#ifdef _WIN32
+    if (!hChildStd_IN_Wr) return;
+    std::string fullCmd = cmd + "\r\n";
+    DWORD dwWritten;
+    WriteFile(hChildStd_IN_Wr, fullCmd.c_str(), fullCmd.size(), &dwWritten, NULL);
+#endif
+#ifdef __APPLE__
+    if (ptyFd < 0) return;
+    std::string fullCmd = cmd + "\n";
+    ::write(ptyFd, fullCmd.c_str(), fullCmd.size());
+#elif defined(__linux__)
+    if (ptyFd < 0) return;
+    std::string fullCmd = cmd + "\n";
+    ::write(ptyFd, fullCmd.c_str(), fullCmd.size());
+#endif
+}
+
+void TermSession::writeRawToPipe(const std::string& data) {
+#ifdef _WIN32
+    if (!hChildStd_IN_Wr) return;
+    DWORD dwWritten;
+    WriteFile(hChildStd_IN_Wr, data.c_str(), data.size(), &dwWritten, NULL);
+#endif
+#ifdef __APPLE__
+    if (ptyFd < 0) return;
+    ::write(ptyFd, data.c_str(), data.size());
+#elif defined(__linux__)
+    if (ptyFd < 0) return;
+    ::write(ptyFd, data.c_str(), data.size());
+#endif
+}
+
+bool TermSession::saveLog(const std::string& path) {
+    if (logState == LOG_WRITING) return false;
+    if (logThread.joinable()) logThread.join();
+    logState = LOG_WRITING;
+    logThread = std::thread([this, path] { logState = writeLog(path) ? LOG_DONE : LOG_FAILED; });
+    return true;
+}
+
+int TermSession::takeLogResult() {
+    int state = logState;
+    if (state == LOG_DONE || state == LOG_FAILED) logState = LOG_IDLE;
+    return state;
+}
+
+void TermSession::memoryUsage(MemoryReport& report) {
+    std::string name = shellName + " #" + std::to_string(id);
+    size_t lines, bytes;
+    {
+        std::lock_guard<std::mutex> lock(modelMutex);
+        lines = displayHistory.size();
+        bytes = displayHistory.memoryBytes();
+    }
+    report.add("Scrollback", name + " (" + std::to_string(lines) + " lines)", bytes);
+    report.add("Terminal buffers", name + " input", inputRing.capacity());
+    report.add("Textures", name + " row cache", RenderTextureBytes(rowCache));
+}
+
+size_t TermSession::historyCapacity() {
+    std::lock_guard<std::mutex> lock(modelMutex);
+    return displayHistory.capacity();
+}
+
+size_t TermSession::trimHistory(size_t maxLines) {
+    std::lock_guard<std::mutex> lock(modelMutex);
+    size_t before = displayHistory.memoryBytes();
+    displayHistory.shrink(maxLines);
+    size_t after = displayHistory.memoryBytes();
+    return before > after ? before - after : 0;
+}
+
+// Spilled segments are decompressed straight into the output buffer, then the
+// in-memory lines are copied out a chunk at a time so the parser is only held
+// up briefly; the buffer goes to disk in WRITE_BLOCK pieces.
+bool TermSession::writeLog(const std::string& path) {
+    FILE* out = fopen(path.c_str(), "wb");
+    if (!out) return false;
+    std::string buffer;
+    buffer.reserve(ScrollbackSpill::WRITE_BLOCK + 64 * 1024);
+
+    ScrollbackSpill::Snapshot snap;
+    uint64_t next, end;
+    std::vector<std::string> screenRows;
+    {
+        std::lock_guard<std::mutex> lock(modelMutex);
+        next = displayHistory.firstId();
+        if (spill) {
+            snap = spill->snapshot();
+            if (!snap.segments.empty() || !snap.pending.empty()) next = snap.end;
+        }
+        end = displayHistory.endId();
+        TerminalLine row;
+        for (int r = 0; r < screen.usedRows(); r++) {
+            screen.rowLine(r, row);
+            screenRows.push_back(row.text);
+        }
+    }
+    bool ok = !spill || spill->writeText(snap, buffer, out);
+
+    TerminalLine line;
+    while (next < end) {
+        uint64_t stop = std::min(end, next + LOG_CHUNK_LINES);
+        {
+            std::lock_guard<std::mutex> lock(modelMutex);
+            for (; next < stop; next++) {
+                // Lines evicted since the snapshot are read back from the spill
+                if (next >= displayHistory.firstId()) {
+                    ScrollLine sl = displayHistory.line((size_t)(next - displayHistory.firstId()));
+                    buffer.append(sl.text, sl.len);
+                } else if (spill && spill->line(next, line)) {
+                    buffer += line.text;
+                } else {
+                    continue;
+                }
+                buffer += '\n';
+            }
+        }
+        if (buffer.size() >= ScrollbackSpill::WRITE_BLOCK) {
+            fwrite(buffer.data(), 1, buffer.size(), out);
+            buffer.clear();
+        }
+    }
+    for (const std::string& row : screenRows) {
+        buffer += row;
+        buffer += '\n';
+    }
+    if (!buffer.empty() && fwrite(buffer.data(), 1, buffer.size(), out) != buffer.size()) ok = false;
+    if (fclose(out) != 0) ok = false;
+    return ok;
+}
+
+void TermSession::runCommand(const std::string& cmd) {
+    if (cmd == "clear" || cmd == "cls") {
+        std::lock_guard<std::mutex> lock(modelMutex);
+        displayHistory.clear();
+        screen.reset();
+        followOutput = true;
+    } else {
+#ifdef _WIN32
+        writeToPipe(cmd);
+#else
+        writeToPipe(cmd);
+#endif
+        cmdHistory.push_back(cmd);
+    }
+}
+
+// Keyboard input for the session shown in the panel.
+void TermSession::update() {
+    bool ctrl = IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL);
+
+    // Scrollback
+    float wheel = GetMouseWheelMove();
+    if (wheel != 0.0f) scrollDelta += (int)wheel;
+
+    if (ctrl && IsKeyPressed(KEY_F)) {
+        searchOpen = true;
+        while (GetCharPressed() > 0) {}
+        return;
+    }
+    if (searchOpen) {
+        updateSearchInput();
+        return;
+    }
+    if (task) {
+        // A task reads nothing; Ctrl+C is the only key it takes
+        if (ctrl && IsKeyPressed(KEY_C)) cancelTask();
+        while (GetCharPressed() > 0) {}
+        return;
+    }
+
+#ifdef _WIN32
+    // History navigation
+    if (IsKeyPressed(KEY_UP)) { 
+        if (!cmdHistory.empty()) { 
+            if (historyIndex == -1) historyIndex = cmdHistory.size()-1; 
+            else if(historyIndex > 0) historyIndex--; 
+            inputBuffer = cmdHistory[historyIndex]; 
+        } 
+    }
+    if (IsKeyPressed(KEY_DOWN)) { 
+        if (historyIndex != -1) { 
+            if (historyIndex < (int)cmdHistory.size()-1) { 
+                historyIndex++; 
+                inputBuffer = cmdHistory[historyIndex]; 
+            } else { 
+                historyIndex = -1; 
+                inputBuffer = ""; 
+            } 
+        } 
+    }
+
+    // Input text
+    int c = GetCharPressed();
+    while (c > 0) { 
+        if (c >= 32 && c <= 126) inputBuffer += (char)c; 
+        c = GetCharPressed(); 
+    }
+    if (IsKeyPressed(KEY_BACKSPACE) && !inputBuffer.empty()) inputBuffer.pop_back();
+    
+    // Execute
+    if (IsKeyPressed(KEY_ENTER)) { 
+        if (!inputBuffer.empty()) {
+            runCommand(inputBuffer);
+            inputBuffer = "";
+            historyIndex = -1;
+        } else {
+            writeToPipe("");
+        }
+    }
+#else
+    // Send key input directly to PTY for real terminal behavior
+    if (ctrl && IsKeyPressed(KEY_C)) { writeRawToPipe("\x03"); return; }
+    if (ctrl && IsKeyPressed(KEY_D)) { writeRawToPipe("\x04"); return; }
+    if (ctrl && IsKeyPressed(KEY_Z)) { writeRawToPipe("\x1A"); return; }
+
+    int c = GetCharPressed();
+    while (c > 0) {
+        char ch = (char)c;
+        writeRawToPipe(std::string(1, ch));
+        c = GetCharPressed();
+    }
+    if (IsKeyPressed(KEY_BACKSPACE)) writeRawToPipe("\x7f");
+    if (IsKeyPressed(KEY_ENTER)) writeRawToPipe("\n");
+    if (IsKeyPressed(KEY_TAB)) writeRawToPipe("\t");
+    // DECCKM switches arrows to SS3 form for full-screen programs
+    const char* csi = viewAppCursor ? "\x1bO" : "\x1b[";
+    if (IsKeyPressed(KEY_UP)) writeRawToPipe(std::string(csi) + "A");
+    if (IsKeyPressed(KEY_DOWN)) writeRawToPipe(std::string(csi) + "B");
+    if (IsKeyPressed(KEY_LEFT)) writeRawToPipe(std::string(csi) + "D");
+    if (IsKeyPressed(KEY_RIGHT)) writeRawToPipe(std::string(csi) + "C");
+    if (IsKeyPressed(KEY_ESCAPE)) writeRawToPipe("\x1b");
+#endif
+}
+
+// While the search bar is open it takes all keyboard input.
+void TermSession::updateSearchInput() {
+    if (IsKeyPressed(KEY_ESCAPE)) {
+        searchOpen = false;
+        searchQuery.clear();
+        search.setQuery("");
+        searchCurrent = -1;
+        return;
+    }
+    bool changed = false;
+    int c = GetCharPressed();
+    while (c > 0) {
+        if (c >= 32 && c <= 126) { searchQuery += (char)c; changed = true; }
+        c = GetCharPressed();
+    }
+    if (IsKeyPressed(KEY_BACKSPACE) && !searchQuery.empty()) { searchQuery.pop_back(); changed = true; }
+    if (changed) {
+        search.setQuery(searchQuery);
+        searchCurrent = -1;
+        searchJumpPending = !searchQuery.empty();
+    }
+
+    // Enter/F3 go to the next (newer) hit, with Shift to the previous one
+    bool shift = IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
+    if (IsKeyPressed(KEY_ENTER) || IsKeyPressed(KEY_F3)) {
+        if (searchCurrent < 0) jumpToMatch(shift ? searchCount() - 1 : 0);
+        else jumpToMatch(shift ? searchCurrent - 1 : searchCurrent + 1);
+    }
+}
+
+// Pulls new hits from the worker and forgets those on evicted lines.
+void TermSession::collectSearch() {
+    if (search.collect(searchHits, searchScreenHits, searchCapped)) searchCurrent = -1;
+    auto keep = std::lower_bound(searchHits.begin(), searchHits.end(), viewHistoryFirst,
+                                 [](const TermMatch& m, uint64_t id) { return m.id < id; });
+    int dropped = (int)(keep - searchHits.begin());
+    if (dropped > 0) {
+        searchHits.erase(searchHits.begin(), keep);
+        searchCurrent = (searchCurrent >= dropped) ? searchCurrent - dropped : -1;
+    }
+    if (searchCurrent >= searchCount()) searchCurrent = -1;
+    // Scanning runs oldest first, so the first hit to arrive is the oldest one
+    if (searchJumpPending && searchCount() > 0) {
+        searchJumpPending = false;
+        jumpToMatch(0);
+    }
+}
+
+int TermSession::searchCount() const {
+    return (int)(searchHits.size() + searchScreenHits.size());
+}
+
+const TermMatch& TermSession::searchMatch(int index) const {
+    if (index < (int)searchHits.size()) return searchHits[index];
+    return searchScreenHits[index - searchHits.size()];
+}
+
+// Scrolls so the hit sits in the middle of the panel on the next sync.
+void TermSession::jumpToMatch(int index) {
+    int total = searchCount();
+    if (total == 0) return;
+    searchCurrent = ((index % total) + total) % total;
+    jumpTarget = searchMatch(searchCurrent);
+    jumpPending = true;
+}
+
+void TermSession::drawSearchBar(Rectangle bounds, Font font) {
+    Rectangle box = {bounds.x + bounds.width - 410, bounds.y - 23, 320, 21};
+    DrawRectangleRec(box, theme.panelBg);
+    DrawRectangleLinesEx(box, 1, theme.keyword);
+    DrawTextEx(font, (searchQuery + "_").c_str(), {box.x + 6, box.y + 2}, Config::FONT_SIZE_SMALL, 1, theme.text);
+
+    int total = searchCount();
+    std::string status;
+    if (total > 0) status = TextFormat("%d/%d%s", searchCurrent + 1, total, searchCapped ? "+" : "");
+    else if (!searchQuery.empty()) status = "No results";
+    if (status.empty()) return;
+    float sw = MeasureTextEx(font, status.c_str(), Config::FONT_SIZE_SMALL, 1).x;
+    DrawTextEx(font, status.c_str(), {box.x + box.width - sw - 6, box.y + 2}, Config::FONT_SIZE_SMALL, 1, theme.comment);
+}
+
+// Hit offsets are bytes; rows are laid out on the cell grid, so count cells.
+void TermSession::drawSearchHighlights(const TermViewRow& row, float x, float y) {
+    const std::string& text = row.line.text;
+    auto mark = [&](const TermMatch& m, int index) {
+        // Clip the hit to the piece of the line this row shows
+        size_t lo = std::max<size_t>(m.start, row.byteStart);
+        size_t hi = std::min<size_t>((size_t)m.start + m.len, row.byteStart + text.size());
+        if (lo >= hi) return;
+        lo -= row.byteStart;
+        hi -= row.byteStart;
+        int col = CountCells(text.data(), lo);
+        int cells = CountCells(text.data() + lo, hi - lo);
+        Color c = (index == searchCurrent) ? Fade(theme.keyword, 0.45f) : Fade(theme.selection, 0.6f);
+        DrawRectangle((int)(x + 5 + col * cellW), (int)y, (int)(cells * cellW), (int)rowH, c);
+    };
+    auto it = std::lower_bound(searchHits.begin(), searchHits.end(), row.id,
+                               [](const TermMatch& m, uint64_t id) { return m.id < id; });
+    for (; it != searchHits.end() && it->id == row.id; ++it) mark(*it, (int)(it - searchHits.begin()));
+    for (size_t j = 0; j < searchScreenHits.size(); j++) {
+        if (searchScreenHits[j].id == row.id) mark(searchScreenHits[j], (int)(searchHits.size() + j));
+    }
+}
+
+void TermSession::updateMetrics(Font font) {
+    Vector2 one = MeasureTextEx(font, "M", Config::FONT_SIZE_UI, 1);
+    Vector2 two = MeasureTextEx(font, "MM", Config::FONT_SIZE_UI, 1);
+    float h = ceilf(one.y) + 2;
+    float w = two.x - one.x;
+    bool colorsChanged = memcmp(&cacheBg, &theme.panelBg, sizeof(Color)) != 0 || memcmp(&cacheText, &theme.text, sizeof(Color)) != 0;
+    if (font.texture.id == layoutFontId && h == rowH && w == cellW && !colorsChanged) return;
+    layoutFontId = font.texture.id;
+    rowH = h;
+    cellW = w;
+    cacheBg = theme.panelBg;
+    cacheText = theme.text;
+    for (TermViewRow& row : viewRows) { row.laidOut = false; row.slot = -1; }
+    for (TermRowSlot& slot : slots) slot = TermRowSlot{};
+}
+
+void TermSession::ensureRowCache(int width, int slotCount) {
+    int height = (int)(slotCount * rowH);
+    if (rowCache.id > 0 && rowCache.texture.width == width && rowCache.texture.height == height) return;
+    if (rowCache.id > 0) UnloadRenderTexture(rowCache);
+    rowCache = LoadRenderTexture(width, height);
+    slots.assign(slotCount, TermRowSlot{});
+    for (TermViewRow& row : viewRows) row.slot = -1;
+}
+
+// Splits a row into styled pieces placed on the cell grid, so columns line up
+// and nothing needs measuring when the row is drawn.
+void TermSession::layoutRow(TermViewRow& row) {
+    const TerminalLine& line = row.line;
+    row.layout.clear();
+    size_t pos = 0, r = 0;
+    int column = 0;
+    TermStyle style;
+    while (pos < line.text.size()) {
+        while (r < line.runs.size() && line.runs[r].start <= pos) { style = line.runs[r].style; r++; }
+        size_t end = (r < line.runs.size()) ? std::min<size_t>(line.runs[r].start, line.text.size()) : line.text.size();
+        if (end <= pos) { pos = end; continue; }
+        int cells = 0;
+        for (size_t i = pos; i < end; i++) if (((unsigned char)line.text[i] & 0xC0) != 0x80) cells++;
+        row.layout.push_back({line.text.substr(pos, end - pos), column * cellW, cells * cellW, style});
+        column += cells;
+        pos = end;
+    }
+    row.laidOut = true;
+}
+
+// Called between BeginTextureMode/EndTextureMode on the row cache.
+void TermSession::drawRowToSlot(Font font, const TermViewRow& row, int slot) {
+    float sy = slot * rowH;
+    DrawRectangle(0, (int)sy, rowCache.texture.width, (int)rowH, theme.panelBg);
+    for (const TermGlyphRun& piece : row.layout) {
+        Color fg, bg; bool hasBg;
+        ResolveStyle(piece.style, fg, bg, hasBg);
+        float x = 5 + piece.x;
+        if (hasBg) DrawRectangle((int)x, (int)sy, (int)ceilf(piece.w), (int)rowH, bg);
+        DrawTextEx(font, piece.text.c_str(), {x, sy + 1}, Config::FONT_SIZE_UI, 1, fg);
+        if (piece.style.attrs & TA_UNDERLINE) DrawLine((int)x, (int)(sy + rowH - 3), (int)(x + piece.w), (int)(sy + rowH - 3), fg);
+    }
+}
+
+void TermSession::render(Rectangle bounds, Font font) {
+    updateMetrics(font);
+
+    // The grid follows the panel; a drag only reaches the pty once it settles
+    int cols = std::max(2, (int)((bounds.width - 10) / cellW));
+    int rows = std::max(2, (int)((bounds.height - 25) / rowH));
+    if (cols != gridCols || rows != gridRows) {
+        double now = NowSeconds();
+        if (cols != wantCols || rows != wantRows) {
+            wantCols = cols;
+            wantRows = rows;
+            wantSince = now;
+        }
+        if (now - wantSince >= RESIZE_DEBOUNCE) applySize(cols, rows);
+    }
+
+    int visibleRows = (int)(bounds.height / rowH) + 1;
+    syncView(visibleRows);
+    collectSearch();
+
+    // Bring the row cache up to date before any scissor state is set
+    frameCounter++;
+    ensureRowCache(std::max(1, (int)bounds.width), visibleRows + 2);
+    std::vector<int> dirty;
+    for (int k = 0; k < (int)viewRows.size(); k++) {
+        TermViewRow& row = viewRows[k];
+        if (row.slot >= 0 && row.slot < (int)slots.size() && slots[row.slot].id == row.id && slots[row.slot].sub == row.sub && slots[row.slot].stamp == row.stamp) {
+            slots[row.slot].lastFrame = frameCounter;
+            continue;
+        }
+        int victim = -1;
+        for (int i = 0; i < (int)slots.size(); i++) {
+            if (slots[i].lastFrame == frameCounter) continue;
+            if (victim < 0 || slots[i].lastFrame < slots[victim].lastFrame) victim = i;
+        }
+        if (victim < 0) { row.slot = -1; continue; }
+        slots[victim] = {row.id, row.sub, row.stamp, frameCounter};
+        row.slot = victim;
+        if (!row.laidOut) layoutRow(row);
+        dirty.push_back(k);
+    }
+    if (!dirty.empty()) {
+        BeginTextureMode(rowCache);
+        BeginText(font);
+        for (int k : dirty) drawRowToSlot(font, viewRows[k], viewRows[k].slot);
+        EndText(font);
+        EndTextureMode();
+    }
+
+    unseenOutput = false;
+    DrawRectangleRec(bounds, theme.panelBg);
+    DrawRectangleLinesEx(bounds, 1, theme.border);
+    BeginText(font);
+    std::string status;
+    if (taskRunning() && !searchOpen) status = TextFormat("Running %.1fs  ", taskElapsed());
+    if (viewRate > 0.0f) status += TextFormat("%.1f MB/s", viewRate);
+    if (!status.empty()) {
+        float sw = MeasureTextEx(font, status.c_str(), Config::FONT_SIZE_SMALL, 1).x;
+        DrawTextEx(font, status.c_str(), {bounds.x + bounds.width - sw - 8, bounds.y - 21}, Config::FONT_SIZE_SMALL, 1, theme.comment);
+    }
+    if (searchOpen) drawSearchBar(bounds, font);
+    EndText(font);
+    
+    BeginScissorMode((int)bounds.x, (int)bounds.y, (int)bounds.width, (int)bounds.height);
+        float y = bounds.y + bounds.height - 25;
+#ifdef _WIN32
+        BeginText(font);
+        DrawTextEx(font, ("> " + inputBuffer + "_").c_str(), {bounds.x + 5, y}, Config::FONT_SIZE_UI, 1, theme.keyword);
+        EndText(font);
+#endif
+        float texH = (float)rowCache.texture.height;
+        for (int k = (int)viewRows.size() - 1; k >= 0; k--) {
+            y -= rowH;
+            if (y < bounds.y - rowH) break;
+            const TermViewRow& row = viewRows[k];
+            if (row.slot >= 0) {
+                // Render textures are stored bottom-up, hence the flipped source rect
+                float sy = row.slot * rowH;
+                DrawTextureRec(rowCache.texture, {0, texH - sy - rowH, (float)rowCache.texture.width, -rowH}, {bounds.x, y}, WHITE);
+            }
+            if (searchOpen && searchCount() > 0) drawSearchHighlights(row, bounds.x, y);
+            if (viewCursorShown && row.id == viewCursorId && row.sub == 0) {
+                DrawRectangle((int)(bounds.x + 5 + viewCursorX * cellW), (int)y, (int)cellW, (int)rowH, Fade(theme.cursor, 0.5f));
+            }
+        }
+    EndScissorMode();
+}
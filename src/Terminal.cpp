@@ -1,175 +1,31 @@
-#ifdef _WIN32
-    // 1. Rename conflicting functions to something harmless
-    #define CloseWindow Win32_CloseWindow
-    #define ShowCursor  Win32_ShowCursor
-    #define PlaySound   Win32_PlaySound
-    #define LoadImage   Win32_LoadImage
-    #define DrawText    Win32_DrawText
-    #define DrawTextEx  Win32_DrawTextEx
-    
-    // 2. Block GDI Rectangle
-    #define NOGDI 
-    #define Rectangle Win32_Rectangle_Dummy
-    
-    // 3. Include Windows
-    #include <windows.h>
-    
-    // 4. Undefine everything so Raylib can use the names
-    #undef CloseWindow
-    #undef ShowCursor
-    #undef PlaySound
-    #undef LoadImage
-    #undef DrawText
-    #undef DrawTextEx
-    #undef Rectangle
-    #undef ERROR 
-#elif defined(__APPLE__)
+#if defined(__linux__)
     #include <unistd.h>
     #include <fcntl.h>
-    #include <signal.h>
-    #include <sys/wait.h>
-    #include <util.h>
-    #include <termios.h>
-#elif defined(__linux__)
+    #include <sys/epoll.h>
+#elif defined(__APPLE__)
     #include <unistd.h>
     #include <fcntl.h>
-    #include <signal.h>
-    #include <sys/wait.h>
-    #include <pty.h>
-    #include <termios.h>
-#else
-    #include <unistd.h>
+    #include <poll.h>
 #endif
 
-// Now it is safe to include Raylib
 #include "../include/Terminal.hpp"
+#include "../include/TextFont.hpp"
 
-#include <iostream>
-#include <cstdio>
-#include <memory>
-#include <array>
-#include <cstring>
-
-static Color AnsiColor(int code) {
-    switch (code) {
-        case 30: return BLACK;
-        case 31: return (Color){220, 50, 47, 255};
-        case 32: return (Color){133, 153, 0, 255};
-        case 33: return (Color){181, 137, 0, 255};
-        case 34: return (Color){38, 139, 210, 255};
-        case 35: return (Color){211, 54, 130, 255};
-        case 36: return (Color){42, 161, 152, 255};
-        case 37: return RAYWHITE;
-        case 90: return DARKGRAY;
-        case 91: return (Color){255, 85, 85, 255};
-        case 92: return (Color){152, 195, 121, 255};
-        case 93: return (Color){229, 192, 123, 255};
-        case 94: return (Color){97, 175, 239, 255};
-        case 95: return (Color){198, 120, 221, 255};
-        case 96: return (Color){86, 182, 194, 255};
-        case 97: return WHITE;
-        default: return WHITE;
-    }
-}
-
-static void AppendSegment(TerminalLine& line, const std::string& text, Color color) {
-    if (text.empty()) return;
-    if (!line.segments.empty() && line.segments.back().color.r == color.r &&
-        line.segments.back().color.g == color.g && line.segments.back().color.b == color.b) {
-        line.segments.back().text += text;
-    } else {
-        line.segments.push_back({text, color});
-    }
-}
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <ctime>
+#include <filesystem>
 
-static void ClearLine(TerminalLine& line) {
-    line.segments.clear();
-}
+// Parser chunks are small enough that the UI never waits long for a session lock
+static const size_t PARSE_CHUNK = 64 * 1024;
+static const size_t READ_CHUNK = 64 * 1024;
 
-static void BackspaceLine(TerminalLine& line) {
-    if (line.segments.empty()) return;
-    TerminalSegment& seg = line.segments.back();
-    if (!seg.text.empty()) {
-        seg.text.pop_back();
-        if (seg.text.empty()) line.segments.pop_back();
-    } else {
-        line.segments.pop_back();
-    }
-}
-
-static void AppendPlainLine(std::vector<TerminalLine>& lines, const std::string& text, Color color) {
-    TerminalLine line;
-    AppendSegment(line, text, color);
-    lines.push_back(line);
-}
+// Diagnostics handed to the editor per frame
+static const size_t DIAG_BATCH = 2000;
 
-static void AppendAnsiText(std::vector<TerminalLine>& lines, Color& currentColor, bool& pendingCR, const std::string& input) {
-    if (lines.empty()) lines.push_back(TerminalLine{});
-    TerminalLine* line = &lines.back();
-
-    std::string buffer;
-    bool inEscape = false;
-    std::string esc;
-
-    auto flush = [&]() {
-        AppendSegment(*line, buffer, currentColor);
-        buffer.clear();
-    };
-
-    for (size_t i = 0; i < input.size(); i++) {
-        char c = input[i];
-        if (!inEscape) {
-            if (c == 0x1B) { // ESC
-                flush();
-                inEscape = true;
-                esc.clear();
-            } else if (c == '\r') {
-                flush();
-                lines.push_back(TerminalLine{});
-                line = &lines.back();
-                pendingCR = true;
-            } else if (c == '\n') {
-                if (pendingCR) {
-                    pendingCR = false;
-                    // finish current line and move to next
-                }
-                flush();
-                lines.push_back(TerminalLine{});
-                line = &lines.back();
-            } else if (c == 0x08 || c == 0x7F) { // backspace/delete
-                flush();
-                BackspaceLine(*line);
-            } else {
-                buffer += c;
-            }
-        } else {
-            esc += c;
-            if (c == 'm') {
-                // Parse SGR
-                // esc format like "[31m" or "[0m"
-                if (!esc.empty() && esc[0] == '[') {
-                    std::string params = esc.substr(1, esc.size() - 2);
-                    if (params.empty()) params = "0";
-                    size_t start = 0;
-                    while (start < params.size()) {
-                        size_t sep = params.find(';', start);
-                        std::string token = params.substr(start, sep == std::string::npos ? std::string::npos : sep - start);
-                        int code = std::atoi(token.c_str());
-                        if (code == 0) {
-                            currentColor = theme.text;
-                        } else if ((code >= 30 && code <= 37) || (code >= 90 && code <= 97)) {
-                            currentColor = AnsiColor(code);
-                        }
-                        if (sep == std::string::npos) break;
-                        start = sep + 1;
-                    }
-                }
-                inEscape = false;
-            }
-        }
-    }
-    flush();
-}
+// epoll data for the wake pipe; session ids start at 1
+static const uint64_t WAKE_ID = 0;
 
 Terminal::Terminal() {}
 
@@ -178,278 +34,450 @@ Terminal::~Terminal() {
 }
 
 void Terminal::init() {
-    createShellProcess();
-#ifdef _WIN32
-    AppendPlainLine(displayHistory, "Microsoft Windows [CMD Session]", theme.text);
-#elif defined(__APPLE__)
-    AppendPlainLine(displayHistory, "macOS Terminal", theme.text);
-#else
-    AppendPlainLine(displayHistory, "POSIX Shell", theme.text);
-#endif
-    AppendPlainLine(displayHistory, "Integrated Terminal Ready.", theme.text);
-    AppendPlainLine(displayHistory, " ", theme.text);
+    startThreads();
+    newSession();
 }
 
-void Terminal::createShellProcess() {
-#ifdef _WIN32
-    SECURITY_ATTRIBUTES saAttr;
-    saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
-    saAttr.bInheritHandle = TRUE;
-    saAttr.lpSecurityDescriptor = NULL;
-
-    if (!CreatePipe(&hChildStd_OUT_Rd, &hChildStd_OUT_Wr, &saAttr, 0)) return;
-    if (!SetHandleInformation(hChildStd_OUT_Rd, HANDLE_FLAG_INHERIT, 0)) return;
-
-    if (!CreatePipe(&hChildStd_IN_Rd, &hChildStd_IN_Wr, &saAttr, 0)) return;
-    if (!SetHandleInformation(hChildStd_IN_Wr, HANDLE_FLAG_INHERIT, 0)) return;
-
-    PROCESS_INFORMATION piProcInfo;
-    STARTUPINFOA siStartInfo;
-    ZeroMemory(&piProcInfo, sizeof(PROCESS_INFORMATION));
-    ZeroMemory(&siStartInfo, sizeof(STARTUPINFO));
-    siStartInfo.cb = sizeof(STARTUPINFO);
-    siStartInfo.hStdError = hChildStd_OUT_Wr;
-    siStartInfo.hStdOutput = hChildStd_OUT_Wr;
-    siStartInfo.hStdInput = hChildStd_IN_Rd;
-    siStartInfo.dwFlags |= STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
-    siStartInfo.wShowWindow = 0; // 0 is SW_HIDE
-
-    char cmdLine[] = "cmd.exe";
-    if (CreateProcessA(NULL, cmdLine, NULL, NULL, TRUE, 0, NULL, NULL, &siStartInfo, &piProcInfo)) {
-        hProcess = piProcInfo.hProcess;
-        CloseHandle(piProcInfo.hThread); 
-        CloseHandle(hChildStd_OUT_Wr);   
-        CloseHandle(hChildStd_IN_Rd);    
+// Stops the I/O threads first so dropping the sessions here ends their shells.
+void Terminal::close() {
+    stopThreads();
+    std::vector<std::shared_ptr<TermSession>> old;
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        old.swap(sessions);
     }
-#elif defined(__APPLE__)
-    currentColor = theme.text;
-    int masterFd = -1;
-    pid_t pid = forkpty(&masterFd, NULL, NULL, NULL);
-    if (pid == 0) {
-        const char* shell = settings.shellPath.empty() ? "/bin/zsh" : settings.shellPath.c_str();
-        const char* base = strrchr(shell, '/');
-        const char* name = base ? base + 1 : shell;
-        setenv("TERM", "xterm-256color", 1);
-        execl(shell, name, "-l", (char*)NULL);
-        _exit(1);
-    } else if (pid > 0) {
-        ptyFd = masterFd;
-        shellPid = (int)pid;
-        int flags = fcntl(ptyFd, F_GETFL, 0);
-        fcntl(ptyFd, F_SETFL, flags | O_NONBLOCK);
+    active = -1;
+    for (auto& s : old) s->cleanup();
+}
+
+// GPU resources must go before the window does, so main() calls this explicitly.
+void Terminal::cleanup() {
+    for (auto& s : sessions) s->cleanup();
+}
+
+void Terminal::startThreads() {
+    running = true;
+    outputReady = false;
+#if defined(__APPLE__) || defined(__linux__)
+    if (pipe(wakePipe) == 0) {
+        fcntl(wakePipe[0], F_SETFL, fcntl(wakePipe[0], F_GETFL, 0) | O_NONBLOCK);
+        fcntl(wakePipe[1], F_SETFL, fcntl(wakePipe[1], F_GETFL, 0) | O_NONBLOCK);
     }
-#elif defined(__linux__)
-    currentColor = theme.text;
-    int masterFd = -1;
-    pid_t pid = forkpty(&masterFd, NULL, NULL, NULL);
-    if (pid == 0) {
-        const char* shell = settings.shellPath.empty() ? "/bin/bash" : settings.shellPath.c_str();
-        const char* base = strrchr(shell, '/');
-        const char* name = base ? base + 1 : shell;
-        setenv("TERM", "xterm-256color", 1);
-        execl(shell, name, "-l", (char*)NULL);
-        _exit(1);
-    } else if (pid > 0) {
-        ptyFd = masterFd;
-        shellPid = (int)pid;
-        int flags = fcntl(ptyFd, F_GETFL, 0);
-        fcntl(ptyFd, F_SETFL, flags | O_NONBLOCK);
+#endif
+#if defined(__linux__)
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd >= 0 && wakePipe[0] >= 0) {
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.u64 = WAKE_ID;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakePipe[0], &ev);
     }
 #endif
+    ioThread = std::thread(&Terminal::ioLoop, this);
+    parserThread = std::thread(&Terminal::parserLoop, this);
 }
 
-void Terminal::close() {
-#ifdef _WIN32
-    if (hProcess) {
-        TerminateProcess(hProcess, 0);
-        CloseHandle(hProcess);
-        hProcess = nullptr;
+void Terminal::stopThreads() {
+    running = false;
+    wakeIo();
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        outputReady = true;
     }
-    if (hChildStd_IN_Wr) CloseHandle(hChildStd_IN_Wr);
-    if (hChildStd_OUT_Rd) CloseHandle(hChildStd_OUT_Rd);
+    wakeCv.notify_all();
+    if (ioThread.joinable()) ioThread.join();
+    if (parserThread.joinable()) parserThread.join();
+#if defined(__linux__)
+    if (epollFd >= 0) ::close(epollFd);
+    epollFd = -1;
 #endif
 #if defined(__APPLE__) || defined(__linux__)
-    if (shellPid > 0) {
-        kill(shellPid, SIGHUP);
-        waitpid(shellPid, nullptr, 0);
-        shellPid = -1;
-    }
-    if (ptyFd >= 0) {
-        ::close(ptyFd);
-        ptyFd = -1;
+    for (int& fd : wakePipe) {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
     }
 #endif
 }
 
-void Terminal::readFromPipe() {
-#ifdef _WIN32
-    if (!hChildStd_OUT_Rd) return;
-
-    DWORD dwRead, dwAvail, dwLeft;
-    if (PeekNamedPipe(hChildStd_OUT_Rd, NULL, 0, NULL, &dwAvail, &dwLeft) && dwAvail > 0) {
-        char buffer[4096];
-        if (ReadFile(hChildStd_OUT_Rd, buffer, sizeof(buffer) - 1, &dwRead, NULL) && dwRead > 0) {
-            buffer[dwRead] = '\0';
-            currentColor = theme.text;
-            AppendAnsiText(displayHistory, currentColor, pendingCR, std::string(buffer));
-        }
-    }
-#elif defined(__APPLE__) || defined(__linux__)
-    if (ptyFd < 0) return;
-    char buffer[4096];
-    ssize_t n = read(ptyFd, buffer, sizeof(buffer) - 1);
-    if (n > 0) {
-        buffer[n] = '\0';
-        AppendAnsiText(displayHistory, currentColor, pendingCR, std::string(buffer));
+std::vector<std::shared_ptr<TermSession>> Terminal::snapshot() {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    return sessions;
+}
+
+// `sessions` only changes on the UI thread, so the UI reads it without locking.
+std::shared_ptr<TermSession> Terminal::activeSession() {
+    if (active < 0 || active >= (int)sessions.size()) return nullptr;
+    return sessions[active];
+}
+
+void Terminal::wakeIo() {
+#if defined(__APPLE__) || defined(__linux__)
+    if (wakePipe[1] >= 0) {
+        char b = 1;
+        (void)!::write(wakePipe[1], &b, 1);
     }
 #endif
 }
 
-void Terminal::writeToPipe(const std::string& cmd) {
-#ifdef _WIN32
-    if (!hChildStd_IN_Wr) return;
-    std::string fullCmd = cmd + "\r\n";
-    DWORD dwWritten;
-    WriteFile(hChildStd_IN_Wr, fullCmd.c_str(), fullCmd.size(), &dwWritten, NULL);
+void Terminal::watch(TermSession& s) {
+#if defined(__linux__)
+    if (epollFd < 0 || s.fd() < 0) return;
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = s.id;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, s.fd(), &ev);
+#else
+    // The poll set is rebuilt from the session list on every wake
+    (void)s;
+    wakeIo();
 #endif
-#ifdef __APPLE__
-    if (ptyFd < 0) return;
-    std::string fullCmd = cmd + "\n";
-    ::write(ptyFd, fullCmd.c_str(), fullCmd.size());
-#elif defined(__linux__)
-    if (ptyFd < 0) return;
-    std::string fullCmd = cmd + "\n";
-    ::write(ptyFd, fullCmd.c_str(), fullCmd.size());
+}
+
+void Terminal::unwatch(TermSession& s) {
+#if defined(__linux__)
+    if (epollFd >= 0 && s.fd() >= 0) epoll_ctl(epollFd, EPOLL_CTL_DEL, s.fd(), nullptr);
+#else
+    (void)s;
+    wakeIo();
 #endif
 }
 
-void Terminal::writeRawToPipe(const std::string& data) {
-#ifdef _WIN32
-    if (!hChildStd_IN_Wr) return;
-    DWORD dwWritten;
-    WriteFile(hChildStd_IN_Wr, data.c_str(), data.size(), &dwWritten, NULL);
+// A full ring stops the pty from being read, so the shell blocks on its own
+// output instead of the I/O thread spinning on it.
+void Terminal::pause(TermSession& s) {
+    std::lock_guard<std::mutex> lock(pauseMutex);
+    if (s.paused || s.exited) return;
+    s.paused = true;
+#if defined(__linux__)
+    epoll_event ev = {};
+    ev.events = 0;
+    ev.data.u64 = s.id;
+    if (epollFd >= 0 && s.fd() >= 0) epoll_ctl(epollFd, EPOLL_CTL_MOD, s.fd(), &ev);
 #endif
-#ifdef __APPLE__
-    if (ptyFd < 0) return;
-    ::write(ptyFd, data.c_str(), data.size());
-#elif defined(__linux__)
-    if (ptyFd < 0) return;
-    ::write(ptyFd, data.c_str(), data.size());
+}
+
+void Terminal::resume(TermSession& s) {
+    std::lock_guard<std::mutex> lock(pauseMutex);
+    if (!s.paused || s.exited) return;
+    s.paused = false;
+#if defined(__linux__)
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = s.id;
+    if (epollFd >= 0 && s.fd() >= 0) epoll_ctl(epollFd, EPOLL_CTL_MOD, s.fd(), &ev);
+#else
+    wakeIo();
 #endif
 }
 
-void Terminal::runCommand(const std::string& cmd) {
-    if (cmd == "clear" || cmd == "cls") {
-        displayHistory.clear();
-        scrollOffset = 0;
-    } else {
-#ifdef _WIN32
-        writeToPipe(cmd);
+// I/O thread: sleeps until any pty has output and moves it into that
+// session's ring. Sessions with nothing to say cost nothing here.
+void Terminal::ioLoop() {
+    std::vector<char> buffer(READ_CHUNK);
+    std::vector<std::shared_ptr<TermSession>> ready;
+    while (running) {
+        ready.clear();
+#if defined(__linux__)
+        if (epollFd < 0) break;
+        epoll_event events[32];
+        int n = epoll_wait(epollFd, events, 32, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        std::vector<std::shared_ptr<TermSession>> list = snapshot();
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.u64 == WAKE_ID) {
+                char drain[64];
+                while (read(wakePipe[0], drain, sizeof(drain)) > 0) {}
+                continue;
+            }
+            for (auto& s : list) if (s->id == events[i].data.u64) ready.push_back(s);
+        }
+#elif defined(__APPLE__)
+        // kqueue does not report pty masters reliably, so macOS uses poll
+        std::vector<std::shared_ptr<TermSession>> list = snapshot();
+        std::vector<struct pollfd> fds;
+        std::vector<std::shared_ptr<TermSession>> owners;
+        fds.push_back({wakePipe[0], POLLIN, 0});
+        for (auto& s : list) {
+            if (s->exited || s->paused || s->fd() < 0) continue;
+            fds.push_back({s->fd(), POLLIN, 0});
+            owners.push_back(s);
+        }
+        int n = poll(fds.data(), (nfds_t)fds.size(), -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[0].revents) {
+            char drain[64];
+            while (read(wakePipe[0], drain, sizeof(drain)) > 0) {}
+        }
+        for (size_t i = 1; i < fds.size(); i++) if (fds[i].revents) ready.push_back(owners[i - 1]);
 #else
-        writeToPipe(cmd);
+        // Anonymous pipes cannot be waited on together, so one thread peeks them all
+        for (auto& s : snapshot()) if (!s->exited && !s->paused) ready.push_back(s);
+#endif
+        bool gotAny = false;
+        for (auto& s : ready) {
+            int got = s->pump(buffer);
+            if (got < 0) {
+                s->exited = true;
+                unwatch(*s);
+                continue;
+            }
+            if (got > 0) gotAny = true;
+            if (s->ringFull()) pause(*s);
+        }
+        if (gotAny) {
+            {
+                std::lock_guard<std::mutex> lock(wakeMutex);
+                outputReady = true;
+            }
+            wakeCv.notify_one();
+        }
+#if !defined(__APPLE__) && !defined(__linux__)
+        if (!gotAny) std::this_thread::sleep_for(std::chrono::milliseconds(5));
 #endif
-        cmdHistory.push_back(cmd);
     }
 }
 
-void Terminal::update(bool isFocused) {
-    readFromPipe(); // Always read output
-
-    if (!isFocused) return;
-
-    // Scrollback
-    float wheel = GetMouseWheelMove();
-    if (wheel != 0.0f) {
-        scrollOffset -= (int)wheel;
-        if (scrollOffset < 0) scrollOffset = 0;
-        int maxScroll = (int)displayHistory.size();
-        if (scrollOffset > maxScroll) scrollOffset = maxScroll;
+// Parser thread: gives every session with pending output one chunk per round.
+void Terminal::parserLoop() {
+    std::vector<char> chunk(PARSE_CHUNK);
+    while (running) {
+        bool worked = false;
+        for (auto& s : snapshot()) {
+            if (s->parsePending(chunk)) worked = true;
+            if (s->paused && s->ringDrained()) resume(*s);
+        }
+        if (worked) continue;
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeCv.wait_for(lock, std::chrono::milliseconds(50), [&] { return !running || outputReady; });
+        outputReady = false;
     }
+}
 
-#ifdef _WIN32
-    // History navigation
-    if (IsKeyPressed(KEY_UP)) { 
-        if (!cmdHistory.empty()) { 
-            if (historyIndex == -1) historyIndex = cmdHistory.size()-1; 
-            else if(historyIndex > 0) historyIndex--; 
-            inputBuffer = cmdHistory[historyIndex]; 
-        } 
+void Terminal::newSession() {
+    auto s = std::make_shared<TermSession>(nextSessionId++);
+    s->start(lastCols, lastRows);
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        sessions.push_back(s);
     }
-    if (IsKeyPressed(KEY_DOWN)) { 
-        if (historyIndex != -1) { 
-            if (historyIndex < (int)cmdHistory.size()-1) { 
-                historyIndex++; 
-                inputBuffer = cmdHistory[historyIndex]; 
-            } else { 
-                historyIndex = -1; 
-                inputBuffer = ""; 
-            } 
-        } 
+    active = (int)sessions.size() - 1;
+    watch(*s);
+}
+
+int Terminal::findTask(const std::string& title) {
+    for (int i = 0; i < (int)sessions.size(); i++) {
+        if (sessions[i]->isTask() && sessions[i]->name() == title) return i;
     }
+    return -1;
+}
 
-    // Input text
-    int c = GetCharPressed();
-    while (c > 0) { 
-        if (c >= 32 && c <= 126) inputBuffer += (char)c; 
-        c = GetCharPressed(); 
+void Terminal::runTask(const std::string& title, const std::string& command, bool show) {
+    int index = findTask(title);
+    if (index >= 0 && sessions[index]->taskRunning()) {
+        if (show) switchTo(index);
+        ShowToast(title + " is already running");
+        return;
+    }
+    auto s = std::make_shared<TermSession>(nextSessionId++);
+    if (!s->startTask(title, command, lastCols, lastRows)) {
+        ShowToast("Could not start " + title);
+        return;
     }
-    if (IsKeyPressed(KEY_BACKSPACE) && !inputBuffer.empty()) inputBuffer.pop_back();
-    
-    // Execute
-    if (IsKeyPressed(KEY_ENTER)) { 
-        if (!inputBuffer.empty()) {
-            runCommand(inputBuffer);
-            inputBuffer = "";
-            historyIndex = -1;
+    std::shared_ptr<TermSession> old;
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        if (index >= 0) {
+            old = sessions[index];
+            sessions[index] = s;
         } else {
-            writeToPipe("");
+            sessions.push_back(s);
+            index = (int)sessions.size() - 1;
         }
     }
-#else
-    // Send key input directly to PTY for real terminal behavior
+    if (old) {
+        unwatch(*old);
+        old->cleanup();
+    }
+    if (show) active = index;
+    watch(*s);
+}
+
+void Terminal::cancelTask(const std::string& title) {
+    int index = findTask(title);
+    if (index >= 0) sessions[index]->cancelTask();
+}
+
+double Terminal::taskRunningFor(const std::string& title) {
+    int index = findTask(title);
+    if (index < 0 || !sessions[index]->taskRunning()) return -1.0;
+    return sessions[index]->taskElapsed();
+}
+
+bool Terminal::taskFinished(const std::string& title, int& exitCode) {
+    int index = findTask(title);
+    if (index < 0) { exitCode = -1; return true; }
+    if (sessions[index]->taskRunning()) return false;
+    exitCode = sessions[index]->taskExitCode();
+    return true;
+}
+
+void Terminal::takeDiagnostics(const std::string& title, uint64_t& run, std::vector<Diagnostic>& out) {
+    int index = findTask(title);
+    if (index < 0) return;
+    run = sessions[index]->id;
+    sessions[index]->takeDiagnostics(out, DIAG_BATCH);
+}
+
+void Terminal::memoryUsage(MemoryReport& report) {
+    for (auto& s : sessions) s->memoryUsage(report);
+}
+
+// Lines a session keeps however far over budget the editor is
+static const size_t MIN_SCROLLBACK = 1000;
+
+size_t Terminal::trimScrollback(size_t want) {
+    std::vector<std::shared_ptr<TermSession>> order;
+    for (int i = 0; i < (int)sessions.size(); i++) if (i != active) order.push_back(sessions[i]);
+    if (auto s = activeSession()) order.push_back(s);
+    size_t freed = 0;
+    bool progress = true;
+    while (freed < want && progress) {
+        progress = false;
+        for (auto& s : order) {
+            if (freed >= want) break;
+            size_t cap = s->historyCapacity();
+            if (cap <= MIN_SCROLLBACK) continue;
+            freed += s->trimHistory(std::max(MIN_SCROLLBACK, cap / 2));
+            progress = true;
+        }
+    }
+    return freed;
+}
+
+// The shell ends when the last reference goes, which may be an I/O thread
+// that still holds the session for a moment.
+void Terminal::closeSession(int index) {
+    if (index < 0 || index >= (int)sessions.size()) return;
+    std::shared_ptr<TermSession> s = sessions[index];
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        sessions.erase(sessions.begin() + index);
+    }
+    unwatch(*s);
+    s->cleanup();
+    if (active > index || active >= (int)sessions.size()) active--;
+    if (sessions.empty()) newSession();
+}
+
+void Terminal::switchTo(int index) {
+    int n = (int)sessions.size();
+    if (n == 0) return;
+    active = ((index % n) + n) % n;
+}
+
+void Terminal::runCommand(const std::string& cmd) {
+    if (auto s = activeSession()) s->runCommand(cmd);
+}
+
+// Saves the active session's history to data/logs; render() reports the result.
+void Terminal::saveLog() {
+    std::shared_ptr<TermSession> s = activeSession();
+    if (!s) return;
+    if (logging) { ShowToast("Terminal log already being saved"); return; }
+    std::error_code ec;
+    std::filesystem::create_directories("data/logs", ec);
+    char stamp[32];
+    time_t now = time(nullptr);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+    std::string path = std::string("data/logs/terminal-") + stamp + ".log";
+    if (!s->saveLog(path)) return;
+    logging = s;
+    ShowToast("Saving " + path);
+}
+
+void Terminal::update(bool isFocused) {
+    // Output is read and parsed by the I/O threads; render() picks it up
+    for (auto& s : sessions) s->pollTask();
+    if (!isFocused) return;
     bool ctrl = IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL);
-    if (ctrl && IsKeyPressed(KEY_C)) { writeRawToPipe("\x03"); return; }
-    if (ctrl && IsKeyPressed(KEY_D)) { writeRawToPipe("\x04"); return; }
-    if (ctrl && IsKeyPressed(KEY_Z)) { writeRawToPipe("\x1A"); return; }
-
-    int c = GetCharPressed();
-    while (c > 0) {
-        char ch = (char)c;
-        writeRawToPipe(std::string(1, ch));
-        c = GetCharPressed();
+    bool shift = IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
+    if (ctrl && shift && IsKeyPressed(KEY_T)) { newSession(); return; }
+    if (ctrl && shift && IsKeyPressed(KEY_W)) { closeSession(active); return; }
+    if (ctrl && IsKeyPressed(KEY_PAGE_UP)) { switchTo(active - 1); return; }
+    if (ctrl && IsKeyPressed(KEY_PAGE_DOWN)) { switchTo(active + 1); return; }
+    if (auto s = activeSession()) s->update();
+}
+
+// Tabs are drawn and clicked in one pass, like the menu buttons; tabs past
+// `limit` stay reachable with Ctrl+PageUp/PageDown.
+void Terminal::drawTabs(Rectangle bounds, Font font, float limit) {
+    Vector2 mouse = GetMousePosition();
+    bool click = IsMouseButtonPressed(MOUSE_LEFT_BUTTON);
+    float y = bounds.y - 25;
+    float x = bounds.x;
+    int pick = -1, closeIndex = -1;
+    for (int i = 0; i < (int)sessions.size(); i++) {
+        const TermSession& s = *sessions[i];
+        std::string title = std::to_string(i + 1) + ": " + s.name();
+        if (s.isTask()) {
+            if (s.taskRunning()) title += TextFormat(" %.0fs", s.taskElapsed());
+            else title += s.taskExitCode() == 0 ? " (done)" : " (failed)";
+        } else if (s.exited) {
+            title += " (exited)";
+        }
+        float tabW = MeasureTextEx(font, title.c_str(), Config::FONT_SIZE_SMALL, 1).x + 36;
+        if (x + tabW > limit) break;
+        Rectangle tabR = {x, y, tabW, 25};
+        bool isActive = i == active;
+        DrawRectangleRec(tabR, isActive ? theme.tabActive : theme.tabInactive);
+        if (isActive) DrawRectangle((int)x, (int)y, (int)tabW, 2, theme.keyword);
+        DrawTextEx(font, title.c_str(), {x + 8, y + 4}, Config::FONT_SIZE_SMALL, 1, isActive ? WHITE : GRAY);
+        if (CheckCollisionPointRec(mouse, tabR)) {
+            Rectangle closeR = {x + tabW - 22, y + 3, 20, 19};
+            DrawTextEx(font, "x", {x + tabW - 17, y + 3}, 18, 1, theme.closeBtn);
+            if (click) {
+                if (CheckCollisionPointRec(mouse, closeR)) closeIndex = i;
+                else pick = i;
+            }
+        } else if (!isActive && s.unseenOutput) {
+            DrawCircle((int)(x + tabW - 12), (int)(y + 13), 3, theme.keyword);
+        }
+        x += tabW + 2;
     }
-    if (IsKeyPressed(KEY_BACKSPACE)) writeRawToPipe("\x7f");
-    if (IsKeyPressed(KEY_ENTER)) writeRawToPipe("\n");
-    if (IsKeyPressed(KEY_TAB)) writeRawToPipe("\t");
-    if (IsKeyPressed(KEY_UP)) writeRawToPipe("\x1b[A");
-    if (IsKeyPressed(KEY_DOWN)) writeRawToPipe("\x1b[B");
-    if (IsKeyPressed(KEY_LEFT)) writeRawToPipe("\x1b[D");
-    if (IsKeyPressed(KEY_RIGHT)) writeRawToPipe("\x1b[C");
-#endif
+    Rectangle plusR = {x + 2, y + 2, 24, 21};
+    bool hoverPlus = CheckCollisionPointRec(mouse, plusR);
+    DrawRectangleRec(plusR, hoverPlus ? theme.menuHover : theme.border);
+    DrawTextEx(font, "+", {plusR.x + 7, plusR.y + 1}, Config::FONT_SIZE_UI, 1, theme.text);
+
+    if (pick >= 0) switchTo(pick);
+    if (closeIndex >= 0) closeSession(closeIndex);
+    else if (hoverPlus && click) newSession();
 }
 
+// Only the session on screen is synced and drawn; the rest just keep parsing.
 void Terminal::render(Rectangle bounds, Font font) {
-    DrawRectangleRec(bounds, theme.panelBg);
-    DrawRectangleLinesEx(bounds, 1, theme.border);
+    if (logging) {
+        int result = logging->takeLogResult();
+        if (result == TermSession::LOG_DONE) ShowToast("Terminal log saved");
+        else if (result == TermSession::LOG_FAILED) ShowToast("Could not save terminal log");
+        if (result != TermSession::LOG_WRITING) logging.reset();
+    }
     DrawRectangle(bounds.x, bounds.y - 25, bounds.width, 25, theme.border);
-    DrawTextEx(font, "TERMINAL", {bounds.x + 5, bounds.y - 22}, Config::FONT_SIZE_UI, 1, theme.text);
-    
-    BeginScissorMode((int)bounds.x, (int)bounds.y, (int)bounds.width, (int)bounds.height);
-        float y = bounds.y + bounds.height - 25;
-#ifdef _WIN32
-        DrawTextEx(font, ("> " + inputBuffer + "_").c_str(), {bounds.x + 5, y}, Config::FONT_SIZE_UI, 1, theme.keyword);
-#endif
-        int startIndex = (int)displayHistory.size() - 1 - scrollOffset;
-        for (int i = startIndex; i >= 0; i--) {
-            y -= 22;
-            if (y < bounds.y) break;
-            float x = bounds.x + 5;
-            for (const auto& seg : displayHistory[i].segments) {
-            if (!seg.text.empty()) {
-                DrawTextEx(font, seg.text.c_str(), {x, y}, Config::FONT_SIZE_UI, 1, seg.color);
-                x += MeasureTextEx(font, seg.text.c_str(), Config::FONT_SIZE_UI, 1).x;
-            }
-        }
-        }
-    EndScissorMode();
+    std::shared_ptr<TermSession> s = activeSession();
+    float reserve = (s && s->searchVisible()) ? 420 : (s && s->taskRunning()) ? 220 : 90;
+    float limit = bounds.x + bounds.width - reserve;
+    BeginText(font);
+    drawTabs(bounds, font, limit);
+    EndText(font);
+    s = activeSession();
+    if (!s) return;
+    s->render(bounds, font);
+    lastCols = s->cols();
+    lastRows = s->rows();
 }
@@ -0,0 +1,85 @@
+#include "../include/TextFont.hpp"
+#include <rlgl.h>
+#include <vector>
+#include <algorithm>
+
+// Distance field resolution; edges stay sharp far above this size
+static const int SDF_SIZE = 32;
+static const int GLYPH_COUNT = 250;
+// The bitmap fallback, as the font was loaded before
+static const int BITMAP_SIZE = 96;
+
+// fwidth() follows the on-screen scale, so the edge is about one pixel wide
+// at any size. Shapes sample raylib's white texel and pass through.
+static const char* SDF_FRAGMENT = R"(#version 330
+in vec2 fragTexCoord;
+in vec4 fragColor;
+uniform sampler2D texture0;
+uniform vec4 colDiffuse;
+out vec4 finalColor;
+void main() {
+    float dist = texture(texture0, fragTexCoord).a;
+    float edge = max(fwidth(dist) * 0.7, 0.001);
+    float alpha = smoothstep(0.5 - edge, 0.5 + edge, dist);
+    finalColor = vec4(fragColor.rgb * colDiffuse.rgb, fragColor.a * colDiffuse.a * alpha);
+}
+)";
+
+static Shader sdfShader = { 0 };
+static std::vector<unsigned int> sdfTextures;
+
+static Font LoadBitmapFont(const std::string& path) {
+    Font font = LoadFontEx(path.c_str(), BITMAP_SIZE, 0, GLYPH_COUNT);
+    SetTextureFilter(font.texture, TEXTURE_FILTER_BILINEAR);
+    return font;
+}
+
+Font LoadTextFont(const std::string& path) {
+    if (sdfShader.id == 0) {
+        sdfShader = LoadShaderFromMemory(nullptr, SDF_FRAGMENT);
+        // A shader that failed to build comes back as the default one
+        if (sdfShader.id == rlGetShaderIdDefault()) sdfShader.id = 0;
+    }
+    int size = 0;
+    unsigned char* data = sdfShader.id ? LoadFileData(path.c_str(), &size) : nullptr;
+    if (!data) return LoadBitmapFont(path);
+
+    Font font = { 0 };
+    font.baseSize = SDF_SIZE;
+    font.glyphCount = GLYPH_COUNT;
+    font.glyphs = LoadFontData(data, size, SDF_SIZE, nullptr, GLYPH_COUNT, FONT_SDF);
+    UnloadFileData(data);
+    if (!font.glyphs) return LoadBitmapFont(path);
+    Image atlas = GenImageFontAtlas(font.glyphs, &font.recs, GLYPH_COUNT, SDF_SIZE, 0, 1);
+    font.texture = LoadTextureFromImage(atlas);
+    UnloadImage(atlas);
+    SetTextureFilter(font.texture, TEXTURE_FILTER_BILINEAR);
+    // Drawing only reads the atlas, so the per-glyph bitmaps can go
+    for (int i = 0; i < font.glyphCount; i++) {
+        UnloadImage(font.glyphs[i].image);
+        font.glyphs[i].image = Image{ 0 };
+    }
+    sdfTextures.push_back(font.texture.id);
+    return font;
+}
+
+void UnloadTextFont(Font font) {
+    sdfTextures.erase(std::remove(sdfTextures.begin(), sdfTextures.end(), font.texture.id), sdfTextures.end());
+    UnloadFont(font);
+    if (sdfTextures.empty() && sdfShader.id) {
+        UnloadShader(sdfShader);
+        sdfShader = Shader{ 0 };
+    }
+}
+
+bool IsSdfFont(Font font) {
+    return std::find(sdfTextures.begin(), sdfTextures.end(), font.texture.id) != sdfTextures.end();
+}
+
+void BeginText(Font font) {
+    if (IsSdfFont(font)) BeginShaderMode(sdfShader);
+}
+
+void EndText(Font font) {
+    if (IsSdfFont(font)) EndShaderMode();
+}
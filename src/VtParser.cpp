@@ -0,0 +1,226 @@
+#include "../include/VtParser.hpp"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define VT_HAVE_SSE2 1
+#endif
+
+// Entry/exit actions (clear, osc_start, osc_end) are run by VtParser::enter
+// and feed(); DCS payloads are consumed but not interpreted.
+enum Action : uint8_t {
+    A_NONE, A_PRINT, A_EXECUTE, A_COLLECT, A_PARAM,
+    A_ESC_DISPATCH, A_CSI_DISPATCH, A_PUT, A_OSC_PUT, A_IGNORE
+};
+
+// Table entries pack the action in the high nibble and the next state in the
+// low nibble; NO_CHANGE keeps the current state without entry/exit actions.
+static const uint8_t NO_CHANGE = 0x0F;
+
+struct VtTable {
+    uint8_t t[VtParser::STATE_COUNT][256];
+
+    void set(int s, int lo, int hi, Action a, uint8_t next = NO_CHANGE) {
+        for (int b = lo; b <= hi; b++) t[s][b] = (uint8_t)((a << 4) | next);
+    }
+    // C0 controls other than CAN, SUB and ESC, which are handled from anywhere
+    void c0(int s, Action a) {
+        set(s, 0x00, 0x17, a);
+        set(s, 0x19, 0x19, a);
+        set(s, 0x1C, 0x1F, a);
+    }
+
+    VtTable() {
+        using P = VtParser;
+        for (int s = 0; s < P::STATE_COUNT; s++) {
+            set(s, 0x00, 0xFF, A_IGNORE);
+            set(s, 0x18, 0x18, A_EXECUTE, P::GROUND);
+            set(s, 0x1A, 0x1A, A_EXECUTE, P::GROUND);
+            set(s, 0x1B, 0x1B, A_NONE, P::ESCAPE);
+        }
+
+        c0(P::GROUND, A_EXECUTE);
+        set(P::GROUND, 0x20, 0x7E, A_PRINT);
+        set(P::GROUND, 0x80, 0xFF, A_PRINT);
+
+        c0(P::ESCAPE, A_EXECUTE);
+        set(P::ESCAPE, 0x20, 0x2F, A_COLLECT, P::ESCAPE_INTERMEDIATE);
+        set(P::ESCAPE, 0x30, 0x7E, A_ESC_DISPATCH, P::GROUND);
+        set(P::ESCAPE, 0x50, 0x50, A_NONE, P::DCS_ENTRY);
+        set(P::ESCAPE, 0x58, 0x58, A_NONE, P::SOS_PM_APC_STRING);
+        set(P::ESCAPE, 0x5B, 0x5B, A_NONE, P::CSI_ENTRY);
+        set(P::ESCAPE, 0x5D, 0x5D, A_NONE, P::OSC_STRING);
+        set(P::ESCAPE, 0x5E, 0x5F, A_NONE, P::SOS_PM_APC_STRING);
+
+        c0(P::ESCAPE_INTERMEDIATE, A_EXECUTE);
+        set(P::ESCAPE_INTERMEDIATE, 0x20, 0x2F, A_COLLECT);
+        set(P::ESCAPE_INTERMEDIATE, 0x30, 0x7E, A_ESC_DISPATCH, P::GROUND);
+
+        // ':' is accepted as a parameter separator so SGR sub-parameters
+        // (38:2:r:g:b) parse like their ';' form.
+        c0(P::CSI_ENTRY, A_EXECUTE);
+        set(P::CSI_ENTRY, 0x20, 0x2F, A_COLLECT, P::CSI_INTERMEDIATE);
+        set(P::CSI_ENTRY, 0x30, 0x3B, A_PARAM, P::CSI_PARAM);
+        set(P::CSI_ENTRY, 0x3C, 0x3F, A_COLLECT, P::CSI_PARAM);
+        set(P::CSI_ENTRY, 0x40, 0x7E, A_CSI_DISPATCH, P::GROUND);
+
+        c0(P::CSI_PARAM, A_EXECUTE);
+        set(P::CSI_PARAM, 0x20, 0x2F, A_COLLECT, P::CSI_INTERMEDIATE);
+        set(P::CSI_PARAM, 0x30, 0x3B, A_PARAM);
+        set(P::CSI_PARAM, 0x3C, 0x3F, A_NONE, P::CSI_IGNORE);
+        set(P::CSI_PARAM, 0x40, 0x7E, A_CSI_DISPATCH, P::GROUND);
+
+        c0(P::CSI_INTERMEDIATE, A_EXECUTE);
+        set(P::CSI_INTERMEDIATE, 0x20, 0x2F, A_COLLECT);
+        set(P::CSI_INTERMEDIATE, 0x30, 0x3F, A_NONE, P::CSI_IGNORE);
+        set(P::CSI_INTERMEDIATE, 0x40, 0x7E, A_CSI_DISPATCH, P::GROUND);
+
+        c0(P::CSI_IGNORE, A_EXECUTE);
+        set(P::CSI_IGNORE, 0x40, 0x7E, A_NONE, P::GROUND);
+
+        set(P::DCS_ENTRY, 0x20, 0x2F, A_COLLECT, P::DCS_INTERMEDIATE);
+        set(P::DCS_ENTRY, 0x30, 0x39, A_PARAM, P::DCS_PARAM);
+        set(P::DCS_ENTRY, 0x3A, 0x3A, A_NONE, P::DCS_IGNORE);
+        set(P::DCS_ENTRY, 0x3B, 0x3B, A_PARAM, P::DCS_PARAM);
+        set(P::DCS_ENTRY, 0x3C, 0x3F, A_COLLECT, P::DCS_PARAM);
+        set(P::DCS_ENTRY, 0x40, 0x7E, A_NONE, P::DCS_PASSTHROUGH);
+
+        set(P::DCS_PARAM, 0x20, 0x2F, A_COLLECT, P::DCS_INTERMEDIATE);
+        set(P::DCS_PARAM, 0x30, 0x39, A_PARAM);
+        set(P::DCS_PARAM, 0x3A, 0x3A, A_NONE, P::DCS_IGNORE);
+        set(P::DCS_PARAM, 0x3B, 0x3B, A_PARAM);
+        set(P::DCS_PARAM, 0x3C, 0x3F, A_NONE, P::DCS_IGNORE);
+        set(P::DCS_PARAM, 0x40, 0x7E, A_NONE, P::DCS_PASSTHROUGH);
+
+        set(P::DCS_INTERMEDIATE, 0x20, 0x2F, A_COLLECT);
+        set(P::DCS_INTERMEDIATE, 0x30, 0x3F, A_NONE, P::DCS_IGNORE);
+        set(P::DCS_INTERMEDIATE, 0x40, 0x7E, A_NONE, P::DCS_PASSTHROUGH);
+
+        c0(P::DCS_PASSTHROUGH, A_PUT);
+        set(P::DCS_PASSTHROUGH, 0x20, 0x7E, A_PUT);
+        set(P::DCS_PASSTHROUGH, 0x80, 0xFF, A_PUT);
+
+        // xterm also ends OSC strings with BEL
+        set(P::OSC_STRING, 0x07, 0x07, A_NONE, P::GROUND);
+        set(P::OSC_STRING, 0x20, 0x7E, A_OSC_PUT);
+        set(P::OSC_STRING, 0x80, 0xFF, A_OSC_PUT);
+    }
+};
+
+static const VtTable& Table() {
+    static const VtTable table;
+    return table;
+}
+
+size_t VtScanPrintable(const char* data, size_t len) {
+    size_t i = 0;
+#ifdef VT_HAVE_SSE2
+    // Bytes < 0x20 or == 0x7F stop the run; bytes >= 0x80 are UTF-8 text.
+    // Signed compares see those as negative, so they are masked back out.
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i del = _mm_set1_epi8(0x7F);
+    const __m128i zero = _mm_setzero_si128();
+    while (i + 16 <= len) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i low = _mm_andnot_si128(_mm_cmplt_epi8(v, zero), _mm_cmplt_epi8(v, space));
+        __m128i stop = _mm_or_si128(low, _mm_cmpeq_epi8(v, del));
+        int mask = _mm_movemask_epi8(stop);
+        if (mask != 0) {
+#if defined(_MSC_VER)
+            unsigned long bit; _BitScanForward(&bit, (unsigned long)mask);
+            return i + bit;
+#else
+            return i + (size_t)__builtin_ctz((unsigned)mask);
+#endif
+        }
+        i += 16;
+    }
+#endif
+    while (i < len) {
+        uint8_t b = (uint8_t)data[i];
+        if (b < 0x20 || b == 0x7F) break;
+        i++;
+    }
+    return i;
+}
+
+void VtParser::reset() {
+    state = GROUND;
+    clear();
+    oscLen = 0;
+}
+
+void VtParser::clear() {
+    paramCount = 0;
+    params[0] = 0;
+    interCount = 0;
+}
+
+void VtParser::enter(State next) {
+    state = next;
+    if (next == ESCAPE || next == CSI_ENTRY || next == DCS_ENTRY) clear();
+    else if (next == OSC_STRING) oscLen = 0;
+}
+
+void VtParser::perform(uint8_t action, uint8_t byte, VtHandler& handler) {
+    switch (action) {
+        case A_PRINT: {
+            char c = (char)byte;
+            handler.print(&c, 1);
+            break;
+        }
+        case A_EXECUTE:
+            handler.execute(byte);
+            break;
+        case A_COLLECT:
+            if (interCount < MAX_INTERMEDIATES) inter[interCount++] = (char)byte;
+            break;
+        case A_PARAM:
+            if (paramCount == 0) { paramCount = 1; params[0] = 0; }
+            if (byte == ';' || byte == ':') {
+                if (paramCount < MAX_PARAMS) params[paramCount++] = 0;
+            } else {
+                int& p = params[paramCount - 1];
+                if (p < 100000) p = p * 10 + (byte - '0');
+            }
+            break;
+        case A_ESC_DISPATCH:
+            handler.escDispatch(inter, interCount, (char)byte);
+            break;
+        case A_CSI_DISPATCH:
+            handler.csiDispatch(params, paramCount, inter, interCount, (char)byte);
+            break;
+        case A_OSC_PUT:
+            if (oscLen < MAX_OSC) osc[oscLen++] = (char)byte;
+            break;
+        default:
+            break;
+    }
+}
+
+void VtParser::feed(const char* data, size_t len, VtHandler& handler) {
+    const VtTable& table = Table();
+    size_t i = 0;
+    while (i < len) {
+        if (state == GROUND) {
+            size_t run = VtScanPrintable(data + i, len - i);
+            if (run > 0) {
+                handler.print(data + i, run);
+                i += run;
+                continue;
+            }
+        }
+        uint8_t byte = (uint8_t)data[i++];
+        uint8_t entry = table.t[state][byte];
+        uint8_t action = entry >> 4;
+        uint8_t next = entry & 0x0F;
+        if (next == NO_CHANGE) {
+            perform(action, byte, handler);
+        } else {
+            // exit action, transition action, entry action
+            if (state == OSC_STRING) handler.oscDispatch(osc, oscLen);
+            perform(action, byte, handler);
+            enter((State)next);
+        }
+    }
+}
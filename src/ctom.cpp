@@ -2,6 +2,13 @@
 #include "../include/Editor.hpp"
 #include "../include/FileManager.hpp"
 #include "../include/Terminal.hpp"
+#include "../include/BuildCache.hpp"
+#include "../include/TaskScheduler.hpp"
+#include "../include/SyntaxChecker.hpp"
+#include "../include/SymbolIndex.hpp"
+#include "../include/LspClient.hpp"
+#include "../include/MemoryStats.hpp"
+#include "../include/TextFont.hpp"
 #include <cstdlib> 
 #include <unistd.h>
 #include <string>
@@ -28,6 +35,22 @@ struct AppState {
     int focus = 0; 
     int editingField = 0; 
     int inputCursor = 0;
+    uint64_t diagRun = 0;
+    BuildCache::Plan runPlan;       // Quick Run in flight, stored in the cache when it ends
+    bool runWatch = false;
+    bool showSymbols = false;
+    std::string symbolQuery;
+    int symbolSel = 0;
+    std::vector<SymbolLocation> symbolResults;
+    const void* symbolSnap = nullptr;   // snapshot the results came from
+    bool showReferences = false;
+    std::string referenceWord;
+    std::vector<LspClient::Location> references;
+    int referenceSel = 0;
+    bool showMemory = false;
+    MemoryReport memory;                // refreshed every MEMORY_INTERVAL
+    size_t memoryResident = 0;
+    double memoryAt = -100.0;
 };
 
 // --- UI HELPERS ---
@@ -130,6 +153,12 @@ void DrawSettings(Rectangle bounds, Font font, Editor& editor, Terminal& termina
         if (DrawMenuBtn({bounds.x+160, y-5, 60, 26}, settings.imagePreview ? "On" : "Off", font, theme.btnNormal)) {
             settings.imagePreview = !settings.imagePreview;
         }
+        DrawTextEx(font, "Live Check:", {bounds.x+250, y}, (float)Config::FONT_SIZE_UI, 1, GRAY);
+        std::string checkLabel = settings.syntaxCheckDelay > 0 ? std::to_string(settings.syntaxCheckDelay) + "ms" : "Off";
+        if (DrawMenuBtn({bounds.x+410, y-5, 80, 26}, checkLabel.c_str(), font, theme.btnNormal)) {
+            // Off -> 300 -> 600 -> 1200 -> Off
+            settings.syntaxCheckDelay = settings.syntaxCheckDelay <= 0 ? 300 : settings.syntaxCheckDelay >= 1200 ? 0 : settings.syntaxCheckDelay * 2;
+        }
 
         y += 40;
         // Audio Preview
@@ -137,6 +166,10 @@ void DrawSettings(Rectangle bounds, Font font, Editor& editor, Terminal& termina
         if (DrawMenuBtn({bounds.x+160, y-5, 60, 26}, settings.audioPreview ? "On" : "Off", font, theme.btnNormal)) {
             settings.audioPreview = !settings.audioPreview;
         }
+        DrawTextEx(font, "Spill Scrollback:", {bounds.x+250, y}, (float)Config::FONT_SIZE_UI, 1, GRAY);
+        if (DrawMenuBtn({bounds.x+410, y-5, 60, 26}, settings.scrollbackSpill ? "On" : "Off", font, theme.btnNormal)) {
+            settings.scrollbackSpill = !settings.scrollbackSpill;
+        }
 
         y += 40;
         // Shell Path
@@ -167,8 +200,7 @@ void DrawSettings(Rectangle bounds, Font font, Editor& editor, Terminal& termina
         y += 50;
         // Actions
         if(DrawMenuBtn({bounds.x+20, y, 140, 30}, "Apply Settings", font, theme.btnNormal)) {
-            Font newFont = LoadFontEx(settings.fontPath.c_str(), 96, 0, 250);
-            SetTextureFilter(newFont.texture, TEXTURE_FILTER_BILINEAR);
+            Font newFont = LoadTextFont(settings.fontPath);
             editor.reloadFont(newFont);
             terminal.close();
             terminal.init();
@@ -226,7 +258,9 @@ void DrawAbout(Rectangle bounds, Font font, AppState& app, Texture2D icon) {
         float targetSize = (float)Config::ICON_SIZE_LARGE;
         float scale = targetSize / (float)icon.width;
         float iconX = bounds.x + (bounds.width - targetSize) / 2;
+        EndText(font);
         DrawTextureEx(icon, {iconX, contentY}, 0.0f, scale, WHITE);
+        BeginText(font);
         contentY += targetSize + 15;
     }
 
@@ -245,6 +279,152 @@ void DrawAbout(Rectangle bounds, Font font, AppState& app, Texture2D icon) {
     DrawTextEx(font, ver, {bounds.x + (bounds.width - verSize.x)/2, contentY}, 18, 1, GRAY);
 }
 
+// Ctrl+T: symbol search over the folder index
+static const int SYMBOL_ROWS = 12;
+
+void OpenSymbolSearch(AppState& app, const std::string& query) {
+    app.showSymbols = true;
+    app.symbolQuery = query;
+    app.inputCursor = query.size();
+    app.symbolSel = 0;
+    app.symbolSnap = nullptr;
+}
+
+void DrawSymbolSearch(Rectangle bounds, Font font, AppState& app, SymbolIndex& symbols, Editor& editor) {
+    std::string before = app.symbolQuery;
+    HandleTextInput(app.symbolQuery, app.inputCursor);
+    auto snap = symbols.snapshot();
+    if (app.symbolQuery != before || snap.get() != app.symbolSnap) {
+        app.symbolResults = symbols.search(app.symbolQuery, SYMBOL_ROWS);
+        app.symbolSnap = snap.get();
+        app.symbolSel = 0;
+    }
+    int n = (int)app.symbolResults.size();
+    if (IsKeyPressed(KEY_DOWN) && n) app.symbolSel = (app.symbolSel + 1) % n;
+    if (IsKeyPressed(KEY_UP) && n) app.symbolSel = (app.symbolSel + n - 1) % n;
+    int chosen = IsKeyPressed(KEY_ENTER) && n ? app.symbolSel : -1;
+
+    float rowH = 26;
+    bounds.height = 40 + std::max(1, n) * rowH + 6;
+    DrawRectangleRec(bounds, theme.panelBg);
+    DrawRectangleLinesEx(bounds, 2, theme.border);
+    Rectangle box = {bounds.x + 6, bounds.y + 6, bounds.width - 12, 28};
+    DrawRectangleRec(box, theme.bg);
+    DrawTextEx(font, app.symbolQuery.c_str(), {box.x + 6, box.y + 4}, (float)Config::FONT_SIZE_UI, 1, theme.text);
+    if ((int)(GetTime()*2)%2==0) {
+        float cw = MeasureTextEx(font, app.symbolQuery.substr(0, app.inputCursor).c_str(), (float)Config::FONT_SIZE_UI, 1).x;
+        DrawRectangle((int)(box.x + 6 + cw), (int)(box.y + 4), 2, 20, theme.cursor);
+    }
+    if (symbols.indexing()) DrawTextEx(font, "indexing...", {box.x + box.width - 90, box.y + 6}, 16, 1, GRAY);
+
+    float y = bounds.y + 40;
+    if (n == 0) DrawTextEx(font, snap ? "No matching symbols" : "Open a folder to index its symbols", {bounds.x + 12, y + 3}, 18, 1, GRAY);
+    for (int i = 0; i < n; i++, y += rowH) {
+        const SymbolLocation& loc = app.symbolResults[i];
+        Rectangle row = {bounds.x + 2, y, bounds.width - 4, rowH};
+        bool hover = CheckCollisionPointRec(GetMousePosition(), row);
+        if (i == app.symbolSel || hover) DrawRectangleRec(row, theme.selection);
+        if (hover && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) chosen = i;
+        std::string name = loc.symbol.scope + loc.symbol.name;
+        DrawTextEx(font, name.c_str(), {bounds.x + 12, y + 3}, 18, 1, theme.text);
+        DrawTextEx(font, SymbolKindName(loc.symbol.kind), {bounds.x + 300, y + 4}, 16, 1, theme.keyword);
+        std::string where = fs::path(loc.path).filename().string() + ":" + std::to_string(loc.symbol.line);
+        DrawTextEx(font, where.c_str(), {bounds.x + 390, y + 4}, 16, 1, GRAY);
+    }
+    if (chosen >= 0) {
+        const SymbolLocation& loc = app.symbolResults[chosen];
+        editor.openAt(loc.path, loc.symbol.line);
+        app.showSymbols = false;
+        app.focus = 0;
+    }
+}
+
+// Shift+F12: where the language server found the word under the cursor
+void DrawReferences(Rectangle bounds, Font font, AppState& app, Editor& editor) {
+    int n = (int)app.references.size();
+    if (IsKeyPressed(KEY_DOWN)) app.referenceSel = (app.referenceSel + 1) % n;
+    if (IsKeyPressed(KEY_UP)) app.referenceSel = (app.referenceSel + n - 1) % n;
+    int first = std::max(0, std::min(app.referenceSel - SYMBOL_ROWS / 2, n - SYMBOL_ROWS));
+    int shown = std::min(n, SYMBOL_ROWS);
+    int chosen = IsKeyPressed(KEY_ENTER) ? app.referenceSel : -1;
+
+    float rowH = 26;
+    bounds.height = 40 + shown * rowH + 6;
+    DrawRectangleRec(bounds, theme.panelBg);
+    DrawRectangleLinesEx(bounds, 2, theme.border);
+    std::string title = "References to " + app.referenceWord + " (" + std::to_string(n) + ")";
+    DrawTextEx(font, title.c_str(), {bounds.x + 12, bounds.y + 10}, (float)Config::FONT_SIZE_UI, 1, theme.keyword);
+    float y = bounds.y + 40;
+    for (int i = first; i < first + shown; i++, y += rowH) {
+        const LspClient::Location& loc = app.references[i];
+        Rectangle row = {bounds.x + 2, y, bounds.width - 4, rowH};
+        bool hover = CheckCollisionPointRec(GetMousePosition(), row);
+        if (i == app.referenceSel || hover) DrawRectangleRec(row, theme.selection);
+        if (hover && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) chosen = i;
+        std::string where = fs::path(loc.path).filename().string() + ":" + std::to_string(loc.line) + ":" + std::to_string(loc.col);
+        DrawTextEx(font, where.c_str(), {bounds.x + 12, y + 3}, 18, 1, theme.text);
+        DrawTextEx(font, fs::path(loc.path).parent_path().string().c_str(), {bounds.x + 250, y + 4}, 16, 1, GRAY);
+    }
+    if (chosen >= 0) {
+        const LspClient::Location& loc = app.references[chosen];
+        editor.openAt(loc.path, loc.line, loc.col);
+        app.showReferences = false;
+        app.focus = 0;
+    }
+}
+
+static const double MEMORY_INTERVAL = 2.0;
+static const int MEMORY_ROWS = 8;
+
+static MemoryReport CollectMemory(Editor& editor, Terminal& terminal, Font font, Texture2D logo) {
+    MemoryReport report;
+    editor.memoryUsage(report);
+    terminal.memoryUsage(report);
+    report.add("Textures", "UI font", FontBytes(font));
+    report.add("Textures", "logo", TextureBytes(logo));
+    return report;
+}
+
+// Navbar memory label: where the accounted bytes go, and a dump to data/memory.txt
+void DrawMemory(Rectangle bounds, Font font, AppState& app) {
+    std::vector<MemoryEntry> groups = app.memory.groups();
+    std::vector<MemoryEntry> top = app.memory.largest(MEMORY_ROWS);
+    float rowH = 22;
+    bounds.height = 44 + (groups.size() + top.size()) * rowH + 30 + 44;
+    DrawRectangleRec(bounds, theme.panelBg);
+    DrawRectangleLinesEx(bounds, 2, theme.border);
+    std::string title = "Memory " + FormatBytes(app.memory.total());
+    if (app.memoryResident) title += " (process " + FormatBytes(app.memoryResident) + ")";
+    DrawTextEx(font, title.c_str(), {bounds.x + 12, bounds.y + 10}, (float)Config::FONT_SIZE_UI, 1, theme.keyword);
+    float y = bounds.y + 44;
+    for (const MemoryEntry& g : groups) {
+        DrawTextEx(font, g.group.c_str(), {bounds.x + 12, y}, 18, 1, theme.text);
+        DrawTextEx(font, FormatBytes(g.bytes).c_str(), {bounds.x + bounds.width - 110, y}, 18, 1, theme.text);
+        y += rowH;
+    }
+    y += 8;
+    DrawTextEx(font, "Largest", {bounds.x + 12, y}, 16, 1, theme.keyword);
+    y += rowH;
+    for (const MemoryEntry& e : top) {
+        std::string name = fs::path(e.name).filename().string();
+        if (name.empty()) name = e.name;
+        DrawTextEx(font, name.c_str(), {bounds.x + 12, y}, 16, 1, GRAY);
+        DrawTextEx(font, FormatBytes(e.bytes).c_str(), {bounds.x + bounds.width - 110, y}, 16, 1, GRAY);
+        y += rowH;
+    }
+    std::string budget = settings.memoryBudgetMB > 0 ? "Budget " + std::to_string(settings.memoryBudgetMB) + " MB" : "No budget";
+    DrawTextEx(font, budget.c_str(), {bounds.x + 12, y + 12}, 16, 1, theme.text);
+    Rectangle rDump = {bounds.x + bounds.width - 100, y + 6, 88, 28};
+    if (DrawMenuBtn(rDump, "Dump", font, theme.btnNormal)) {
+        std::error_code ec;
+        fs::create_directories("data", ec);
+        std::ofstream out("data/memory.txt");
+        out << app.memory.dump();
+        ShowToast(out.good() ? "Wrote data/memory.txt" : "Could not write data/memory.txt");
+    }
+    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && !CheckCollisionPointRec(GetMousePosition(), bounds) && GetMousePosition().y > 30) app.showMemory = false;
+}
+
 // --- MISSING FUNCTION ADDED HERE ---
 void OpenModal(AppState& app, int type) {
     app.showMenuFile = false; 
@@ -293,22 +473,30 @@ int main() {
     }
 
     LoadSettings();
-    Font mainFont = LoadFontEx(settings.fontPath.c_str(), 96, 0, 250);
-    SetTextureFilter(mainFont.texture, TEXTURE_FILTER_BILINEAR);
+    Font mainFont = LoadTextFont(settings.fontPath);
     ApplyThemePreset(settings.themeIndex);
     Editor editor; editor.init(mainFont); 
     FileManager fileMgr; fileMgr.init(); 
     Terminal terminal; terminal.init(); 
+    BuildCache buildCache;
+    TaskScheduler scheduler;
+    SyntaxChecker syntaxChecker;
+    SymbolIndex symbols;
+    LspClient lsp;
+    editor.setLanguageClient(&lsp);
     AppState app;
 
     while (!WindowShouldClose()) {
         float w = (float)GetScreenWidth(); 
         float h = (float)GetScreenHeight(); 
         Vector2 m = GetMousePosition();
-        bool isModalOpen = app.showSettings || app.showAbout || app.showMenuFile || app.showMenuHelp;
+        bool isModalOpen = app.showSettings || app.showAbout || app.showMenuFile || app.showMenuHelp || app.showSymbols || app.showReferences || app.showMemory;
 
         if (IsKeyPressed(KEY_ESCAPE)) {
-            if (app.showMenuFile) app.showMenuFile = false;
+            if (app.showSymbols) app.showSymbols = false;
+            else if (app.showReferences) app.showReferences = false;
+            else if (app.showMemory) app.showMemory = false;
+            else if (app.showMenuFile) app.showMenuFile = false;
             else if (app.showMenuHelp) app.showMenuHelp = false;
             else if (app.showSettings) app.showSettings = false;
             else if (app.showAbout) app.showAbout = false;
@@ -386,8 +574,84 @@ int main() {
         if (ctrl && !shift && IsKeyPressed(KEY_O)) { fileMgr.openFileDialog(); app.focus=0; }
         if (ctrl && shift && IsKeyPressed(KEY_O)) { fileMgr.openFolderDialog(); app.focus=1; }
 
+        // Compiler messages from the Run tab; a new run starts a fresh set
+        uint64_t diagRun = app.diagRun;
+        std::vector<Diagnostic> diagBatch;
+        terminal.takeDiagnostics(app.runMakefile ? "build" : "Run", diagRun, diagBatch);
+        if (diagRun != app.diagRun) { editor.clearDiagnostics(); app.diagRun = diagRun; }
+        if (!diagBatch.empty()) editor.addDiagnostics(diagBatch);
+        // Quick Run: the cache check finishes on its worker, then the task starts
+        if (app.runWatch && terminal.taskRunningFor("Run") < 0) { buildCache.finished(app.runPlan); app.runWatch = false; }
+        BuildCache::Plan runPlan;
+        if (buildCache.takePlan(runPlan)) {
+            terminal.runTask("Run", runPlan.command);
+            app.runPlan = runPlan;
+            app.runWatch = true;
+        }
+        scheduler.update(terminal);
+        // Background -fsyntax-only once the buffer has been still for a moment,
+        // unless a language server is already reporting on the file
+        std::string checkPath = editor.getCurrentPath();
+        if (settings.syntaxCheckDelay > 0 && IsCheckableSource(checkPath) && !(lsp.running() && lsp.serves(checkPath)) &&
+            syntaxChecker.settle(checkPath, editor.getCurrentVersion(), GetTime(), settings.syntaxCheckDelay / 1000.0)) {
+            syntaxChecker.submit(checkPath, editor.getCurrentText(), settings.cFlags);
+        }
+        SyntaxChecker::Result checked;
+        while (syntaxChecker.takeResult(checked)) editor.setFileDiagnostics(checked.path, checked.diagnostics);
+        // Go to definition (F12 / Ctrl+click in the editor) and Ctrl+T
+        std::string openedRoot = fileMgr.popOpenedRoot();
+        if (!openedRoot.empty()) {
+            symbols.open(openedRoot);
+            if (!settings.lspCommand.empty() && !lsp.start(settings.lspCommand, openedRoot)) ShowToast("Could not start " + settings.lspCommand);
+        }
+        // Language server results; the editor takes hover and completion
+        LspClient::Event lspEvent;
+        while (lsp.poll(lspEvent)) {
+            if (lspEvent.kind == LspClient::EventKind::Diagnostics) editor.setFileDiagnostics(lspEvent.path, lspEvent.diagnostics);
+            else if (lspEvent.kind == LspClient::EventKind::Exited) ShowToast(lspEvent.text);
+            else editor.languageEvent(lspEvent);
+        }
+        std::string refWord;
+        std::vector<LspClient::Location> refs;
+        if (editor.popReferences(refWord, refs)) {
+            if (refs.empty()) ShowToast("No references to " + refWord);
+            else {
+                app.showReferences = true;
+                app.referenceWord = refWord;
+                app.references = refs;
+                app.referenceSel = 0;
+            }
+        }
+        std::string defWord = editor.popDefinitionRequest();
+        if (!defWord.empty()) {
+            std::vector<SymbolLocation> defs = symbols.lookup(defWord);
+            if (defs.size() == 1) editor.openAt(defs[0].path, defs[0].symbol.line);
+            else if (defs.size() > 1) OpenSymbolSearch(app, defWord);
+            else ShowToast(symbols.indexing() ? "Still indexing, try again shortly" : "No definition found for " + defWord);
+        }
+        if (ctrl && !shift && IsKeyPressed(KEY_T) && !isModalOpen && app.focus != 2) OpenSymbolSearch(app, "");
+        // Over the budget, undo history of background tabs goes first, then
+        // old scrollback; what the libraries and driver hold is not counted.
+        if (GetTime() - app.memoryAt >= MEMORY_INTERVAL) {
+            app.memoryAt = GetTime();
+            app.memory = CollectMemory(editor, terminal, mainFont, logoTexture);
+            app.memoryResident = ProcessResidentBytes();
+            size_t budget = (size_t)settings.memoryBudgetMB << 20;
+            size_t total = app.memory.total();
+            if (budget > 0 && total > budget) {
+                size_t over = total - budget;
+                size_t freed = editor.trimUndo(over);
+                if (freed < over) freed += terminal.trimScrollback(over - freed);
+                if (freed > 0) {
+                    ShowToast("Memory budget: freed " + FormatBytes(freed) + " of undo and scrollback");
+                    app.memory = CollectMemory(editor, terminal, mainFont, logoTexture);
+                }
+            }
+        }
+        if (IsKeyPressed(KEY_F8) && !isModalOpen) { editor.nextDiagnostic(IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT) ? -1 : 1); app.focus=0; }
+
         if (!app.showSettings && !app.showAbout) {
-            fileMgr.update(rFiles, app.focus==1 && !app.showMenuFile); 
+            fileMgr.update(rFiles, app.focus==1 && !app.showMenuFile && !app.showSymbols && !app.showReferences); 
             std::string sel = fileMgr.popSelectedFile();
             if (!sel.empty()) {
                 auto lower = sel;
@@ -413,12 +677,13 @@ int main() {
                     app.focus=0;
                 }
             }
-            terminal.update(app.focus==2); 
-            editor.update(rEdit, app.focus==0 && !app.showMenuFile && !app.showMenuHelp);
+            terminal.update(app.focus==2 && !app.showSymbols && !app.showReferences); 
+            editor.update(rEdit, app.focus==0 && !app.showMenuFile && !app.showMenuHelp && !app.showSymbols && !app.showReferences && !app.showMemory);
         }
 
         BeginDrawing();
             ClearBackground(theme.bg);
+            BeginText(mainFont);
             DrawRectangle(0,0,w,Config::NAVBAR_HEIGHT,theme.panelBg); 
             
             // Draw Menus
@@ -430,51 +695,72 @@ int main() {
             float runX = w - 140; 
             Rectangle rRun = {runX, 0, 140, 30}; 
             bool hRun = CheckCollisionPointRec(m, rRun);
+            double runFor = terminal.taskRunningFor("Run");
             DrawRectangleRec(rRun, hRun ? theme.runButton : theme.panelBg); 
             DrawRectangleLinesEx(rRun, 1, theme.border);
-            DrawTextEx(mainFont, app.runMakefile ? "Run: Make" : "Run: File", {runX+10, 5}, 20, 1, WHITE);
+            BuildCache::Status cacheStatus = buildCache.status();
+            std::string runLabel = runFor >= 0 ? TextFormat("Stop %.1fs", runFor) : app.runMakefile ? "Run: Make" : cacheStatus == BuildCache::CHECKING ? "Checking..." : "Run: File";
+            DrawTextEx(mainFont, runLabel.c_str(), {runX+10, 5}, 20, 1, WHITE);
+            // Whether the last Quick Run came from the build cache
+            if (!app.runMakefile && runFor < 0 && (cacheStatus == BuildCache::HIT || cacheStatus == BuildCache::MISS)) {
+                bool hit = cacheStatus == BuildCache::HIT;
+                DrawTextEx(mainFont, hit ? "hit" : "miss", {runX+100, 8}, 14, 1, hit ? theme.runButton : ORANGE);
+            }
             
+            // Builds run in a terminal tab of their own; clicking again stops them
             if (hRun && IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && !isModalOpen) {
-                std::string cmd;
-                if (app.runMakefile) {
-#ifdef _WIN32
-                    cmd = "start cmd /c \"make && pause\"";
-#elif defined(__linux__)
-                    cmd = "x-terminal-emulator -e sh -lc \"make; echo; read -n1 -p 'Press any key to close'\"";
-#else
-                    cmd = "osascript -e 'tell app \"Terminal\" to do script \"make; read -n 1\"'";
-#endif
-                }
+                if (runFor >= 0) terminal.cancelTask("Run");
+                else if (app.runMakefile) scheduler.trigger("build", editor.getCurrentPath(), terminal);
                 else {
                     std::string path = editor.getCurrentPath();
-                    if (path.empty()) terminal.runCommand("echo No file selected");
-                    else {
-                        std::string buildCmd = settings.cFlags;
-                        size_t pos = buildCmd.find("$FILE");
-                        if (pos != std::string::npos) buildCmd.replace(pos, 5, "\"" + path + "\"");
-#ifdef _WIN32
-                        cmd = "start cmd /c \"" + buildCmd + " && echo. && pause\"";
-#elif defined(__linux__)
-                        cmd = "x-terminal-emulator -e sh -lc \"" + buildCmd + "; echo; read -n1 -p 'Press any key to close'\"";
-#else
-                        cmd = "osascript -e 'tell app \"Terminal\" to do script \"" + buildCmd + "; read -n 1\"'";
-#endif
-                    }
-                }
-                if (!cmd.empty()) { 
-                    system(cmd.c_str()); 
-                    terminal.runCommand("echo Launched external console...");
+                    if (path.empty()) ShowToast("No file selected");
+                    else if (buildCache.status() != BuildCache::CHECKING) buildCache.check(settings.cFlags, path);
                 }
+                if (settings.layout != LayoutMode::Focus) app.focus = 2;
             }
             if (hRun && IsMouseButtonPressed(MOUSE_RIGHT_BUTTON)) app.runMakefile = !app.runMakefile;
+
+            // Accounted memory; amber from 90% of the budget
+            float memX = runX - 100;
+            Rectangle rMem = {memX, 4, 96, 22};
+            bool hMem = CheckCollisionPointRec(m, rMem);
+            size_t budget = (size_t)settings.memoryBudgetMB << 20;
+            if (hMem || app.showMemory) DrawRectangleRec(rMem, theme.btnNormal);
+            std::string memLabel = FormatBytes(app.memory.total());
+            Color memColor = budget > 0 && app.memory.total() * 10 >= budget * 9 ? ORANGE : GRAY;
+            DrawTextEx(mainFont, memLabel.c_str(), {memX + 96 - MeasureTextEx(mainFont, memLabel.c_str(), 16, 1).x - 6, 7}, 16, 1, memColor);
+            if (hMem && IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && (!isModalOpen || app.showMemory)) app.showMemory = !app.showMemory;
+
+            // Task badges: click runs the task and its dependencies, right-click cancels
+            float taskX = 230;
+            for (const TaskDef& task : settings.tasks) {
+                float tw = MeasureTextEx(mainFont, task.name.c_str(), 16, 1).x + 22;
+                if (taskX + tw > memX - 10) break;
+                Rectangle rTask = {taskX, 4, tw, 22};
+                bool hTask = CheckCollisionPointRec(m, rTask);
+                TaskScheduler::State ts = scheduler.state(task.name);
+                Color dot = ts == TaskScheduler::WAITING ? YELLOW : ts == TaskScheduler::RUNNING ? theme.keyword :
+                            ts == TaskScheduler::SUCCEEDED ? theme.runButton : ts == TaskScheduler::FAILED ? theme.closeBtn : GRAY;
+                if (hTask) DrawRectangleRec(rTask, theme.btnNormal);
+                DrawCircle(taskX + 9, 15, 4, dot);
+                DrawTextEx(mainFont, task.name.c_str(), {taskX + 17, 7}, 16, 1, theme.text);
+                if (hTask && !isModalOpen) {
+                    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) scheduler.trigger(task.name, editor.getCurrentPath(), terminal);
+                    if (IsMouseButtonPressed(MOUSE_RIGHT_BUTTON)) scheduler.cancel(task.name, terminal);
+                }
+                taskX += tw + 4;
+            }
             
             DrawLine(0,Config::NAVBAR_HEIGHT,w,Config::NAVBAR_HEIGHT,theme.border);
+            EndText(mainFont);
 
+            // Panels switch the text shader around their own textures
             if (settings.layout != LayoutMode::Focus) { 
                 fileMgr.render(rFiles, mainFont); 
                 terminal.render(rTerm, mainFont); 
             }
             editor.render(rEdit);
+            BeginText(mainFont);
             
             // Highlight active panel
             Rectangle rf = (app.focus==0) ? rEdit : (app.focus==1) ? rFiles : rTerm; 
@@ -483,25 +769,27 @@ int main() {
             // Dropdowns
             if (app.showMenuFile) {
                 float mx=0,my=30,mw=260; 
-                DrawRectangle(mx,my,mw,180,theme.panelBg); 
-                DrawRectangleLines(mx,my,mw,180,theme.border);
+                DrawRectangle(mx,my,mw,210,theme.panelBg); 
+                DrawRectangleLines(mx,my,mw,210,theme.border);
                 if(DrawMenuItem(mx,my,mw,"New (Ctrl+N)",mainFont)) { editor.createNewFile(); app.showMenuFile=false; }
                 if(DrawMenuItem(mx,my+30,mw,"Open File (Ctrl+O)",mainFont)) { fileMgr.openFileDialog(); app.focus=0; app.showMenuFile=false; }
                 if(DrawMenuItem(mx,my+60,mw,"Open Folder (Ctrl+Sh+O)",mainFont)) { fileMgr.openFolderDialog(); app.focus=1; app.showMenuFile=false; }
                 if(DrawMenuItem(mx,my+90,mw,"Save (Ctrl+S)",mainFont)) { editor.saveFile(); app.showMenuFile=false; }
                 if(DrawMenuItem(mx,my+120,mw,"Save As...",mainFont)) { editor.saveAs(); app.showMenuFile=false; }
-                if(DrawMenuItem(mx,my+150,mw,"Exit",mainFont)) break;
-                if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && !CheckCollisionPointRec(m, {mx,my,mw,180}) && m.y > 30) app.showMenuFile = false;
+                if(DrawMenuItem(mx,my+150,mw,"Save Terminal Log",mainFont)) { terminal.saveLog(); app.showMenuFile=false; }
+                if(DrawMenuItem(mx,my+180,mw,"Exit",mainFont)) break;
+                if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && !CheckCollisionPointRec(m, {mx,my,mw,210}) && m.y > 30) app.showMenuFile = false;
             }
             if (app.showMenuHelp) {
                 float mx=60,my=30,mw=300; 
-                DrawRectangle(mx,my,mw,130,theme.panelBg); 
-                DrawRectangleLines(mx,my,mw,130,theme.border);
+                DrawRectangle(mx,my,mw,160,theme.panelBg); 
+                DrawRectangleLines(mx,my,mw,160,theme.border);
                 if(DrawMenuItem(mx,my,mw,"About ctom", mainFont)) OpenModal(app, 2);
-                DrawTextEx(mainFont,"Shortcuts:",{mx+10,my+35},18,1,theme.keyword);
-                DrawTextEx(mainFont,"Ctrl+O/S/C/V/A", {mx+10,my+55},18,1,theme.menuText);
-                DrawTextEx(mainFont,"Hover Tab 'x': Close", {mx+10,my+75},18,1,theme.menuText);
-                if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && !CheckCollisionPointRec(m, {mx,my,mw,130}) && m.y > 30) app.showMenuHelp = false;
+                if(DrawMenuItem(mx,my+30,mw,"Benchmark Lexers", mainFont)) { ShowToast(editor.benchmarkLexers()); app.showMenuHelp = false; }
+                DrawTextEx(mainFont,"Shortcuts:",{mx+10,my+65},18,1,theme.keyword);
+                DrawTextEx(mainFont,"Ctrl+O/S/C/V/A", {mx+10,my+85},18,1,theme.menuText);
+                DrawTextEx(mainFont,"Hover Tab 'x': Close", {mx+10,my+105},18,1,theme.menuText);
+                if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && !CheckCollisionPointRec(m, {mx,my,mw,160}) && m.y > 30) app.showMenuHelp = false;
             }
 
             if (app.showSettings) { 
@@ -513,16 +801,23 @@ int main() {
                 DrawAbout({(w-400)/2, (h-250)/2, 400, 250}, mainFont, app, logoTexture); 
             }
             
+            if (app.showSymbols) DrawSymbolSearch({(w-600)/2, 60, 600, 0}, mainFont, app, symbols, editor);
+            if (app.showReferences) DrawReferences({(w-600)/2, 60, 600, 0}, mainFont, app, editor);
+            if (app.showMemory) DrawMemory({w - 440, 32, 420, 0}, mainFont, app);
+
             DrawToasts(mainFont, w, h);
+            EndText(mainFont);
         EndDrawing();
     }
 
+    editor.cleanup();
     CloseAudioDevice();
     
     if (logoTexture.id > 0) UnloadTexture(logoTexture);
     fileMgr.cleanup(); 
+    terminal.cleanup();
     SaveSettings(); 
-    UnloadFont(mainFont); 
+    UnloadTextFont(mainFont); 
     CloseWindow(); 
     return 0;
 }
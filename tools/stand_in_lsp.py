@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+"""Stand-in language server for trying out LspClient without clangd.
+
+Run it from the editor by setting, in data/settings.cfg:
+
+    lsp=python3 /path/to/ctom/tools/stand_in_lsp.py [--utf16] [--slow SECONDS] [--mirror DIR]
+
+It keeps its own copy of every open document, applying didChange ranges the
+way a real server would, and after each change publishes one diagnostic on
+the first line giving the copy's line count and CRC-32. A range that does not
+fit the copy (past the end of a line, or inside a multi-byte character) is
+reported as an error on the line it points at, which is what a broken
+didChange merge looks like.
+
+  --utf16         do not offer UTF-8 positions, so the client counts UTF-16 units
+  --slow SECONDS  wait this long before answering hover, completion and references
+  --mirror DIR    write each document's copy to DIR after every change; diff it
+                  against the file once saved
+
+Hover, completion and references return canned answers.
+"""
+import argparse
+import json
+import os
+import sys
+import time
+import zlib
+from urllib.parse import unquote
+
+
+def read_message():
+    headers = {}
+    while True:
+        line = sys.stdin.buffer.readline()
+        if not line:
+            return None
+        line = line.decode('ascii').strip()
+        if not line:
+            break
+        key, value = line.split(':', 1)
+        headers[key.lower()] = value.strip()
+    return json.loads(sys.stdin.buffer.read(int(headers['content-length'])))
+
+
+def send(message):
+    message['jsonrpc'] = '2.0'
+    body = json.dumps(message).encode('utf-8')
+    sys.stdout.buffer.write(b'Content-Length: %d\r\n\r\n' % len(body) + body)
+    sys.stdout.buffer.flush()
+
+
+class OutOfRange(Exception):
+    def __init__(self, line, message):
+        Exception.__init__(self, message)
+        self.line = line
+
+
+def byte_offset(text, pos, utf16):
+    """Byte offset of an LSP position in `text` (bytes), or OutOfRange."""
+    lines = text.split(b'\n')
+    row, col = pos['line'], pos['character']
+    if row >= len(lines):
+        # The position just past the last line is where appends land
+        if row == len(lines) and col == 0:
+            return len(text)
+        raise OutOfRange(len(lines) - 1, 'line %d past the end (%d lines)' % (row + 1, len(lines)))
+    line = lines[row]
+    if utf16:
+        units = 0
+        index = 0
+        chars = line.decode('utf-8')
+        while units < col and index < len(chars):
+            units += 2 if ord(chars[index]) > 0xFFFF else 1
+            index += 1
+        if units != col:
+            raise OutOfRange(row, 'column %d not on a character of line %d' % (col, row + 1))
+        col = len(chars[:index].encode('utf-8'))
+    elif col > len(line) or (col < len(line) and (line[col] & 0xC0) == 0x80):
+        raise OutOfRange(row, 'column %d not on a character of line %d' % (col, row + 1))
+    return sum(len(l) + 1 for l in lines[:row]) + col
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Stand-in language server for ctom.')
+    parser.add_argument('--utf16', action='store_true')
+    parser.add_argument('--slow', type=float, default=0.0)
+    parser.add_argument('--mirror')
+    args = parser.parse_args()
+
+    docs = {}
+
+    def publish(uri, diagnostics):
+        send({'method': 'textDocument/publishDiagnostics', 'params': {'uri': uri, 'diagnostics': diagnostics}})
+
+    def at_line(line, severity, message):
+        return {'range': {'start': {'line': line, 'character': 0}, 'end': {'line': line, 'character': 1}},
+                'severity': severity, 'source': 'stand-in', 'message': message}
+
+    def report(uri):
+        text = docs[uri]
+        if args.mirror:
+            name = os.path.basename(unquote(uri).rstrip('/')) or 'untitled'
+            with open(os.path.join(args.mirror, name), 'wb') as f:
+                f.write(text)
+        summary = 'copy: %d lines, crc32 %08x' % (text.count(b'\n') + 1, zlib.crc32(text) & 0xFFFFFFFF)
+        publish(uri, [at_line(0, 3, summary)])
+
+    while True:
+        message = read_message()
+        if message is None:
+            break
+        method = message.get('method')
+        params = message.get('params') or {}
+
+        if method == 'initialize':
+            caps = {'hoverProvider': True, 'completionProvider': {}, 'referencesProvider': True,
+                    'textDocumentSync': {'openClose': True, 'change': 2}}
+            if not args.utf16:
+                caps['positionEncoding'] = 'utf-8'
+            send({'id': message['id'], 'result': {'capabilities': caps}})
+        elif method == 'textDocument/didOpen':
+            doc = params['textDocument']
+            docs[doc['uri']] = doc['text'].encode('utf-8')
+            report(doc['uri'])
+        elif method == 'textDocument/didClose':
+            docs.pop(params['textDocument']['uri'], None)
+        elif method == 'textDocument/didChange':
+            uri = params['textDocument']['uri']
+            if uri not in docs:
+                continue
+            try:
+                for change in params['contentChanges']:
+                    new = change['text'].encode('utf-8')
+                    if 'range' not in change:
+                        docs[uri] = new
+                        continue
+                    text = docs[uri]
+                    start = byte_offset(text, change['range']['start'], args.utf16)
+                    end = byte_offset(text, change['range']['end'], args.utf16)
+                    if end < start:
+                        raise OutOfRange(change['range']['start']['line'], 'range ends before it starts')
+                    docs[uri] = text[:start] + new + text[end:]
+                report(uri)
+            except OutOfRange as e:
+                publish(uri, [at_line(max(e.line, 0), 1, 'didChange out of step: ' + str(e))])
+        elif method in ('textDocument/hover', 'textDocument/completion', 'textDocument/references'):
+            if args.slow > 0:
+                time.sleep(args.slow)
+            pos = params['position']
+            if method == 'textDocument/hover':
+                value = '```\nstand-in hover at %d:%d\n```' % (pos['line'] + 1, pos['character'] + 1)
+                result = {'contents': {'kind': 'markdown', 'value': value}}
+            elif method == 'textDocument/completion':
+                result = {'isIncomplete': False, 'items': [{'label': 'standIn()', 'insertText': 'standIn'}, {'label': 'standInValue'}]}
+            else:
+                result = [{'uri': params['textDocument']['uri'], 'range': {'start': pos, 'end': pos}}]
+            send({'id': message['id'], 'result': result})
+        elif method == 'shutdown':
+            send({'id': message['id'], 'result': None})
+        elif method == 'exit':
+            break
+        elif 'id' in message and method is not None:
+            send({'id': message['id'], 'error': {'code': -32601, 'message': 'not handled: ' + method}})
+
+
+if __name__ == '__main__':
+    main()